@@ -0,0 +1,279 @@
+#include "AllocatorVk.h"
+#include "vulkan.h"
+
+#include <algorithm>
+
+AllocatorVk::AllocatorVk()
+	: m_device()
+	, m_memoryProperties()
+	, m_granularity(1)
+	, m_dedicatedAllocation(false)
+	, vkGetImageMemoryRequirements2KHR(nullptr)
+{
+}
+
+AllocatorVk::~AllocatorVk()
+{
+	for (auto& block : m_blocks)
+	{
+		if (block)
+			vkFreeMemory(m_device, block->Memory, nullptr);
+	}
+}
+
+bool AllocatorVk::Init(VkDevice device, VkPhysicalDevice physicalDevice, VkInstance instance)
+{
+	VK_DEVICE_FUNCTION(device, vkAllocateMemory)
+	VK_DEVICE_FUNCTION(device, vkFreeMemory)
+	VK_DEVICE_FUNCTION(device, vkBindImageMemory)
+	VK_DEVICE_FUNCTION(device, vkGetImageMemoryRequirements)
+
+	// OpenVR requires VK_KHR_get_memory_requirements2 and VK_KHR_dedicated_allocation, but don't rely on
+	// the application to enable them. Without them every allocation is a plain allocation.
+	m_dedicatedAllocation = IsDeviceExtensionEnabled(device, VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME) &&
+		IsDeviceExtensionEnabled(device, VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
+	vkGetImageMemoryRequirements2KHR = nullptr;
+	if (m_dedicatedAllocation)
+	{
+		vkGetImageMemoryRequirements2KHR = (PFN_vkGetImageMemoryRequirements2KHR)
+			vkGetDeviceProcAddr(device, "vkGetImageMemoryRequirements2KHR");
+		m_dedicatedAllocation = vkGetImageMemoryRequirements2KHR != nullptr;
+	}
+
+	vkGetPhysicalDeviceProperties = (PFN_vkGetPhysicalDeviceProperties)
+		vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties");
+	if (!vkGetPhysicalDeviceProperties)
+		return false;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	m_granularity = properties.limits.bufferImageGranularity;
+
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+	m_device = device;
+	return true;
+}
+
+bool AllocatorVk::GetMemoryType(uint32_t typeBits, VkMemoryPropertyFlags flags, uint32_t* typeIndex)
+{
+	auto it = m_memoryTypes.find(std::make_pair(typeBits, flags));
+	if (it != m_memoryTypes.end())
+	{
+		*typeIndex = it->second;
+		return true;
+	}
+
+	// Search memtypes to find first index with those properties
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+	{
+		if ((typeBits & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+		{
+			m_memoryTypes[std::make_pair(typeBits, flags)] = i;
+			*typeIndex = i;
+			return true;
+		}
+	}
+
+	// No memory types matched, return failure
+	return false;
+}
+
+bool AllocatorVk::AllocateImage(VkImage image, VkMemoryPropertyFlags flags, AllocationVk* outAllocation)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	VkMemoryRequirements requirements;
+	bool dedicated = false;
+	if (vkGetImageMemoryRequirements2KHR)
+	{
+		VkMemoryDedicatedRequirementsKHR dedicatedRequirements = {};
+		dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR;
+		VkMemoryRequirements2KHR requirements2 = {};
+		requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR;
+		requirements2.pNext = &dedicatedRequirements;
+		VkImageMemoryRequirementsInfo2KHR info = {};
+		info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR;
+		info.image = image;
+
+		vkGetImageMemoryRequirements2KHR(m_device, &info, &requirements2);
+		requirements = requirements2.memoryRequirements;
+		dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	}
+	else
+	{
+		vkGetImageMemoryRequirements(m_device, image, &requirements);
+	}
+
+	uint32_t memoryType;
+	if (!GetMemoryType(requirements.memoryTypeBits, flags, &memoryType))
+		return false;
+
+	// Allocations are aligned to their size, so the alignment and the granularity only increase the size
+	VkDeviceSize size = (std::max)((std::max)(requirements.size, requirements.alignment), (std::max)(m_granularity, REV_VK_MIN_ALLOCATION));
+	uint32_t order = 0;
+	while ((REV_VK_MIN_ALLOCATION << order) < size)
+		order++;
+
+	// Don't waste a whole block or half of it on a single image
+	if (dedicated || order >= REV_VK_ORDER_COUNT - 2)
+		return AllocateDedicated(image, requirements, memoryType, outAllocation);
+
+	uint32_t index = 0;
+	VkDeviceSize offset = 0;
+	Block* block = nullptr;
+	for (; index < m_blocks.size(); index++)
+	{
+		block = m_blocks[index].get();
+		if (block && block->MemoryType == memoryType && AllocateFromBlock(block, order, &offset))
+			break;
+		block = nullptr;
+	}
+
+	if (!block)
+	{
+		// Fall back to a dedicated allocation if there's not enough memory for a new block
+		block = CreateBlock(memoryType, &index);
+		if (!block || !AllocateFromBlock(block, order, &offset))
+			return AllocateDedicated(image, requirements, memoryType, outAllocation);
+	}
+
+	if (vkBindImageMemory(m_device, image, block->Memory, offset) != VK_SUCCESS)
+	{
+		FreeToBlock(block, offset, order);
+		return false;
+	}
+
+	outAllocation->Memory = block->Memory;
+	outAllocation->Offset = offset;
+	outAllocation->Block = index;
+	outAllocation->Order = order;
+	return true;
+}
+
+bool AllocatorVk::AllocateDedicated(VkImage image, const VkMemoryRequirements& requirements, uint32_t memoryType, AllocationVk* outAllocation)
+{
+	VkMemoryDedicatedAllocateInfoKHR dedicatedInfo = {};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR;
+	dedicatedInfo.image = image;
+
+	VkMemoryAllocateInfo memAlloc = {};
+	memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memAlloc.pNext = m_dedicatedAllocation ? &dedicatedInfo : nullptr;
+	memAlloc.allocationSize = requirements.size;
+	memAlloc.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_device, &memAlloc, nullptr, &memory) != VK_SUCCESS)
+		return false;
+
+	if (vkBindImageMemory(m_device, image, memory, 0) != VK_SUCCESS)
+	{
+		vkFreeMemory(m_device, memory, nullptr);
+		return false;
+	}
+
+	outAllocation->Memory = memory;
+	outAllocation->Offset = 0;
+	outAllocation->Block = REV_VK_DEDICATED;
+	outAllocation->Order = 0;
+	return true;
+}
+
+AllocatorVk::Block* AllocatorVk::CreateBlock(uint32_t memoryType, uint32_t* outIndex)
+{
+	VkMemoryAllocateInfo memAlloc = {};
+	memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memAlloc.allocationSize = REV_VK_BLOCK_SIZE;
+	memAlloc.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_device, &memAlloc, nullptr, &memory) != VK_SUCCESS)
+		return nullptr;
+
+	Block* block = new Block();
+	block->Memory = memory;
+	block->MemoryType = memoryType;
+	block->Used = 0;
+	block->FreeLists[REV_VK_ORDER_COUNT - 1].push_back(0);
+
+	// Reuse the slot of a released block, so the indices of the other blocks stay valid
+	auto it = std::find(m_blocks.begin(), m_blocks.end(), nullptr);
+	*outIndex = uint32_t(it - m_blocks.begin());
+	if (it != m_blocks.end())
+		it->reset(block);
+	else
+		m_blocks.emplace_back(block);
+	return block;
+}
+
+bool AllocatorVk::AllocateFromBlock(Block* block, uint32_t order, VkDeviceSize* outOffset)
+{
+	// Find the smallest free allocation that fits
+	uint32_t current = order;
+	while (current < REV_VK_ORDER_COUNT && block->FreeLists[current].empty())
+		current++;
+	if (current == REV_VK_ORDER_COUNT)
+		return false;
+
+	VkDeviceSize offset = block->FreeLists[current].back();
+	block->FreeLists[current].pop_back();
+
+	// Split it until it has the right size, the upper halves become free buddies
+	while (current > order)
+	{
+		current--;
+		block->FreeLists[current].push_back(offset + (REV_VK_MIN_ALLOCATION << current));
+	}
+
+	block->Used += REV_VK_MIN_ALLOCATION << order;
+	*outOffset = offset;
+	return true;
+}
+
+void AllocatorVk::FreeToBlock(Block* block, VkDeviceSize offset, uint32_t order)
+{
+	block->Used -= REV_VK_MIN_ALLOCATION << order;
+
+	// Merge with the buddy for as long as it's free
+	while (order < REV_VK_ORDER_COUNT - 1)
+	{
+		std::vector<VkDeviceSize>& list = block->FreeLists[order];
+		auto buddy = std::find(list.begin(), list.end(), offset ^ (REV_VK_MIN_ALLOCATION << order));
+		if (buddy == list.end())
+			break;
+
+		list.erase(buddy);
+		offset &= ~(REV_VK_MIN_ALLOCATION << order);
+		order++;
+	}
+
+	block->FreeLists[order].push_back(offset);
+}
+
+void AllocatorVk::Free(const AllocationVk& allocation)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	if (allocation.Block == REV_VK_DEDICATED)
+	{
+		vkFreeMemory(m_device, allocation.Memory, nullptr);
+		return;
+	}
+
+	std::unique_ptr<Block>& block = m_blocks[allocation.Block];
+	FreeToBlock(block.get(), allocation.Offset, allocation.Order);
+
+	// Release empty blocks, but keep one block per memory type to avoid churn
+	if (block->Used == 0)
+	{
+		for (auto& other : m_blocks)
+		{
+			if (other && other != block && other->MemoryType == block->MemoryType)
+			{
+				vkFreeMemory(m_device, block->Memory, nullptr);
+				block.reset();
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "vulkan.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Device memory is allocated in large blocks, which are divided with a buddy allocator
+#define REV_VK_BLOCK_SIZE (256ull << 20)
+#define REV_VK_MIN_ALLOCATION (64ull << 10)
+#define REV_VK_ORDER_COUNT 13 // log2(REV_VK_BLOCK_SIZE / REV_VK_MIN_ALLOCATION) + 1
+
+#define REV_VK_DEDICATED UINT32_MAX
+
+struct AllocationVk
+{
+	VkDeviceMemory Memory;
+	VkDeviceSize Offset;
+	uint32_t Block;  // Index of the block or REV_VK_DEDICATED for dedicated allocations
+	uint32_t Order;
+};
+
+/*
+	Sub-allocator for image memory, images that are half a block or larger or that the driver
+	wants a dedicated allocation for get their own allocation. Thread-safe, shared by the textures
+	so it outlives the compositor if textures are destroyed after it.
+*/
+class AllocatorVk
+{
+public:
+	AllocatorVk();
+	~AllocatorVk();
+
+	bool Init(VkDevice device, VkPhysicalDevice physicalDevice, VkInstance instance);
+
+	// Allocates memory for the image and binds it
+	bool AllocateImage(VkImage image, VkMemoryPropertyFlags flags, AllocationVk* outAllocation);
+	void Free(const AllocationVk& allocation);
+
+private:
+	struct Block
+	{
+		VkDeviceMemory Memory;
+		uint32_t MemoryType;
+		VkDeviceSize Used;
+
+		// Free offsets for every order, an allocation of order n is REV_VK_MIN_ALLOCATION << n bytes
+		std::vector<VkDeviceSize> FreeLists[REV_VK_ORDER_COUNT];
+	};
+
+	std::mutex m_mutex;
+	VkDevice m_device;
+	VkPhysicalDeviceMemoryProperties m_memoryProperties;
+	VkDeviceSize m_granularity;
+	bool m_dedicatedAllocation;
+	std::vector<std::unique_ptr<Block>> m_blocks;
+	std::map<std::pair<uint32_t, VkMemoryPropertyFlags>, uint32_t> m_memoryTypes;
+
+	bool GetMemoryType(uint32_t typeBits, VkMemoryPropertyFlags flags, uint32_t* typeIndex);
+	bool AllocateDedicated(VkImage image, const VkMemoryRequirements& requirements, uint32_t memoryType, AllocationVk* outAllocation);
+	bool AllocateFromBlock(Block* block, uint32_t order, VkDeviceSize* outOffset);
+	void FreeToBlock(Block* block, VkDeviceSize offset, uint32_t order);
+	Block* CreateBlock(uint32_t memoryType, uint32_t* outIndex);
+
+	VK_DEFINE_FUNCTION(vkAllocateMemory)
+	VK_DEFINE_FUNCTION(vkFreeMemory)
+	VK_DEFINE_FUNCTION(vkBindImageMemory)
+	VK_DEFINE_FUNCTION(vkGetImageMemoryRequirements)
+	VK_DEFINE_FUNCTION(vkGetImageMemoryRequirements2KHR)
+	VK_DEFINE_FUNCTION(vkGetPhysicalDeviceProperties)
+};
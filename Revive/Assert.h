@@ -1,10 +1,6 @@
 #pragma once
 
 #include "microprofile.h"
+#include "Trace.h"
 
-#if 0
-#include <Windows.h>
-#define REV_TRACE(x) OutputDebugStringA("Revive: " #x "\n");
-#else
-#define REV_TRACE(x) MICROPROFILE_SCOPEI("Revive", #x, 0xff0000);
-#endif
+#define REV_TRACE(x) MICROPROFILE_SCOPEI("Revive", #x, 0xff0000); REV_TRACE_SCOPE(#x);
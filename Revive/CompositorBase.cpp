@@ -1,9 +1,11 @@
 #include "CompositorBase.h"
+#include "FramePacer.h"
 #include "OVR_CAPI.h"
 #include "REV_Math.h"
 #include "Settings.h"
 #include "Session.h"
 #include "SessionDetails.h"
+#include "Trace.h"
 #include "microprofile.h"
 #include "rcu_ptr.h"
 
@@ -42,31 +44,42 @@ ovrResult rev_CompositorErrorToOvrError(vr::EVRCompositorError error)
 CompositorBase::CompositorBase()
 	: m_MirrorTexture(nullptr)
 	, m_ChainCount(0)
+	, m_OverlayCount(0)
+	, m_FrameCount(0)
+	, m_SkyboxSize(0)
+	, m_SkyboxFormat(OVR_FORMAT_UNKNOWN)
+	, m_SkyboxIdentifier(0)
+	, m_SkyboxCommitCount(0)
+	, m_SkyboxOrientation()
+	, m_SkyboxActive(false)
+	, m_SceneTextures()
+	, m_SceneViewports()
 {
 }
 
 CompositorBase::~CompositorBase()
 {
+	ClearSkybox();
+
 	if (m_MirrorTexture)
 		delete m_MirrorTexture;
 }
 
-ovrResult CompositorBase::CreateTextureSwapChain(const ovrTextureSwapChainDesc* desc, ovrTextureSwapChain* out_TextureSwapChain)
+ovrResult CompositorBase::CreateTextureSwapChain(const ovrTextureSwapChainDesc* desc, ovrTextureSwapChain* out_TextureSwapChain, int length)
 {
 	ovrTextureSwapChain swapChain = new ovrTextureSwapChainData(*desc);
 	swapChain->Identifier = m_ChainCount++;
-
-	// FIXME: A bug in OpenVR causes Asynchronous Reprojection to fail with swapchains
-	if (GetAPI() == vr::TextureType_OpenGL)
-		swapChain->Length = 1;
+	swapChain->Length = length;
 
 	for (int i = 0; i < swapChain->Length; i++)
 	{
-		TextureBase* texture = CreateTexture();
-		bool success = texture->Init(desc->Type, desc->Width, desc->Height, desc->MipLevels,
-			desc->ArraySize, desc->Format, desc->MiscFlags, desc->BindFlags);
-		if (!success)
+		TextureBase* texture = AcquireTexture(desc);
+		if (!texture)
+		{
+			// Return the textures we already got to the pool
+			DestroyTextureSwapChain(swapChain);
 			return ovrError_RuntimeException;
+		}
 		swapChain->Textures[i].reset(texture);
 	}
 
@@ -74,6 +87,72 @@ ovrResult CompositorBase::CreateTextureSwapChain(const ovrTextureSwapChainDesc*
 	return ovrSuccess;
 }
 
+void CompositorBase::DestroyTextureSwapChain(ovrTextureSwapChain chain)
+{
+	{
+		std::lock_guard<std::mutex> lk(m_PoolMutex);
+
+		// Keep the textures for swapchains that are recreated, e.g. when an application changes its resolution
+		for (int i = 0; i < chain->Length; i++)
+		{
+			if (chain->Textures[i])
+				m_TexturePool.push_front(PooledTexture{ chain->Desc, m_FrameCount, std::move(chain->Textures[i]) });
+		}
+
+		while (m_TexturePool.size() > REV_TEXTURE_POOL_SIZE)
+			m_TexturePool.pop_back();
+		MICROPROFILE_COUNTER_SET("TexturePool/Size", m_TexturePool.size());
+	}
+
+	delete chain;
+}
+
+TextureBase* CompositorBase::AcquireTexture(const ovrTextureSwapChainDesc* desc)
+{
+	{
+		std::lock_guard<std::mutex> lk(m_PoolMutex);
+
+		// Reuse the most recently released texture with the same description that is no longer in use
+		for (auto it = m_TexturePool.begin(); it != m_TexturePool.end(); it++)
+		{
+			const ovrTextureSwapChainDesc& pooled = it->Desc;
+			if (pooled.Type == desc->Type && pooled.Format == desc->Format && pooled.ArraySize == desc->ArraySize &&
+				pooled.Width == desc->Width && pooled.Height == desc->Height && pooled.MipLevels == desc->MipLevels &&
+				pooled.SampleCount == desc->SampleCount && pooled.MiscFlags == desc->MiscFlags &&
+				pooled.BindFlags == desc->BindFlags && it->Texture->FenceSignaled())
+			{
+				TextureBase* texture = it->Texture.release();
+				m_TexturePool.erase(it);
+				MICROPROFILE_COUNTER_ADD("TexturePool/Hits", 1);
+				MICROPROFILE_COUNTER_SET("TexturePool/Size", m_TexturePool.size());
+				return texture;
+			}
+		}
+	}
+
+	MICROPROFILE_COUNTER_ADD("TexturePool/Misses", 1);
+	TextureBase* texture = CreateTexture();
+	bool success = texture->Init(desc->Type, desc->Width, desc->Height, desc->MipLevels,
+		desc->ArraySize, desc->Format, desc->MiscFlags, desc->BindFlags);
+	if (!success)
+	{
+		delete texture;
+		return nullptr;
+	}
+	return texture;
+}
+
+void CompositorBase::TrimTexturePool()
+{
+	std::lock_guard<std::mutex> lk(m_PoolMutex);
+
+	// Release the textures that haven't been reused for a while, starting with the least recently released
+	m_FrameCount++;
+	while (!m_TexturePool.empty() && m_FrameCount - m_TexturePool.back().ReleaseFrame > REV_TEXTURE_POOL_LIFETIME)
+		m_TexturePool.pop_back();
+	MICROPROFILE_COUNTER_SET("TexturePool/Size", m_TexturePool.size());
+}
+
 ovrResult CompositorBase::CreateMirrorTexture(const ovrMirrorTextureDesc* desc, ovrMirrorTexture* out_MirrorTexture)
 {
 	// There can only be one mirror texture at a time
@@ -98,13 +177,12 @@ ovrResult CompositorBase::WaitToBeginFrame(ovrSession session, long long frameIn
 {
 	MICROPROFILE_SCOPE(WaitToBeginFrame);
 
-	vr::EVRCompositorError err = vr::VRCompositorError_None;
-	for (long long index = session->FrameIndex; index < frameIndex; index++)
-	{
-		// Call WaitGetPoses to block until the running start, also known as queue-ahead in the Oculus SDK.
-		err = vr::VRCompositor()->WaitGetPoses(nullptr, 0, nullptr, 0);
-	}
-	return rev_CompositorErrorToOvrError(err);
+	// The frame already began, frame indices below it are passed on since the application may restart them
+	if (frameIndex == session->FrameIndex)
+		return ovrSuccess;
+
+	// Block once until the running start, even if the application skipped ahead several frames
+	return rev_CompositorErrorToOvrError(session->Pacer->WaitToBeginFrame(frameIndex));
 }
 
 ovrResult CompositorBase::BeginFrame(ovrSession session, long long frameIndex)
@@ -127,55 +205,24 @@ ovrResult CompositorBase::EndFrame(ovrSession session, ovrLayerHeader const * co
 
 	ovrLayerEyeFov baseLayer;
 	bool baseLayerFound = false;
-	std::vector<vr::VROverlayHandle_t> activeOverlays;
+	const ovrLayerCube* cubeLayer = nullptr;
+	m_LayerBlits.clear();
+	m_SubmittedTextures.clear();
+	m_SceneTextures[ovrEye_Left] = m_SceneTextures[ovrEye_Right] = nullptr;
 	for (uint32_t i = 0; i < layerCount; i++)
 	{
 		if (layerPtrList[i] == nullptr)
 			continue;
 
-		// TODO: Support ovrLayerType_Cylinder and ovrLayerType_Cube
-		if (layerPtrList[i]->Type == ovrLayerType_Quad)
+		if (layerPtrList[i]->Type == ovrLayerType_Quad ||
+			layerPtrList[i]->Type == ovrLayerType_Cylinder)
 		{
-			ovrLayerQuad* layer = (ovrLayerQuad*)layerPtrList[i];
-			ovrTextureSwapChain chain = layer->ColorTexture;
-
-			// Every overlay is associated with a swapchain.
-			// This is necessary because the position of the layer may change in the array,
-			// which would otherwise cause flickering between overlays.
-			// TODO: Support multiple overlays using the same texture.
-			vr::VROverlayHandle_t overlay = layer->ColorTexture->Overlay;
-			if (overlay == vr::k_ulOverlayHandleInvalid)
-			{
-				overlay = CreateOverlay();
-				layer->ColorTexture->Overlay = overlay;
-
-				vr::VRTextureWithPose_t texture = chain->Textures[chain->SubmitIndex]->ToVRTexture();
-				vr::VROverlay()->SetOverlayTexture(chain->Overlay, &texture);
-			}
-			activeOverlays.push_back(overlay);
-
-			// Set the layer rendering order.
-			vr::VROverlay()->SetOverlaySortOrder(overlay, i);
-
-			// Transform the overlay.
-			vr::HmdMatrix34_t transform = REV::Matrix4f(layer->QuadPoseCenter);
-			vr::VROverlay()->SetOverlayWidthInMeters(overlay, layer->QuadSize.x);
-			if (layer->Header.Flags & ovrLayerFlag_HeadLocked)
-				vr::VROverlay()->SetOverlayTransformTrackedDeviceRelative(overlay, vr::k_unTrackedDeviceIndex_Hmd, &transform);
-			else
-				vr::VROverlay()->SetOverlayTransformAbsolute(overlay, session->TrackingOrigin, &transform);
-
-			// Set the texture and show the overlay.
-			vr::VRTextureBounds_t bounds = ViewportToTextureBounds(layer->Viewport, layer->ColorTexture, layer->Header.Flags);
-			vr::Texture_t texture = chain->Textures[chain->SubmitIndex]->ToVRTexture();
-			vr::VROverlay()->SetOverlayTextureBounds(overlay, &bounds);
-
-			// Show the overlay, unfortunately we have no control over the order in which
-			// overlays are drawn.
-			// TODO: Support ovrLayerFlag_HighQuality for overlays with anisotropic sampling.
-			// TODO: Handle overlay errors.
-			vr::VROverlay()->ShowOverlay(overlay);
-			chain->Submit();
+			SubmitOverlayLayer(session, layerPtrList[i], i);
+		}
+		else if (layerPtrList[i]->Type == ovrLayerType_Cube)
+		{
+			// There is only one skybox, so only the last cube layer is shown.
+			cubeLayer = (const ovrLayerCube*)layerPtrList[i];
 		}
 		else if (layerPtrList[i]->Type == ovrLayerType_EyeFov ||
 			layerPtrList[i]->Type == ovrLayerType_EyeFovDepth ||
@@ -204,14 +251,16 @@ ovrResult CompositorBase::EndFrame(ovrSession session, ovrLayerHeader const * co
 	}
 
 	// Hide previous overlays that are not part of the current layers.
-	for (vr::VROverlayHandle_t overlay : m_ActiveOverlays)
-	{
-		// Find the overlay in the current active overlays, if it was not found then hide it.
-		// TODO: Handle overlay errors.
-		if (std::find(activeOverlays.begin(), activeOverlays.end(), overlay) == activeOverlays.end())
-			vr::VROverlay()->HideOverlay(overlay);
-	}
-	m_ActiveOverlays = activeOverlays;
+	m_OverlayVisibility.EndFrame(vr::VROverlay());
+
+	// The skybox is shown by OpenVR whenever the scene layer isn't submitted, such as on loading screens.
+	// TODO: Composite the cube layer behind the scene layer.
+	if (!cubeLayer || !SubmitCubeLayer(cubeLayer))
+		ClearSkybox();
+
+	// Composit all the eye layers into the base layer, sharing the state setup between them.
+	if (!m_LayerBlits.empty())
+		RenderLayerBlits(m_LayerBlits.data(), m_LayerBlits.size());
 
 	vr::EVRCompositorError error = vr::VRCompositorError_None;
 	if (baseLayerFound)
@@ -220,12 +269,200 @@ ovrResult CompositorBase::EndFrame(ovrSession session, ovrLayerHeader const * co
 	if (m_MirrorTexture && error == vr::VRCompositorError_None)
 		RenderMirrorTexture(m_MirrorTexture);
 
+	// Fence the submitted textures once all work that reads them is queued, so the application
+	// waits for the compositor before it renders to them again. The fences are flushed so they
+	// can be polled and waited on from other contexts.
+	if (!m_SubmittedTextures.empty())
+	{
+		SignalFences(m_SubmittedTextures.data(), m_SubmittedTextures.size());
+		Flush();
+	}
+	FinishFrame();
+
+	TrimTexturePool();
+
 	// Flip the profiler.
 	MicroProfileFlip();
+	TraceFrame();
 
 	return rev_CompositorErrorToOvrError(error);
 }
 
+void CompositorBase::SubmitOverlayLayer(ovrSession session, const ovrLayerHeader* layer, uint32_t sortOrder)
+{
+	ovrTextureSwapChain chain;
+	ovrRecti viewport;
+	vr::HmdMatrix34_t transform;
+	float width, curvature, texelAspect;
+	if (layer->Type == ovrLayerType_Cylinder)
+	{
+		const ovrLayerCylinder* cylinder = (const ovrLayerCylinder*)layer;
+		chain = cylinder->ColorTexture;
+		viewport = cylinder->Viewport;
+
+		// OpenVR bends the overlay around the viewer, where the curvature is the fraction of a full circle that
+		// the overlay covers. The overlay itself is positioned at the center of the arc.
+		REV::Matrix4f center(cylinder->CylinderPoseCenter);
+		transform = REV::Matrix4f(center * OVR::Matrix4f::Translation(0.0f, 0.0f, -cylinder->CylinderRadius));
+		width = cylinder->CylinderRadius * cylinder->CylinderAngle;
+		curvature = cylinder->CylinderAngle / MATH_FLOAT_TWOPI;
+
+		// The height of the overlay follows from the size of the viewport, so we stretch the texels
+		// to get the aspect ratio of the cylinder.
+		float w = (float)(viewport.Size.w > 0 ? viewport.Size.w : chain->Desc.Width);
+		float h = (float)(viewport.Size.h > 0 ? viewport.Size.h : chain->Desc.Height);
+		texelAspect = cylinder->CylinderAspectRatio * h / w;
+	}
+	else
+	{
+		const ovrLayerQuad* quad = (const ovrLayerQuad*)layer;
+		chain = quad->ColorTexture;
+		viewport = quad->Viewport;
+		transform = REV::Matrix4f(quad->QuadPoseCenter);
+		width = quad->QuadSize.x;
+		curvature = 0.0f;
+		texelAspect = 1.0f;
+	}
+
+	// Every overlay is associated with a swapchain.
+	// This is necessary because the position of the layer may change in the array,
+	// which would otherwise cause flickering between overlays.
+	// TODO: Support multiple overlays using the same texture.
+	vr::VROverlayHandle_t overlay = chain->Overlay;
+	bool created = overlay == vr::k_ulOverlayHandleInvalid;
+	if (created)
+	{
+		overlay = CreateOverlay();
+		chain->Overlay = overlay;
+
+		vr::VRTextureWithPose_t texture = chain->Textures[chain->SubmitIndex]->ToVRTexture();
+		vr::VROverlay()->SetOverlayTexture(chain->Overlay, &texture);
+	}
+
+	OverlayState next;
+	next.SortOrder = sortOrder;
+	next.Width = width;
+	next.Curvature = curvature;
+	next.TexelAspect = texelAspect;
+	next.HeadLocked = (layer->Flags & ovrLayerFlag_HeadLocked) != 0;
+	next.Origin = session->TrackingOrigin;
+	next.Transform = transform;
+	next.Bounds = ViewportToTextureBounds(viewport, chain, layer->Flags);
+	chain->LastOverlay.Apply(vr::VROverlay(), overlay, next, created);
+
+	// TODO: Support ovrLayerFlag_HighQuality for overlays with anisotropic sampling.
+	m_OverlayVisibility.Submit(vr::VROverlay(), overlay, created);
+	SubmitSwapChain(chain);
+}
+
+bool CompositorBase::SubmitCubeLayer(const ovrLayerCube* layer)
+{
+	ovrTextureSwapChain chain = layer->CubeMapTexture;
+	if (!chain || chain->Desc.Type != ovrTexture_Cube)
+		return false;
+
+	// Only redraw the skybox if the cube map was committed or the layer was rotated.
+	if (m_SkyboxActive && m_SkyboxIdentifier == chain->Identifier && m_SkyboxCommitCount == chain->CommitCount &&
+		memcmp(&m_SkyboxOrientation, &layer->Orientation, sizeof(ovrQuatf)) == 0)
+	{
+		SubmitSwapChain(chain);
+		return true;
+	}
+
+	// Create the skybox textures, the format has to be renderable so compressed cube maps are decompressed.
+	ovrTextureFormat format = SkyboxFormat(chain->Desc.Format);
+	if (!m_SkyboxTextures[0] || m_SkyboxSize != chain->Desc.Width || m_SkyboxFormat != format)
+	{
+		for (int i = 0; i < REV_SKYBOX_FACES; i++)
+		{
+			TextureBase* texture = CreateTexture();
+			bool success = texture->Init(ovrTexture_2D, chain->Desc.Width, chain->Desc.Width, 1, 1, format,
+				ovrTextureMisc_None, ovrTextureBind_DX_RenderTarget);
+			m_SkyboxTextures[i].reset(texture);
+			if (!success)
+			{
+				m_SkyboxTextures[0].reset();
+				return false;
+			}
+		}
+		m_SkyboxSize = chain->Desc.Width;
+		m_SkyboxFormat = format;
+	}
+
+	// The skybox faces in tracking space as right, up and forward vectors.
+	static const OVR::Vector3f faceBasis[REV_SKYBOX_FACES][3] = {
+		{ {  1.0f, 0.0f,  0.0f }, { 0.0f, 1.0f,  0.0f }, {  0.0f,  0.0f, -1.0f } }, // Front
+		{ { -1.0f, 0.0f,  0.0f }, { 0.0f, 1.0f,  0.0f }, {  0.0f,  0.0f,  1.0f } }, // Back
+		{ {  0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f,  0.0f }, { -1.0f,  0.0f,  0.0f } }, // Left
+		{ {  0.0f, 0.0f,  1.0f }, { 0.0f, 1.0f,  0.0f }, {  1.0f,  0.0f,  0.0f } }, // Right
+		{ {  1.0f, 0.0f,  0.0f }, { 0.0f, 0.0f,  1.0f }, {  0.0f,  1.0f,  0.0f } }, // Top
+		{ {  1.0f, 0.0f,  0.0f }, { 0.0f, 0.0f, -1.0f }, {  0.0f, -1.0f,  0.0f } }, // Bottom
+	};
+
+	// Rotate the faces into the space of the cube map, cube maps use a left-handed
+	// coordinate system so the z-axis is flipped.
+	OVR::Quatf inverse = OVR::Quatf(layer->Orientation).Inverted();
+	SkyboxFace faces[REV_SKYBOX_FACES];
+	TextureBase* targets[REV_SKYBOX_FACES];
+	for (int i = 0; i < REV_SKYBOX_FACES; i++)
+	{
+		ovrVector3f* vectors[3] = { &faces[i].Right, &faces[i].Up, &faces[i].Forward };
+		for (int j = 0; j < 3; j++)
+		{
+			OVR::Vector3f v = inverse.Rotate(faceBasis[i][j]);
+			*vectors[j] = OVR::Vector3f(v.x, v.y, -v.z);
+		}
+		targets[i] = m_SkyboxTextures[i].get();
+	}
+
+	if (!RenderSkybox(chain, faces, targets))
+		return false;
+	SubmitSwapChain(chain);
+	Flush();
+
+	vr::Texture_t textures[REV_SKYBOX_FACES];
+	for (int i = 0; i < REV_SKYBOX_FACES; i++)
+		textures[i] = m_SkyboxTextures[i]->ToVRTexture();
+
+	vr::EVRCompositorError err = vr::VRCompositor()->SetSkyboxOverride(textures, REV_SKYBOX_FACES);
+	m_SkyboxActive = err == vr::VRCompositorError_None;
+	m_SkyboxIdentifier = chain->Identifier;
+	m_SkyboxCommitCount = chain->CommitCount;
+	m_SkyboxOrientation = layer->Orientation;
+	return m_SkyboxActive;
+}
+
+void CompositorBase::ClearSkybox()
+{
+	if (!m_SkyboxActive)
+		return;
+
+	vr::VRCompositor()->ClearSkyboxOverride();
+	m_SkyboxActive = false;
+}
+
+ovrTextureFormat CompositorBase::SkyboxFormat(ovrTextureFormat format)
+{
+	switch (format)
+	{
+		case OVR_FORMAT_R8G8B8A8_UNORM_SRGB:
+		case OVR_FORMAT_B8G8R8A8_UNORM_SRGB:
+		case OVR_FORMAT_B8G8R8X8_UNORM_SRGB:
+		case OVR_FORMAT_BC1_UNORM_SRGB:
+		case OVR_FORMAT_BC2_UNORM_SRGB:
+		case OVR_FORMAT_BC3_UNORM_SRGB:
+		case OVR_FORMAT_BC7_UNORM_SRGB:
+			return OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
+		case OVR_FORMAT_R16G16B16A16_FLOAT:
+		case OVR_FORMAT_R11G11B10_FLOAT:
+		case OVR_FORMAT_BC6H_UF16:
+		case OVR_FORMAT_BC6H_SF16:
+			return OVR_FORMAT_R16G16B16A16_FLOAT;
+		default:
+			return OVR_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
 vr::VROverlayHandle_t CompositorBase::CreateOverlay()
 {
 	// Each overlay needs a unique key, so just count how many overlays we've created until now.
@@ -323,13 +560,19 @@ void CompositorBase::BlitFovLayers(ovrLayerEyeFov* dstLayer, ovrLayerEyeFov* src
 		// Calculate the texture bounds
 		vr::VRTextureBounds_t bounds = ViewportToTextureBounds(srcLayer->Viewport[i], swapChain[i], srcLayer->Header.Flags);
 
-		// Composit the layer
-		RenderTextureSwapChain((vr::EVREye)i, swapChain[i], dstLayer->ColorTexture[i], dstLayer->Viewport[i], bounds, quad);
+		// Queue the layer for compositing
+		ovrTextureSwapChain sceneChain = dstLayer->ColorTexture[i] ? dstLayer->ColorTexture[i] : dstLayer->ColorTexture[ovrEye_Left];
+		LayerBlit blit = {
+			swapChain[i]->Textures[swapChain[i]->SubmitIndex].get(),
+			sceneChain->Textures[sceneChain->SubmitIndex].get(),
+			dstLayer->Viewport[i], bounds, quad
+		};
+		m_LayerBlits.push_back(blit);
 	}
 
-	swapChain[ovrEye_Left]->Submit();
+	SubmitSwapChain(swapChain[ovrEye_Left]);
 	if (swapChain[ovrEye_Left] != swapChain[ovrEye_Right])
-		swapChain[ovrEye_Right]->Submit();
+		SubmitSwapChain(swapChain[ovrEye_Right]);
 }
 
 vr::VRCompositorError CompositorBase::SubmitFovLayer(ovrSession session, ovrLayerEyeFov* fovLayer)
@@ -370,6 +613,8 @@ vr::VRCompositorError CompositorBase::SubmitFovLayer(ovrSession session, ovrLaye
 		bounds.vMax *= fovBounds.vMax;
 
 		vr::VRTextureWithPose_t texture = chain->Textures[chain->SubmitIndex]->ToVRTexture();
+		m_SceneTextures[i] = chain->Textures[chain->SubmitIndex].get();
+		m_SceneViewports[i] = fovLayer->Viewport[i];
 
 		// Add the pose data to the eye texture
 		REV::Matrix4f pose(fovLayer->RenderPose[i]);
@@ -388,13 +633,24 @@ vr::VRCompositorError CompositorBase::SubmitFovLayer(ovrSession session, ovrLaye
 			break;
 	}
 
-	swapChain[ovrEye_Left]->Submit();
+	SubmitSwapChain(swapChain[ovrEye_Left]);
 	if (swapChain[ovrEye_Left] != swapChain[ovrEye_Right])
-		swapChain[ovrEye_Right]->Submit();
+		SubmitSwapChain(swapChain[ovrEye_Right]);
 
 	return err;
 }
 
+void CompositorBase::SignalFences(TextureBase* const* textures, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		textures[i]->SignalFence();
+}
+
+void CompositorBase::SubmitSwapChain(ovrTextureSwapChain chain)
+{
+	m_SubmittedTextures.push_back(chain->Textures[chain->SubmitIndex].get());
+}
+
 void CompositorBase::SetMirrorTexture(ovrMirrorTexture mirrorTexture)
 {
 	m_MirrorTexture = mirrorTexture;
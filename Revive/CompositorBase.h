@@ -1,11 +1,31 @@
 #pragma once
 
+#include "LayerBlit.h"
 #include "TextureBase.h"
 #include "OVR_CAPI.h"
 
 #include <openvr.h>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <vector>
 
+// The skybox faces in the order expected by OpenVR: front, back, left, right, top and bottom
+#define REV_SKYBOX_FACES 6
+
+// Textures of destroyed swapchains are kept for reuse until they've been unused for this many frames
+#define REV_TEXTURE_POOL_LIFETIME 90
+#define REV_TEXTURE_POOL_SIZE 12
+
+// Basis of a skybox face in cube map space, the sample direction for a texel at (x, y) in
+// normalized device coordinates is Forward + x * Right + y * Up.
+struct SkyboxFace
+{
+	ovrVector3f Right;
+	ovrVector3f Up;
+	ovrVector3f Forward;
+};
+
 class CompositorBase
 {
 public:
@@ -17,13 +37,28 @@ public:
 	virtual TextureBase* CreateTexture() = 0;
 
 	// Texture Swapchain
-	ovrResult CreateTextureSwapChain(const ovrTextureSwapChainDesc* desc, ovrTextureSwapChain* out_TextureSwapChain);
-	virtual void RenderTextureSwapChain(vr::EVREye eye, ovrTextureSwapChain swapChain, ovrTextureSwapChain sceneChain, ovrRecti viewport, vr::VRTextureBounds_t bounds, vr::HmdVector4_t quad) = 0;
+	ovrResult CreateTextureSwapChain(const ovrTextureSwapChainDesc* desc, ovrTextureSwapChain* out_TextureSwapChain,
+		int length = REV_SWAPCHAIN_MAX_LENGTH);
+	void DestroyTextureSwapChain(ovrTextureSwapChain chain);
+
+	// Renders all queued layer blits for a frame at once, so the pipeline state is only set up once per frame.
+	// The Vulkan compositor draws the layers with the same target in instanced batches, the others draw
+	// every layer on its own.
+	virtual void RenderLayerBlits(const LayerBlit* blits, size_t count) = 0;
 
 	// Mirror Texture
 	ovrResult CreateMirrorTexture(const ovrMirrorTextureDesc* desc, ovrMirrorTexture* out_MirrorTexture);
 	virtual void RenderMirrorTexture(ovrMirrorTexture mirrorTexture) = 0;
 
+	// Fences all textures submitted in a frame, by default every texture signals its own fence
+	virtual void SignalFences(TextureBase* const* textures, size_t count);
+
+	// Called once all the work of a frame is queued
+	virtual void FinishFrame() { }
+
+	// Skybox, renders the faces of a cube map into the 2D skybox textures
+	virtual bool RenderSkybox(ovrTextureSwapChain cubeMap, const SkyboxFace* faces, TextureBase** targets) { return false; }
+
 	ovrResult WaitToBeginFrame(ovrSession session, long long frameIndex);
 	ovrResult BeginFrame(ovrSession session, long long frameIndex);
 	ovrResult EndFrame(ovrSession session, ovrLayerHeader const * const * layerPtrList, unsigned int layerCount);
@@ -35,15 +70,55 @@ protected:
 	unsigned int m_ChainCount;
 	ovrMirrorTexture m_MirrorTexture;
 
+	// Eye textures of the scene layer submitted in the current frame, for backends that can't get
+	// a mirror texture from OpenVR
+	TextureBase* m_SceneTextures[ovrEye_Count];
+	ovrRecti m_SceneViewports[ovrEye_Count];
+
 	vr::VROverlayHandle_t CreateOverlay();
 	vr::VRTextureBounds_t ViewportToTextureBounds(ovrRecti viewport, ovrTextureSwapChain swapChain, unsigned int flags);
 	ovrLayerEyeFov ToFovLayer(ovrLayerEyeMatrix* matrix);
 
 	void BlitFovLayers(ovrLayerEyeFov* dstLayer, ovrLayerEyeFov* srcLayer);
 	vr::VRCompositorError SubmitFovLayer(ovrSession session, ovrLayerEyeFov* fovLayer);
+	void SubmitOverlayLayer(ovrSession session, const ovrLayerHeader* layer, uint32_t sortOrder);
+	bool SubmitCubeLayer(const ovrLayerCube* layer);
+	void SubmitSwapChain(ovrTextureSwapChain chain);
+	void ClearSkybox();
 
 private:
-	// Overlays
+	// Overlays, only shown and hidden when they appear or disappear from the layers
 	unsigned int m_OverlayCount;
-	std::vector<vr::VROverlayHandle_t> m_ActiveOverlays;
+	OverlayVisibility m_OverlayVisibility;
+
+	// Texture pool, the most recently released textures are at the front
+	struct PooledTexture
+	{
+		ovrTextureSwapChainDesc Desc;
+		unsigned int ReleaseFrame;
+		std::unique_ptr<TextureBase> Texture;
+	};
+	std::mutex m_PoolMutex;
+	std::list<PooledTexture> m_TexturePool;
+	unsigned int m_FrameCount;
+
+	TextureBase* AcquireTexture(const ovrTextureSwapChainDesc* desc);
+	void TrimTexturePool();
+
+	// Layer blits queued for the current frame
+	std::vector<LayerBlit> m_LayerBlits;
+
+	// Textures submitted in the current frame, fenced at the end of the frame
+	std::vector<TextureBase*> m_SubmittedTextures;
+
+	// Skybox, only redrawn when the cube map is committed or the layer is rotated
+	std::unique_ptr<TextureBase> m_SkyboxTextures[REV_SKYBOX_FACES];
+	int m_SkyboxSize;
+	ovrTextureFormat m_SkyboxFormat;
+	unsigned int m_SkyboxIdentifier;
+	unsigned int m_SkyboxCommitCount;
+	ovrQuatf m_SkyboxOrientation;
+	bool m_SkyboxActive;
+
+	static ovrTextureFormat SkyboxFormat(ovrTextureFormat format);
 };
@@ -9,6 +9,7 @@
 #include "VertexShader.hlsl.h"
 #include "MirrorShader.hlsl.h"
 #include "CompositorShader.hlsl.h"
+#include "SkyboxShader.hlsl.h"
 
 struct Vertex
 {
@@ -16,6 +17,13 @@ struct Vertex
 	ovrVector2f TexCoord;
 };
 
+struct SkyboxConstants
+{
+	ovrVector4f Right;
+	ovrVector4f Up;
+	ovrVector4f Forward;
+};
+
 CompositorD3D* CompositorD3D::Create(IUnknown* d3dPtr)
 {
 	// Get the device for this context
@@ -34,6 +42,7 @@ CompositorD3D* CompositorD3D::Create(IUnknown* d3dPtr)
 }
 
 CompositorD3D::CompositorD3D(ID3D11Device* pDevice)
+	: m_LayerBufferSize(0)
 {
 	m_pDevice = pDevice;
 	m_pDevice->GetImmediateContext(m_pContext.GetAddressOf());
@@ -42,6 +51,7 @@ CompositorD3D::CompositorD3D(ID3D11Device* pDevice)
 	m_pDevice->CreateVertexShader(g_VertexShader, sizeof(g_VertexShader), NULL, m_VertexShader.GetAddressOf());
 	m_pDevice->CreatePixelShader(g_MirrorShader, sizeof(g_MirrorShader), NULL, m_MirrorShader.GetAddressOf());
 	m_pDevice->CreatePixelShader(g_CompositorShader, sizeof(g_CompositorShader), NULL, m_CompositorShader.GetAddressOf());
+	m_pDevice->CreatePixelShader(g_SkyboxShader, sizeof(g_SkyboxShader), NULL, m_SkyboxShader.GetAddressOf());
 
 	// Create the vertex buffer.
 	D3D11_BUFFER_DESC bufferDesc;
@@ -52,6 +62,11 @@ CompositorD3D::CompositorD3D(ID3D11Device* pDevice)
 	bufferDesc.MiscFlags = 0;
 	m_pDevice->CreateBuffer(&bufferDesc, nullptr, m_VertexBuffer.GetAddressOf());
 
+	// Create the skybox constant buffer.
+	bufferDesc.ByteWidth = sizeof(SkyboxConstants);
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	m_pDevice->CreateBuffer(&bufferDesc, nullptr, m_SkyboxBuffer.GetAddressOf());
+
 	// Create the input layout.
 	D3D11_INPUT_ELEMENT_DESC layout[] =
 	{
@@ -79,6 +94,7 @@ CompositorD3D::CompositorD3D(ID3D11Device* pDevice)
 
 CompositorD3D::CompositorD3D(ID3D12CommandQueue* pQueue)
 	: m_pQueue(pQueue)
+	, m_LayerBufferSize(0)
 	, m_pMirror()
 {
 }
@@ -162,14 +178,49 @@ void CompositorD3D::RenderMirrorTexture(ovrMirrorTexture mirrorTexture)
 	m_pContext->IASetPrimitiveTopology(topology);
 }
 
-void CompositorD3D::RenderTextureSwapChain(vr::EVREye eye, ovrTextureSwapChain swapChain, ovrTextureSwapChain sceneChain, ovrRecti viewport, vr::VRTextureBounds_t bounds, vr::HmdVector4_t quad)
+void CompositorD3D::RenderLayerBlits(const LayerBlit* blits, size_t count)
 {
 	// TODO: Support compositing layers in DX12
 	if (!m_pDevice)
 		return;
 
-	TextureD3D* texture = (TextureD3D*)swapChain->Textures[swapChain->SubmitIndex].get();
-	TextureD3D* scene = (TextureD3D*)sceneChain->Textures[sceneChain->SubmitIndex].get();
+	// Grow the layer vertex buffer to fit all the layers
+	UINT size = UINT(sizeof(Vertex) * 4 * count);
+	if (size > m_LayerBufferSize)
+	{
+		D3D11_BUFFER_DESC bufferDesc;
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.ByteWidth = size;
+		bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = 0;
+		m_LayerBuffer.Reset();
+		if (FAILED(m_pDevice->CreateBuffer(&bufferDesc, nullptr, m_LayerBuffer.GetAddressOf())))
+		{
+			m_LayerBufferSize = 0;
+			return;
+		}
+		m_LayerBufferSize = size;
+	}
+
+	// Update the vertices for all the layers at once
+	D3D11_MAPPED_SUBRESOURCE map = { 0 };
+	if (FAILED(m_pContext->Map(m_LayerBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &map)))
+		return;
+	Vertex* vertices = (Vertex*)map.pData;
+	for (size_t i = 0; i < count; i++)
+	{
+		const vr::HmdVector4_t& quad = blits[i].Quad;
+		const vr::VRTextureBounds_t& bounds = blits[i].Bounds;
+		Vertex layer[4] = {
+			{ { quad.v[0], quad.v[2] },{ bounds.uMin, bounds.vMin } },
+			{ { quad.v[1], quad.v[2] },{ bounds.uMax, bounds.vMin } },
+			{ { quad.v[0], quad.v[3] },{ bounds.uMin, bounds.vMax } },
+			{ { quad.v[1], quad.v[3] },{ bounds.uMax, bounds.vMax } }
+		};
+		memcpy(vertices + i * 4, layer, sizeof(layer));
+	}
+	m_pContext->Unmap(m_LayerBuffer.Get(), 0);
 
 	// Get the current state objects
 	Microsoft::WRL::ComPtr<ID3D11BlendState> blend_state;
@@ -180,21 +231,90 @@ void CompositorD3D::RenderTextureSwapChain(vr::EVREye eye, ovrTextureSwapChain s
 	D3D11_PRIMITIVE_TOPOLOGY topology;
 	m_pContext->IAGetPrimitiveTopology(&topology);
 
-	ID3D11RasterizerState* ras_state;
-	m_pContext->RSGetState(&ras_state);
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> ras_state;
+	m_pContext->RSGetState(ras_state.GetAddressOf());
 
-	// Set the compositor shaders
+	// Set the compositor shaders and state
 	m_pContext->VSSetShader(m_VertexShader.Get(), NULL, 0);
 	m_pContext->PSSetShader(m_CompositorShader.Get(), NULL, 0);
+	m_pContext->OMSetBlendState(m_BlendState.Get(), nullptr, -1);
+	m_pContext->RSSetState(nullptr);
+
+	// Set the vertices
+	uint32_t stride = sizeof(Vertex);
+	uint32_t offset = 0;
+	m_pContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	m_pContext->IASetInputLayout(m_InputLayout.Get());
+	m_pContext->IASetVertexBuffers(0, 1, m_LayerBuffer.GetAddressOf(), &stride, &offset);
+
+	// Draw every layer, only changing the bindings that differ from the previous layer
+	TextureD3D* lastTarget = nullptr;
+	ovrRecti lastViewport = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		TextureD3D* texture = (TextureD3D*)blits[i].Texture;
+		TextureD3D* scene = (TextureD3D*)blits[i].Target;
+
+		ID3D11ShaderResourceView* resource = texture->Resource();
+		m_pContext->PSSetShaderResources(0, 1, &resource);
+
+		const ovrRecti& viewport = blits[i].Viewport;
+		if (i == 0 || memcmp(&viewport, &lastViewport, sizeof(ovrRecti)) != 0)
+		{
+			D3D11_VIEWPORT vp = { (float)viewport.Pos.x, (float)viewport.Pos.y, (float)viewport.Size.w, (float)viewport.Size.h, D3D11_MIN_DEPTH, D3D11_MIN_DEPTH };
+			m_pContext->RSSetViewports(1, &vp);
+			lastViewport = viewport;
+		}
+
+		if (scene != lastTarget)
+		{
+			ID3D11RenderTargetView* target = scene->Target();
+			m_pContext->OMSetRenderTargets(1, &target, nullptr);
+			lastTarget = scene;
+		}
+
+		m_pContext->Draw(4, UINT(i * 4));
+	}
+
+	// Restore the state objects
+	m_pContext->RSSetState(ras_state.Get());
+	m_pContext->OMSetBlendState(blend_state.Get(), blend_factor, sample_mask);
+	m_pContext->IASetPrimitiveTopology(topology);
+}
+
+bool CompositorD3D::RenderSkybox(ovrTextureSwapChain cubeMap, const SkyboxFace* faces, TextureBase** targets)
+{
+	// TODO: Support skyboxes in DX12
+	if (!m_pDevice)
+		return false;
+
+	TextureD3D* texture = (TextureD3D*)cubeMap->Textures[cubeMap->SubmitIndex].get();
+
+	// Get the current state objects
+	Microsoft::WRL::ComPtr<ID3D11BlendState> blend_state;
+	float blend_factor[4];
+	uint32_t sample_mask;
+	m_pContext->OMGetBlendState(blend_state.GetAddressOf(), blend_factor, &sample_mask);
+
+	D3D11_PRIMITIVE_TOPOLOGY topology;
+	m_pContext->IAGetPrimitiveTopology(&topology);
+
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> ras_state;
+	m_pContext->RSGetState(ras_state.GetAddressOf());
+
+	// Set the skybox shaders
+	m_pContext->VSSetShader(m_VertexShader.Get(), NULL, 0);
+	m_pContext->PSSetShader(m_SkyboxShader.Get(), NULL, 0);
+	m_pContext->PSSetConstantBuffers(0, 1, m_SkyboxBuffer.GetAddressOf());
 	ID3D11ShaderResourceView* resource = texture->Resource();
 	m_pContext->PSSetShaderResources(0, 1, &resource);
 
 	// Update the vertex buffer
 	Vertex vertices[4] = {
-		{ { quad.v[0], quad.v[2] },{ bounds.uMin, bounds.vMin } },
-		{ { quad.v[1], quad.v[2] },{ bounds.uMax, bounds.vMin } },
-		{ { quad.v[0], quad.v[3] },{ bounds.uMin, bounds.vMax } },
-		{ { quad.v[1], quad.v[3] },{ bounds.uMax, bounds.vMax } }
+		{ { -1.0f,  1.0f },{ 0.0f, 0.0f } },
+		{ {  1.0f,  1.0f },{ 1.0f, 0.0f } },
+		{ { -1.0f, -1.0f },{ 0.0f, 1.0f } },
+		{ {  1.0f, -1.0f },{ 1.0f, 1.0f } }
 	};
 	D3D11_MAPPED_SUBRESOURCE map = { 0 };
 	m_pContext->Map(m_VertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &map);
@@ -202,23 +322,39 @@ void CompositorD3D::RenderTextureSwapChain(vr::EVREye eye, ovrTextureSwapChain s
 	m_pContext->Unmap(m_VertexBuffer.Get(), 0);
 
 	// Prepare the render target
-	D3D11_VIEWPORT vp = { (float)viewport.Pos.x, (float)viewport.Pos.y, (float)viewport.Size.w, (float)viewport.Size.h, D3D11_MIN_DEPTH, D3D11_MIN_DEPTH };
-	m_pContext->RSSetViewports(1, &vp);
-	ID3D11RenderTargetView* target = scene->Target();
-	m_pContext->OMSetRenderTargets(1, &target, nullptr);
-	m_pContext->OMSetBlendState(m_BlendState.Get(), nullptr, -1);
+	D3D11_VIEWPORT viewport = { 0.0f, 0.0f, (float)cubeMap->Desc.Width, (float)cubeMap->Desc.Width, D3D11_MIN_DEPTH, D3D11_MIN_DEPTH };
+	m_pContext->RSSetViewports(1, &viewport);
+	m_pContext->OMSetBlendState(nullptr, nullptr, -1);
 	m_pContext->RSSetState(nullptr);
 
-	// Set and draw the vertices
-	uint32_t stride = sizeof(Vertex);
-	uint32_t offset = 0;
+	// Set the vertices
+	UINT stride = sizeof(Vertex);
+	UINT offset = 0;
 	m_pContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 	m_pContext->IASetInputLayout(m_InputLayout.Get());
 	m_pContext->IASetVertexBuffers(0, 1, m_VertexBuffer.GetAddressOf(), &stride, &offset);
-	m_pContext->Draw(4, 0);
+
+	// Draw every face of the skybox
+	for (int i = 0; i < REV_SKYBOX_FACES; i++)
+	{
+		SkyboxConstants constants = {
+			{ faces[i].Right.x, faces[i].Right.y, faces[i].Right.z, 0.0f },
+			{ faces[i].Up.x, faces[i].Up.y, faces[i].Up.z, 0.0f },
+			{ faces[i].Forward.x, faces[i].Forward.y, faces[i].Forward.z, 0.0f }
+		};
+		m_pContext->Map(m_SkyboxBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &map);
+		memcpy(map.pData, &constants, sizeof(SkyboxConstants));
+		m_pContext->Unmap(m_SkyboxBuffer.Get(), 0);
+
+		ID3D11RenderTargetView* target = ((TextureD3D*)targets[i])->Target();
+		m_pContext->OMSetRenderTargets(1, &target, nullptr);
+		m_pContext->Draw(4, 0);
+	}
 
 	// Restore the state objects
-	m_pContext->RSSetState(ras_state);
+	m_pContext->OMSetRenderTargets(0, nullptr, nullptr);
+	m_pContext->RSSetState(ras_state.Get());
 	m_pContext->OMSetBlendState(blend_state.Get(), blend_factor, sample_mask);
 	m_pContext->IASetPrimitiveTopology(topology);
+	return true;
 }
@@ -19,8 +19,9 @@ public:
 	virtual void Flush() { if (m_pContext) m_pContext->Flush(); };
 	virtual TextureBase* CreateTexture();
 
-	virtual void RenderTextureSwapChain(vr::EVREye eye, ovrTextureSwapChain swapChain, ovrTextureSwapChain sceneChain, ovrRecti viewport, vr::VRTextureBounds_t bounds, vr::HmdVector4_t quad);
+	virtual void RenderLayerBlits(const LayerBlit* blits, size_t count);
 	virtual void RenderMirrorTexture(ovrMirrorTexture mirrorTexture);
+	virtual bool RenderSkybox(ovrTextureSwapChain cubeMap, const SkyboxFace* faces, TextureBase** targets);
 
 protected:
 	// DirectX 11
@@ -34,10 +35,14 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_VertexShader;
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_MirrorShader;
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_CompositorShader;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_SkyboxShader;
 
 	// Input
 	Microsoft::WRL::ComPtr<ID3D11Buffer> m_VertexBuffer;
 	Microsoft::WRL::ComPtr<ID3D11InputLayout> m_InputLayout;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_SkyboxBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_LayerBuffer;
+	UINT m_LayerBufferSize;
 
 	// States
 	Microsoft::WRL::ComPtr<ID3D11BlendState> m_BlendState;
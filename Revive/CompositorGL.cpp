@@ -7,6 +7,86 @@
 
 GLboolean CompositorGL::gladInitialized = GL_FALSE;
 
+static const char* s_LayerVertexShader = R"(
+#version 330
+layout(std140) uniform Layer
+{
+	vec4 Quad;
+	vec4 Bounds;
+};
+out vec2 tex;
+void main()
+{
+	vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+	vec2 pos = vec2(mix(Quad.x, Quad.y, corner.x), mix(Quad.z, Quad.w, corner.y));
+	tex = mix(Bounds.xy, Bounds.zw, corner);
+	gl_Position = vec4(pos.x, -pos.y, 0.0, 1.0);
+}
+)";
+
+static const char* s_LayerFragmentShader = R"(
+#version 330
+uniform sampler2D eye;
+in vec2 tex;
+out vec4 color;
+void main()
+{
+	color = texture(eye, tex);
+}
+)";
+
+static const char* s_SkyboxVertexShader = R"(
+#version 150
+out vec2 ndc;
+void main()
+{
+	ndc = vec2(float(gl_VertexID & 1) * 2.0 - 1.0, float(gl_VertexID >> 1) * 2.0 - 1.0);
+	gl_Position = vec4(ndc, 0.0, 1.0);
+}
+)";
+
+static const char* s_SkyboxFragmentShader = R"(
+#version 150
+uniform samplerCube cube;
+uniform vec3 Right;
+uniform vec3 Up;
+uniform vec3 Forward;
+in vec2 ndc;
+out vec4 color;
+void main()
+{
+	color = texture(cube, Forward + ndc.x * Right + ndc.y * Up);
+}
+)";
+
+struct LayerUniforms
+{
+	float Quad[4];
+	float Bounds[4];
+};
+
+// The queries for every state type, blend function and layer buffer need several queries
+static const GLenum s_StateQueries[] = {
+	GL_CURRENT_PROGRAM,
+	GL_VERTEX_ARRAY_BINDING,
+	GL_DRAW_FRAMEBUFFER_BINDING,
+	GL_READ_FRAMEBUFFER_BINDING,
+	GL_UNIFORM_BUFFER_BINDING,
+	GL_UNIFORM_BUFFER_BINDING,
+	GL_ACTIVE_TEXTURE,
+	GL_SAMPLER_BINDING,
+	GL_TEXTURE_BINDING_2D,
+	GL_TEXTURE_BINDING_CUBE_MAP,
+	GL_VIEWPORT,
+	GL_NONE,
+	GL_BLEND,
+	GL_DEPTH_TEST,
+	GL_STENCIL_TEST,
+	GL_SCISSOR_TEST,
+	GL_CULL_FACE,
+	GL_FRAMEBUFFER_SRGB,
+};
+
 void CompositorGL::DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
 {
 	OutputDebugStringA(message);
@@ -32,29 +112,43 @@ CompositorGL* CompositorGL::Create()
 }
 
 CompositorGL::CompositorGL()
+	: m_mirrorSize()
+	, m_layerProgram(0)
+	, m_layerBuffer(0)
+	, m_layerBufferSize(0)
+	, m_layerBinding(0)
+	, m_layerAlignment(1)
+	, m_skyboxProgram(0)
+	, m_skyboxBasis()
+	, m_VAO(0)
+	, m_sampler(0)
+	, m_appState()
+	, m_state()
+	, m_savedState(0)
 {
-	// Get the mirror textures
+	// Get the mirror textures, their size doesn't change during the session
 	glGenFramebuffers(ovrEye_Count, m_mirrorFB);
 	for (int i = 0; i < ovrEye_Count; i++)
 	{
 		vr::VRCompositor()->GetMirrorTextureGL((vr::EVREye)i, &m_mirror[i].first, &m_mirror[i].second);
 
-		GLint drawFboId = 0, readFboId = 0;
-		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFboId);
-		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFboId);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, m_mirrorFB[i]);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_mirror[i].first, 0);
-		glReadBuffer(GL_COLOR_ATTACHMENT0);
-		glDrawBuffer(GL_COLOR_ATTACHMENT0);
+		SetState(State_ReadFramebuffer, m_mirrorFB[i]);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_mirror[i].first, 0);
 
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFboId);
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, readFboId);
+		SetState(State_Texture2D, m_mirror[i].first);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &m_mirrorSize[i][0]);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &m_mirrorSize[i][1]);
 	}
+	RestoreState();
 }
 
 CompositorGL::~CompositorGL()
 {
+	glDeleteSamplers(1, &m_sampler);
+	glDeleteVertexArrays(1, &m_VAO);
+	glDeleteBuffers(1, &m_layerBuffer);
+	glDeleteProgram(m_layerProgram);
+	glDeleteProgram(m_skyboxProgram);
 	for (int i = 0; i < ovrEye_Count; i++)
 		vr::VRCompositor()->ReleaseSharedGLTexture(m_mirror[i].first, m_mirror[i].second);
 }
@@ -64,39 +158,300 @@ TextureBase* CompositorGL::CreateTexture()
 	return new TextureGL();
 }
 
-void CompositorGL::RenderMirrorTexture(ovrMirrorTexture mirrorTexture)
+void CompositorGL::SaveState(StateType type)
+{
+	GLint* values = m_appState[type];
+	values[0] = values[1] = values[2] = values[3] = 0;
+
+	switch (type)
+	{
+		case State_LayerBuffer:
+			glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, m_layerBinding, &values[0]);
+			glGetIntegeri_v(GL_UNIFORM_BUFFER_START, m_layerBinding, &values[1]);
+			glGetIntegeri_v(GL_UNIFORM_BUFFER_SIZE, m_layerBinding, &values[2]);
+			break;
+		case State_BlendFunc:
+			glGetIntegerv(GL_BLEND_SRC_RGB, &values[0]);
+			glGetIntegerv(GL_BLEND_DST_RGB, &values[1]);
+			glGetIntegerv(GL_BLEND_SRC_ALPHA, &values[2]);
+			glGetIntegerv(GL_BLEND_DST_ALPHA, &values[3]);
+			break;
+		default:
+			if (type >= State_Blend)
+				values[0] = glIsEnabled(s_StateQueries[type]);
+			else
+				glGetIntegerv(s_StateQueries[type], values);
+			break;
+	}
+
+	memcpy(m_state[type], values, sizeof(m_state[type]));
+	m_savedState |= 1 << type;
+}
+
+void CompositorGL::ApplyState(StateType type, const GLint* values)
+{
+	switch (type)
+	{
+		case State_Program: glUseProgram(values[0]); break;
+		case State_VertexArray: glBindVertexArray(values[0]); break;
+		case State_DrawFramebuffer: glBindFramebuffer(GL_DRAW_FRAMEBUFFER, values[0]); break;
+		case State_ReadFramebuffer: glBindFramebuffer(GL_READ_FRAMEBUFFER, values[0]); break;
+		case State_UniformBuffer: glBindBuffer(GL_UNIFORM_BUFFER, values[0]); break;
+		case State_LayerBuffer:
+			// Binding an indexed buffer also changes the generic binding
+			if (!(m_savedState & (1 << State_UniformBuffer)))
+				SaveState(State_UniformBuffer);
+			if (values[2] > 0)
+				glBindBufferRange(GL_UNIFORM_BUFFER, m_layerBinding, values[0], values[1], values[2]);
+			else
+				glBindBufferBase(GL_UNIFORM_BUFFER, m_layerBinding, values[0]);
+			m_state[State_UniformBuffer][0] = values[0];
+			break;
+		case State_ActiveTexture: glActiveTexture(values[0]); break;
+		case State_Sampler: glBindSampler(0, values[0]); break;
+		case State_Texture2D: glBindTexture(GL_TEXTURE_2D, values[0]); break;
+		case State_TextureCube: glBindTexture(GL_TEXTURE_CUBE_MAP, values[0]); break;
+		case State_Viewport: glViewport(values[0], values[1], values[2], values[3]); break;
+		case State_BlendFunc: glBlendFuncSeparate(values[0], values[1], values[2], values[3]); break;
+		default:
+			if (values[0])
+				glEnable(s_StateQueries[type]);
+			else
+				glDisable(s_StateQueries[type]);
+			break;
+	}
+}
+
+void CompositorGL::SetState(StateType type, GLint v0, GLint v1, GLint v2, GLint v3)
+{
+	// The texture unit state can only be queried and changed for the active texture unit
+	if (type == State_Sampler || type == State_Texture2D || type == State_TextureCube)
+		SetState(State_ActiveTexture, GL_TEXTURE0);
+
+	if (!(m_savedState & (1 << type)))
+		SaveState(type);
+
+	GLint values[4] = { v0, v1, v2, v3 };
+	if (memcmp(m_state[type], values, sizeof(values)) == 0)
+		return;
+
+	ApplyState(type, values);
+	memcpy(m_state[type], values, sizeof(values));
+}
+
+void CompositorGL::RestoreState()
 {
-	GLint drawFboId = 0, readFboId = 0, texId = 0;
-	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFboId);
-	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFboId);
-	glGetIntegerv(GL_TEXTURE_BINDING_2D, &texId);
+	for (int type = State_Count - 1; type >= 0; type--)
+	{
+		if (!(m_savedState & (1 << type)))
+			continue;
+
+		if (memcmp(m_state[type], m_appState[type], sizeof(m_state[type])) != 0)
+		{
+			ApplyState((StateType)type, m_appState[type]);
+			memcpy(m_state[type], m_appState[type], sizeof(m_state[type]));
+		}
+	}
+
+	// The state can change outside of the compositor before the next pass
+	m_savedState = 0;
+}
+
+GLuint CompositorGL::GetFramebuffer(TextureGL* texture)
+{
+	// Framebuffers are only created for textures that are actually rendered to
+	if (!texture->Framebuffer)
+	{
+		glGenFramebuffers(1, &texture->Framebuffer);
+		SetState(State_DrawFramebuffer, texture->Framebuffer);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->Texture, 0);
+	}
+	return texture->Framebuffer;
+}
 
+void CompositorGL::RenderMirrorTexture(ovrMirrorTexture mirrorTexture)
+{
 	TextureGL* texture = (TextureGL*)mirrorTexture->Texture.get();
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, texture->Framebuffer);
+	SetState(State_DrawFramebuffer, GetFramebuffer(texture));
+	SetState(State_ScissorTest, GL_FALSE);
 
 	for (int i = 0; i < ovrEye_Count; i++)
 	{
 		vr::VRCompositor()->LockGLSharedTextureForAccess(m_mirror[i].second);
 
-		GLint width, height;
-		glBindTexture(GL_TEXTURE_2D, m_mirror[i].first);
-		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
-		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
-
 		// Bind the buffer to copy from the compositor to the mirror texture
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_mirrorFB[i]);
+		SetState(State_ReadFramebuffer, m_mirrorFB[i]);
 		GLint offset = (mirrorTexture->Desc.Width / 2) * i;
-		glBlitFramebuffer(0, 0, width, height, offset, 0, offset + mirrorTexture->Desc.Width / 2, mirrorTexture->Desc.Height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBlitFramebuffer(0, 0, m_mirrorSize[i][0], m_mirrorSize[i][1], offset, 0, offset + mirrorTexture->Desc.Width / 2, mirrorTexture->Desc.Height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
 
 		vr::VRCompositor()->UnlockGLSharedTextureForAccess(m_mirror[i].second);
 	}
 
-	glBindTexture(GL_TEXTURE_2D, texId);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFboId);
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, readFboId);
+	RestoreState();
+}
+
+bool CompositorGL::InitPrograms()
+{
+	// Only try to create the programs once
+	if (m_VAO)
+		return m_layerProgram && m_skyboxProgram;
+
+	// The vertices are generated from the vertex id, but core profiles still need a vertex array
+	glGenVertexArrays(1, &m_VAO);
+
+	glGenSamplers(1, &m_sampler);
+	glSamplerParameteri(m_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(m_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(m_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(m_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(m_sampler, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+	m_skyboxProgram = CreateProgram(s_SkyboxVertexShader, s_SkyboxFragmentShader);
+	if (m_skyboxProgram)
+	{
+		m_skyboxBasis[0] = glGetUniformLocation(m_skyboxProgram, "Right");
+		m_skyboxBasis[1] = glGetUniformLocation(m_skyboxProgram, "Up");
+		m_skyboxBasis[2] = glGetUniformLocation(m_skyboxProgram, "Forward");
+	}
+
+	// Use the last uniform buffer binding, since it's the least likely to be used by the application
+	m_layerProgram = CreateProgram(s_LayerVertexShader, s_LayerFragmentShader);
+	if (m_layerProgram)
+	{
+		GLint bindings = 1;
+		glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &bindings);
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_layerAlignment);
+		m_layerBinding = bindings - 1;
+		glUniformBlockBinding(m_layerProgram, glGetUniformBlockIndex(m_layerProgram, "Layer"), m_layerBinding);
+		glGenBuffers(1, &m_layerBuffer);
+	}
+
+	return m_layerProgram && m_skyboxProgram;
 }
 
-void CompositorGL::RenderTextureSwapChain(vr::EVREye eye, ovrTextureSwapChain swapChain, ovrTextureSwapChain sceneChain, ovrRecti viewport, vr::VRTextureBounds_t bounds, vr::HmdVector4_t quad)
+void CompositorGL::RenderLayerBlits(const LayerBlit* blits, size_t count)
 {
-	// TODO: Support blending multiple scene layers
+	if (!InitPrograms())
+		return;
+
+	// Grow the layer uniform buffer to fit all the layers, every layer is aligned to a valid buffer offset
+	GLsizeiptr stride = (sizeof(LayerUniforms) + m_layerAlignment - 1) / m_layerAlignment * m_layerAlignment;
+	GLsizeiptr size = stride * count;
+	SetState(State_UniformBuffer, m_layerBuffer);
+	if (size > m_layerBufferSize)
+	{
+		glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		m_layerBufferSize = size;
+	}
+
+	// Update the uniforms for all the layers at once
+	char* data = (char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!data)
+	{
+		RestoreState();
+		return;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		const vr::HmdVector4_t& quad = blits[i].Quad;
+		const vr::VRTextureBounds_t& bounds = blits[i].Bounds;
+		LayerUniforms layer = {
+			{ quad.v[0], quad.v[1], quad.v[2], quad.v[3] },
+			{ bounds.uMin, bounds.vMin, bounds.uMax, bounds.vMax }
+		};
+		memcpy(data + i * stride, &layer, sizeof(layer));
+	}
+	glUnmapBuffer(GL_UNIFORM_BUFFER);
+
+	// Set the compositor program and state, layers are blended with pre-multiplied alpha
+	SetState(State_Program, m_layerProgram);
+	SetState(State_VertexArray, m_VAO);
+	SetState(State_Sampler, m_sampler);
+	SetState(State_BlendFunc, GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ZERO);
+	SetState(State_Blend, GL_TRUE);
+	SetState(State_DepthTest, GL_FALSE);
+	SetState(State_StencilTest, GL_FALSE);
+	SetState(State_ScissorTest, GL_FALSE);
+	SetState(State_CullFace, GL_FALSE);
+	SetState(State_FramebufferSRGB, GL_TRUE);
+
+	// Draw every layer, the shadow state skips the bindings that are the same as the previous layer
+	for (size_t i = 0; i < count; i++)
+	{
+		TextureGL* texture = (TextureGL*)blits[i].Texture;
+		TextureGL* scene = (TextureGL*)blits[i].Target;
+		const ovrRecti& viewport = blits[i].Viewport;
+
+		SetState(State_DrawFramebuffer, GetFramebuffer(scene));
+		SetState(State_Texture2D, texture->Texture);
+		SetState(State_LayerBuffer, m_layerBuffer, GLint(i * stride), sizeof(LayerUniforms));
+		SetState(State_Viewport, viewport.Pos.x, viewport.Pos.y, viewport.Size.w, viewport.Size.h);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	}
+
+	RestoreState();
+}
+
+GLuint CompositorGL::CreateProgram(const char* vertexSource, const char* fragmentSource)
+{
+	GLuint program = glCreateProgram();
+	GLuint shaders[] = { glCreateShader(GL_VERTEX_SHADER), glCreateShader(GL_FRAGMENT_SHADER) };
+	const char* sources[] = { vertexSource, fragmentSource };
+	for (int i = 0; i < 2; i++)
+	{
+		glShaderSource(shaders[i], 1, &sources[i], nullptr);
+		glCompileShader(shaders[i]);
+		glAttachShader(program, shaders[i]);
+	}
+	glLinkProgram(program);
+
+	// The shaders are only needed until the program is linked
+	for (int i = 0; i < 2; i++)
+	{
+		glDetachShader(program, shaders[i]);
+		glDeleteShader(shaders[i]);
+	}
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+
+bool CompositorGL::RenderSkybox(ovrTextureSwapChain cubeMap, const SkyboxFace* faces, TextureBase** targets)
+{
+	if (!InitPrograms())
+		return false;
+
+	// Set the skybox program and state
+	TextureGL* texture = (TextureGL*)cubeMap->Textures[cubeMap->SubmitIndex].get();
+	SetState(State_Program, m_skyboxProgram);
+	SetState(State_VertexArray, m_VAO);
+	SetState(State_Sampler, m_sampler);
+	SetState(State_TextureCube, texture->Texture);
+	SetState(State_Viewport, 0, 0, cubeMap->Desc.Width, cubeMap->Desc.Width);
+	SetState(State_Blend, GL_FALSE);
+	SetState(State_DepthTest, GL_FALSE);
+	SetState(State_StencilTest, GL_FALSE);
+	SetState(State_ScissorTest, GL_FALSE);
+	SetState(State_CullFace, GL_FALSE);
+	SetState(State_FramebufferSRGB, GL_TRUE);
+
+	// Draw every face of the skybox
+	for (int i = 0; i < REV_SKYBOX_FACES; i++)
+	{
+		SetState(State_DrawFramebuffer, GetFramebuffer((TextureGL*)targets[i]));
+		glUniform3f(m_skyboxBasis[0], faces[i].Right.x, faces[i].Right.y, faces[i].Right.z);
+		glUniform3f(m_skyboxBasis[1], faces[i].Up.x, faces[i].Up.y, faces[i].Up.z);
+		glUniform3f(m_skyboxBasis[2], faces[i].Forward.x, faces[i].Forward.y, faces[i].Forward.z);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	}
+
+	RestoreState();
+	return true;
 }
@@ -6,6 +6,8 @@
 #include <openvr.h>
 #include <utility>
 
+class TextureGL;
+
 class CompositorGL :
 	public CompositorBase
 {
@@ -18,14 +20,73 @@ public:
 	virtual void Flush() { glFlush(); };
 	virtual TextureBase* CreateTexture();
 
-	virtual void RenderTextureSwapChain(vr::EVREye eye, ovrTextureSwapChain swapChain, ovrTextureSwapChain sceneChain, ovrRecti viewport, vr::VRTextureBounds_t bounds, vr::HmdVector4_t quad);
+	virtual void RenderLayerBlits(const LayerBlit* blits, size_t count);
 	virtual void RenderMirrorTexture(ovrMirrorTexture mirrorTexture);
+	virtual bool RenderSkybox(ovrTextureSwapChain cubeMap, const SkyboxFace* faces, TextureBase** targets);
 
 protected:
 	std::pair<vr::glUInt_t, vr::glSharedTextureHandle_t> m_mirror[ovrEye_Count];
 	GLuint m_mirrorFB[ovrEye_Count];
+	GLint m_mirrorSize[ovrEye_Count][2];
+
+	// Layers
+	GLuint m_layerProgram;
+	GLuint m_layerBuffer;
+	GLsizeiptr m_layerBufferSize;
+	GLint m_layerBinding;
+	GLint m_layerAlignment;
+
+	// Skybox
+	GLuint m_skyboxProgram;
+	GLint m_skyboxBasis[3];
+
+	// Shared by all programs
+	GLuint m_VAO;
+	GLuint m_sampler;
 
 private:
+	// State that is changed by the compositor, in the order it's applied. State is restored in reverse order,
+	// so the texture bindings are restored before the active texture unit.
+	enum StateType
+	{
+		State_Program,
+		State_VertexArray,
+		State_DrawFramebuffer,
+		State_ReadFramebuffer,
+		State_UniformBuffer,
+		State_LayerBuffer,
+		State_ActiveTexture,
+		State_Sampler,
+		State_Texture2D,
+		State_TextureCube,
+		State_Viewport,
+		State_BlendFunc,
+		State_Blend,
+		State_DepthTest,
+		State_StencilTest,
+		State_ScissorTest,
+		State_CullFace,
+		State_FramebufferSRGB,
+		State_Count
+	};
+
+	// Shadow copy of the bound state. The application state is only queried right before the compositor first
+	// changes it in a pass, so redundant changes within a pass don't query the driver. RestoreState() ends the
+	// pass and forgets the shadow state: the application may change any state between frames and the passes of
+	// a frame are separated by OpenVR calls on the same context, so the bound state isn't known after a pass.
+	GLint m_appState[State_Count][4];
+	GLint m_state[State_Count][4];
+	uint32_t m_savedState;
+
+	void SetState(StateType type, GLint v0, GLint v1 = 0, GLint v2 = 0, GLint v3 = 0);
+	void SaveState(StateType type);
+	void ApplyState(StateType type, const GLint* values);
+	void RestoreState();
+
+	bool InitPrograms();
+	GLuint GetFramebuffer(TextureGL* texture);
+
 	static GLboolean gladInitialized;
+	static GLuint CreateProgram(const char* vertexSource, const char* fragmentSource);
 	static void DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam);
 };
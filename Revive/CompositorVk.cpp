@@ -1,28 +1,957 @@
 #include "CompositorVk.h"
-#include "TextureVK.h"
+#include "TextureVk.h"
 #include "OVR_CAPI.h"
 
+#include <algorithm>
+#include <vector>
+
+#include "LayerShader.vert.h"
+#include "LayerShader.frag.h"
+#include "SkyboxShader.vert.h"
+#include "SkyboxShader.frag.h"
+
+struct LayerConstants
+{
+	float Quad[4];
+	float Bounds[4];
+};
+
+struct SkyboxConstants
+{
+	ovrVector4f Right;
+	ovrVector4f Up;
+	ovrVector4f Forward;
+};
+
 CompositorVk::CompositorVk(VkPhysicalDevice physicalDevice, VkInstance instance)
-	: m_physicalDevice(physicalDevice)
+	: m_device()
+	, m_physicalDevice(physicalDevice)
 	, m_instance(instance)
+	, m_queue()
+	, m_initialized(false)
+	, m_initFailed(false)
+	, m_commandPool()
+	, m_layerSetLayout()
+	, m_skyboxSetLayout()
+	, m_layerPipelineLayout()
+	, m_skyboxPipelineLayout()
+	, m_pipelineCache()
+	, m_layerVertexShader()
+	, m_layerFragmentShader()
+	, m_skyboxVertexShader()
+	, m_skyboxFragmentShader()
+	, m_sampler()
+	, m_layerBuffer()
+	, m_layerMemory()
+	, m_frames()
+	, m_frameIndex(0)
+	, m_frame()
 {
 }
 
 CompositorVk::~CompositorVk()
 {
+	if (!m_initialized)
+		return;
+
+	// Wait for all frames to finish before destroying their resources
+	if (m_queue)
+		vkQueueWaitIdle(m_queue);
+
+	for (auto& pipeline : m_pipelines)
+		vkDestroyPipeline(m_device, pipeline.second, nullptr);
+	for (auto& renderPass : m_renderPasses)
+		vkDestroyRenderPass(m_device, renderPass.second, nullptr);
+
+	for (Frame& frame : m_frames)
+	{
+		vkDestroyDescriptorPool(m_device, frame.DescriptorPool, nullptr);
+		vkDestroyFence(m_device, frame.Fence, nullptr);
+	}
+	vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+
+	// Freeing the memory also unmaps it
+	vkDestroyBuffer(m_device, m_layerBuffer, nullptr);
+	vkFreeMemory(m_device, m_layerMemory, nullptr);
+
+	vkDestroySampler(m_device, m_sampler, nullptr);
+	vkDestroyShaderModule(m_device, m_skyboxFragmentShader, nullptr);
+	vkDestroyShaderModule(m_device, m_skyboxVertexShader, nullptr);
+	vkDestroyShaderModule(m_device, m_layerFragmentShader, nullptr);
+	vkDestroyShaderModule(m_device, m_layerVertexShader, nullptr);
+	vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+	vkDestroyPipelineLayout(m_device, m_skyboxPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(m_device, m_layerPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(m_device, m_skyboxSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(m_device, m_layerSetLayout, nullptr);
 }
 
 TextureBase* CompositorVk::CreateTexture()
 {
-	return new TextureVk(m_device, m_physicalDevice, m_instance, &m_queue);
+	return new TextureVk(m_device, m_physicalDevice, m_instance, &m_queue, m_allocator);
+}
+
+bool CompositorVk::SetDevice(VkDevice device)
+{
+	if (device == m_device && m_allocator)
+		return true;
+
+	// Textures keep a reference to the allocator of their device
+	std::shared_ptr<AllocatorVk> allocator = std::make_shared<AllocatorVk>();
+	if (!allocator->Init(device, m_physicalDevice, m_instance))
+		return false;
+
+	// Frame fences are needed even if the device doesn't support compositing
+	VK_DEVICE_FUNCTION(device, vkQueueSubmit)
+	VK_DEVICE_FUNCTION(device, vkCreateFence)
+	VK_DEVICE_FUNCTION(device, vkDestroyFence)
+	VK_DEVICE_FUNCTION(device, vkWaitForFences)
+	VK_DEVICE_FUNCTION(device, vkResetFences)
+	VK_DEVICE_FUNCTION(device, vkGetFenceStatus)
+
+	m_device = device;
+	m_allocator = allocator;
+	m_fences.clear();
+	return true;
+}
+
+bool CompositorVk::Initialize()
+{
+	if (m_initialized)
+		return true;
+
+	// Don't retry every frame if the device doesn't support compositing
+	if (m_initFailed || !m_device || !m_queue)
+		return false;
+	m_initFailed = true;
+
+	vkGetPhysicalDeviceQueueFamilyProperties = (PFN_vkGetPhysicalDeviceQueueFamilyProperties)
+		vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceQueueFamilyProperties");
+	if (!vkGetPhysicalDeviceQueueFamilyProperties)
+		return false;
+
+	VK_DEVICE_FUNCTION(m_device, vkCreateCommandPool)
+	VK_DEVICE_FUNCTION(m_device, vkDestroyCommandPool)
+	VK_DEVICE_FUNCTION(m_device, vkAllocateCommandBuffers)
+	VK_DEVICE_FUNCTION(m_device, vkBeginCommandBuffer)
+	VK_DEVICE_FUNCTION(m_device, vkEndCommandBuffer)
+	VK_DEVICE_FUNCTION(m_device, vkResetCommandBuffer)
+	VK_DEVICE_FUNCTION(m_device, vkQueueWaitIdle)
+	VK_DEVICE_FUNCTION(m_device, vkCreateDescriptorPool)
+	VK_DEVICE_FUNCTION(m_device, vkDestroyDescriptorPool)
+	VK_DEVICE_FUNCTION(m_device, vkResetDescriptorPool)
+	VK_DEVICE_FUNCTION(m_device, vkCreateDescriptorSetLayout)
+	VK_DEVICE_FUNCTION(m_device, vkDestroyDescriptorSetLayout)
+	VK_DEVICE_FUNCTION(m_device, vkAllocateDescriptorSets)
+	VK_DEVICE_FUNCTION(m_device, vkUpdateDescriptorSets)
+	VK_DEVICE_FUNCTION(m_device, vkCreatePipelineLayout)
+	VK_DEVICE_FUNCTION(m_device, vkDestroyPipelineLayout)
+	VK_DEVICE_FUNCTION(m_device, vkCreatePipelineCache)
+	VK_DEVICE_FUNCTION(m_device, vkDestroyPipelineCache)
+	VK_DEVICE_FUNCTION(m_device, vkCreateGraphicsPipelines)
+	VK_DEVICE_FUNCTION(m_device, vkDestroyPipeline)
+	VK_DEVICE_FUNCTION(m_device, vkCreateRenderPass)
+	VK_DEVICE_FUNCTION(m_device, vkDestroyRenderPass)
+	VK_DEVICE_FUNCTION(m_device, vkCreateShaderModule)
+	VK_DEVICE_FUNCTION(m_device, vkDestroyShaderModule)
+	VK_DEVICE_FUNCTION(m_device, vkCreateSampler)
+	VK_DEVICE_FUNCTION(m_device, vkDestroySampler)
+	VK_DEVICE_FUNCTION(m_device, vkCreateBuffer)
+	VK_DEVICE_FUNCTION(m_device, vkDestroyBuffer)
+	VK_DEVICE_FUNCTION(m_device, vkGetBufferMemoryRequirements)
+	VK_DEVICE_FUNCTION(m_device, vkAllocateMemory)
+	VK_DEVICE_FUNCTION(m_device, vkFreeMemory)
+	VK_DEVICE_FUNCTION(m_device, vkBindBufferMemory)
+	VK_DEVICE_FUNCTION(m_device, vkMapMemory)
+	VK_DEVICE_FUNCTION(m_device, vkCmdPipelineBarrier)
+	VK_DEVICE_FUNCTION(m_device, vkCmdBeginRenderPass)
+	VK_DEVICE_FUNCTION(m_device, vkCmdEndRenderPass)
+	VK_DEVICE_FUNCTION(m_device, vkCmdBindPipeline)
+	VK_DEVICE_FUNCTION(m_device, vkCmdBindDescriptorSets)
+	VK_DEVICE_FUNCTION(m_device, vkCmdPushConstants)
+	VK_DEVICE_FUNCTION(m_device, vkCmdSetViewport)
+	VK_DEVICE_FUNCTION(m_device, vkCmdSetScissor)
+	VK_DEVICE_FUNCTION(m_device, vkCmdDraw)
+	VK_DEVICE_FUNCTION(m_device, vkCmdBlitImage)
+
+	// The command pool must be created for the family of the synchronization queue
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &familyCount, families.data());
+
+	// If we didn't see the device being created, assume it's the first graphics queue family
+	uint32_t family = GetQueueFamilyIndex(m_device, m_queue);
+	if (family == VK_QUEUE_FAMILY_IGNORED)
+	{
+		family = 0;
+		while (family < familyCount && !(families[family].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+			family++;
+	}
+	if (family >= familyCount || !(families[family].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+		return false;
+
+	VkCommandPoolCreateInfo pool_info = {};
+	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	pool_info.queueFamilyIndex = family;
+	if (vkCreateCommandPool(m_device, &pool_info, nullptr, &m_commandPool) != VK_SUCCESS)
+		return false;
+
+	// Layers are drawn in instanced batches, every batch binds the textures of its layers and the constants
+	// of all layers in the frame. The quads are generated from the constants, so no vertex buffers are needed.
+	VkDescriptorSetLayoutBinding layer_bindings[2] = {};
+	layer_bindings[0].binding = 0;
+	layer_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	layer_bindings[0].descriptorCount = REV_VK_LAYER_BATCH;
+	layer_bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	layer_bindings[1].binding = 1;
+	layer_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layer_bindings[1].descriptorCount = 1;
+	layer_bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutCreateInfo set_info = {};
+	set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	set_info.bindingCount = 2;
+	set_info.pBindings = layer_bindings;
+	if (vkCreateDescriptorSetLayout(m_device, &set_info, nullptr, &m_layerSetLayout) != VK_SUCCESS)
+		return false;
+
+	// The skybox draws every face with the cube map and the quad and face in push constants
+	VkDescriptorSetLayoutBinding skybox_binding = {};
+	skybox_binding.binding = 0;
+	skybox_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	skybox_binding.descriptorCount = 1;
+	skybox_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	set_info.bindingCount = 1;
+	set_info.pBindings = &skybox_binding;
+	if (vkCreateDescriptorSetLayout(m_device, &set_info, nullptr, &m_skyboxSetLayout) != VK_SUCCESS)
+		return false;
+
+	VkPushConstantRange layer_range = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(int32_t) };
+	VkPipelineLayoutCreateInfo layout_info = {};
+	layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_info.setLayoutCount = 1;
+	layout_info.pSetLayouts = &m_layerSetLayout;
+	layout_info.pushConstantRangeCount = 1;
+	layout_info.pPushConstantRanges = &layer_range;
+	if (vkCreatePipelineLayout(m_device, &layout_info, nullptr, &m_layerPipelineLayout) != VK_SUCCESS)
+		return false;
+
+	VkPushConstantRange skybox_ranges[2] = {
+		{ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(LayerConstants) },
+		{ VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(LayerConstants), sizeof(SkyboxConstants) },
+	};
+
+	layout_info.pSetLayouts = &m_skyboxSetLayout;
+	layout_info.pushConstantRangeCount = 2;
+	layout_info.pPushConstantRanges = skybox_ranges;
+	if (vkCreatePipelineLayout(m_device, &layout_info, nullptr, &m_skyboxPipelineLayout) != VK_SUCCESS)
+		return false;
+
+	VkPipelineCacheCreateInfo cache_info = {};
+	cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	if (vkCreatePipelineCache(m_device, &cache_info, nullptr, &m_pipelineCache) != VK_SUCCESS)
+		return false;
+
+	m_layerVertexShader = CreateShaderModule(g_LayerVertexShader, sizeof(g_LayerVertexShader));
+	m_layerFragmentShader = CreateShaderModule(g_LayerFragmentShader, sizeof(g_LayerFragmentShader));
+	m_skyboxVertexShader = CreateShaderModule(g_SkyboxVertexShader, sizeof(g_SkyboxVertexShader));
+	m_skyboxFragmentShader = CreateShaderModule(g_SkyboxFragmentShader, sizeof(g_SkyboxFragmentShader));
+	if (!m_layerVertexShader || !m_layerFragmentShader || !m_skyboxVertexShader || !m_skyboxFragmentShader)
+		return false;
+
+	VkSamplerCreateInfo sampler_info = {};
+	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_info.magFilter = VK_FILTER_LINEAR;
+	sampler_info.minFilter = VK_FILTER_LINEAR;
+	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+	if (vkCreateSampler(m_device, &sampler_info, nullptr, &m_sampler) != VK_SUCCESS)
+		return false;
+
+	VkCommandBuffer commandBuffers[REV_VK_FRAME_COUNT][Pass_Count];
+	VkCommandBufferAllocateInfo alloc_info = {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	alloc_info.commandPool = m_commandPool;
+	alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	alloc_info.commandBufferCount = REV_VK_FRAME_COUNT * Pass_Count;
+	if (vkAllocateCommandBuffers(m_device, &alloc_info, &commandBuffers[0][0]) != VK_SUCCESS)
+		return false;
+
+	if (!CreateLayerBuffer())
+		return false;
+
+	// Every set binds at most a full batch of layer textures and the layer constants
+	VkDescriptorPoolSize pool_sizes[2] = {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, REV_VK_MAX_DESCRIPTORS * REV_VK_LAYER_BATCH },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, REV_VK_MAX_DESCRIPTORS },
+	};
+	VkDescriptorPoolCreateInfo descriptor_info = {};
+	descriptor_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptor_info.maxSets = REV_VK_MAX_DESCRIPTORS;
+	descriptor_info.poolSizeCount = 2;
+	descriptor_info.pPoolSizes = pool_sizes;
+
+	// The fences start signaled, so the first use of every frame doesn't wait
+	VkFenceCreateInfo fence_info = {};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	for (int i = 0; i < REV_VK_FRAME_COUNT; i++)
+	{
+		for (int j = 0; j < Pass_Count; j++)
+			m_frames[i].CommandBuffers[j] = commandBuffers[i][j];
+		if (vkCreateFence(m_device, &fence_info, nullptr, &m_frames[i].Fence) != VK_SUCCESS)
+			return false;
+		if (vkCreateDescriptorPool(m_device, &descriptor_info, nullptr, &m_frames[i].DescriptorPool) != VK_SUCCESS)
+			return false;
+	}
+
+	m_initialized = true;
+	m_initFailed = false;
+	return true;
+}
+
+VkShaderModule CompositorVk::CreateShaderModule(const uint32_t* code, size_t size)
+{
+	VkShaderModuleCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	create_info.codeSize = size;
+	create_info.pCode = code;
+
+	VkShaderModule module = VK_NULL_HANDLE;
+	if (vkCreateShaderModule(m_device, &create_info, nullptr, &module) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	return module;
+}
+
+VkRenderPass CompositorVk::GetRenderPass(VkFormat format, bool discard)
+{
+	auto it = m_renderPasses.find(std::make_pair(format, discard));
+	if (it != m_renderPasses.end())
+		return it->second;
+
+	// Submitted textures are kept in the transfer source layout that OpenVR expects, so the render pass
+	// transitions from and back to that layout.
+	VkAttachmentDescription attachment = {};
+	attachment.format = format;
+	attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	attachment.loadOp = discard ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment.initialLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	VkAttachmentReference reference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &reference;
+
+	// Wait for the application to finish rendering to the texture, and make our writes visible to the
+	// transfers OpenVR uses to copy the submitted textures.
+	VkSubpassDependency dependencies[2] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+	VkRenderPassCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	create_info.attachmentCount = 1;
+	create_info.pAttachments = &attachment;
+	create_info.subpassCount = 1;
+	create_info.pSubpasses = &subpass;
+	create_info.dependencyCount = 2;
+	create_info.pDependencies = dependencies;
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	if (vkCreateRenderPass(m_device, &create_info, nullptr, &renderPass) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	m_renderPasses[std::make_pair(format, discard)] = renderPass;
+	return renderPass;
+}
+
+VkPipeline CompositorVk::GetPipeline(VkRenderPass renderPass, PipelineType type)
+{
+	if (!renderPass)
+		return VK_NULL_HANDLE;
+
+	auto it = m_pipelines.find(std::make_pair(renderPass, type));
+	if (it != m_pipelines.end())
+		return it->second;
+
+	VkPipelineShaderStageCreateInfo stages[2] = {};
+	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = type == Pipeline_Skybox ? m_skyboxVertexShader : m_layerVertexShader;
+	stages[0].pName = "main";
+	stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = type == Pipeline_Skybox ? m_skyboxFragmentShader : m_layerFragmentShader;
+	stages[1].pName = "main";
+
+	VkPipelineVertexInputStateCreateInfo vertex_input = {};
+	vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+
+	VkPipelineViewportStateCreateInfo viewport = {};
+	viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport.viewportCount = 1;
+	viewport.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterization = {};
+	rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterization.cullMode = VK_CULL_MODE_NONE;
+	rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterization.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisample = {};
+	multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Layers are blended with pre-multiplied alpha, the same as the other compositors
+	VkPipelineColorBlendAttachmentState attachment = {};
+	attachment.blendEnable = type == Pipeline_Layer;
+	attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	attachment.colorBlendOp = VK_BLEND_OP_ADD;
+	attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+		VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo blend = {};
+	blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	blend.attachmentCount = 1;
+	blend.pAttachments = &attachment;
+
+	VkDynamicState states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamic = {};
+	dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamic.dynamicStateCount = 2;
+	dynamic.pDynamicStates = states;
+
+	VkGraphicsPipelineCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	create_info.stageCount = 2;
+	create_info.pStages = stages;
+	create_info.pVertexInputState = &vertex_input;
+	create_info.pInputAssemblyState = &input_assembly;
+	create_info.pViewportState = &viewport;
+	create_info.pRasterizationState = &rasterization;
+	create_info.pMultisampleState = &multisample;
+	create_info.pColorBlendState = &blend;
+	create_info.pDynamicState = &dynamic;
+	create_info.layout = type == Pipeline_Skybox ? m_skyboxPipelineLayout : m_layerPipelineLayout;
+	create_info.renderPass = renderPass;
+	create_info.subpass = 0;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if (vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &create_info, nullptr, &pipeline) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	m_pipelines[std::make_pair(renderPass, type)] = pipeline;
+	return pipeline;
+}
+
+VkCommandBuffer CompositorVk::BeginPass(Pass pass, Frame** outFrame)
+{
+	if (!Initialize())
+		return VK_NULL_HANDLE;
+
+	// The first pass of a frame waits until the frame is no longer in use by the GPU
+	if (!m_frame)
+	{
+		m_frame = &m_frames[m_frameIndex++ % REV_VK_FRAME_COUNT];
+		vkWaitForFences(m_device, 1, &m_frame->Fence, VK_TRUE, UINT64_MAX);
+		vkResetDescriptorPool(m_device, m_frame->DescriptorPool, 0);
+	}
+
+	VkCommandBuffer commandBuffer = m_frame->CommandBuffers[pass];
+	vkResetCommandBuffer(commandBuffer, 0);
+
+	VkCommandBufferBeginInfo begin_info = {};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (vkBeginCommandBuffer(commandBuffer, &begin_info) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	*outFrame = m_frame;
+	return commandBuffer;
+}
+
+void CompositorVk::EndPass(Frame* frame, Pass pass)
+{
+	if (vkEndCommandBuffer(frame->CommandBuffers[pass]) != VK_SUCCESS)
+		return;
+
+	// Submit to the application queue, so the commands are ordered before the submission to OpenVR
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &frame->CommandBuffers[pass];
+	vkQueueSubmit(m_queue, 1, &submit_info, VK_NULL_HANDLE);
+}
+
+void CompositorVk::FinishFrame()
+{
+	if (!m_frame)
+		return;
+
+	// An empty submission signals the fence once all the passes of the frame are done
+	vkResetFences(m_device, 1, &m_frame->Fence);
+	vkQueueSubmit(m_queue, 0, nullptr, m_frame->Fence);
+	m_frame = nullptr;
+}
+
+bool CompositorVk::CreateLayerBuffer()
+{
+	// Every frame has its own range, which is a multiple of the largest uniform buffer offset alignment
+	const VkDeviceSize frameSize = REV_VK_MAX_LAYERS * sizeof(LayerConstants);
+	static_assert(frameSize % 256 == 0, "The layer constants of a frame aren't aligned");
+
+	VkBufferCreateInfo buffer_info = {};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.size = frameSize * REV_VK_FRAME_COUNT;
+	buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (vkCreateBuffer(m_device, &buffer_info, nullptr, &m_layerBuffer) != VK_SUCCESS)
+		return false;
+
+	// The constants are written once per frame, so they're kept in coherent host memory
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(m_device, m_layerBuffer, &requirements);
+	VkPhysicalDeviceMemoryProperties properties;
+	vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &properties);
+	const VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	uint32_t type = 0;
+	while (type < properties.memoryTypeCount &&
+		!((requirements.memoryTypeBits & (1 << type)) && (properties.memoryTypes[type].propertyFlags & flags) == flags))
+		type++;
+	if (type >= properties.memoryTypeCount)
+		return false;
+
+	VkMemoryAllocateInfo alloc_info = {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = requirements.size;
+	alloc_info.memoryTypeIndex = type;
+	if (vkAllocateMemory(m_device, &alloc_info, nullptr, &m_layerMemory) != VK_SUCCESS)
+		return false;
+
+	void* data;
+	if (vkBindBufferMemory(m_device, m_layerBuffer, m_layerMemory, 0) != VK_SUCCESS ||
+		vkMapMemory(m_device, m_layerMemory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+		return false;
+
+	for (int i = 0; i < REV_VK_FRAME_COUNT; i++)
+	{
+		m_frames[i].LayersOffset = frameSize * i;
+		m_frames[i].Layers = (LayerConstants*)data + REV_VK_MAX_LAYERS * i;
+	}
+	return true;
+}
+
+VkDescriptorSet CompositorVk::AllocateDescriptorSet(Frame* frame, TextureVk* texture)
+{
+	VkImageView view = texture->View();
+	if (!view)
+		return VK_NULL_HANDLE;
+
+	VkDescriptorSetAllocateInfo alloc_info = {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.descriptorPool = frame->DescriptorPool;
+	alloc_info.descriptorSetCount = 1;
+	alloc_info.pSetLayouts = &m_skyboxSetLayout;
+
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	if (vkAllocateDescriptorSets(m_device, &alloc_info, &set) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	VkDescriptorImageInfo image_info = {};
+	image_info.sampler = m_sampler;
+	image_info.imageView = view;
+	image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &image_info;
+	vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+	return set;
+}
+
+VkDescriptorSet CompositorVk::AllocateLayerSet(Frame* frame, const VkImageView* views)
+{
+	VkDescriptorSetAllocateInfo alloc_info = {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.descriptorPool = frame->DescriptorPool;
+	alloc_info.descriptorSetCount = 1;
+	alloc_info.pSetLayouts = &m_layerSetLayout;
+
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	if (vkAllocateDescriptorSets(m_device, &alloc_info, &set) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	VkDescriptorImageInfo image_infos[REV_VK_LAYER_BATCH] = {};
+	for (int i = 0; i < REV_VK_LAYER_BATCH; i++)
+	{
+		image_infos[i].sampler = m_sampler;
+		image_infos[i].imageView = views[i];
+		image_infos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+
+	VkDescriptorBufferInfo buffer_info = { m_layerBuffer, frame->LayersOffset, REV_VK_MAX_LAYERS * sizeof(LayerConstants) };
+
+	VkWriteDescriptorSet writes[2] = {};
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet = set;
+	writes[0].dstBinding = 0;
+	writes[0].descriptorCount = REV_VK_LAYER_BATCH;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writes[0].pImageInfo = image_infos;
+	writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[1].dstSet = set;
+	writes[1].dstBinding = 1;
+	writes[1].descriptorCount = 1;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	writes[1].pBufferInfo = &buffer_info;
+	vkUpdateDescriptorSets(m_device, 2, writes, 0, nullptr);
+	return set;
+}
+
+void CompositorVk::AddBarrier(TextureVk* texture, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+	// An image can only be transitioned once per barrier
+	for (const VkImageMemoryBarrier& barrier : m_barriers)
+	{
+		if (barrier.image == texture->Image())
+			return;
+	}
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = texture->Image();
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+	m_barriers.push_back(barrier);
 }
 
 void CompositorVk::RenderMirrorTexture(ovrMirrorTexture mirrorTexture)
 {
-	// TODO: Support mirror textures
+	// OpenVR has no mirror textures for Vulkan, so we mirror the eye textures of the scene layer instead
+	if (!m_SceneTextures[ovrEye_Left])
+		return;
+
+	Frame* frame;
+	VkCommandBuffer commandBuffer = BeginPass(Pass_Mirror, &frame);
+	if (!commandBuffer)
+		return;
+
+	TextureVk* texture = (TextureVk*)mirrorTexture->Texture.get();
+	TextureVk* eyes[ovrEye_Count] = {
+		(TextureVk*)m_SceneTextures[ovrEye_Left],
+		(TextureVk*)(m_SceneTextures[ovrEye_Right] ? m_SceneTextures[ovrEye_Right] : m_SceneTextures[ovrEye_Left])
+	};
+
+	// The previous contents of the mirror texture are discarded, the eye textures remain in the transfer
+	// source layout, but we need to wait for any rendering to finish.
+	m_barriers.clear();
+	AddBarrier(texture, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+	for (int i = 0; i < ovrEye_Count; i++)
+	{
+		AddBarrier(eyes[i], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+	}
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, (uint32_t)m_barriers.size(), m_barriers.data());
+
+	// Blit the eye textures side-by-side into the mirror texture
+	for (int i = 0; i < ovrEye_Count; i++)
+	{
+		const ovrRecti& viewport = m_SceneViewports[i];
+		VkImageBlit region = {};
+		region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.srcSubresource.layerCount = 1;
+		region.srcOffsets[0] = { viewport.Pos.x, viewport.Pos.y, 0 };
+		region.srcOffsets[1] = { viewport.Pos.x + viewport.Size.w, viewport.Pos.y + viewport.Size.h, 1 };
+		region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.dstSubresource.layerCount = 1;
+		region.dstOffsets[0] = { (mirrorTexture->Desc.Width / 2) * i, 0, 0 };
+		region.dstOffsets[1] = { (mirrorTexture->Desc.Width / 2) * (i + 1), mirrorTexture->Desc.Height, 1 };
+
+		// Workaround for applications that leave the viewport uninitialized
+		if (viewport.Size.w <= 0 || viewport.Size.h <= 0)
+		{
+			VkExtent2D extent = eyes[i]->Extent();
+			region.srcOffsets[0] = { 0, 0, 0 };
+			region.srcOffsets[1] = { (int32_t)extent.width, (int32_t)extent.height, 1 };
+		}
+
+		vkCmdBlitImage(commandBuffer, eyes[i]->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			texture->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_LINEAR);
+	}
+
+	// Leave the mirror texture in the transfer source layout for the application
+	m_barriers.clear();
+	AddBarrier(texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0, 0, nullptr, 0, nullptr, (uint32_t)m_barriers.size(), m_barriers.data());
+
+	EndPass(frame, Pass_Mirror);
+}
+
+void CompositorVk::RenderLayerBlits(const LayerBlit* blits, size_t count)
+{
+	Frame* frame;
+	VkCommandBuffer commandBuffer = BeginPass(Pass_Layers, &frame);
+	if (!commandBuffer)
+		return;
+
+	// Make the layer textures readable by the shaders
+	m_barriers.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		AddBarrier((TextureVk*)blits[i].Texture, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, (uint32_t)m_barriers.size(), m_barriers.data());
+
+	// Draw all consecutive layers with the same target in a single render pass, with an instanced draw per batch
+	// of layers. The quads are mapped to the whole target, so the viewport doesn't change between layers.
+	uint32_t layerCount = 0;
+	for (size_t i = 0, end; i < count; i = end)
+	{
+		for (end = i + 1; end < count && blits[end].Target == blits[i].Target; end++);
+
+		TextureVk* target = (TextureVk*)blits[i].Target;
+		VkRenderPass renderPass = GetRenderPass(target->Format(), false);
+		VkPipeline pipeline = GetPipeline(renderPass, Pipeline_Layer);
+		VkFramebuffer framebuffer = pipeline ? target->Framebuffer(renderPass) : VK_NULL_HANDLE;
+		if (!framebuffer)
+			continue;
+
+		VkExtent2D extent = target->Extent();
+		VkViewport viewport = { 0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f };
+		VkRect2D scissor = { { 0, 0 }, extent };
+
+		VkRenderPassBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		begin_info.renderPass = renderPass;
+		begin_info.framebuffer = framebuffer;
+		begin_info.renderArea.extent = extent;
+		vkCmdBeginRenderPass(commandBuffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		// Layers beyond the constants of a frame are dropped, the same as when the descriptor pool runs out
+		for (size_t batch = i, batchEnd; batch < end && layerCount < REV_VK_MAX_LAYERS; batch = batchEnd)
+		{
+			batchEnd = (std::min)((std::min)(end, batch + REV_VK_LAYER_BATCH), batch + (REV_VK_MAX_LAYERS - layerCount));
+
+			// Unused slots are filled with another texture of the batch, a layer without a view is drawn empty
+			VkImageView views[REV_VK_LAYER_BATCH] = {};
+			VkImageView fallback = VK_NULL_HANDLE;
+			for (size_t j = batch; j < batchEnd; j++)
+			{
+				views[j - batch] = ((TextureVk*)blits[j].Texture)->View();
+				if (!fallback)
+					fallback = views[j - batch];
+			}
+			if (!fallback)
+				continue;
+
+			LayerConstants* constants = frame->Layers + layerCount;
+			for (size_t j = batch; j < batchEnd; j++)
+			{
+				vr::HmdVector4_t quad = {};
+				vr::VRTextureBounds_t bounds = {};
+				if (views[j - batch])
+					LayerBlitToTarget(blits[j], (int)extent.width, (int)extent.height, &quad, &bounds);
+				constants[j - batch] = {
+					{ quad.v[0], quad.v[1], quad.v[2], quad.v[3] },
+					{ bounds.uMin, bounds.vMin, bounds.uMax, bounds.vMax }
+				};
+			}
+			for (VkImageView& view : views)
+			{
+				if (!view)
+					view = fallback;
+			}
+
+			VkDescriptorSet set = AllocateLayerSet(frame, views);
+			if (!set)
+				break;
+
+			int32_t first = (int32_t)layerCount;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_layerPipelineLayout, 0, 1, &set, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, m_layerPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(first), &first);
+			vkCmdDraw(commandBuffer, 4, (uint32_t)(batchEnd - batch), 0, layerCount);
+			layerCount += (uint32_t)(batchEnd - batch);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	// Return the layer textures to the transfer source layout
+	for (VkImageMemoryBarrier& barrier : m_barriers)
+	{
+		std::swap(barrier.oldLayout, barrier.newLayout);
+		barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	}
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, (uint32_t)m_barriers.size(), m_barriers.data());
+
+	EndPass(frame, Pass_Layers);
+}
+
+bool CompositorVk::RenderSkybox(ovrTextureSwapChain cubeMap, const SkyboxFace* faces, TextureBase** targets)
+{
+	TextureVk* texture = (TextureVk*)cubeMap->Textures[cubeMap->SubmitIndex].get();
+	TextureVk* target = (TextureVk*)targets[0];
+
+	// All faces have the same format, so they share the render pass
+	VkRenderPass renderPass = Initialize() ? GetRenderPass(target->Format(), true) : VK_NULL_HANDLE;
+	VkPipeline pipeline = GetPipeline(renderPass, Pipeline_Skybox);
+	if (!pipeline)
+		return false;
+
+	Frame* frame;
+	VkCommandBuffer commandBuffer = BeginPass(Pass_Skybox, &frame);
+	if (!commandBuffer)
+		return false;
+
+	VkDescriptorSet set = AllocateDescriptorSet(frame, texture);
+	if (set)
+	{
+		// Make the cube map readable by the shaders
+		m_barriers.clear();
+		AddBarrier(texture, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, (uint32_t)m_barriers.size(), m_barriers.data());
+
+		// Every face covers the whole texture
+		LayerConstants layer = { { -1.0f, 1.0f, 1.0f, -1.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } };
+		VkExtent2D extent = target->Extent();
+		VkViewport viewport = { 0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f };
+		VkRect2D scissor = { { 0, 0 }, extent };
+
+		for (int i = 0; i < REV_SKYBOX_FACES; i++)
+		{
+			VkFramebuffer framebuffer = ((TextureVk*)targets[i])->Framebuffer(renderPass);
+			if (!framebuffer)
+				continue;
+
+			SkyboxConstants face = {
+				{ faces[i].Right.x, faces[i].Right.y, faces[i].Right.z, 0.0f },
+				{ faces[i].Up.x, faces[i].Up.y, faces[i].Up.z, 0.0f },
+				{ faces[i].Forward.x, faces[i].Forward.y, faces[i].Forward.z, 0.0f }
+			};
+
+			VkRenderPassBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			begin_info.renderPass = renderPass;
+			begin_info.framebuffer = framebuffer;
+			begin_info.renderArea.extent = extent;
+			vkCmdBeginRenderPass(commandBuffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_skyboxPipelineLayout, 0, 1, &set, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, m_skyboxPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(layer), &layer);
+			vkCmdPushConstants(commandBuffer, m_skyboxPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(layer), sizeof(face), &face);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+			vkCmdDraw(commandBuffer, 4, 1, 0, 0);
+			vkCmdEndRenderPass(commandBuffer);
+		}
+
+		// Return the cube map to the transfer source layout
+		m_barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		m_barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		m_barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		m_barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, (uint32_t)m_barriers.size(), m_barriers.data());
+	}
+
+	// The command buffer was begun, so it's always submitted
+	EndPass(frame, Pass_Skybox);
+	return set != VK_NULL_HANDLE;
 }
 
-void CompositorVk::RenderTextureSwapChain(vr::EVREye eye, ovrTextureSwapChain swapChain, ovrTextureSwapChain sceneChain, ovrRecti viewport, vr::VRTextureBounds_t bounds, vr::HmdVector4_t quad)
+void CompositorVk::SignalFences(TextureBase* const* textures, size_t count)
 {
-	// TODO: Support blending multiple scene layers
+	if (!m_device || !m_queue)
+		return;
+
+	// Reuse a fence that was signaled and isn't referenced by a texture anymore
+	std::shared_ptr<FenceVk> fence;
+	for (const std::shared_ptr<FenceVk>& pooled : m_fences)
+	{
+		if (pooled.use_count() == 1 && pooled->Signaled())
+		{
+			fence = pooled;
+			VkFence handle = fence->Fence();
+			vkResetFences(m_device, 1, &handle);
+			break;
+		}
+	}
+
+	if (!fence)
+	{
+		VkFenceCreateInfo create_info = {};
+		create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkFence handle = VK_NULL_HANDLE;
+		if (vkCreateFence(m_device, &create_info, nullptr, &handle) != VK_SUCCESS)
+			return;
+		fence = std::make_shared<FenceVk>(m_device, handle, vkDestroyFence, vkGetFenceStatus, vkWaitForFences);
+		m_fences.push_back(fence);
+	}
+
+	// A single empty submission for the whole frame signals the fence once all previously queued work is done,
+	// it's submitted last so it also covers the work OpenVR queued for the submitted textures
+	if (vkQueueSubmit(m_queue, 0, nullptr, fence->Fence()) != VK_SUCCESS)
+	{
+		m_fences.erase(std::find(m_fences.begin(), m_fences.end(), fence));
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++)
+		((TextureVk*)textures[i])->SetFence(fence);
 }
@@ -1,6 +1,52 @@
 #pragma once
 
 #include "CompositorBase.h"
+#include "AllocatorVk.h"
+#include "vulkan.h"
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#define REV_VK_FRAME_COUNT 3
+#define REV_VK_MAX_DESCRIPTORS 64
+
+// Layers are drawn in instanced batches, every batch binds up to REV_VK_LAYER_BATCH textures. At most
+// REV_VK_MAX_LAYERS layers are drawn per frame, both must match the layer shaders.
+#define REV_VK_LAYER_BATCH 8
+#define REV_VK_MAX_LAYERS 64
+
+class TextureVk;
+struct LayerConstants;
+
+// Fence shared by all textures submitted in the same frame, destroyed when the last texture releases it
+class FenceVk
+{
+public:
+	FenceVk(VkDevice device, VkFence fence, PFN_vkDestroyFence destroyFence, PFN_vkGetFenceStatus getFenceStatus,
+		PFN_vkWaitForFences waitForFences)
+		: m_device(device)
+		, m_fence(fence)
+		, vkDestroyFence(destroyFence)
+		, vkGetFenceStatus(getFenceStatus)
+		, vkWaitForFences(waitForFences)
+	{
+	}
+	~FenceVk() { vkDestroyFence(m_device, m_fence, nullptr); }
+
+	VkFence Fence() { return m_fence; }
+	bool Signaled() { return vkGetFenceStatus(m_device, m_fence) == VK_SUCCESS; }
+	void Wait() { vkWaitForFences(m_device, 1, &m_fence, VK_TRUE, UINT64_MAX); }
+
+private:
+	VkDevice m_device;
+	VkFence m_fence;
+
+	VK_DEFINE_FUNCTION(vkDestroyFence)
+	VK_DEFINE_FUNCTION(vkGetFenceStatus)
+	VK_DEFINE_FUNCTION(vkWaitForFences)
+};
 
 class CompositorVk :
 	public CompositorBase
@@ -13,16 +59,143 @@ public:
 	virtual void Flush() { }
 	virtual TextureBase* CreateTexture();
 
-	virtual void RenderTextureSwapChain(vr::EVREye eye, ovrTextureSwapChain swapChain, ovrTextureSwapChain sceneChain, ovrRecti viewport, vr::VRTextureBounds_t bounds, vr::HmdVector4_t quad);
+	virtual void RenderLayerBlits(const LayerBlit* blits, size_t count);
 	virtual void RenderMirrorTexture(ovrMirrorTexture mirrorTexture);
+	virtual bool RenderSkybox(ovrTextureSwapChain cubeMap, const SkyboxFace* faces, TextureBase** targets);
+	virtual void SignalFences(TextureBase* const* textures, size_t count);
+	virtual void FinishFrame();
 
-	void SetDevice(VkDevice device) { m_device = device; }
+	bool SetDevice(VkDevice device);
 	void SetQueue(VkQueue queue) { m_queue = queue; }
 
 private:
+	enum PipelineType
+	{
+		Pipeline_Layer,
+		Pipeline_Skybox,
+	};
+
+	// Every pass of a frame is recorded in its own command buffer, so it can be submitted before the
+	// OpenVR call that reads its results
+	enum Pass
+	{
+		Pass_Skybox,
+		Pass_Layers,
+		Pass_Mirror,
+		Pass_Count,
+	};
+
+	// Frames are recorded in a ring that advances once per frame, every frame waits for its fence before
+	// it's reused. The fence is signaled after the last pass, which covers all passes submitted before it.
+	struct Frame
+	{
+		VkCommandBuffer CommandBuffers[Pass_Count];
+		VkFence Fence;
+		VkDescriptorPool DescriptorPool;
+		VkDeviceSize LayersOffset;
+		LayerConstants* Layers;
+	};
+
 	VkDevice m_device;
 	VkPhysicalDevice m_physicalDevice;
 	VkInstance m_instance;
 	VkQueue m_queue;
-};
+	std::shared_ptr<AllocatorVk> m_allocator;
+
+	// Device objects, created when the first layer is composited
+	bool m_initialized;
+	bool m_initFailed;
+	VkCommandPool m_commandPool;
+	VkDescriptorSetLayout m_layerSetLayout;
+	VkDescriptorSetLayout m_skyboxSetLayout;
+	VkPipelineLayout m_layerPipelineLayout;
+	VkPipelineLayout m_skyboxPipelineLayout;
+	VkPipelineCache m_pipelineCache;
+	VkShaderModule m_layerVertexShader;
+	VkShaderModule m_layerFragmentShader;
+	VkShaderModule m_skyboxVertexShader;
+	VkShaderModule m_skyboxFragmentShader;
+	VkSampler m_sampler;
+
+	// Layer constants of all frames in a single persistently mapped buffer
+	VkBuffer m_layerBuffer;
+	VkDeviceMemory m_layerMemory;
+
+	Frame m_frames[REV_VK_FRAME_COUNT];
+	uint32_t m_frameIndex;
 
+	// The frame that passes are recorded to, null until the first pass of a frame begins
+	Frame* m_frame;
+
+	// Render passes and pipelines are cached per format, the render pass either preserves or discards the contents
+	std::map<std::pair<VkFormat, bool>, VkRenderPass> m_renderPasses;
+	std::map<std::pair<VkRenderPass, PipelineType>, VkPipeline> m_pipelines;
+
+	// Scratch space for the image barriers
+	std::vector<VkImageMemoryBarrier> m_barriers;
+
+	// Frame fences, a fence is reused once it's signaled and no texture references it anymore
+	std::vector<std::shared_ptr<FenceVk>> m_fences;
+
+	bool Initialize();
+	VkShaderModule CreateShaderModule(const uint32_t* code, size_t size);
+	VkRenderPass GetRenderPass(VkFormat format, bool discard);
+	VkPipeline GetPipeline(VkRenderPass renderPass, PipelineType type);
+	VkCommandBuffer BeginPass(Pass pass, Frame** outFrame);
+	void EndPass(Frame* frame, Pass pass);
+	bool CreateLayerBuffer();
+	VkDescriptorSet AllocateDescriptorSet(Frame* frame, TextureVk* texture);
+	VkDescriptorSet AllocateLayerSet(Frame* frame, const VkImageView* views);
+	void AddBarrier(TextureVk* texture, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess);
+
+	VK_DEFINE_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties)
+	VK_DEFINE_FUNCTION(vkCreateCommandPool)
+	VK_DEFINE_FUNCTION(vkDestroyCommandPool)
+	VK_DEFINE_FUNCTION(vkAllocateCommandBuffers)
+	VK_DEFINE_FUNCTION(vkBeginCommandBuffer)
+	VK_DEFINE_FUNCTION(vkEndCommandBuffer)
+	VK_DEFINE_FUNCTION(vkResetCommandBuffer)
+	VK_DEFINE_FUNCTION(vkQueueSubmit)
+	VK_DEFINE_FUNCTION(vkQueueWaitIdle)
+	VK_DEFINE_FUNCTION(vkCreateFence)
+	VK_DEFINE_FUNCTION(vkDestroyFence)
+	VK_DEFINE_FUNCTION(vkWaitForFences)
+	VK_DEFINE_FUNCTION(vkResetFences)
+	VK_DEFINE_FUNCTION(vkGetFenceStatus)
+	VK_DEFINE_FUNCTION(vkCreateDescriptorPool)
+	VK_DEFINE_FUNCTION(vkDestroyDescriptorPool)
+	VK_DEFINE_FUNCTION(vkResetDescriptorPool)
+	VK_DEFINE_FUNCTION(vkCreateDescriptorSetLayout)
+	VK_DEFINE_FUNCTION(vkDestroyDescriptorSetLayout)
+	VK_DEFINE_FUNCTION(vkAllocateDescriptorSets)
+	VK_DEFINE_FUNCTION(vkUpdateDescriptorSets)
+	VK_DEFINE_FUNCTION(vkCreatePipelineLayout)
+	VK_DEFINE_FUNCTION(vkDestroyPipelineLayout)
+	VK_DEFINE_FUNCTION(vkCreatePipelineCache)
+	VK_DEFINE_FUNCTION(vkDestroyPipelineCache)
+	VK_DEFINE_FUNCTION(vkCreateGraphicsPipelines)
+	VK_DEFINE_FUNCTION(vkDestroyPipeline)
+	VK_DEFINE_FUNCTION(vkCreateRenderPass)
+	VK_DEFINE_FUNCTION(vkDestroyRenderPass)
+	VK_DEFINE_FUNCTION(vkCreateShaderModule)
+	VK_DEFINE_FUNCTION(vkDestroyShaderModule)
+	VK_DEFINE_FUNCTION(vkCreateSampler)
+	VK_DEFINE_FUNCTION(vkDestroySampler)
+	VK_DEFINE_FUNCTION(vkCreateBuffer)
+	VK_DEFINE_FUNCTION(vkDestroyBuffer)
+	VK_DEFINE_FUNCTION(vkGetBufferMemoryRequirements)
+	VK_DEFINE_FUNCTION(vkAllocateMemory)
+	VK_DEFINE_FUNCTION(vkFreeMemory)
+	VK_DEFINE_FUNCTION(vkBindBufferMemory)
+	VK_DEFINE_FUNCTION(vkMapMemory)
+	VK_DEFINE_FUNCTION(vkCmdPipelineBarrier)
+	VK_DEFINE_FUNCTION(vkCmdBeginRenderPass)
+	VK_DEFINE_FUNCTION(vkCmdEndRenderPass)
+	VK_DEFINE_FUNCTION(vkCmdBindPipeline)
+	VK_DEFINE_FUNCTION(vkCmdBindDescriptorSets)
+	VK_DEFINE_FUNCTION(vkCmdPushConstants)
+	VK_DEFINE_FUNCTION(vkCmdSetViewport)
+	VK_DEFINE_FUNCTION(vkCmdSetScissor)
+	VK_DEFINE_FUNCTION(vkCmdDraw)
+	VK_DEFINE_FUNCTION(vkCmdBlitImage)
+};
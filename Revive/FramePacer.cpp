@@ -0,0 +1,208 @@
+#include "FramePacer.h"
+#include "Trace.h"
+#include "microprofile.h"
+
+#include <math.h>
+
+FramePacer::FramePacer(vr::IVRCompositor* compositor, vr::IVRSystem* system, Clock clock)
+	: m_Compositor(compositor)
+	, m_System(system)
+	, m_Clock(clock)
+	, m_Timeline()
+	, m_WaitedIndex(0)
+	, m_Samples()
+	, m_SampleCount(0)
+	, m_SampleNext(0)
+{
+	float frequency = m_System->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
+	m_NominalDuration = frequency > 0.0f ? 1.0 / frequency : 1.0 / 90.0;
+
+	Timeline timeline = {};
+	timeline.FrameDuration = m_NominalDuration;
+	timeline.AnchorIndex = -1;
+	m_Timeline.store(timeline);
+}
+
+vr::EVRCompositorError FramePacer::WaitToBeginFrame(long long frameIndex)
+{
+	// Claim the frame, but don't hold the lock while blocking so the session thread and
+	// the display time predictions aren't stalled for the rest of the frame
+	{
+		std::lock_guard<std::mutex> lk(m_Mutex);
+		if (frameIndex == m_WaitedIndex)
+			return vr::VRCompositorError_None;
+
+		// The application restarted its frame indices, so the anchor no longer applies either
+		if (frameIndex < m_WaitedIndex)
+		{
+			Timeline timeline = m_Timeline.load();
+			timeline.AnchorIndex = -1;
+			m_Timeline.store(timeline);
+		}
+		m_WaitedIndex = frameIndex;
+	}
+
+	vr::EVRCompositorError err;
+	{
+		REV_TRACE_SCOPE("WaitGetPoses");
+		err = m_Compositor->WaitGetPoses(nullptr, 0, nullptr, 0);
+	}
+
+	// Don't move the anchor back if a later frame was anchored in the meantime
+	std::lock_guard<std::mutex> lk(m_Mutex);
+	if (m_Timeline.load().AnchorIndex <= frameIndex)
+		UpdateTimeline(frameIndex);
+	return err;
+}
+
+void FramePacer::Sample()
+{
+	// Skip this tick if an application thread is updating the timeline, it adds a sample itself
+	std::unique_lock<std::mutex> lk(m_Mutex, std::try_to_lock);
+	if (!lk.owns_lock())
+		return;
+
+	Timeline timeline = m_Timeline.load();
+	if (AddVsyncSample(timeline))
+		m_Timeline.store(timeline);
+}
+
+double FramePacer::GetPredictedDisplayTime(long long frameIndex, long long currentIndex, double* outError)
+{
+	Timeline timeline = m_Timeline.load();
+
+	// The application didn't wait for the current frame, so anchor it to the next vsync
+	if (timeline.AnchorIndex < currentIndex)
+	{
+		std::lock_guard<std::mutex> lk(m_Mutex);
+		timeline = m_Timeline.load();
+		if (timeline.AnchorIndex < currentIndex)
+		{
+			UpdateTimeline(currentIndex);
+			timeline = m_Timeline.load();
+		}
+	}
+
+	long long vsync = (long long)timeline.AnchorVsync + (frameIndex - timeline.AnchorIndex);
+	double displayTime = timeline.VsyncTime + double(vsync - (long long)timeline.VsyncCounter) * timeline.FrameDuration;
+
+	// Frames after the anchor can't be displayed before the next vsync
+	if (frameIndex > timeline.AnchorIndex)
+	{
+		double now = m_Clock();
+		if (displayTime < now)
+			displayTime += ceil((now - displayTime) / timeline.FrameDuration) * timeline.FrameDuration;
+	}
+
+	if (outError)
+		*outError = timeline.Error;
+	return displayTime;
+}
+
+void FramePacer::UpdateTimeline(long long anchorIndex)
+{
+	Timeline timeline = m_Timeline.load();
+
+	if (!AddVsyncSample(timeline))
+	{
+		// Without a vsync counter assume the previous vsync is one frame before the next one
+		timeline.VsyncTime = m_Clock() + m_Compositor->GetFrameTimeRemaining() - timeline.FrameDuration;
+		timeline.VsyncCounter = 0;
+		m_SampleCount = 0;
+	}
+
+	// The frame we're anchoring on is displayed at the next vsync
+	uint64_t nextVsync = timeline.VsyncCounter + 1;
+	double now = m_Clock();
+	while (timeline.VsyncTime + double(nextVsync - timeline.VsyncCounter) * timeline.FrameDuration < now)
+		nextVsync++;
+
+	timeline.AnchorIndex = anchorIndex;
+	timeline.AnchorVsync = nextVsync;
+	m_Timeline.store(timeline);
+}
+
+bool FramePacer::AddVsyncSample(Timeline& timeline)
+{
+	float secondsSinceVsync;
+	uint64_t vsyncCounter;
+	if (!m_System->GetTimeSinceLastVsync(&secondsSinceVsync, &vsyncCounter))
+		return false;
+
+	VsyncSample sample = { vsyncCounter, m_Clock() - secondsSinceVsync };
+
+	if (m_SampleCount > 0)
+	{
+		// Log how far the model was off, a large error means the display mode changed
+		double predicted = timeline.VsyncTime + (double(sample.Counter) - double(timeline.VsyncCounter)) * timeline.FrameDuration;
+		double error = sample.Time - predicted;
+		MICROPROFILE_COUNTER_SET("FramePacer/Error (us)", (int64_t)(error * 1000000.0));
+
+		if (sample.Counter < timeline.VsyncCounter || fabs(error) > timeline.FrameDuration * REV_PACER_RESET_THRESHOLD)
+		{
+			MICROPROFILE_COUNTER_ADD("FramePacer/Resets", 1);
+			m_SampleCount = 0;
+
+			float frequency = m_System->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
+			if (frequency > 0.0f)
+				m_NominalDuration = 1.0 / frequency;
+			timeline.FrameDuration = m_NominalDuration;
+		}
+	}
+
+	m_Samples[m_SampleNext] = sample;
+	m_SampleNext = (m_SampleNext + 1) % REV_PACER_SAMPLE_COUNT;
+	if (m_SampleCount < REV_PACER_SAMPLE_COUNT)
+		m_SampleCount++;
+
+	FitTimeline(timeline);
+	return true;
+}
+
+void FramePacer::FitTimeline(Timeline& timeline)
+{
+	// Fit relative to the newest sample, so the sums stay small enough for a double
+	const VsyncSample& newest = m_Samples[(m_SampleNext + REV_PACER_SAMPLE_COUNT - 1) % REV_PACER_SAMPLE_COUNT];
+
+	double meanX = 0.0, meanY = 0.0;
+	for (uint32_t i = 0; i < m_SampleCount; i++)
+	{
+		const VsyncSample& sample = m_Samples[(m_SampleNext + REV_PACER_SAMPLE_COUNT - 1 - i) % REV_PACER_SAMPLE_COUNT];
+		meanX += double(sample.Counter) - double(newest.Counter);
+		meanY += sample.Time - newest.Time;
+	}
+	meanX /= m_SampleCount;
+	meanY /= m_SampleCount;
+
+	double covariance = 0.0, variance = 0.0;
+	for (uint32_t i = 0; i < m_SampleCount; i++)
+	{
+		const VsyncSample& sample = m_Samples[(m_SampleNext + REV_PACER_SAMPLE_COUNT - 1 - i) % REV_PACER_SAMPLE_COUNT];
+		double x = double(sample.Counter) - double(newest.Counter) - meanX;
+		double y = sample.Time - newest.Time - meanY;
+		covariance += x * y;
+		variance += x * x;
+	}
+
+	// The slope is only meaningful once the samples span a few vsyncs, until then use the nominal duration
+	double duration = timeline.FrameDuration;
+	if (variance >= 1.0)
+	{
+		duration = covariance / variance;
+		if (fabs(duration - m_NominalDuration) > m_NominalDuration * 0.1)
+			duration = m_NominalDuration;
+	}
+
+	timeline.FrameDuration = duration;
+	timeline.VsyncCounter = newest.Counter;
+	timeline.VsyncTime = newest.Time + meanY - duration * meanX;
+
+	double residuals = 0.0;
+	for (uint32_t i = 0; i < m_SampleCount; i++)
+	{
+		const VsyncSample& sample = m_Samples[(m_SampleNext + REV_PACER_SAMPLE_COUNT - 1 - i) % REV_PACER_SAMPLE_COUNT];
+		double predicted = timeline.VsyncTime + (double(sample.Counter) - double(timeline.VsyncCounter)) * duration;
+		residuals += (sample.Time - predicted) * (sample.Time - predicted);
+	}
+	timeline.Error = sqrt(residuals / m_SampleCount);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "seqlock.h"
+
+#include <openvr.h>
+#include <mutex>
+#include <stdint.h>
+
+// Number of vsync timestamps the timeline is fitted to
+#define REV_PACER_SAMPLE_COUNT 32
+
+// Vsync timestamps that deviate more than this fraction of a frame from the model reset the fit
+#define REV_PACER_RESET_THRESHOLD 0.25
+
+/*
+	Models the vsync timeline of the compositor, so the application only blocks once per frame
+	and the display time of any frame index can be predicted without calling into the compositor.
+	The timeline is a least-squares fit of the vsync time against the vsync counter.
+*/
+class FramePacer
+{
+public:
+	typedef double(*Clock)();
+
+	FramePacer(vr::IVRCompositor* compositor, vr::IVRSystem* system, Clock clock);
+	~FramePacer() { }
+
+	// Blocks until the running start of the frame, also known as queue-ahead in the Oculus SDK.
+	// Only blocks once per frame, even if the application skipped ahead several frames. A frame
+	// index below the last waited one restarts the frame indices.
+	vr::EVRCompositorError WaitToBeginFrame(long long frameIndex);
+
+	// Called periodically from the session thread, so the fit keeps tracking the vsync
+	// even when the application doesn't wait for its frames. Never blocks the caller.
+	void Sample();
+
+	// Predicts the vsync at which the frame will be displayed, the current frame is used as the
+	// anchor if the application didn't wait for it. The error is the RMS residual of the fit.
+	double GetPredictedDisplayTime(long long frameIndex, long long currentIndex, double* outError = nullptr);
+
+private:
+	// Snapshot of the vsync timeline, the anchor frame is displayed at the anchor vsync
+	struct Timeline
+	{
+		double VsyncTime;
+		uint64_t VsyncCounter;
+		double FrameDuration;
+		double Error;
+		long long AnchorIndex;
+		uint64_t AnchorVsync;
+	};
+
+	struct VsyncSample
+	{
+		uint64_t Counter;
+		double Time;
+	};
+
+	vr::IVRCompositor* m_Compositor;
+	vr::IVRSystem* m_System;
+	Clock m_Clock;
+	double m_NominalDuration;
+
+	// Only one thread can update the timeline at a time, readers never block.
+	// Never held while blocking in the compositor.
+	std::mutex m_Mutex;
+	seqlock<Timeline> m_Timeline;
+	long long m_WaitedIndex;
+
+	// Recent vsync timestamps, protected by the mutex
+	VsyncSample m_Samples[REV_PACER_SAMPLE_COUNT];
+	uint32_t m_SampleCount;
+	uint32_t m_SampleNext;
+
+	void UpdateTimeline(long long anchorIndex);
+	bool AddVsyncSample(Timeline& timeline);
+	void FitTimeline(Timeline& timeline);
+};
@@ -1,65 +1,102 @@
 #include "HapticsBuffer.h"
 
+#include <algorithm>
+#include <string.h>
+
+static uint64_t PackConstant(float frequency, float amplitude)
+{
+	uint32_t freq, amp;
+	memcpy(&freq, &frequency, sizeof(float));
+	memcpy(&amp, &amplitude, sizeof(float));
+	return (uint64_t)freq << 32 | amp;
+}
+
+static void UnpackConstant(uint64_t constant, float* frequency, float* amplitude)
+{
+	uint32_t freq = (uint32_t)(constant >> 32);
+	uint32_t amp = (uint32_t)constant;
+	memcpy(frequency, &freq, sizeof(float));
+	memcpy(amplitude, &amp, sizeof(float));
+}
+
 HapticsBuffer::HapticsBuffer()
 	: m_ReadIndex(0)
-	, m_WriteIndex(0)
+	, m_ReserveIndex(0)
 	, m_Buffer()
+	, m_Constant(0)
+	, m_ConstantTimeout(0)
 {
+	for (Slot& slot : m_Buffer)
+		slot.Sequence.store(0, std::memory_order_relaxed);
 }
 
-void HapticsBuffer::AddSamples(const ovrHapticsBuffer* buffer)
+bool HapticsBuffer::AddSamples(const ovrHapticsBuffer* buffer)
 {
+	// Enqueue is the only submit mode, samples are always appended to the queue
+	if (buffer->SubmitMode != ovrHapticsBufferSubmit_Enqueue || buffer->SamplesCount < 0)
+		return false;
+
 	// Force constant vibration off
 	m_ConstantTimeout = 0;
 
-	uint8_t* samples = (uint8_t*)buffer->Samples;
-
-	for (int i = 0; i < buffer->SamplesCount; i++)
+	// Reserve as many samples as will fit in the buffer
+	uint32_t start = m_ReserveIndex.load(std::memory_order_relaxed);
+	uint32_t count;
+	do
 	{
-		if (m_WriteIndex == m_ReadIndex - 1)
-			return;
-
-		m_Buffer[m_WriteIndex] = samples[i];
-
-		// We increment the atomic here as a memory barrier
-		// Index will overflow correctly, so no need for a modulo operator
-		m_WriteIndex++;
+		uint32_t queued = start - m_ReadIndex.load(std::memory_order_acquire);
+		count = std::min((uint32_t)buffer->SamplesCount, OVR_HAPTICS_BUFFER_SAMPLES_MAX - queued);
+		if (count == 0)
+			return true;
+	} while (!m_ReserveIndex.compare_exchange_weak(start, start + count, std::memory_order_relaxed));
+
+	// Publish every sample on its own, producers never wait for each other
+	const uint8_t* samples = (const uint8_t*)buffer->Samples;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Slot& slot = m_Buffer[(start + i) % OVR_HAPTICS_BUFFER_SAMPLES_MAX];
+		slot.Sample = samples[i];
+		slot.Sequence.store(start + i + 1, std::memory_order_release);
 	}
+	return true;
 }
 
 void HapticsBuffer::SetConstant(float frequency, float amplitude)
 {
 	// The documentation specifies a constant vibration should time out after 2.5 seconds
-	m_ConstantMutex.lock();
-	m_Amplitude = amplitude;
-	m_Frequency = frequency;
-	m_ConstantMutex.unlock();
-	m_ConstantTimeout = (uint16_t)(REV_HAPTICS_SAMPLE_RATE * 2.5);
+	m_Constant.store(PackConstant(frequency, amplitude), std::memory_order_relaxed);
+
+	// A zero amplitude stops the vibration, so there's no need to keep sampling it
+	m_ConstantTimeout = amplitude > 0.0f ? (uint16_t)(REV_HAPTICS_SAMPLE_RATE * 2.5) : 0;
 }
 
 float HapticsBuffer::GetSample()
 {
-	if (m_ConstantTimeout > 0)
+	// The producers can reset the timeout at any time, so only decrement it while it's still positive,
+	// otherwise a reset between the check and the decrement would wrap it around
+	uint16_t timeout = m_ConstantTimeout.load(std::memory_order_relaxed);
+	while (timeout > 0 && !m_ConstantTimeout.compare_exchange_weak(timeout, timeout - 1, std::memory_order_relaxed));
+
+	if (timeout > 0)
 	{
-		m_ConstantMutex.lock();
-		float sample = m_Amplitude;
-		if (m_Frequency <= 0.5f && m_ConstantTimeout % 2 == 0)
-			sample = 0.0f;
-		m_ConstantMutex.unlock();
+		float frequency, amplitude;
+		UnpackConstant(m_Constant.load(std::memory_order_relaxed), &frequency, &amplitude);
 
-		m_ConstantTimeout--;
+		float sample = amplitude;
+		if (frequency <= 0.5f && timeout % 2 == 0)
+			sample = 0.0f;
 		return sample;
 	}
 
-	// We can't pass the write index, so the buffer is now empty
-	if (m_ReadIndex == m_WriteIndex)
+	// The next slot hasn't been published yet, either the buffer is empty or
+	// a producer is still writing it, in which case it's picked up next time
+	uint32_t read = m_ReadIndex.load(std::memory_order_relaxed);
+	Slot& slot = m_Buffer[read % OVR_HAPTICS_BUFFER_SAMPLES_MAX];
+	if (slot.Sequence.load(std::memory_order_acquire) != read + 1)
 		return 0.0f;
 
-	uint8_t sample = m_Buffer[m_ReadIndex];
-
-	// We increment the atomic here as a memory barrier
-	// Index will overflow correctly, so no need for a modulo operator
-	m_ReadIndex++;
+	uint8_t sample = slot.Sample;
+	m_ReadIndex.store(read + 1, std::memory_order_release);
 
 	return sample / 255.0f;
 }
@@ -68,11 +105,13 @@ ovrHapticsPlaybackState HapticsBuffer::GetState()
 {
 	ovrHapticsPlaybackState state = { 0 };
 
-	for (uint8_t i = m_WriteIndex; i != m_ReadIndex; i++)
-		state.RemainingQueueSpace++;
-
-	for (uint8_t i = m_ReadIndex; i != m_WriteIndex; i++)
-		state.SamplesQueued++;
+	// Samples that are still being written count as queued, the consumer
+	// may advance between the loads, so clamp the result
+	uint32_t read = m_ReadIndex.load(std::memory_order_acquire);
+	uint32_t reserve = m_ReserveIndex.load(std::memory_order_acquire);
+	int32_t queued = std::max((int32_t)(reserve - read), 0);
+	state.SamplesQueued = queued;
+	state.RemainingQueueSpace = OVR_HAPTICS_BUFFER_SAMPLES_MAX - queued;
 
 	return state;
 }
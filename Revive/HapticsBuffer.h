@@ -3,7 +3,6 @@
 #include "OVR_CAPI.h"
 
 #include <atomic>
-#include <mutex>
 
 #define REV_HAPTICS_SAMPLE_RATE 320
 
@@ -13,22 +12,30 @@ public:
 	HapticsBuffer();
 	~HapticsBuffer() { }
 
-	void AddSamples(const ovrHapticsBuffer* buffer);
+	bool AddSamples(const ovrHapticsBuffer* buffer);
 	void SetConstant(float frequency, float amplitude);
 	float GetSample();
 	ovrHapticsPlaybackState GetState();
+	bool IsActive() { return m_ConstantTimeout > 0 || m_ReadIndex != m_ReserveIndex; }
 
 private:
-	// Lock-less circular buffer, single producer/consumer
-	std::atomic_uint8_t m_ReadIndex;
-	std::atomic_uint8_t m_WriteIndex;
-	uint8_t m_Buffer[OVR_HAPTICS_BUFFER_SAMPLES_MAX];
-
-	// Constant feedback, uses locks
-	std::mutex m_ConstantMutex;
+	// Every slot is published with the position it was written at plus one,
+	// so the consumer can tell whether a reserved slot has been written yet
+	struct Slot
+	{
+		std::atomic_uint32_t Sequence;
+		uint8_t Sample;
+	};
+
+	// Lock-free circular buffer, multiple producers and a single consumer
+	// Indices are free-running counters, so the occupancy is simply the difference
+	std::atomic_uint32_t m_ReadIndex;
+	std::atomic_uint32_t m_ReserveIndex;
+	Slot m_Buffer[OVR_HAPTICS_BUFFER_SAMPLES_MAX];
+
+	// Constant feedback, the frequency and amplitude are packed together
+	std::atomic_uint64_t m_Constant;
 	std::atomic_uint16_t m_ConstantTimeout;
-	float m_Frequency;
-	float m_Amplitude;
 };
 
 static_assert(OVR_HAPTICS_BUFFER_SAMPLES_MAX == 256, "The Haptics Buffer is designed for 256 samples");
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Drives the vibration of all devices while any of them is vibrating, the thread sleeps until
+	it's woken up when all devices are idle. The devices need IsVibrating() and PlayVibration(),
+	the clock is a template parameter so the schedule can be tested with a simulated clock.
+*/
+template<typename Device, typename Clock = std::chrono::steady_clock>
+class HapticsScheduler
+{
+public:
+	HapticsScheduler(const std::vector<Device*>& devices, std::chrono::microseconds period)
+		: m_Devices(devices), m_Period(period), m_bRunning(false), m_bPending(false) { }
+	~HapticsScheduler() { Stop(); }
+
+	// The devices must not change while the scheduler is running
+	void Start()
+	{
+		m_bRunning = true;
+		m_Thread = std::thread(&HapticsScheduler::Run, this);
+	}
+
+	void Stop()
+	{
+		if (!m_Thread.joinable())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lk(m_Mutex);
+			m_bRunning = false;
+		}
+		m_CV.notify_all();
+		m_Thread.join();
+	}
+
+	// Call after submitting a vibration, the flag makes sure the wakeup isn't lost if the
+	// thread is just about to go to sleep
+	void Wake()
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_Mutex);
+			m_bPending = true;
+		}
+		m_CV.notify_one();
+	}
+
+private:
+	const std::vector<Device*>& m_Devices;
+	std::chrono::microseconds m_Period;
+	std::thread m_Thread;
+	std::mutex m_Mutex;
+	std::condition_variable m_CV;
+	bool m_bRunning;
+	bool m_bPending;
+
+	void Run()
+	{
+		std::unique_lock<std::mutex> lk(m_Mutex);
+		typename Clock::time_point deadline = Clock::now();
+		while (m_bRunning)
+		{
+			bool vibrating = false;
+			for (Device* device : m_Devices)
+				vibrating |= device->IsVibrating();
+
+			// If all devices are idle, sleep until new vibrations are submitted
+			if (!vibrating)
+			{
+				m_CV.wait(lk, [this] { return !m_bRunning || m_bPending; });
+				m_bPending = false;
+				deadline = Clock::now();
+				continue;
+			}
+			m_bPending = false;
+
+			lk.unlock();
+			for (Device* device : m_Devices)
+				device->PlayVibration(m_Period);
+			lk.lock();
+
+			// Use absolute deadlines so the sample rate doesn't drift, but don't try to catch up after a stall.
+			// Restart the schedule a full period after the late sample, so it isn't followed by another one.
+			deadline += m_Period;
+			typename Clock::time_point now = Clock::now();
+			if (deadline + m_Period < now)
+				deadline = now + m_Period;
+			m_CV.wait_until(lk, deadline, [this] { return !m_bRunning; });
+		}
+	}
+};
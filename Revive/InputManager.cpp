@@ -5,8 +5,10 @@
 #include "SettingsManager.h"
 #include "CompositorBase.h"
 #include "OVR_CAPI.h"
+#include "PoseConversion.h"
 #include "REV_Math.h"
 #include "rcu_ptr.h"
+#include "Trace.h"
 
 #include <openvr.h>
 #include <Windows.h>
@@ -14,12 +16,11 @@
 #include <lua.hpp>
 #include <assert.h>
 
-const char* InputManager::s_ButtonNames[vr::k_EButton_Max];
-const char* InputManager::s_TypeNames[4];
-
 InputManager::InputManager()
 	: m_InputDevices()
 	, m_LastPoses()
+	, m_PoseCache()
+	, m_HapticsScheduler(m_InputDevices, std::chrono::microseconds(std::chrono::seconds(1)) / REV_HAPTICS_SAMPLE_RATE)
 {
 	for (ovrPoseStatef& pose : m_LastPoses)
 		pose.ThePose = OVR::Posef::Identity();
@@ -27,11 +28,6 @@ InputManager::InputManager()
 	// TODO: This might change if a new HMD is connected (unlikely)
 	m_fVsyncToPhotons = vr::VRSystem()->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
 
-	for (int i = 0; i < vr::k_EButton_Max; i++)
-		s_ButtonNames[i] = vr::VRSystem()->GetButtonIdNameFromEnum((vr::EVRButtonId)i) + 10; // Skip the 10-char enum prefix
-	for (int i = 0; i < 4; i++)
-		s_TypeNames[i] = vr::VRSystem()->GetControllerAxisTypeNameFromEnum((vr::EVRControllerAxisType)i) + +18; // Skip the 18-char enum prefix
-
 	// TODO: XInput is slow, move it to another thread
 #if 0
 	m_InputDevices.push_back(new XboxGamepad());
@@ -41,43 +37,63 @@ InputManager::InputManager()
 	m_InputDevices.push_back(new OculusTouch(vr::TrackedControllerRole_RightHand));
 
 	UpdateConnectedControllers();
+
+	m_HapticsScheduler.Start();
 }
 
 InputManager::~InputManager()
 {
+	m_HapticsScheduler.Stop();
+
 	for (InputDevice* device : m_InputDevices)
 		delete device;
 }
 
 void InputManager::UpdateConnectedControllers()
 {
+	m_HandIndices[ovrHand_Left] = vr::VRSystem()->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_LeftHand);
+	m_HandIndices[ovrHand_Right] = vr::VRSystem()->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_RightHand);
+
+	vr::TrackedDeviceIndex_t trackers[vr::k_unMaxTrackedDeviceCount];
+	uint32_t trackerCount = vr::VRSystem()->GetSortedTrackedDeviceIndicesOfClass(vr::TrackedDeviceClass_GenericTracker, trackers, vr::k_unMaxTrackedDeviceCount);
+	for (uint32_t i = 0; i < sizeof(m_TrackerIndices) / sizeof(m_TrackerIndices[0]); i++)
+		m_TrackerIndices[i] = i < trackerCount ? trackers[i] : vr::k_unTrackedDeviceIndexInvalid;
+
+	// Refresh the cached device indices before checking which controllers are connected
 	uint32_t types = 0;
 	for (InputDevice* device : m_InputDevices)
 	{
-		if (device->IsConnected())
-			types |= device->GetType();
-
 		if (device->GetType() & ovrControllerType_Touch)
 		{
 			OculusTouch* touch = dynamic_cast<OculusTouch*>(device);
 			assert(touch);
-			if (!touch)
-				continue;
-
-			uint16_t axes = 0;
-			vr::TrackedDeviceIndex_t index = vr::VRSystem()->GetTrackedDeviceIndexForControllerRole(touch->GetRole());
-			for (int i = 0; i < vr::k_unControllerStateAxisCount; i++)
-			{
-				vr::EVRControllerAxisType type = (vr::EVRControllerAxisType)vr::VRSystem()->GetInt32TrackedDeviceProperty(
-					index, (vr::ETrackedDeviceProperty)(vr::Prop_Axis0Type_Int32 + i));
-				axes |= (type & 3) << (i * 2);
-			}
-			touch->m_AxisTypes = axes;
+			if (touch)
+				touch->UpdateDevice(m_HandIndices[touch->GetRole() == vr::TrackedControllerRole_LeftHand ? ovrHand_Left : ovrHand_Right]);
 		}
+
+		if (device->IsConnected())
+			types |= device->GetType();
 	}
 	ConnectedControllers = types;
 }
 
+void InputManager::OculusTouch::UpdateDevice(vr::TrackedDeviceIndex_t index)
+{
+	uint16_t axes = 0;
+	if (index != vr::k_unTrackedDeviceIndexInvalid)
+	{
+		for (int i = 0; i < vr::k_unControllerStateAxisCount; i++)
+		{
+			vr::EVRControllerAxisType type = (vr::EVRControllerAxisType)vr::VRSystem()->GetInt32TrackedDeviceProperty(
+				index, (vr::ETrackedDeviceProperty)(vr::Prop_Axis0Type_Int32 + i));
+			axes |= (type & 3) << (i * 2);
+		}
+	}
+	m_AxisTypes = axes;
+	m_DeviceIndex = index;
+	SetModel(index);
+}
+
 ovrResult InputManager::SetControllerVibration(ovrSession session, ovrControllerType controllerType, float frequency, float amplitude)
 {
 	// Clamp the input
@@ -90,13 +106,12 @@ ovrResult InputManager::SetControllerVibration(ovrSession session, ovrController
 			device->SetVibration(frequency, amplitude);
 	}
 
+	m_HapticsScheduler.Wake();
 	return ovrSuccess;
 }
 
-// TODO: Make GetInputState() lock-free
 ovrResult InputManager::GetInputState(ovrSession session, ovrControllerType controllerType, ovrInputState* inputState)
 {
-	std::unique_lock<std::mutex> lk(m_InputMutex);
 	memset(inputState, 0, sizeof(ovrInputState));
 
 	inputState->TimeInSeconds = ovr_GetTimeInSeconds();
@@ -106,8 +121,13 @@ ovrResult InputManager::GetInputState(ovrSession session, ovrControllerType cont
 	{
 		if (controllerType & device->GetType() && ConnectedControllers & device->GetType())
 		{
-			if (device->GetInputState(session, inputState))
+			ovrInputState state = { inputState->TimeInSeconds };
+			if (device->PollInputState(session, &state))
 				types |= device->GetType();
+			MergeInputState(inputState, state);
+
+			// Report the time of the oldest snapshot, another thread may have polled the device earlier
+			inputState->TimeInSeconds = min(inputState->TimeInSeconds, state.TimeInSeconds);
 		}
 	}
 
@@ -117,12 +137,16 @@ ovrResult InputManager::GetInputState(ovrSession session, ovrControllerType cont
 
 ovrResult InputManager::SubmitControllerVibration(ovrSession session, ovrControllerType controllerType, const ovrHapticsBuffer* buffer)
 {
+	if (!buffer || buffer->SubmitMode != ovrHapticsBufferSubmit_Enqueue)
+		return ovrError_InvalidParameter;
+
 	for (InputDevice* device : m_InputDevices)
 	{
 		if (controllerType & device->GetType() && ConnectedControllers & device->GetType())
 			device->SubmitVibration(buffer);
 	}
 
+	m_HapticsScheduler.Wake();
 	return ovrSuccess;
 }
 
@@ -156,6 +180,34 @@ ovrTouchHapticsDesc InputManager::GetTouchHapticsDesc(ovrControllerType controll
 	return desc;
 }
 
+void InputManager::MergeInputState(ovrInputState* dst, const ovrInputState& src)
+{
+	dst->Buttons |= src.Buttons;
+	dst->Touches |= src.Touches;
+
+	// Every device only writes the hands it represents, so only merge the values that were set
+	for (int i = 0; i < ovrHand_Count; i++)
+	{
+	#define MERGE_FIELD(field) \
+		if (src.field[i] != 0.0f) dst->field[i] = src.field[i];
+	#define MERGE_VECTOR(field) \
+		if (src.field[i].x != 0.0f || src.field[i].y != 0.0f) dst->field[i] = src.field[i];
+
+		MERGE_FIELD(IndexTrigger);
+		MERGE_FIELD(HandTrigger);
+		MERGE_VECTOR(Thumbstick);
+		MERGE_FIELD(IndexTriggerNoDeadzone);
+		MERGE_FIELD(HandTriggerNoDeadzone);
+		MERGE_VECTOR(ThumbstickNoDeadzone);
+		MERGE_FIELD(IndexTriggerRaw);
+		MERGE_FIELD(HandTriggerRaw);
+		MERGE_VECTOR(ThumbstickRaw);
+
+	#undef MERGE_FIELD
+	#undef MERGE_VECTOR
+	}
+}
+
 unsigned int InputManager::TrackedDevicePoseToOVRStatusFlags(vr::TrackedDevicePose_t pose)
 {
 	unsigned int result = 0;
@@ -172,33 +224,6 @@ unsigned int InputManager::TrackedDevicePoseToOVRStatusFlags(vr::TrackedDevicePo
 	return result;
 }
 
-ovrPoseStatef InputManager::TrackedDevicePoseToOVRPose(vr::TrackedDevicePose_t pose, ovrPoseStatef& lastPose, double time)
-{
-	ovrPoseStatef result = { OVR::Posef::Identity() };
-	if (!pose.bPoseIsValid)
-		return result;
-
-	OVR::Matrix4f matrix = REV::Matrix4f(pose.mDeviceToAbsoluteTracking);
-
-	// Make sure the orientation stays in the same hemisphere as the previous orientation, this prevents
-	// linear interpolations from suddenly flipping the long way around in Oculus Medium.
-	OVR::Quatf q(matrix);
-	q.EnsureSameHemisphere(lastPose.ThePose.Orientation);
-
-	result.ThePose.Orientation = q;
-	result.ThePose.Position = matrix.GetTranslation();
-	result.AngularVelocity = (REV::Vector3f)pose.vAngularVelocity;
-	result.LinearVelocity = (REV::Vector3f)pose.vVelocity;
-	result.AngularAcceleration = ((REV::Vector3f)pose.vAngularVelocity - lastPose.AngularVelocity) / float(time - lastPose.TimeInSeconds);
-	result.LinearAcceleration = ((REV::Vector3f)pose.vVelocity - lastPose.LinearVelocity) / float(time - lastPose.TimeInSeconds);
-	result.TimeInSeconds = time;
-
-	// Store the last pose
-	lastPose = result;
-
-	return result;
-}
-
 int InputManager::ErrorHandler(lua_State* L)
 {
 	static bool first_error = true;
@@ -226,6 +251,7 @@ bool InputManager::LoadResourceScript(lua_State* L, const char* name)
 		lua_pop(L, 1);
 		return false;
 	}
+	REV_TRACE_SCOPE("LoadScript");
 	return !lua_pcall(L, 0, LUA_MULTRET, 1);
 }
 
@@ -238,10 +264,11 @@ bool InputManager::LoadFileScript(lua_State* L, const char* fn)
 		lua_pop(L, 1);
 		return false;
 	}
+	REV_TRACE_SCOPE("LoadScript");
 	return !lua_pcall(L, 0, LUA_MULTRET, 1);
 }
 
-bool InputManager::LoadInputScript(const char* fn)
+bool InputManager::LoadInputScript(const char* fn, bool nativeFallback)
 {
 	for (InputDevice* device : m_InputDevices)
 	{
@@ -250,7 +277,6 @@ bool InputManager::LoadInputScript(const char* fn)
 			/* Create LUA VM state */
 			lua_State* L = luaL_newstate();
 			assert(L);
-			m_ScriptStates.push_back(L);
 
 			lua_pushcfunction(L, ErrorHandler);
 
@@ -258,26 +284,31 @@ bool InputManager::LoadInputScript(const char* fn)
 			lua_pushcfunction(L, luaopen_##lib); \
 			lua_pcall(L, 0, 0, 1);
 
-			// We only load three basic libraries, we don't want to expose dangerous OS functions
+			// We only load a few basic libraries, we don't want to expose dangerous OS functions
 			LUA_LOADLIB(base);
 			LUA_LOADLIB(table);
 			LUA_LOADLIB(math);
 			LUA_LOADLIB(string);
+			LUA_LOADLIB(bit);
 
 			bool success = LoadResourceScript(L, "HEADER");
 			assert(success);
-			if (!success)
-				return false;
 
-			// Attempt to load the script, if it fails load the internal script instead
-			success = LoadFileScript(L, fn);
-			if (!success)
-				success = LoadResourceScript(L, "INPUT");
-			assert(success);
+			// Attempt to load the script, if it fails the controllers use the native input mapping instead.
+			// Without the native mapping the embedded default script is loaded, as it was before.
+			if (success)
+			{
+				success = LoadFileScript(L, fn);
+				if (!success && !nativeFallback)
+					success = LoadResourceScript(L, "INPUT");
+			}
 
-			// If the lua script fails, we set it on the controllers
 			if (!success)
-				return false;
+			{
+				lua_close(L);
+				continue;
+			}
+			m_ScriptStates.push_back(L);
 
 			OculusTouch* touch = dynamic_cast<OculusTouch*>(device);
 			if (touch)
@@ -290,7 +321,10 @@ bool InputManager::LoadInputScript(const char* fn)
 void InputManager::GetTrackingState(ovrSession session, ovrTrackingState* outState, double absTime)
 {
 	if (session->Details->UseHack(SessionDetails::HACK_WAIT_IN_TRACKING_STATE))
+	{
+		REV_TRACE_SCOPE("WaitGetPoses");
 		vr::VRCompositor()->WaitGetPoses(nullptr, 0, nullptr, 0);
+	}
 
 	// Calculate the relative prediction time
 	float relTime = 0.0f;
@@ -302,117 +336,152 @@ void InputManager::GetTrackingState(ovrSession session, ovrTrackingState* outSta
 	// Get the device poses
 	vr::ETrackingUniverseOrigin origin = session->TrackingOrigin;
 	vr::TrackedDevicePose_t poses[vr::k_unMaxTrackedDeviceCount];
-	vr::VRSystem()->GetDeviceToAbsoluteTrackingPose(origin, relTime, poses, vr::k_unMaxTrackedDeviceCount);
+	GetTrackedDevicePoses(session, origin, relTime, poses);
 
-	// Convert the head pose
-	outState->HeadPose = TrackedDevicePoseToOVRPose(poses[vr::k_unTrackedDeviceIndex_Hmd], m_LastPoses[vr::k_unTrackedDeviceIndex_Hmd], absTime);
+	// Gather the head pose and the hand poses, so they can be converted in a single batch
+	vr::TrackedDevicePose_t batch[1 + ovrHand_Count];
+	ovrPoseStatef* lastPoses[1 + ovrHand_Count];
+	ovrPoseStatef results[1 + ovrHand_Count];
+	int batchHands[ovrHand_Count];
+	int count = 0;
+
+	batch[count] = poses[vr::k_unTrackedDeviceIndex_Hmd];
+	lastPoses[count++] = &m_LastPoses[vr::k_unTrackedDeviceIndex_Hmd];
 	outState->StatusFlags = TrackedDevicePoseToOVRStatusFlags(poses[vr::k_unTrackedDeviceIndex_Hmd]);
 
-	// Convert the hand poses
 	rcu_ptr<InputSettings> settings = session->Settings->Input;
-	vr::TrackedDeviceIndex_t hands[] = { vr::VRSystem()->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_LeftHand),
-		vr::VRSystem()->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_RightHand) };
 	for (int i = 0; i < ovrHand_Count; i++)
 	{
-		vr::TrackedDeviceIndex_t deviceIndex = hands[i];
+		vr::TrackedDeviceIndex_t deviceIndex = m_HandIndices[i];
 		if (deviceIndex == vr::k_unTrackedDeviceIndexInvalid)
 		{
-			outState->HandPoses[i].ThePose = OVR::Posef::Identity();
+			batchHands[i] = -1;
 			continue;
 		}
 
-		vr::TrackedDevicePose_t pose;
-		vr::VRSystem()->ApplyTransform(&pose, &poses[deviceIndex], &settings->TouchOffset[i]);
-		outState->HandPoses[i] = TrackedDevicePoseToOVRPose(pose, m_LastPoses[deviceIndex], absTime);
+		vr::VRSystem()->ApplyTransform(&batch[count], &poses[deviceIndex], &settings->TouchOffset[i]);
+		lastPoses[count] = &m_LastPoses[deviceIndex];
+		batchHands[i] = count++;
 		outState->HandStatusFlags[i] = TrackedDevicePoseToOVRStatusFlags(poses[deviceIndex]);
 	}
 
+	TrackedDevicePosesToOVRPoses(batch, lastPoses, count, absTime, results);
+
+	outState->HeadPose = results[0];
+	for (int i = 0; i < ovrHand_Count; i++)
+	{
+		if (batchHands[i] < 0)
+			outState->HandPoses[i].ThePose = OVR::Posef::Identity();
+		else
+			outState->HandPoses[i] = results[batchHands[i]];
+	}
+
 	// TODO: Calibrate the origin ourselves instead of relying on OpenVR.
 	outState->CalibratedOrigin.Orientation = OVR::Quatf::Identity();
 	outState->CalibratedOrigin.Position = OVR::Vector3f();
 }
 
-ovrResult InputManager::GetDevicePoses(ovrTrackedDeviceType* deviceTypes, int deviceCount, double absTime, ovrPoseStatef* outDevicePoses)
+vr::TrackedDeviceIndex_t InputManager::GetDeviceIndex(ovrTrackedDeviceType deviceType,
+	const vr::TrackedDeviceIndex_t* hands, const vr::TrackedDeviceIndex_t* trackers)
+{
+	// Get the index for device types we recognize
+	switch (deviceType)
+	{
+	case ovrTrackedDevice_HMD:
+		return vr::k_unTrackedDeviceIndex_Hmd;
+	case ovrTrackedDevice_LTouch:
+		return hands[ovrHand_Left];
+	case ovrTrackedDevice_RTouch:
+		return hands[ovrHand_Right];
+	case ovrTrackedDevice_Object0:
+		return trackers[0];
+	case ovrTrackedDevice_Object1:
+		return trackers[1];
+	case ovrTrackedDevice_Object2:
+		return trackers[2];
+	case ovrTrackedDevice_Object3:
+		return trackers[3];
+	default:
+		return vr::k_unTrackedDeviceIndexInvalid;
+	}
+}
+
+ovrResult InputManager::GetDevicePoses(ovrSession session, ovrTrackedDeviceType* deviceTypes, int deviceCount, double absTime, ovrPoseStatef* outDevicePoses)
 {
 	// Get the device poses
 	vr::ETrackingUniverseOrigin space = vr::VRCompositor()->GetTrackingSpace();
 	float relTime = float(absTime - ovr_GetTimeInSeconds());
 	vr::TrackedDevicePose_t poses[vr::k_unMaxTrackedDeviceCount];
-	vr::VRSystem()->GetDeviceToAbsoluteTrackingPose(space, relTime, poses, vr::k_unMaxTrackedDeviceCount);
-
-	// Get the generic tracker indices
-	vr::TrackedDeviceIndex_t trackers[vr::k_unMaxTrackedDeviceCount];
-	vr::VRSystem()->GetSortedTrackedDeviceIndicesOfClass(vr::TrackedDeviceClass_GenericTracker, trackers, vr::k_unMaxTrackedDeviceCount);
-
-	for (int i = 0; i < deviceCount; i++)
+	GetTrackedDevicePoses(session, space, relTime, poses);
+
+	// Use a consistent set of indices, in case the devices change while we're converting
+	vr::TrackedDeviceIndex_t hands[ovrHand_Count] = { m_HandIndices[ovrHand_Left], m_HandIndices[ovrHand_Right] };
+	vr::TrackedDeviceIndex_t trackers[4] = { m_TrackerIndices[0], m_TrackerIndices[1], m_TrackerIndices[2], m_TrackerIndices[3] };
+
+	// Gather the unique devices, so every device is converted only once in a single batch
+	vr::TrackedDevicePose_t batch[vr::k_unMaxTrackedDeviceCount];
+	ovrPoseStatef* lastPoses[vr::k_unMaxTrackedDeviceCount];
+	ovrPoseStatef results[vr::k_unMaxTrackedDeviceCount];
+	int batchIndices[vr::k_unMaxTrackedDeviceCount];
+	memset(batchIndices, -1, sizeof(batchIndices));
+	int count = 0;
+
+	ovrResult result = ovrSuccess;
+	int available = 0;
+	for (; available < deviceCount; available++)
 	{
-		// Get the index for device types we recognize
-		uint32_t index = vr::k_unTrackedDeviceIndexInvalid;
-		switch (deviceTypes[i])
+		// If the tracking index is invalid it will fall outside of the range of the array
+		vr::TrackedDeviceIndex_t index = GetDeviceIndex(deviceTypes[available], hands, trackers);
+		if (index >= vr::k_unMaxTrackedDeviceCount)
 		{
-		case ovrTrackedDevice_HMD:
-			index = vr::k_unTrackedDeviceIndex_Hmd;
-			break;
-		case ovrTrackedDevice_LTouch:
-			index = vr::VRSystem()->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_LeftHand);
-			break;
-		case ovrTrackedDevice_RTouch:
-			index = vr::VRSystem()->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_RightHand);
-			break;
-		case ovrTrackedDevice_Object0:
-			index = trackers[0];
-			break;
-		case ovrTrackedDevice_Object1:
-			index = trackers[1];
-			break;
-		case ovrTrackedDevice_Object2:
-			index = trackers[2];
-			break;
-		case ovrTrackedDevice_Object3:
-			index = trackers[3];
+			result = ovrError_DeviceUnavailable;
 			break;
 		}
 
-		// If the tracking index is invalid it will fall outside of the range of the array
-		if (index >= vr::k_unMaxTrackedDeviceCount)
-			return ovrError_DeviceUnavailable;
-		outDevicePoses[i] = TrackedDevicePoseToOVRPose(poses[index], m_LastPoses[index], absTime);
+		if (batchIndices[index] < 0)
+		{
+			batch[count] = poses[index];
+			lastPoses[count] = &m_LastPoses[index];
+			batchIndices[index] = count++;
+		}
 	}
 
-	return ovrSuccess;
-}
+	// Only the devices preceding an unavailable device are returned
+	TrackedDevicePosesToOVRPoses(batch, lastPoses, count, absTime, results);
+	for (int i = 0; i < available; i++)
+		outDevicePoses[i] = results[batchIndices[GetDeviceIndex(deviceTypes[i], hands, trackers)]];
 
-/* Controller child-classes */
+	return result;
+}
 
-void InputManager::OculusTouch::HapticsThread(OculusTouch* device)
+void InputManager::GetTrackedDevicePoses(ovrSession session, vr::ETrackingUniverseOrigin origin, float relTime, vr::TrackedDevicePose_t* poses)
 {
-	std::chrono::microseconds freq(std::chrono::seconds(1));
-	freq /= REV_HAPTICS_SAMPLE_RATE;
-
-	while (device->m_bHapticsRunning)
+	m_PoseCache.Get(session->FrameIndex, origin, ovr_GetTimeInSeconds(), relTime, poses, [origin, relTime](vr::TrackedDevicePose_t* results)
 	{
-		vr::TrackedDeviceIndex_t touch = vr::VRSystem()->GetTrackedDeviceIndexForControllerRole(device->GetRole());
+		vr::VRSystem()->GetDeviceToAbsoluteTrackingPose(origin, relTime, results, vr::k_unMaxTrackedDeviceCount);
+	});
+}
 
-		uint16_t duration = (uint16_t)((float)freq.count() * device->m_Haptics.GetSample());
-		if (duration > 0)
-			vr::VRSystem()->TriggerHapticPulse(touch, 0, duration);
+/* Controller child-classes */
 
-		std::this_thread::sleep_for(freq);
-	}
+bool InputManager::InputDevice::PollInputState(ovrSession session, ovrInputState* inputState)
+{
+	// If another thread is already polling this device, use the state it published last.
+	// The snapshot keeps the time it was polled at, so the caller can tell how old it is.
+	return m_Poller.poll(inputState, [this, session](ovrInputState* state) { return GetInputState(session, state); });
 }
 
 InputManager::OculusTouch::OculusTouch(vr::ETrackedControllerRole role)
 	: m_Script()
+	, m_AxisTypes(0)
+	, m_DeviceIndex(vr::k_unTrackedDeviceIndexInvalid)
 	, m_Role(role)
-	, m_bHapticsRunning(true)
+	, m_ModelVersion(0)
+	, m_Mapping()
+	, m_MappingModelVersion(~0u)
+	, m_MappingAxisTypes(0)
+	, m_ScriptBinding()
 {
-	m_HapticsThread = std::thread(HapticsThread, this);
-}
-
-InputManager::OculusTouch::~OculusTouch()
-{
-	m_bHapticsRunning = false;
-	m_HapticsThread.join();
 }
 
 ovrControllerType InputManager::OculusTouch::GetType()
@@ -422,159 +491,84 @@ ovrControllerType InputManager::OculusTouch::GetType()
 
 bool InputManager::OculusTouch::IsConnected() const
 {
-	// Check if the Vive controller is assigned
-	vr::TrackedDeviceIndex_t touch = vr::VRSystem()->GetTrackedDeviceIndexForControllerRole(m_Role);
-	return touch != vr::k_unTrackedDeviceIndexInvalid;
+	// Check if the Vive controller is assigned, the index is refreshed when the controllers change
+	return m_DeviceIndex != vr::k_unTrackedDeviceIndexInvalid;
 }
 
-void InputManager::OculusTouch::AddStateField(lua_State* L, vr::TrackedDeviceIndex_t index,
-	vr::VRControllerState_t& state, vr::EVRButtonId button, const char* name)
+void InputManager::OculusTouch::PlayVibration(std::chrono::microseconds period)
 {
-	bool isAxis = vr::k_EButton_Axis0 <= button && button <= vr::k_EButton_Axis4;
-	if (isAxis)
-	{
-		// We put axes in the array part
-		lua_pushnumber(L, button - vr::k_EButton_Axis0 + 1);
-	}
-	else
+	// Always consume the sample, even if the controller is disconnected
+	uint16_t duration = (uint16_t)((float)period.count() * m_Haptics.GetSample());
+	vr::TrackedDeviceIndex_t touch = m_DeviceIndex;
+	if (duration > 0 && touch != vr::k_unTrackedDeviceIndexInvalid)
+		vr::VRSystem()->TriggerHapticPulse(touch, 0, duration);
+}
+
+void InputManager::OculusTouch::SetModel(vr::TrackedDeviceIndex_t index)
+{
+	std::string model;
+	if (index != vr::k_unTrackedDeviceIndexInvalid)
 	{
-		// And buttons in the hash table
-		if (!name)
-			name = s_ButtonNames[button];
-		lua_pushstring(L, name);
+		uint32_t size = vr::VRSystem()->GetStringTrackedDeviceProperty(index, vr::Prop_ModelNumber_String, nullptr, 0);
+		if (size > 0)
+		{
+			std::vector<char> buffer(size);
+			vr::VRSystem()->GetStringTrackedDeviceProperty(index, vr::Prop_ModelNumber_String, buffer.data(), size);
+			model = buffer.data();
+		}
 	}
 
-	lua_createtable(L, 0, isAxis ? 5 : 2);
-	lua_pushboolean(L, !!(state.ulButtonPressed & vr::ButtonMaskFromId(button)));
-	lua_setfield(L, -2, "pressed");
-	lua_pushboolean(L, !!(state.ulButtonTouched & vr::ButtonMaskFromId(button)));
-	lua_setfield(L, -2, "touched");
-
-	if (isAxis)
+	std::lock_guard<std::mutex> lk(m_ModelMutex);
+	if (m_Model != model)
 	{
-		int n = button - vr::k_EButton_Axis0;
-		vr::VRControllerAxis_t& axis = state.rAxis[n];
-
-		lua_pushnumber(L, axis.x);
-		lua_setfield(L, -2, "x");
-		lua_pushnumber(L, axis.y);
-		lua_setfield(L, -2, "y");
-
-		const char* type = s_TypeNames[(m_AxisTypes >> (n * 2)) & 3];
-		lua_pushstring(L, type);
-		lua_setfield(L, -2, "type");
+		m_Model = model;
+		m_ModelVersion++;
 	}
-
-	lua_settable(L, -3);
 }
 
-
-void InputManager::OculusTouch::CreateStateTable(lua_State* L, vr::TrackedDeviceIndex_t index, vr::VRControllerState_t& state)
-{
-	lua_createtable(L, vr::k_unControllerStateAxisCount, 12);
-	// Known buttons
-	for (int i = vr::k_EButton_System; i <= vr::k_EButton_A; i++)
-		AddStateField(L, index, state, (vr::EVRButtonId)i);
-
-	// Known axes
-	for (int i = vr::k_EButton_Axis0; i <= vr::k_EButton_Axis4; i++)
-		AddStateField(L, index, state, (vr::EVRButtonId)i);
-
-	// Some controllers define additional undocumented buttons
-	AddStateField(L, index, state, (vr::EVRButtonId)8, "B");
-	AddStateField(L, index, state, (vr::EVRButtonId)9, "X");
-	AddStateField(L, index, state, (vr::EVRButtonId)10, "Y");
-
-	// ... are you really going to use the headset sensor for input?
-	AddStateField(L, index, state, vr::k_EButton_ProximitySensor);
-}
-
-// TODO: Make GetInputState reentrant (thread-safe).
 bool InputManager::OculusTouch::GetInputState(ovrSession session, ovrInputState* inputState)
 {
 	// Get controller index
-	vr::TrackedDeviceIndex_t index = vr::VRSystem()->GetTrackedDeviceIndexForControllerRole(m_Role);
+	vr::TrackedDeviceIndex_t index = m_DeviceIndex;
 	ovrHandType hand = (m_Role == vr::TrackedControllerRole_LeftHand) ? ovrHand_Left : ovrHand_Right;
 
-	rcu_ptr<InputSettings> settings = session->Settings->Input;
-	lua_State* L = m_Script.load();
-
-	if (!L || index == vr::k_unTrackedDeviceIndexInvalid)
+	if (index == vr::k_unTrackedDeviceIndexInvalid)
 		return false;
 
 	vr::VRControllerState_t state;
 	vr::VRSystem()->GetControllerState(index, &state, sizeof(state));
 
-	CreateStateTable(L, index, state);
-	lua_setglobal(L, "state");
-
-	lua_pushnumber(L, inputState->TimeInSeconds);
-	lua_setglobal(L, "time");
-
-	uint32_t size = vr::VRSystem()->GetStringTrackedDeviceProperty(index, vr::Prop_ModelNumber_String, nullptr, 0);
-	std::vector<char> model(size);
-	vr::VRSystem()->GetStringTrackedDeviceProperty(index, vr::Prop_ModelNumber_String, model.data(), size);
-	lua_pushstring(L, model.data());
-	lua_setglobal(L, "controller_model");
-
-	lua_createtable(L, 0, 5);
-	lua_pushboolean(L, settings->ToggleGrip == revGrip_Normal);
-	lua_setfield(L, -2, "normal");
-	lua_pushboolean(L, settings->ToggleGrip == revGrip_Toggle);
-	lua_setfield(L, -2, "toggle");
-	lua_pushboolean(L, settings->ToggleGrip == revGrip_Hybrid);
-	lua_setfield(L, -2, "hybrid");
-	lua_pushnumber(L, settings->ToggleDelay);
-	lua_setfield(L, -2, "delay");
-	lua_pushboolean(L, settings->TriggerAsGrip);
-	lua_setfield(L, -2, "trigger");
-	lua_setglobal(L, "grip_mode");
-
-	lua_getglobal(L, "GetButtons");
-	lua_pushboolean(L, hand == ovrHand_Right);
-	if (lua_pcall(L, 1, LUA_MULTRET, 1))
-		return false;
-	while (lua_gettop(L) > 1)
+	rcu_ptr<InputSettings> settings = session->Settings->Input;
+	lua_State* L = m_Script.load();
+	if (L)
 	{
-		inputState->Buttons |= lua_tointeger(L, -1);
-		lua_pop(L, 1);
-	}
+		// Not reentrant, the Lua state is protected by InputDevice::PollInputState()
+		uint32_t version = m_ModelVersion;
+		if (m_ScriptBinding.Bind(L, version))
+		{
+			std::lock_guard<std::mutex> lk(m_ModelMutex);
+			m_ScriptBinding.SetModel(m_Model.data(), m_Model.size(), version);
+		}
 
-	lua_getglobal(L, "GetTouches");
-	lua_pushboolean(L, hand == ovrHand_Right);
-	if (lua_pcall(L, 1, LUA_MULTRET, 1))
-		return false;
-	while (lua_gettop(L) > 1)
-	{
-		inputState->Touches |= lua_tointeger(L, -1);
-		lua_pop(L, 1);
+		if (!m_ScriptBinding.GetInputState(state, m_AxisTypes, *settings, hand, inputState->TimeInSeconds, inputState))
+			return false;
 	}
+	else
+	{
+		// Recompile the mapping if the controller has changed
+		uint32_t version = m_ModelVersion;
+		uint16_t axes = m_AxisTypes;
+		if (version != m_MappingModelVersion || axes != m_MappingAxisTypes)
+		{
+			std::lock_guard<std::mutex> lk(m_ModelMutex);
+			m_Mapping.Compile(m_Model.c_str(), axes, hand);
+			m_MappingModelVersion = version;
+			m_MappingAxisTypes = axes;
+		}
 
-	lua_getglobal(L, "GetTriggers");
-	lua_pushboolean(L, hand == ovrHand_Right);
-	if (lua_pcall(L, 1, 2, 1))
-		return false;
-	inputState->IndexTrigger[hand] = (float)lua_tonumber(L, -2);
-	inputState->HandTrigger[hand] = (float)lua_tonumber(L, -1);
-	lua_pop(L, 2);
-
-	lua_getglobal(L, "GetThumbstick");
-	lua_pushboolean(L, hand == ovrHand_Right);
-	lua_pushnumber(L, settings->Deadzone);
-	if (lua_pcall(L, 2, 2, 1))
-		return false;
-	inputState->Thumbstick[hand].x = (float)lua_tonumber(L, -2);
-	inputState->Thumbstick[hand].y = (float)lua_tonumber(L, -1);
-	lua_pop(L, 2);
-
-	lua_getglobal(L, "GetThumbstick");
-	lua_pushboolean(L, hand == ovrHand_Right);
-	lua_pushnumber(L, 0);
-	if (lua_pcall(L, 2, 2, 1))
-		return false;
-	inputState->ThumbstickNoDeadzone[hand].x = (float)lua_tonumber(L, -2);
-	inputState->ThumbstickNoDeadzone[hand].y = (float)lua_tonumber(L, -1);
-	lua_pop(L, 2);
+		if (!m_Mapping.GetInputState(state, *settings, inputState->TimeInSeconds, inputState))
+			return false;
+	}
 
 	// We don't apply deadzones yet on triggers and grips
 	inputState->IndexTriggerNoDeadzone[hand] = inputState->IndexTrigger[hand];
@@ -584,9 +578,6 @@ bool InputManager::OculusTouch::GetInputState(ovrSession session, ovrInputState*
 	inputState->ThumbstickRaw[hand] = inputState->ThumbstickNoDeadzone[hand];
 	inputState->IndexTriggerRaw[hand] = inputState->IndexTriggerNoDeadzone[hand];
 	inputState->HandTriggerRaw[hand] = inputState->HandTriggerNoDeadzone[hand];
-
-	lua_getglobal(L, "state");
-	lua_setglobal(L, "last_state");
 	return true;
 }
 
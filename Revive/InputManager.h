@@ -1,14 +1,22 @@
 #pragma once
 
 #include "HapticsBuffer.h"
+#include "HapticsScheduler.h"
+#include "InputMapping.h"
+#include "InputScript.h"
 #include "OVR_CAPI.h"
 #include "Extras/OVR_Math.h"
+#include "PoseCache.h"
+#include "single_poller.h"
 
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <string>
 #include <vector>
 #include <atomic>
 #include <list>
-#include <mutex>
 #include <openvr.h>
 #include <Windows.h>
 #include <Xinput.h>
@@ -21,8 +29,13 @@ public:
 	class InputDevice
 	{
 	public:
+		InputDevice() { }
 		virtual ~InputDevice() { }
 
+		// Lock-free polling, only one thread polls the device while the others read the last snapshot.
+		// Until the first poll finishes the other callers get an empty state instead of waiting.
+		bool PollInputState(ovrSession session, ovrInputState* inputState);
+
 		// Input
 		virtual vr::ETrackedControllerRole GetRole() { return vr::TrackedControllerRole_Invalid; }
 		virtual ovrControllerType GetType() = 0;
@@ -33,16 +46,22 @@ public:
 		virtual void SetVibration(float frequency, float amplitude) { }
 		virtual void SubmitVibration(const ovrHapticsBuffer* buffer) { }
 		virtual void GetVibrationState(ovrHapticsPlaybackState* outState) { }
+		virtual bool IsVibrating() { return false; }
+		virtual void PlayVibration(std::chrono::microseconds period) { }
+
+	private:
+		single_poller<ovrInputState> m_Poller;
 	};
 
 	class OculusTouch : public InputDevice
 	{
 	public:
 		OculusTouch(vr::ETrackedControllerRole role);
-		virtual ~OculusTouch();
+		virtual ~OculusTouch() { }
 
 		std::atomic<lua_State*> m_Script;
 		std::atomic_uint16_t m_AxisTypes;
+		std::atomic_uint32_t m_DeviceIndex;
 
 		virtual vr::ETrackedControllerRole GetRole() { return m_Role; }
 		virtual ovrControllerType GetType();
@@ -51,18 +70,30 @@ public:
 		virtual void SetVibration(float frequency, float amplitude) { m_Haptics.SetConstant(frequency, amplitude); }
 		virtual void SubmitVibration(const ovrHapticsBuffer* buffer) { m_Haptics.AddSamples(buffer); }
 		virtual void GetVibrationState(ovrHapticsPlaybackState* outState) { *outState = m_Haptics.GetState(); }
+		virtual bool IsVibrating() { return m_Haptics.IsActive(); }
+		virtual void PlayVibration(std::chrono::microseconds period);
+
+		// Caches the device index and properties of the controller assigned to this role
+		void UpdateDevice(vr::TrackedDeviceIndex_t index);
 
 	private:
+		void SetModel(vr::TrackedDeviceIndex_t index);
+
 		HapticsBuffer m_Haptics;
-		std::atomic_bool m_bHapticsRunning;
 		vr::ETrackedControllerRole m_Role;
 
-		std::thread m_HapticsThread;
-		static void HapticsThread(OculusTouch* device);
+		// Controller model, only queried when the controller role changes
+		std::mutex m_ModelMutex;
+		std::string m_Model;
+		std::atomic_uint32_t m_ModelVersion;
+
+		// Native input mapping, used when there is no input script
+		InputMapping m_Mapping;
+		uint32_t m_MappingModelVersion;
+		uint16_t m_MappingAxisTypes;
 
-		void AddStateField(lua_State* L, vr::TrackedDeviceIndex_t index, vr::VRControllerState_t& state,
-			vr::EVRButtonId button, const char* name = nullptr);
-		void CreateStateTable(lua_State* L, vr::TrackedDeviceIndex_t index, vr::VRControllerState_t& state);
+		// Input script binding, only used while a script is loaded
+		InputScript m_ScriptBinding;
 	};
 
 	class OculusRemote : public InputDevice
@@ -109,29 +140,38 @@ public:
 	ovrResult GetControllerVibrationState(ovrSession session, ovrControllerType controllerType, ovrHapticsPlaybackState* outState);
 
 	void GetTrackingState(ovrSession session, ovrTrackingState* outState, double absTime);
-	ovrResult GetDevicePoses(ovrTrackedDeviceType* deviceTypes, int deviceCount, double absTime, ovrPoseStatef* outDevicePoses);
+	ovrResult GetDevicePoses(ovrSession session, ovrTrackedDeviceType* deviceTypes, int deviceCount, double absTime, ovrPoseStatef* outDevicePoses);
+	void GetTrackedDevicePoses(ovrSession session, vr::ETrackingUniverseOrigin origin, float relTime, vr::TrackedDevicePose_t* poses);
+	vr::TrackedDeviceIndex_t GetHandIndex(ovrHandType hand) const { return m_HandIndices[hand]; }
 
-	bool LoadInputScript(const char* fn);
+	bool LoadInputScript(const char* fn, bool nativeFallback);
 
 protected:
 	std::vector<InputDevice*> m_InputDevices;
 
 private:
-	std::mutex m_InputMutex;
 	float m_fVsyncToPhotons;
 	ovrPoseStatef m_LastPoses[vr::k_unMaxTrackedDeviceCount];
 
+	// Device indices, only updated when the connected devices change
+	std::atomic_uint32_t m_HandIndices[ovrHand_Count];
+	std::atomic_uint32_t m_TrackerIndices[4];
+
+	// Pose cache, tracking queries for the same frame and prediction time share a single query
+	PoseCache m_PoseCache;
+
+	// Haptics scheduler, drives the vibration of all devices while any of them is vibrating
+	HapticsScheduler<InputDevice> m_HapticsScheduler;
+
+	static void MergeInputState(ovrInputState* dst, const ovrInputState& src);
 	unsigned int TrackedDevicePoseToOVRStatusFlags(vr::TrackedDevicePose_t pose);
-	ovrPoseStatef TrackedDevicePoseToOVRPose(vr::TrackedDevicePose_t pose, ovrPoseStatef& lastPose, double time);
+	static vr::TrackedDeviceIndex_t GetDeviceIndex(ovrTrackedDeviceType deviceType,
+		const vr::TrackedDeviceIndex_t* hands, const vr::TrackedDeviceIndex_t* trackers);
 
 	// LUA Support code
 	std::list<lua_State*> m_ScriptStates;
 	bool LoadResourceScript(lua_State* L, const char* name);
 	bool LoadFileScript(lua_State* L, const char* fn);
 	static int ErrorHandler(lua_State* L);
-
-	// Enumeration name caches
-	static const char* s_ButtonNames[vr::k_EButton_Max];
-	static const char* s_TypeNames[4];
 };
 
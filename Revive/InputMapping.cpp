@@ -0,0 +1,318 @@
+#include "InputMapping.h"
+#include "Settings.h"
+#include "SettingsManager.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#define BUTTON(id) (1ull << (id))
+
+static InputRule Rule(InputRuleType type, uint64_t buttons, int axis, int component,
+	unsigned int left = 0, unsigned int right = 0)
+{
+	InputRule rule = { type, buttons, axis, component, { left, right } };
+	return rule;
+}
+
+static InputRule Fallback(InputRule rule, InputCondition condition, unsigned int left, unsigned int right,
+	uint64_t buttons = 0, int axis = 0, double threshold = 0.0)
+{
+	rule.Fallback = condition;
+	rule.FallbackButtons = buttons;
+	rule.FallbackAxis = axis;
+	rule.FallbackThreshold = threshold;
+	rule.FallbackOutput[ovrHand_Left] = left;
+	rule.FallbackOutput[ovrHand_Right] = right;
+	return rule;
+}
+
+// Controllers with a touchpad and a grip button, such as the Vive wands
+static const InputRule s_DefaultRules[] = {
+	Rule(Rule_Button, BUTTON(vr::k_EButton_ApplicationMenu), 0, 0, ovrButton_Enter, ovrButton_Enter),
+	Rule(Rule_Button, BUTTON(vr::k_EButton_A), 0, 0, ovrButton_X, ovrButton_A),
+	Rule(Rule_Button, BUTTON(8), 0, 0, ovrButton_Y, ovrButton_B),
+	Rule(Rule_ButtonQuadrant, BUTTON(vr::k_EButton_SteamVR_Touchpad), 0, 0),
+
+	Rule(Rule_Touch, BUTTON(vr::k_EButton_A), 0, 0, ovrTouch_X, ovrTouch_A),
+	Rule(Rule_Touch, BUTTON(8), 0, 0, ovrTouch_Y, ovrTouch_B),
+	Fallback(Rule(Rule_TouchQuadrant, BUTTON(vr::k_EButton_SteamVR_Touchpad), 0, 0),
+		Condition_Gripped, ovrTouch_LThumbUp, ovrTouch_RThumbUp),
+	Fallback(Rule(Rule_Touch, BUTTON(vr::k_EButton_SteamVR_Trigger), 0, 0, ovrTouch_LIndexTrigger, ovrTouch_RIndexTrigger),
+		Condition_Gripped, ovrTouch_LIndexPointing, ovrTouch_RIndexPointing),
+
+	Rule(Rule_Grip, BUTTON(vr::k_EButton_Grip), 1, 0),
+	Rule(Rule_FindThumbstick, BUTTON(vr::k_EButton_SteamVR_Touchpad), 0, 0),
+};
+
+// Knuckles controllers, the grip and menu buttons are used as face buttons
+static const InputRule s_KnucklesRules[] = {
+	Rule(Rule_ButtonChord, BUTTON(vr::k_EButton_ApplicationMenu) | BUTTON(vr::k_EButton_Grip), 0, 0, ovrButton_Enter, ovrButton_Enter),
+	Rule(Rule_Button, BUTTON(vr::k_EButton_Grip), 0, 0, ovrButton_X, ovrButton_A),
+	Rule(Rule_Button, BUTTON(vr::k_EButton_ApplicationMenu), 0, 0, ovrButton_Y, ovrButton_B),
+	Rule(Rule_Button, BUTTON(vr::k_EButton_SteamVR_Touchpad), 0, 0, ovrButton_LThumb, ovrButton_RThumb),
+
+	Rule(Rule_Touch, BUTTON(vr::k_EButton_Grip), 0, 0, ovrTouch_X, ovrTouch_A),
+	Rule(Rule_Touch, BUTTON(vr::k_EButton_ApplicationMenu), 0, 0, ovrTouch_Y, ovrTouch_B),
+	Fallback(Rule(Rule_Touch, BUTTON(vr::k_EButton_SteamVR_Touchpad), 0, 0, ovrTouch_LThumb, ovrTouch_RThumb),
+		Condition_Untouched, ovrTouch_LThumbUp, ovrTouch_RThumbUp, BUTTON(vr::k_EButton_Grip) | BUTTON(vr::k_EButton_ApplicationMenu)),
+	Fallback(Rule(Rule_Touch, BUTTON(vr::k_EButton_SteamVR_Trigger), 0, 0, ovrTouch_LIndexTrigger, ovrTouch_RIndexTrigger),
+		Condition_AxisBelow, ovrTouch_LIndexPointing, ovrTouch_RIndexPointing, 0, 3, 0.8),
+
+	Rule(Rule_IndexTrigger, 0, 1, 0),
+	Rule(Rule_HandTrigger, 0, 3, 1),
+	Rule(Rule_Thumbstick, 0, 0, 0),
+};
+
+InputMapping::InputMapping()
+	: m_Ops()
+	, m_Hand(ovrHand_Left)
+	, m_Gripped(false)
+	, m_WasPressed(false)
+	, m_HybridTime(0.0)
+	, m_WasTouched(false)
+	, m_Center()
+{
+}
+
+void InputMapping::Compile(const char* model, uint16_t axisTypes, ovrHandType hand)
+{
+	const InputRule* begin = s_DefaultRules;
+	const InputRule* end = s_DefaultRules + sizeof(s_DefaultRules) / sizeof(InputRule);
+	if (strstr(model, "Knuckles"))
+	{
+		begin = s_KnucklesRules;
+		end = s_KnucklesRules + sizeof(s_KnucklesRules) / sizeof(InputRule);
+	}
+
+	m_Hand = hand;
+	m_Ops.clear();
+	for (const InputRule* rule = begin; rule != end; rule++)
+	{
+		InputOp op = { rule->Type, rule->Buttons, rule->Axis, rule->Component, rule->Output[hand],
+			rule->Fallback, rule->FallbackButtons, rule->FallbackAxis, rule->FallbackThreshold, rule->FallbackOutput[hand] };
+
+		if (op.Type == Rule_FindThumbstick)
+		{
+			// Find a physical joystick, skip the touchpad and trigger
+			op.Type = Rule_VirtualThumbstick;
+			for (int i = 2; i < vr::k_unControllerStateAxisCount; i++)
+			{
+				vr::EVRControllerAxisType type = (vr::EVRControllerAxisType)((axisTypes >> (i * 2)) & 3);
+				if (type == vr::k_eControllerAxis_Joystick)
+				{
+					op.Type = Rule_Thumbstick;
+					op.Axis = i;
+					break;
+				}
+				else if (type == vr::k_eControllerAxis_None)
+				{
+					// This is not a valid axis anymore, so exit the loop
+					break;
+				}
+			}
+		}
+
+		m_Ops.push_back(op);
+	}
+}
+
+// Not reentrant, the mapping state is protected by InputDevice::PollInputState().
+bool InputMapping::GetInputState(const vr::VRControllerState_t& state, const InputSettings& settings, double time, ovrInputState* inputState)
+{
+	uint64_t consumed = 0;
+	for (const InputOp& op : m_Ops)
+	{
+		switch (op.Type)
+		{
+		case Rule_Button:
+			if (state.ulButtonPressed & op.Buttons & ~consumed)
+				inputState->Buttons |= op.Output;
+			break;
+		case Rule_ButtonChord:
+			if ((state.ulButtonPressed & op.Buttons) == op.Buttons)
+			{
+				inputState->Buttons |= op.Output;
+				consumed |= op.Buttons;
+			}
+			break;
+		case Rule_ButtonQuadrant:
+			if (state.ulButtonPressed & op.Buttons)
+				inputState->Buttons |= ButtonFromQuadrant(state.rAxis[op.Axis]);
+			break;
+		case Rule_Touch:
+			if (state.ulButtonTouched & op.Buttons)
+				inputState->Touches |= op.Output;
+			else if (EvaluateFallback(op, state))
+				inputState->Touches |= op.FallbackOutput;
+			break;
+		case Rule_TouchQuadrant:
+			if (state.ulButtonTouched & op.Buttons)
+				inputState->Touches |= ButtonFromQuadrant(state.rAxis[op.Axis]);
+			else if (EvaluateFallback(op, state))
+				inputState->Touches |= op.FallbackOutput;
+			break;
+		case Rule_IndexTrigger:
+		{
+			const vr::VRControllerAxis_t& axis = state.rAxis[op.Axis];
+			inputState->IndexTrigger[m_Hand] = op.Component ? axis.y : axis.x;
+			break;
+		}
+		case Rule_HandTrigger:
+		{
+			const vr::VRControllerAxis_t& axis = state.rAxis[op.Axis];
+			inputState->HandTrigger[m_Hand] = op.Component ? axis.y : axis.x;
+			break;
+		}
+		case Rule_Grip:
+		{
+			UpdateGrip(!!(state.ulButtonPressed & op.Buttons), settings, time);
+
+			float trigger = state.rAxis[op.Axis].x;
+			if (settings.TriggerAsGrip)
+			{
+				// Some users prefer the trigger and grip to be swapped.
+				inputState->IndexTrigger[m_Hand] = m_Gripped ? trigger : 0.0f;
+				inputState->HandTrigger[m_Hand] = m_Gripped ? 1.0f : trigger;
+			}
+			else
+			{
+				// When we release the grip we need to keep it just a little bit pressed.
+				// This is necessary because Toybox can't handle a sudden jump to zero.
+				inputState->IndexTrigger[m_Hand] = trigger;
+				inputState->HandTrigger[m_Hand] = m_Gripped ? 1.0f : 0.01f;
+			}
+			break;
+		}
+		case Rule_Thumbstick:
+		{
+			const vr::VRControllerAxis_t& axis = state.rAxis[op.Axis];
+			ApplyDeadzone(axis.x, axis.y, settings.Deadzone, 0.0, &inputState->Thumbstick[m_Hand]);
+			ApplyDeadzone(axis.x, axis.y, 0.0, 0.0, &inputState->ThumbstickNoDeadzone[m_Hand]);
+			break;
+		}
+		case Rule_VirtualThumbstick:
+		{
+			const vr::VRControllerAxis_t& axis = state.rAxis[op.Axis];
+			bool touched = !!(state.ulButtonTouched & op.Buttons);
+			if (touched && !m_WasTouched)
+			{
+				// Center the virtual thumbstick at the location the touchpad is touched for the first time
+				m_Center[0] = axis.x;
+				m_Center[1] = axis.y;
+			}
+			m_WasTouched = touched;
+
+			if (touched)
+			{
+				double deadzone = settings.Deadzone;
+				double x = axis.x - m_Center[0];
+				double y = axis.y - m_Center[1];
+				ApplyDeadzone(x, y, deadzone, deadzone / 2, &inputState->Thumbstick[m_Hand]);
+				ApplyDeadzone(x, y, 0.0, 0.0, &inputState->ThumbstickNoDeadzone[m_Hand]);
+			}
+			else
+			{
+				inputState->Thumbstick[m_Hand] = ovrVector2f{ 0.0f, 0.0f };
+				inputState->ThumbstickNoDeadzone[m_Hand] = ovrVector2f{ 0.0f, 0.0f };
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+unsigned int InputMapping::ButtonFromQuadrant(const vr::VRControllerAxis_t& axis)
+{
+	if (m_Hand == ovrHand_Right)
+	{
+		if (axis.y < -axis.x)
+			return axis.y < axis.x ? ovrButton_A : ovrButton_B;
+		else
+			return ovrButton_RThumb;
+	}
+	else
+	{
+		if (axis.y < axis.x)
+			return axis.y < -axis.x ? ovrButton_X : ovrButton_Y;
+		else
+			return ovrButton_LThumb;
+	}
+}
+
+bool InputMapping::EvaluateFallback(const InputOp& op, const vr::VRControllerState_t& state)
+{
+	switch (op.Fallback)
+	{
+	case Condition_Gripped:
+		return m_Gripped;
+	case Condition_Untouched:
+		return !(state.ulButtonTouched & op.FallbackButtons);
+	case Condition_AxisBelow:
+		return state.rAxis[op.FallbackAxis].x < op.FallbackThreshold;
+	default:
+		return false;
+	}
+}
+
+void InputMapping::UpdateGrip(bool pressed, const InputSettings& settings, double time)
+{
+	if (pressed != m_WasPressed)
+	{
+		// Allow users to enable a toggled grip.
+		if (settings.ToggleGrip == revGrip_Hybrid)
+		{
+			// In hybrid grip mode the user will toggle the grip if it has been released within the delay time.
+			if (pressed)
+			{
+				// Only set the timestamp on when we're not toggled on, we don't want to toggle twice.
+				if (!m_Gripped)
+					m_HybridTime = time + settings.ToggleDelay;
+				m_Gripped = true;
+			}
+			else
+			{
+				// If the user releases the grip after the delay has passed, then we can release the grip normally.
+				if (time > m_HybridTime)
+					m_Gripped = false;
+				// Reset the timestamp so we immediately release the next time.
+				m_HybridTime = 0.0;
+			}
+		}
+		else if (settings.ToggleGrip == revGrip_Toggle)
+		{
+			// A simple grip toggle
+			if (pressed)
+				m_Gripped = !m_Gripped;
+		}
+		else
+		{
+			m_Gripped = pressed;
+		}
+	}
+	m_WasPressed = pressed;
+}
+
+void InputMapping::ApplyDeadzone(double x, double y, double deadZoneLow, double deadZoneHigh, ovrVector2f* out)
+{
+	// The math is done in double precision to match the results of the Lua scripts
+	double mag = sqrt(x * x + y * y);
+	if (mag > deadZoneLow)
+	{
+		// scale such that output magnitude is in the range [0, 1]
+		double legalRange = 1.0 - deadZoneHigh - deadZoneLow;
+		double normalizedMag = (std::min)(1.0, (mag - deadZoneLow) / legalRange);
+		double scale = normalizedMag / mag;
+		out->x = float(x * scale);
+		out->y = float(y * scale);
+	}
+	else
+	{
+		// stick is in the inner dead zone
+		out->x = 0.0f;
+		out->y = 0.0f;
+	}
+}
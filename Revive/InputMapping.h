@@ -0,0 +1,100 @@
+#pragma once
+
+#include "OVR_CAPI.h"
+
+#include <vector>
+#include <openvr.h>
+
+struct InputSettings;
+
+enum InputRuleType
+{
+	Rule_Button,              // Button is pressed
+	Rule_ButtonChord,         // All buttons are pressed, they won't trigger any other button rules
+	Rule_ButtonQuadrant,      // Button is pressed, output depends on the axis quadrant
+	Rule_Touch,               // Button is touched
+	Rule_TouchQuadrant,       // Button is touched, output depends on the axis quadrant
+	Rule_IndexTrigger,        // Index trigger follows an axis component
+	Rule_HandTrigger,         // Hand trigger follows an axis component
+	Rule_Grip,                // Hand trigger follows a button using the grip mode settings
+	Rule_Thumbstick,          // Thumbstick follows an axis with a radial deadzone
+	Rule_VirtualThumbstick,   // Thumbstick is emulated with a trackpad, centered where it's first touched
+	Rule_FindThumbstick,      // Thumbstick follows the first joystick axis, or emulated with the trackpad
+};
+
+enum InputCondition
+{
+	Condition_None,
+	Condition_Gripped,        // The grip is held according to the grip mode
+	Condition_Untouched,      // None of the buttons are touched
+	Condition_AxisBelow,      // The x-component of the axis is below the threshold
+};
+
+/*
+	Declarative description of a single mapping from OpenVR input to Oculus input.
+	A touch rule can have a fallback that's output when the button isn't touched.
+	The rule tables are built into InputMapping.cpp and can't be loaded at runtime,
+	custom mappings are still written as Lua input scripts.
+*/
+struct InputRule
+{
+	InputRuleType Type;
+	uint64_t Buttons;
+	int Axis;
+	int Component;
+	unsigned int Output[ovrHand_Count];
+
+	InputCondition Fallback;
+	uint64_t FallbackButtons;
+	int FallbackAxis;
+	double FallbackThreshold;
+	unsigned int FallbackOutput[ovrHand_Count];
+};
+
+/*
+	Native implementation of the default input script, the rules are compiled to a flat list of
+	operations for a specific controller, so they can be evaluated without a Lua state.
+	Not reentrant, every controller needs its own instance.
+*/
+class InputMapping
+{
+public:
+	InputMapping();
+	~InputMapping() { }
+
+	void Compile(const char* model, uint16_t axisTypes, ovrHandType hand);
+	bool GetInputState(const vr::VRControllerState_t& state, const InputSettings& settings, double time, ovrInputState* inputState);
+
+private:
+	struct InputOp
+	{
+		InputRuleType Type;
+		uint64_t Buttons;
+		int Axis;
+		int Component;
+		unsigned int Output;
+
+		InputCondition Fallback;
+		uint64_t FallbackButtons;
+		int FallbackAxis;
+		double FallbackThreshold;
+		unsigned int FallbackOutput;
+	};
+
+	std::vector<InputOp> m_Ops;
+	ovrHandType m_Hand;
+
+	// Current state for gripping behaviour
+	bool m_Gripped;
+	bool m_WasPressed;
+	double m_HybridTime;
+
+	// Current state for thumbstick behaviour
+	bool m_WasTouched;
+	double m_Center[2];
+
+	unsigned int ButtonFromQuadrant(const vr::VRControllerAxis_t& axis);
+	bool EvaluateFallback(const InputOp& op, const vr::VRControllerState_t& state);
+	void UpdateGrip(bool pressed, const InputSettings& settings, double time);
+	static void ApplyDeadzone(double x, double y, double deadZoneLow, double deadZoneHigh, ovrVector2f* out);
+};
@@ -0,0 +1,187 @@
+#include "InputScript.h"
+#include "Settings.h"
+#include "SettingsManager.h"
+#include "Trace.h"
+
+#include <lua.hpp>
+
+struct StateField
+{
+	vr::EVRButtonId Button;
+	const char* Name;
+};
+
+// Fields of the state table, the names match the OpenVR enums without the prefix
+static const StateField s_StateFields[] = {
+	// Known buttons
+	{ vr::k_EButton_System, "System" },
+	{ vr::k_EButton_ApplicationMenu, "ApplicationMenu" },
+	{ vr::k_EButton_Grip, "Grip" },
+	{ vr::k_EButton_DPad_Left, "DPad_Left" },
+	{ vr::k_EButton_DPad_Up, "DPad_Up" },
+	{ vr::k_EButton_DPad_Right, "DPad_Right" },
+	{ vr::k_EButton_DPad_Down, "DPad_Down" },
+	{ vr::k_EButton_A, "A" },
+
+	// Known axes, these are in the array part so they don't have a name
+	{ vr::k_EButton_Axis0, nullptr },
+	{ vr::k_EButton_Axis1, nullptr },
+	{ vr::k_EButton_Axis2, nullptr },
+	{ vr::k_EButton_Axis3, nullptr },
+	{ vr::k_EButton_Axis4, nullptr },
+
+	// Some controllers define additional undocumented buttons
+	{ (vr::EVRButtonId)8, "B" },
+	{ (vr::EVRButtonId)9, "X" },
+	{ (vr::EVRButtonId)10, "Y" },
+
+	// ... are you really going to use the headset sensor for input?
+	{ vr::k_EButton_ProximitySensor, "ProximitySensor" },
+};
+
+static const char* s_TypeNames[] = { "None", "TrackPad", "Joystick", "Trigger" };
+
+InputScript::InputScript()
+	: m_State(nullptr)
+	, m_StateTables{ LUA_NOREF, LUA_NOREF }
+	, m_GripTable(LUA_NOREF)
+	, m_StateIndex(0)
+	, m_ModelVersion(0)
+{
+}
+
+bool InputScript::Bind(lua_State* L, uint32_t modelVersion)
+{
+	// Make sure the controller model is pushed to a new state on the first poll
+	if (L != m_State)
+	{
+		m_State = L;
+		CreateTables();
+		return true;
+	}
+	return modelVersion != m_ModelVersion;
+}
+
+void InputScript::SetModel(const char* model, size_t length, uint32_t modelVersion)
+{
+	lua_pushlstring(m_State, model, length);
+	lua_setglobal(m_State, "controller_model");
+	m_ModelVersion = modelVersion;
+}
+
+void InputScript::CreateTables()
+{
+	lua_State* L = m_State;
+
+	// The references are kept in the registry, so the tables live as long as the Lua state
+	for (int& ref : m_StateTables)
+	{
+		lua_createtable(L, vr::k_unControllerStateAxisCount, 12);
+		ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+	lua_createtable(L, 0, 5);
+	m_GripTable = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	m_StateIndex = 0;
+}
+
+void InputScript::UpdateStateField(const vr::VRControllerState_t& state, uint16_t axisTypes,
+	vr::EVRButtonId button, const char* name)
+{
+	lua_State* L = m_State;
+	bool isAxis = vr::k_EButton_Axis0 <= button && button <= vr::k_EButton_Axis4;
+	int n = button - vr::k_EButton_Axis0;
+
+	// We put axes in the array part and buttons in the hash table
+	if (isAxis)
+		lua_rawgeti(L, -1, n + 1);
+	else
+		lua_getfield(L, -1, name);
+
+	// The field tables are only created on the first poll
+	if (lua_isnil(L, -1))
+	{
+		lua_pop(L, 1);
+		lua_createtable(L, 0, isAxis ? 5 : 2);
+		lua_pushvalue(L, -1);
+		if (isAxis)
+			lua_rawseti(L, -3, n + 1);
+		else
+			lua_setfield(L, -3, name);
+	}
+
+	lua_pushboolean(L, !!(state.ulButtonPressed & vr::ButtonMaskFromId(button)));
+	lua_setfield(L, -2, "pressed");
+	lua_pushboolean(L, !!(state.ulButtonTouched & vr::ButtonMaskFromId(button)));
+	lua_setfield(L, -2, "touched");
+
+	if (isAxis)
+	{
+		const vr::VRControllerAxis_t& axis = state.rAxis[n];
+
+		lua_pushnumber(L, axis.x);
+		lua_setfield(L, -2, "x");
+		lua_pushnumber(L, axis.y);
+		lua_setfield(L, -2, "y");
+
+		lua_pushstring(L, s_TypeNames[(axisTypes >> (n * 2)) & 3]);
+		lua_setfield(L, -2, "type");
+	}
+
+	lua_pop(L, 1);
+}
+
+void InputScript::UpdateStateTable(const vr::VRControllerState_t& state, uint16_t axisTypes)
+{
+	for (const StateField& field : s_StateFields)
+		UpdateStateField(state, axisTypes, field.Button, field.Name);
+}
+
+bool InputScript::GetInputState(const vr::VRControllerState_t& state, uint16_t axisTypes, const InputSettings& settings,
+	ovrHandType hand, double time, ovrInputState* inputState)
+{
+	lua_State* L = m_State;
+
+	// Alternate between the two state tables, so last_state is never overwritten while it's in use
+	lua_rawgeti(L, LUA_REGISTRYINDEX, m_StateTables[m_StateIndex]);
+	UpdateStateTable(state, axisTypes);
+	lua_setglobal(L, "state");
+
+	lua_pushnumber(L, time);
+	lua_setglobal(L, "time");
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, m_GripTable);
+	lua_pushboolean(L, settings.ToggleGrip == revGrip_Normal);
+	lua_setfield(L, -2, "normal");
+	lua_pushboolean(L, settings.ToggleGrip == revGrip_Toggle);
+	lua_setfield(L, -2, "toggle");
+	lua_pushboolean(L, settings.ToggleGrip == revGrip_Hybrid);
+	lua_setfield(L, -2, "hybrid");
+	lua_pushnumber(L, settings.ToggleDelay);
+	lua_setfield(L, -2, "delay");
+	lua_pushboolean(L, settings.TriggerAsGrip);
+	lua_setfield(L, -2, "trigger");
+	lua_setglobal(L, "grip_mode");
+
+	// A single entry point returns all outputs, see header.lua for the default implementation
+	REV_TRACE_SCOPE("GetInput");
+	lua_getglobal(L, "GetInput");
+	lua_pushboolean(L, hand == ovrHand_Right);
+	lua_pushnumber(L, settings.Deadzone);
+	if (lua_pcall(L, 2, 8, 1))
+		return false;
+	inputState->Buttons |= (unsigned int)lua_tointeger(L, -8);
+	inputState->Touches |= (unsigned int)lua_tointeger(L, -7);
+	inputState->IndexTrigger[hand] = (float)lua_tonumber(L, -6);
+	inputState->HandTrigger[hand] = (float)lua_tonumber(L, -5);
+	inputState->Thumbstick[hand].x = (float)lua_tonumber(L, -4);
+	inputState->Thumbstick[hand].y = (float)lua_tonumber(L, -3);
+	inputState->ThumbstickNoDeadzone[hand].x = (float)lua_tonumber(L, -2);
+	inputState->ThumbstickNoDeadzone[hand].y = (float)lua_tonumber(L, -1);
+	lua_pop(L, 8);
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, m_StateTables[m_StateIndex]);
+	lua_setglobal(L, "last_state");
+	m_StateIndex ^= 1;
+	return true;
+}
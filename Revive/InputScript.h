@@ -0,0 +1,41 @@
+#pragma once
+
+#include "OVR_CAPI.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <openvr.h>
+
+typedef struct lua_State lua_State;
+struct InputSettings;
+
+/*
+	Binding between a controller and a Lua input script. The state, last_state and grip_mode
+	tables are created once for every Lua state and updated in-place on every poll, so polling
+	doesn't allocate any Lua objects. The error handler must be the first value on the stack.
+	Not reentrant, every controller needs its own instance.
+*/
+class InputScript
+{
+public:
+	InputScript();
+	~InputScript() { }
+
+	// Returns true if the controller model has to be pushed with SetModel() before polling
+	bool Bind(lua_State* L, uint32_t modelVersion);
+	void SetModel(const char* model, size_t length, uint32_t modelVersion);
+
+	bool GetInputState(const vr::VRControllerState_t& state, uint16_t axisTypes, const InputSettings& settings,
+		ovrHandType hand, double time, ovrInputState* inputState);
+
+private:
+	lua_State* m_State;
+	int m_StateTables[2];
+	int m_GripTable;
+	uint32_t m_StateIndex;
+	uint32_t m_ModelVersion;
+
+	void CreateTables();
+	void UpdateStateField(const vr::VRControllerState_t& state, uint16_t axisTypes, vr::EVRButtonId button, const char* name);
+	void UpdateStateTable(const vr::VRControllerState_t& state, uint16_t axisTypes);
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "OVR_CAPI.h"
+
+#include <openvr.h>
+#include <algorithm>
+
+class TextureBase;
+
+// A layer that is blitted into the scene layer, the swapchain textures are resolved when the blit is queued
+struct LayerBlit
+{
+	TextureBase* Texture;
+	TextureBase* Target;
+	ovrRecti Viewport;
+	vr::VRTextureBounds_t Bounds;
+	vr::HmdVector4_t Quad;
+};
+
+// Returns the fractions of the edge from a to b that are inside [-1, 1], false if none of it is
+inline bool ClipLayerEdge(float a, float b, float* outStart, float* outEnd)
+{
+	if (a == b)
+		return false;
+
+	float start = (-1.0f - a) / (b - a);
+	float end = (1.0f - a) / (b - a);
+	if (start > end)
+		std::swap(start, end);
+	*outStart = (std::max)(start, 0.0f);
+	*outEnd = (std::min)(end, 1.0f);
+	return *outStart < *outEnd;
+}
+
+/*
+	Maps the quad of a layer from the normalized device coordinates of its viewport to those of the
+	whole target, so layers with different viewports can be drawn without changing the viewport.
+	The quad is clipped to the viewport and the texture bounds are clipped along with it, a quad that's
+	entirely outside of the viewport becomes empty.
+*/
+inline void LayerBlitToTarget(const LayerBlit& blit, int width, int height, vr::HmdVector4_t* outQuad, vr::VRTextureBounds_t* outBounds)
+{
+	const float* quad = blit.Quad.v;
+	float x0, x1, y0, y1;
+	if (!ClipLayerEdge(quad[0], quad[1], &x0, &x1) || !ClipLayerEdge(quad[2], quad[3], &y0, &y1))
+	{
+		*outQuad = vr::HmdVector4_t();
+		*outBounds = vr::VRTextureBounds_t();
+		return;
+	}
+
+	// Workaround for applications that leave the viewport uninitialized
+	ovrRecti viewport = blit.Viewport;
+	if (viewport.Size.w <= 0 || viewport.Size.h <= 0)
+		viewport = ovrRecti{ { 0, 0 }, { width, height } };
+
+	// Interpolate so the unclipped edges stay exactly the same
+	auto mix = [](float a, float b, float t) { return a * (1.0f - t) + b * t; };
+	float left = mix(quad[0], quad[1], x0), right = mix(quad[0], quad[1], x1);
+	float top = mix(quad[2], quad[3], y0), bottom = mix(quad[2], quad[3], y1);
+
+	// The y-axis of the quad points up, the viewport is given from the top-left corner
+	auto toTargetX = [&](float x) { return (viewport.Pos.x + (x + 1.0f) * 0.5f * viewport.Size.w) / width * 2.0f - 1.0f; };
+	auto toTargetY = [&](float y) { return 1.0f - (viewport.Pos.y + (1.0f - y) * 0.5f * viewport.Size.h) / height * 2.0f; };
+	outQuad->v[0] = toTargetX(left);
+	outQuad->v[1] = toTargetX(right);
+	outQuad->v[2] = toTargetY(top);
+	outQuad->v[3] = toTargetY(bottom);
+
+	const vr::VRTextureBounds_t& bounds = blit.Bounds;
+	outBounds->uMin = mix(bounds.uMin, bounds.uMax, x0);
+	outBounds->uMax = mix(bounds.uMin, bounds.uMax, x1);
+	outBounds->vMin = mix(bounds.vMin, bounds.vMax, y0);
+	outBounds->vMax = mix(bounds.vMin, bounds.vMax, y1);
+}
@@ -0,0 +1,29 @@
+#version 450
+
+// Must match REV_VK_LAYER_BATCH
+#define BATCH_SIZE 8
+
+layout(set = 0, binding = 0) uniform sampler2D layers[BATCH_SIZE];
+
+layout(location = 0) in vec2 tex;
+layout(location = 1) flat in int index;
+layout(location = 0) out vec4 color;
+
+void main()
+{
+	// The index differs between instances, so the array is only indexed with constants to avoid
+	// needing the non-uniform indexing feature. The gradients are taken outside of the branches.
+	vec2 dx = dFdx(tex);
+	vec2 dy = dFdy(tex);
+	switch (index)
+	{
+	case 0: color = textureGrad(layers[0], tex, dx, dy); break;
+	case 1: color = textureGrad(layers[1], tex, dx, dy); break;
+	case 2: color = textureGrad(layers[2], tex, dx, dy); break;
+	case 3: color = textureGrad(layers[3], tex, dx, dy); break;
+	case 4: color = textureGrad(layers[4], tex, dx, dy); break;
+	case 5: color = textureGrad(layers[5], tex, dx, dy); break;
+	case 6: color = textureGrad(layers[6], tex, dx, dy); break;
+	default: color = textureGrad(layers[7], tex, dx, dy); break;
+	}
+}
@@ -0,0 +1,36 @@
+#version 450
+
+// Must match REV_VK_MAX_LAYERS
+#define MAX_LAYERS 64
+
+// The quad is given as the left, right, top and bottom edges in normalized device coordinates of the
+// target with the y-axis pointing up, the bounds as the minimum and maximum texture coordinates.
+struct Layer
+{
+	vec4 Quad;
+	vec4 Bounds;
+};
+
+layout(set = 0, binding = 1) uniform Layers
+{
+	Layer layers[MAX_LAYERS];
+};
+
+// The first instance of the draw, every instance samples the texture at its offset from it
+layout(push_constant) uniform Batch
+{
+	int First;
+} batch;
+
+layout(location = 0) out vec2 tex;
+layout(location = 1) flat out int index;
+
+void main()
+{
+	Layer layer = layers[gl_InstanceIndex];
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+	vec2 pos = vec2(mix(layer.Quad.x, layer.Quad.y, corner.x), mix(layer.Quad.z, layer.Quad.w, corner.y));
+	tex = mix(layer.Bounds.xy, layer.Bounds.zw, corner);
+	index = gl_InstanceIndex - batch.First;
+	gl_Position = vec4(pos.x, -pos.y, 0.0, 1.0);
+}
@@ -0,0 +1,76 @@
+#include "OverlayState.h"
+
+#include <algorithm>
+#include <string.h>
+
+void OverlayState::Apply(vr::IVROverlay* overlays, vr::VROverlayHandle_t overlay, const OverlayState& next, bool created)
+{
+	// Set the layer rendering order.
+	if (created || SortOrder != next.SortOrder)
+	{
+		overlays->SetOverlaySortOrder(overlay, next.SortOrder);
+		SortOrder = next.SortOrder;
+	}
+
+	// Transform the overlay.
+	if (created || Width != next.Width)
+	{
+		overlays->SetOverlayWidthInMeters(overlay, next.Width);
+		Width = next.Width;
+	}
+
+	if (created || Curvature != next.Curvature)
+	{
+		overlays->SetOverlayCurvature(overlay, next.Curvature);
+		Curvature = next.Curvature;
+	}
+
+	if (created || TexelAspect != next.TexelAspect)
+	{
+		overlays->SetOverlayTexelAspect(overlay, next.TexelAspect);
+		TexelAspect = next.TexelAspect;
+	}
+
+	// The tracking origin only matters for overlays that aren't head-locked
+	if (created || HeadLocked != next.HeadLocked || (!next.HeadLocked && Origin != next.Origin) ||
+		memcmp(&Transform, &next.Transform, sizeof(Transform)) != 0)
+	{
+		if (next.HeadLocked)
+			overlays->SetOverlayTransformTrackedDeviceRelative(overlay, vr::k_unTrackedDeviceIndex_Hmd, &next.Transform);
+		else
+			overlays->SetOverlayTransformAbsolute(overlay, next.Origin, &next.Transform);
+		HeadLocked = next.HeadLocked;
+		Origin = next.Origin;
+		Transform = next.Transform;
+	}
+
+	// Set the texture bounds.
+	if (created || memcmp(&Bounds, &next.Bounds, sizeof(Bounds)) != 0)
+	{
+		overlays->SetOverlayTextureBounds(overlay, &next.Bounds);
+		Bounds = next.Bounds;
+	}
+}
+
+void OverlayVisibility::Submit(vr::IVROverlay* overlays, vr::VROverlayHandle_t overlay, bool created)
+{
+	// Unfortunately we have no control over the order in which overlays are drawn.
+	// TODO: Handle overlay errors.
+	if (created || !std::binary_search(m_ActiveOverlays.begin(), m_ActiveOverlays.end(), overlay))
+		overlays->ShowOverlay(overlay);
+	m_FrameOverlays.push_back(overlay);
+}
+
+void OverlayVisibility::EndFrame(vr::IVROverlay* overlays)
+{
+	// Hide previous overlays that are not part of the current layers.
+	std::sort(m_FrameOverlays.begin(), m_FrameOverlays.end());
+	for (vr::VROverlayHandle_t overlay : m_ActiveOverlays)
+	{
+		// TODO: Handle overlay errors.
+		if (!std::binary_search(m_FrameOverlays.begin(), m_FrameOverlays.end(), overlay))
+			overlays->HideOverlay(overlay);
+	}
+	m_ActiveOverlays.swap(m_FrameOverlays);
+	m_FrameOverlays.clear();
+}
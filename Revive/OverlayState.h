@@ -0,0 +1,40 @@
+#pragma once
+
+#include <openvr.h>
+#include <vector>
+
+// Overlay properties that were last set for a layer, used to skip redundant overlay calls
+struct OverlayState
+{
+	uint32_t SortOrder;
+	float Width;
+	float Curvature;
+	float TexelAspect;
+	bool HeadLocked;
+	vr::ETrackingUniverseOrigin Origin;
+	vr::HmdMatrix34_t Transform;
+	vr::VRTextureBounds_t Bounds;
+
+	// Only sets the properties that differ from the last state, every call is a round-trip to the
+	// OpenVR compositor. A newly created overlay gets all its properties set.
+	void Apply(vr::IVROverlay* overlays, vr::VROverlayHandle_t overlay, const OverlayState& next, bool created);
+};
+
+/*
+	Keeps track of the overlays that are visible, so an overlay is only shown in the frame it
+	appears and only hidden in the frame it disappears. Both lists are kept sorted so stale
+	overlays can be found with a binary search.
+*/
+class OverlayVisibility
+{
+public:
+	// Shows the overlay if it wasn't visible in the previous frame
+	void Submit(vr::IVROverlay* overlays, vr::VROverlayHandle_t overlay, bool created);
+
+	// Hides the overlays of the previous frame that weren't submitted in this frame
+	void EndFrame(vr::IVROverlay* overlays);
+
+private:
+	std::vector<vr::VROverlayHandle_t> m_ActiveOverlays;
+	std::vector<vr::VROverlayHandle_t> m_FrameOverlays;
+};
@@ -0,0 +1,133 @@
+#include "PerfManager.h"
+
+#include <algorithm>
+#include <math.h>
+
+PerfManager::PerfManager()
+	: m_History()
+	, m_CumulativeStats()
+	, m_LatestFrame(0)
+	, m_SceneFocusProcess(0)
+	, m_DisplayFrequency(90.0f)
+	, m_VsyncToPhotons(0.0f)
+	, m_TargetUtilization(REV_PERF_TARGET_UTILIZATION)
+	, m_MinScale(REV_PERF_MIN_SCALE)
+	, m_MaxScale(REV_PERF_MAX_SCALE)
+	, m_LastFrameIndex(0)
+	, m_GpuUtilization(0.0f)
+	, m_GpuScale(1.0f)
+{
+}
+
+void PerfManager::Sample(vr::IVRCompositor* compositor)
+{
+	vr::Compositor_CumulativeStats stats;
+	compositor->GetCumulativeStats(&stats, sizeof(vr::Compositor_CumulativeStats));
+	m_CumulativeStats.store(stats);
+	m_SceneFocusProcess = compositor->GetCurrentSceneFocusProcess();
+
+	vr::Compositor_FrameTiming timings[REV_PERF_HISTORY_SIZE];
+	timings[0].m_nSize = sizeof(vr::Compositor_FrameTiming);
+	if (!compositor->GetFrameTiming(timings, 0))
+		return;
+
+	// Only copy the frames we haven't seen yet
+	uint32_t latest = m_LatestFrame.load(std::memory_order_relaxed);
+	if (timings[0].m_nFrameIndex <= latest)
+		return;
+
+	uint32_t count = std::min(timings[0].m_nFrameIndex - latest, (uint32_t)REV_PERF_HISTORY_SIZE);
+
+	if (count > 1)
+		count = compositor->GetFrameTimings(timings, count);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (timings[i].m_nFrameIndex > latest)
+			m_History[timings[i].m_nFrameIndex % REV_PERF_HISTORY_SIZE].store(timings[i]);
+	}
+
+	if (count > 0)
+	{
+		AddFrameTimings(timings, count, 1.0f / m_DisplayFrequency);
+		m_LatestFrame.store(timings[count - 1].m_nFrameIndex, std::memory_order_release);
+	}
+}
+
+void PerfManager::SetScaleLimits(float targetUtilization, float minScale, float maxScale)
+{
+	if (targetUtilization > 0.0f)
+		m_TargetUtilization = targetUtilization;
+	if (minScale > 0.0f)
+		m_MinScale = minScale;
+	if (maxScale > 0.0f)
+		m_MaxScale = std::max(maxScale, m_MinScale);
+}
+
+void PerfManager::UpdateDisplayProperties(vr::IVRSystem* system)
+{
+	float frequency = system->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
+	if (frequency > 0.0f)
+		m_DisplayFrequency = frequency;
+	m_VsyncToPhotons = system->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
+}
+
+int PerfManager::GetFrameTimings(uint32_t afterFrame, vr::Compositor_FrameTiming* timings, int count, bool* outDropped)
+{
+	uint32_t latest = m_LatestFrame.load(std::memory_order_acquire);
+	uint32_t available = latest > afterFrame ? latest - afterFrame : 0;
+	*outDropped = available > (uint32_t)count;
+
+	int copied = 0;
+	for (uint32_t frame = latest - std::min(available, (uint32_t)count) + 1; frame <= latest && available > 0; frame++)
+	{
+		timings[copied] = m_History[frame % REV_PERF_HISTORY_SIZE].load();
+
+		// The entry was overwritten by a newer frame, which also means all frames before it were dropped
+		if (timings[copied].m_nFrameIndex != frame)
+			*outDropped = true;
+		else
+			copied++;
+	}
+	return copied;
+}
+
+void PerfManager::AddFrameTimings(const vr::Compositor_FrameTiming* timings, int count, float frameDuration)
+{
+	if (frameDuration <= 0.0f)
+		return;
+
+	for (int i = 0; i < count; i++)
+	{
+		const vr::Compositor_FrameTiming& timing = timings[i];
+		if (timing.m_nFrameIndex <= m_LastFrameIndex)
+			continue;
+		m_LastFrameIndex = timing.m_nFrameIndex;
+
+		// The total render time includes the compositor, so take the larger of both estimates
+		float gpuMs = std::max(timing.m_flPreSubmitGpuMs + timing.m_flPostSubmitGpuMs,
+			timing.m_flTotalRenderGpuMs - timing.m_flCompositorRenderGpuMs);
+
+		// Frames without GPU timing are skipped
+		if (gpuMs <= 0.0f)
+			continue;
+
+		float utilization = gpuMs / (frameDuration * 1000.0f);
+		if (m_GpuUtilization <= 0.0f)
+			m_GpuUtilization = utilization;
+		else if (utilization > m_GpuUtilization)
+			m_GpuUtilization += (utilization - m_GpuUtilization) * REV_PERF_SMOOTHING_UP;
+		else
+			m_GpuUtilization += (utilization - m_GpuUtilization) * REV_PERF_SMOOTHING_DOWN;
+	}
+
+	if (m_GpuUtilization <= 0.0f)
+		return;
+
+	float estimate = m_TargetUtilization / m_GpuUtilization;
+	estimate = std::min(std::max(estimate, m_MinScale), m_MaxScale);
+
+	// Hysteresis, so applications don't keep changing their resolution on small fluctuations
+	if (fabsf(estimate - m_GpuScale) > m_GpuScale * REV_PERF_HYSTERESIS)
+		m_GpuScale = estimate;
+}
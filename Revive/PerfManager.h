@@ -0,0 +1,78 @@
+#pragma once
+
+#include "seqlock.h"
+
+#include <openvr.h>
+#include <atomic>
+#include <stdint.h>
+
+// Number of compositor frames kept in the timing history, must be a power of two
+#define REV_PERF_HISTORY_SIZE 64
+
+// The GPU time the application should aim for, relative to the frame duration
+#define REV_PERF_TARGET_UTILIZATION 0.9f
+
+// Smoothing factors for the GPU utilization, overload is tracked faster than headroom
+#define REV_PERF_SMOOTHING_UP 0.3f
+#define REV_PERF_SMOOTHING_DOWN 0.05f
+
+// The reported scale only changes when the estimate deviates more than this from it
+#define REV_PERF_HYSTERESIS 0.05f
+
+#define REV_PERF_MIN_SCALE 0.25f
+#define REV_PERF_MAX_SCALE 2.0f
+
+class PerfManager
+{
+public:
+	PerfManager();
+	~PerfManager() { }
+
+	// Called periodically from the session thread, copies the timings of the new compositor
+	// frames into the history so the application threads never need to query the compositor.
+	void Sample(vr::IVRCompositor* compositor);
+
+	// Called from the session thread when the display properties may have changed
+	void UpdateDisplayProperties(vr::IVRSystem* system);
+
+	// Feeds the frame timings in ascending order, frames that were already seen are skipped.
+	// Doesn't call into OpenVR, so recorded frame timings can be replayed.
+	void AddFrameTimings(const vr::Compositor_FrameTiming* timings, int count, float frameDuration);
+
+	// Copies the timings of the most recent frames after the given compositor frame in ascending order,
+	// returns the number of frames copied and whether there were more frames than would fit.
+	int GetFrameTimings(uint32_t afterFrame, vr::Compositor_FrameTiming* timings, int count, bool* outDropped);
+
+	vr::Compositor_CumulativeStats GetCumulativeStats() const { return m_CumulativeStats.load(); }
+	uint32_t GetLatestFrame() const { return m_LatestFrame; }
+	uint32_t GetSceneFocusProcess() const { return m_SceneFocusProcess; }
+	float GetDisplayFrequency() const { return m_DisplayFrequency; }
+	float GetVsyncToPhotons() const { return m_VsyncToPhotons; }
+
+	// Overrides the target utilization and the scale limits, zero keeps the default
+	void SetScaleLimits(float targetUtilization, float minScale, float maxScale);
+
+	// Factor the application should scale its GPU load by to stay within the frame budget,
+	// a value of 1.0 means the application is within the budget
+	float GetGpuPerformanceScale() const { return m_GpuScale; }
+
+private:
+	// Timing history, indexed by the compositor frame index. Written only by the session thread,
+	// readers check the frame index of every entry in case it was overwritten while copying.
+	seqlock<vr::Compositor_FrameTiming> m_History[REV_PERF_HISTORY_SIZE];
+	seqlock<vr::Compositor_CumulativeStats> m_CumulativeStats;
+	std::atomic_uint32_t m_LatestFrame;
+	std::atomic_uint32_t m_SceneFocusProcess;
+
+	// Display properties, cached until the HMD reports a property change
+	std::atomic<float> m_DisplayFrequency;
+	std::atomic<float> m_VsyncToPhotons;
+
+	// Performance scale heuristic
+	float m_TargetUtilization;
+	float m_MinScale;
+	float m_MaxScale;
+	uint32_t m_LastFrameIndex;
+	float m_GpuUtilization;
+	std::atomic<float> m_GpuScale;
+};
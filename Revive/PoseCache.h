@@ -0,0 +1,116 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <math.h>
+#include <string.h>
+#include <openvr.h>
+
+#define REV_POSE_CACHE_SIZE 4
+#define REV_POSE_CACHE_BUCKET 0.001
+#define REV_POSE_CACHE_LIFETIME 0.005
+
+/*
+	Tracking queries for the same frame, origin and prediction time share a single OpenVR query.
+	The following rules apply:
+		1. The query runs outside the lock, so a slow query never holds up queries for other keys.
+		2. An entry is reserved before the query runs, callers asking for the same key wait for
+		   it to be published instead of running the query again.
+		3. If all entries are still being queried the caller queries on its own without caching.
+*/
+class PoseCache
+{
+public:
+	PoseCache() : m_Entries(), m_Next(0)
+	{
+		// Make sure the empty entries never match a query
+		for (Entry& entry : m_Entries)
+			entry.FrameIndex = -1;
+	}
+	PoseCache(const PoseCache&) = delete;
+	PoseCache& operator=(const PoseCache&) = delete;
+
+	// Runs query(TrackedDevicePose_t*) unless a recent query for the same key can be shared
+	template<typename F>
+	void Get(long long frameIndex, vr::ETrackingUniverseOrigin origin, double now, float relTime,
+		vr::TrackedDevicePose_t* poses, F query)
+	{
+		// Queries are keyed on the absolute time they predict for, so nearby calls within a frame share the same poses
+		long long bucket = (long long)floor((now + relTime) / REV_POSE_CACHE_BUCKET);
+
+		std::unique_lock<std::mutex> lk(m_Mutex);
+		Entry* entry;
+		while ((entry = Find(frameIndex, origin, bucket, now)) && entry->Pending)
+			m_CV.wait(lk);
+
+		if (entry)
+		{
+			memcpy(poses, entry->Poses, sizeof(entry->Poses));
+			return;
+		}
+
+		entry = Reserve();
+		if (!entry)
+		{
+			lk.unlock();
+			query(poses);
+			return;
+		}
+
+		entry->FrameIndex = frameIndex;
+		entry->Origin = origin;
+		entry->TimeBucket = bucket;
+		entry->QueryTime = now;
+		entry->Pending = true;
+		lk.unlock();
+
+		query(poses);
+
+		lk.lock();
+		memcpy(entry->Poses, poses, sizeof(entry->Poses));
+		entry->Pending = false;
+		lk.unlock();
+		m_CV.notify_all();
+	}
+
+private:
+	struct Entry
+	{
+		long long FrameIndex;
+		vr::ETrackingUniverseOrigin Origin;
+		long long TimeBucket;
+		double QueryTime;
+		bool Pending;
+		vr::TrackedDevicePose_t Poses[vr::k_unMaxTrackedDeviceCount];
+	};
+
+	std::mutex m_Mutex;
+	std::condition_variable m_CV;
+	Entry m_Entries[REV_POSE_CACHE_SIZE];
+	unsigned int m_Next;
+
+	Entry* Find(long long frameIndex, vr::ETrackingUniverseOrigin origin, long long bucket, double now)
+	{
+		for (Entry& entry : m_Entries)
+		{
+			// Entries expire quickly in case the application doesn't advance the frame index
+			if (entry.FrameIndex == frameIndex && entry.Origin == origin && entry.TimeBucket == bucket &&
+				now - entry.QueryTime < REV_POSE_CACHE_LIFETIME)
+				return &entry;
+		}
+		return nullptr;
+	}
+
+	// Replaces the oldest entry, entries that are still being queried are skipped
+	Entry* Reserve()
+	{
+		for (unsigned int i = 0; i < REV_POSE_CACHE_SIZE; i++)
+		{
+			Entry& entry = m_Entries[m_Next];
+			m_Next = (m_Next + 1) % REV_POSE_CACHE_SIZE;
+			if (!entry.Pending)
+				return &entry;
+		}
+		return nullptr;
+	}
+};
@@ -0,0 +1,127 @@
+#include "PoseConversion.h"
+#include "REV_Math.h"
+
+#include <algorithm>
+#include <xmmintrin.h>
+
+void TrackedDevicePosesToOVRPoses(const vr::TrackedDevicePose_t* poses, ovrPoseStatef* const* lastPoses,
+	int count, double time, ovrPoseStatef* outPoses)
+{
+	// Convert the poses in groups of four, the arrays are in a structure-of-arrays layout with one device per lane
+	for (int base = 0; base < count; base += 4)
+	{
+		int lanes = std::min(count - base, 4);
+
+		alignas(16) float m[3][4][4];
+		alignas(16) float last[4][4];
+		alignas(16) float vel[6][4];
+		alignas(16) float lastVel[6][4];
+		alignas(16) float dt[4];
+		for (int lane = 0; lane < 4; lane++)
+		{
+			// Unused lanes get an identity pose, so they don't produce any special values
+			const vr::TrackedDevicePose_t* pose = lane < lanes ? &poses[base + lane] : nullptr;
+			const ovrPoseStatef* lastPose = lane < lanes ? lastPoses[base + lane] : nullptr;
+			for (int row = 0; row < 3; row++)
+			{
+				for (int col = 0; col < 4; col++)
+					m[row][col][lane] = pose ? pose->mDeviceToAbsoluteTracking.m[row][col] : float(row == col);
+			}
+
+			ovrQuatf q = lastPose ? lastPose->ThePose.Orientation : ovrQuatf{ 0.0f, 0.0f, 0.0f, 1.0f };
+			last[0][lane] = q.x;
+			last[1][lane] = q.y;
+			last[2][lane] = q.z;
+			last[3][lane] = q.w;
+
+			for (int i = 0; i < 3; i++)
+			{
+				vel[i][lane] = pose ? pose->vAngularVelocity.v[i] : 0.0f;
+				vel[i + 3][lane] = pose ? pose->vVelocity.v[i] : 0.0f;
+				lastVel[i][lane] = lastPose ? (&lastPose->AngularVelocity.x)[i] : 0.0f;
+				lastVel[i + 3][lane] = lastPose ? (&lastPose->LinearVelocity.x)[i] : 0.0f;
+			}
+			dt[lane] = lastPose ? float(time - lastPose->TimeInSeconds) : 1.0f;
+		}
+
+		__m128 m00 = _mm_load_ps(m[0][0]), m01 = _mm_load_ps(m[0][1]), m02 = _mm_load_ps(m[0][2]);
+		__m128 m10 = _mm_load_ps(m[1][0]), m11 = _mm_load_ps(m[1][1]), m12 = _mm_load_ps(m[1][2]);
+		__m128 m20 = _mm_load_ps(m[2][0]), m21 = _mm_load_ps(m[2][1]), m22 = _mm_load_ps(m[2][2]);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 quarter = _mm_set1_ps(0.25f);
+
+		// Evaluate all four branches of the quaternion extraction in OVR::Quatf(Matrix4f), then select per lane.
+		// The operations are in the same order as the scalar code, so the results are identical.
+		__m128 trace = _mm_add_ps(_mm_add_ps(m00, m11), m22);
+		__m128 d0 = _mm_sub_ps(m21, m12), d1 = _mm_sub_ps(m02, m20), d2 = _mm_sub_ps(m10, m01);
+		__m128 s01 = _mm_add_ps(m01, m10), s02 = _mm_add_ps(m20, m02), s12 = _mm_add_ps(m12, m21);
+
+		__m128 s = _mm_mul_ps(_mm_sqrt_ps(_mm_add_ps(trace, one)), two);
+		__m128 qw0 = _mm_mul_ps(quarter, s);
+		__m128 qx0 = _mm_div_ps(d0, s), qy0 = _mm_div_ps(d1, s), qz0 = _mm_div_ps(d2, s);
+
+		s = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_sub_ps(_mm_add_ps(one, m00), m11), m22)), two);
+		__m128 qw1 = _mm_div_ps(d0, s);
+		__m128 qx1 = _mm_mul_ps(quarter, s), qy1 = _mm_div_ps(s01, s), qz1 = _mm_div_ps(s02, s);
+
+		s = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_sub_ps(_mm_add_ps(one, m11), m00), m22)), two);
+		__m128 qw2 = _mm_div_ps(d1, s);
+		__m128 qx2 = _mm_div_ps(s01, s), qy2 = _mm_mul_ps(quarter, s), qz2 = _mm_div_ps(s12, s);
+
+		s = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_sub_ps(_mm_add_ps(one, m22), m00), m11)), two);
+		__m128 qw3 = _mm_div_ps(d2, s);
+		__m128 qx3 = _mm_div_ps(s02, s), qy3 = _mm_div_ps(s12, s), qz3 = _mm_mul_ps(quarter, s);
+
+		// Build exclusive masks for the branches, later branches are only taken if the previous ones weren't
+		__m128 c0 = _mm_cmpgt_ps(trace, zero);
+		__m128 c1 = _mm_andnot_ps(c0, _mm_and_ps(_mm_cmpgt_ps(m00, m11), _mm_cmpgt_ps(m00, m22)));
+		__m128 c2 = _mm_andnot_ps(_mm_or_ps(c0, c1), _mm_cmpgt_ps(m11, m22));
+		__m128 c3 = _mm_andnot_ps(_mm_or_ps(_mm_or_ps(c0, c1), c2), _mm_cmpeq_ps(zero, zero));
+
+	#define SELECT(v0, v1, v2, v3) \
+		_mm_or_ps(_mm_or_ps(_mm_and_ps(c0, v0), _mm_and_ps(c1, v1)), _mm_or_ps(_mm_and_ps(c2, v2), _mm_and_ps(c3, v3)))
+		__m128 qx = SELECT(qx0, qx1, qx2, qx3);
+		__m128 qy = SELECT(qy0, qy1, qy2, qy3);
+		__m128 qz = SELECT(qz0, qz1, qz2, qz3);
+		__m128 qw = SELECT(qw0, qw1, qw2, qw3);
+	#undef SELECT
+
+		// Make sure the orientation stays in the same hemisphere as the previous orientation, this prevents
+		// linear interpolations from suddenly flipping the long way around in Oculus Medium.
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(qx, _mm_load_ps(last[0])), _mm_mul_ps(qy, _mm_load_ps(last[1]))),
+			_mm_mul_ps(qz, _mm_load_ps(last[2]))), _mm_mul_ps(qw, _mm_load_ps(last[3])));
+		__m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, zero), _mm_set1_ps(-0.0f));
+		_mm_store_ps(last[0], _mm_xor_ps(qx, flip));
+		_mm_store_ps(last[1], _mm_xor_ps(qy, flip));
+		_mm_store_ps(last[2], _mm_xor_ps(qz, flip));
+		_mm_store_ps(last[3], _mm_xor_ps(qw, flip));
+
+		// Finite-difference accelerations, the velocities are multiplied by the reciprocal like OVR::Vector3f does
+		__m128 rcp = _mm_div_ps(one, _mm_load_ps(dt));
+		for (int i = 0; i < 6; i++)
+			_mm_store_ps(vel[i], _mm_mul_ps(_mm_sub_ps(_mm_load_ps(vel[i]), _mm_load_ps(lastVel[i])), rcp));
+
+		for (int lane = 0; lane < lanes; lane++)
+		{
+			const vr::TrackedDevicePose_t& pose = poses[base + lane];
+			ovrPoseStatef result = { OVR::Posef::Identity() };
+			if (pose.bPoseIsValid)
+			{
+				result.ThePose.Orientation = ovrQuatf{ last[0][lane], last[1][lane], last[2][lane], last[3][lane] };
+				result.ThePose.Position = ovrVector3f{ m[0][3][lane], m[1][3][lane], m[2][3][lane] };
+				result.AngularVelocity = (REV::Vector3f)pose.vAngularVelocity;
+				result.LinearVelocity = (REV::Vector3f)pose.vVelocity;
+				result.AngularAcceleration = ovrVector3f{ vel[0][lane], vel[1][lane], vel[2][lane] };
+				result.LinearAcceleration = ovrVector3f{ vel[3][lane], vel[4][lane], vel[5][lane] };
+				result.TimeInSeconds = time;
+
+				// Store the last pose
+				*lastPoses[base + lane] = result;
+			}
+			outPoses[base + lane] = result;
+		}
+	}
+}
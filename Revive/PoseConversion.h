@@ -0,0 +1,14 @@
+#pragma once
+
+#include "OVR_CAPI.h"
+
+#include <openvr.h>
+
+/*
+	Converts a batch of OpenVR poses to Oculus pose states, four devices at a time with SSE.
+	The accelerations are derived from the last pose of every device, which is replaced by the
+	new pose when it's valid. The results are bit-identical to converting every pose on its own
+	with the OVR math classes, ReviveTests compares them against that scalar reference.
+*/
+void TrackedDevicePosesToOVRPoses(const vr::TrackedDevicePose_t* poses, ovrPoseStatef* const* lastPoses,
+	int count, double time, ovrPoseStatef* outPoses);
@@ -5,8 +5,10 @@
 #include "Assert.h"
 #include "Session.h"
 #include "CompositorBase.h"
+#include "FramePacer.h"
 #include "SessionDetails.h"
 #include "InputManager.h"
+#include "PerfManager.h"
 #include "Settings.h"
 #include "SettingsManager.h"
 #include "rcu_ptr.h"
@@ -102,6 +104,11 @@ OVR_PUBLIC_FUNCTION(void) ovr_Shutdown()
 {
 	g_Sessions.clear();
 	vr::VR_Shutdown();
+
+	// Keep the trace of the whole run if recording was enabled
+	if (g_TraceEnabled)
+		TraceDump();
+	TraceConfigure(false, 0.0f);
 	MicroProfileShutdown();
 }
 
@@ -246,6 +253,7 @@ OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetSessionStatus(ovrSession session, ovrSessi
 	first_call = false;
 
 	SessionStatusBits status = session->SessionStatus;
+	session->WakeSessionThread();
 
 	// Don't use the activity level while debugging, so I don't have to put on the HMD
 	sessionStatus->HmdPresent = status.HmdPresent;
@@ -258,8 +266,7 @@ OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetSessionStatus(ovrSession session, ovrSessi
 	sessionStatus->HasInputFocus = status.HasInputFocus;
 	sessionStatus->OverlayPresent = status.OverlayPresent;
 
-	static const bool do_sleep = session->Details->UseHack(SessionDetails::HACK_SLEEP_IN_SESSION_STATUS);
-	if (do_sleep)
+	if (session->Details->UseHack(SessionDetails::HACK_SLEEP_IN_SESSION_STATUS))
 		std::this_thread::sleep_for(std::chrono::milliseconds(1));
 
 	return ovrSuccess;
@@ -327,7 +334,7 @@ OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetDevicePoses(ovrSession session, ovrTracked
 	if (!session)
 		return ovrError_InvalidSession;
 
-	return session->Input->GetDevicePoses(deviceTypes, deviceCount, absTime, outDevicePoses);
+	return session->Input->GetDevicePoses(session, deviceTypes, deviceCount, absTime, outDevicePoses);
 }
 
 struct ovrSensorData_;
@@ -503,14 +510,18 @@ OVR_PUBLIC_FUNCTION(ovrResult) ovr_TestBoundary(ovrSession session, ovrTrackedDe
 {
 	REV_TRACE(ovr_TestBoundary);
 
-	outTestResult->ClosestDistance = INFINITY;
+	if (!session)
+		return ovrError_InvalidSession;
 
-	vr::TrackedDevicePose_t poses[vr::k_unMaxTrackedDeviceCount];
-	vr::VRCompositor()->GetLastPoses(poses, vr::k_unMaxTrackedDeviceCount, nullptr, 0);
+	outTestResult->ClosestDistance = INFINITY;
 
 	if (vr::VRChaperone()->GetCalibrationState() != vr::ChaperoneCalibrationState_OK)
 		return ovrSuccess_BoundaryInvalid;
 
+	// Share the poses with the other tracking queries for this frame
+	vr::TrackedDevicePose_t poses[vr::k_unMaxTrackedDeviceCount];
+	session->Input->GetTrackedDevicePoses(session, vr::VRCompositor()->GetTrackingSpace(), 0.0f, poses);
+
 	if (deviceBitmask & ovrTrackedDevice_HMD)
 	{
 		ovrBoundaryTestResult result = { 0 };
@@ -523,17 +534,15 @@ OVR_PUBLIC_FUNCTION(ovrResult) ovr_TestBoundary(ovrSession session, ovrTrackedDe
 	}
 
 
-	vr::TrackedDeviceIndex_t hands[] = { vr::VRSystem()->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_LeftHand),
-		vr::VRSystem()->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_RightHand) };
-
 	for (int i = 0; i < ovrHand_Count; i++)
 	{
 		if (deviceBitmask & (ovrTrackedDevice_LTouch << i))
 		{
 			ovrBoundaryTestResult result = { 0 };
-			if (hands[i] != vr::k_unTrackedDeviceIndexInvalid)
+			vr::TrackedDeviceIndex_t hand = session->Input->GetHandIndex((ovrHandType)i);
+			if (hand != vr::k_unTrackedDeviceIndexInvalid)
 			{
-				REV::Matrix4f matrix = (REV::Matrix4f)poses[hands[i]].mDeviceToAbsoluteTracking;
+				REV::Matrix4f matrix = (REV::Matrix4f)poses[hand].mDeviceToAbsoluteTracking;
 				ovrVector3f point = matrix.GetTranslation();
 
 				ovrResult err = ovr_TestBoundaryPoint(session, &point, boundaryType, &result);
@@ -722,7 +731,10 @@ OVR_PUBLIC_FUNCTION(void) ovr_DestroyTextureSwapChain(ovrSession session, ovrTex
 
 	MICROPROFILE_META_CPU("Identifier", chain->Identifier);
 	vr::VROverlay()->DestroyOverlay(chain->Overlay);
-	delete chain;
+	if (session && session->Compositor)
+		session->Compositor->DestroyTextureSwapChain(chain);
+	else
+		delete chain;
 }
 
 OVR_PUBLIC_FUNCTION(void) ovr_DestroyMirrorTexture(ovrSession session, ovrMirrorTexture mirrorTexture)
@@ -892,18 +904,22 @@ OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetPerfStats(ovrSession session, ovrPerfStats
 
 	ovrPerfStatsPerCompositorFrame FrameStats[ovrMaxProvidedFrameStats];
 
-	// TODO: Implement performance scale heuristics
-	float AdaptiveGpuPerformanceScale = 1.0f;
-	bool AnyFrameStatsDropped = (session->FrameIndex - session->StatsIndex) > ovrMaxProvidedFrameStats;
-	int FrameStatsCount = AnyFrameStatsDropped ? ovrMaxProvidedFrameStats : int(session->FrameIndex - session->StatsIndex);
-	session->StatsIndex = session->FrameIndex;
+	// The first call only reports the most recent frames, the application couldn't have seen the frames before it
+	if (session->StatsIndex == 0)
+		session->StatsIndex = (std::max)((long long)session->Perf->GetLatestFrame() - ovrMaxProvidedFrameStats, 0ll);
 
+	// Copy the frames since the last call from the timing history, this doesn't call into the compositor
 	vr::Compositor_FrameTiming TimingStats[ovrMaxProvidedFrameStats];
-	TimingStats[0].m_nSize = sizeof(vr::Compositor_FrameTiming);
-	vr::VRCompositor()->GetFrameTimings(TimingStats, FrameStatsCount);
+	bool AnyFrameStatsDropped;
+	int FrameStatsCount = session->Perf->GetFrameTimings((uint32_t)session->StatsIndex, TimingStats, ovrMaxProvidedFrameStats, &AnyFrameStatsDropped);
+	if (FrameStatsCount > 0)
+		session->StatsIndex = TimingStats[FrameStatsCount - 1].m_nFrameIndex;
 
-	vr::Compositor_CumulativeStats TotalStats;
-	vr::VRCompositor()->GetCumulativeStats(&TotalStats, sizeof(vr::Compositor_CumulativeStats));
+	float fVsyncToPhotons = session->Perf->GetVsyncToPhotons();
+	float fFrameDuration = 1.0f / session->Perf->GetDisplayFrequency();
+	float AdaptiveGpuPerformanceScale = session->Perf->GetGpuPerformanceScale();
+
+	vr::Compositor_CumulativeStats TotalStats = session->Perf->GetCumulativeStats();
 
 	// Subtract the base stats so we get the cumulative stats since the last call to ovr_ResetPerfStats
 	TotalStats.m_nNumFramePresents -= session->BaseStats.m_nNumFramePresents;
@@ -921,9 +937,6 @@ OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetPerfStats(ovrSession session, ovrPerfStats
 	TotalStats.m_nNumDroppedFramesTimedOut -= session->BaseStats.m_nNumDroppedFramesTimedOut;
 	TotalStats.m_nNumReprojectedFramesTimedOut -= session->BaseStats.m_nNumReprojectedFramesTimedOut;
 
-	float fVsyncToPhotons = vr::VRSystem()->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
-	float fDisplayFrequency = vr::VRSystem()->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
-	float fFrameDuration = 1.0f / fDisplayFrequency;
 	for (int i = 0; i < FrameStatsCount; i++)
 	{
 		ovrPerfStatsPerCompositorFrame& stats = FrameStats[i];
@@ -972,7 +985,7 @@ OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetPerfStats(ovrSession session, ovrPerfStats
 		out->AswIsAvailable = ovrFalse;
 
 		if (g_MinorVersion >= 14)
-			out->VisibleProcessId = vr::VRCompositor()->GetCurrentSceneFocusProcess();
+			out->VisibleProcessId = session->Perf->GetSceneFocusProcess();
 	}
 
 	return ovrSuccess;
@@ -982,7 +995,7 @@ OVR_PUBLIC_FUNCTION(ovrResult) ovr_ResetPerfStats(ovrSession session)
 {
 	REV_TRACE(ovr_ResetPerfStats);
 
-	vr::VRCompositor()->GetCumulativeStats(&session->BaseStats, sizeof(vr::Compositor_CumulativeStats));
+	session->BaseStats = session->Perf->GetCumulativeStats();
 	return ovrSuccess;
 }
 
@@ -995,14 +1008,9 @@ OVR_PUBLIC_FUNCTION(double) ovr_GetPredictedDisplayTime(ovrSession session, long
 	if (session->FrameIndex == 0)
 		return ovr_GetTimeInSeconds();
 
-	double predictAhead = vr::VRCompositor()->GetFrameTimeRemaining();
-	if (session && frameIndex > 0)
-	{
-		// Some applications ask for frames ahead of the current frame
-		rcu_ptr<ovrHmdDesc> pHmd = session->Details->HmdDesc;
-		predictAhead += double(frameIndex - session->FrameIndex) / pHmd->DisplayRefreshRate;
-	}
-	return ovr_GetTimeInSeconds() + predictAhead;
+	// Some applications ask for frames ahead of the current frame
+	long long currentIndex = session->FrameIndex;
+	return session->Pacer->GetPredictedDisplayTime(frameIndex > 0 ? frameIndex : currentIndex, currentIndex);
 }
 
 OVR_PUBLIC_FUNCTION(double) ovr_GetTimeInSeconds()
@@ -10,7 +10,7 @@ OVR_PUBLIC_FUNCTION(ovrResult) ovr_CreateTextureSwapChainGL(ovrSession session,
 {
 	REV_TRACE(ovr_CreateTextureSwapChainGL);
 
-	if (!desc || !out_TextureSwapChain || desc->Type != ovrTexture_2D)
+	if (!desc || !out_TextureSwapChain || (desc->Type != ovrTexture_2D && desc->Type != ovrTexture_Cube))
 		return ovrError_InvalidParameter;
 
 	if (!session->Compositor)
@@ -23,7 +23,8 @@ OVR_PUBLIC_FUNCTION(ovrResult) ovr_CreateTextureSwapChainGL(ovrSession session,
 	if (session->Compositor->GetAPI() != vr::TextureType_OpenGL)
 		return ovrError_RuntimeException;
 
-	return session->Compositor->CreateTextureSwapChain(desc, out_TextureSwapChain);
+	// FIXME: A bug in OpenVR causes Asynchronous Reprojection to fail with swapchains.
+	return session->Compositor->CreateTextureSwapChain(desc, out_TextureSwapChain, 1);
 }
 
 OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetTextureSwapChainBufferGL(ovrSession session,
@@ -6,7 +6,11 @@
 #include "vulkan.h"
 
 #include <Windows.h>
+#include <MinHook.h>
 #include <openvr.h>
+#include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
 
 HMODULE VulkanLibrary;
@@ -19,6 +23,73 @@ VK_DEFINE_FUNCTION(vkEnumeratePhysicalDevices)
 VK_DEFINE_FUNCTION(vkGetPhysicalDeviceMemoryProperties)
 VK_DEFINE_FUNCTION(vkGetPhysicalDeviceProperties2KHR)
 
+// The queues and extensions the application created every device with, Vulkan has no way to query
+// the family of a queue or the extensions that are enabled on a device
+struct DeviceQueues
+{
+	VkDevice Device;
+	uint32_t Family;
+	uint32_t Count;
+};
+
+PFN_vkCreateDevice TrueCreateDevice;
+std::mutex g_deviceQueuesMutex;
+std::vector<DeviceQueues> g_deviceQueues;
+std::vector<std::pair<VkDevice, std::string>> g_deviceExtensions;
+
+VkResult VKAPI_CALL HookCreateDevice(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator, VkDevice* pDevice)
+{
+	VkResult result = TrueCreateDevice(physicalDevice, pCreateInfo, pAllocator, pDevice);
+	if (result != VK_SUCCESS)
+		return result;
+
+	std::lock_guard<std::mutex> lk(g_deviceQueuesMutex);
+	for (uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; i++)
+	{
+		const VkDeviceQueueCreateInfo& info = pCreateInfo->pQueueCreateInfos[i];
+		g_deviceQueues.push_back({ *pDevice, info.queueFamilyIndex, info.queueCount });
+	}
+	for (uint32_t i = 0; i < pCreateInfo->enabledExtensionCount; i++)
+		g_deviceExtensions.push_back(std::make_pair(*pDevice, pCreateInfo->ppEnabledExtensionNames[i]));
+	return result;
+}
+
+bool IsDeviceExtensionEnabled(VkDevice device, const char* extension)
+{
+	std::lock_guard<std::mutex> lk(g_deviceQueuesMutex);
+	for (const auto& enabled : g_deviceExtensions)
+	{
+		if (enabled.first == device && enabled.second == extension)
+			return true;
+	}
+	return false;
+}
+
+uint32_t GetQueueFamilyIndex(VkDevice device, VkQueue queue)
+{
+	PFN_vkGetDeviceQueue vkGetDeviceQueue = (PFN_vkGetDeviceQueue)vkGetDeviceProcAddr(device, "vkGetDeviceQueue");
+	if (!vkGetDeviceQueue)
+		return VK_QUEUE_FAMILY_IGNORED;
+
+	// Only the queues that were created may be retrieved, so compare against those
+	std::lock_guard<std::mutex> lk(g_deviceQueuesMutex);
+	for (const DeviceQueues& queues : g_deviceQueues)
+	{
+		if (queues.Device != device)
+			continue;
+
+		for (uint32_t i = 0; i < queues.Count; i++)
+		{
+			VkQueue created = VK_NULL_HANDLE;
+			vkGetDeviceQueue(device, queues.Family, i, &created);
+			if (created == queue)
+				return queues.Family;
+		}
+	}
+	return VK_QUEUE_FAMILY_IGNORED;
+}
+
 OVR_PUBLIC_FUNCTION(ovrResult)
 ovr_GetInstanceExtensionsVk(
 	ovrGraphicsLuid luid,
@@ -90,6 +161,13 @@ ovr_GetSessionPhysicalDeviceVk(
 	VK_INSTANCE_FUNCTION(instance, vkGetPhysicalDeviceMemoryProperties)
 	VK_INSTANCE_FUNCTION(instance, vkGetPhysicalDeviceProperties2KHR)
 
+	// The application creates its device after querying the physical device, record which queues it creates
+	if (!TrueCreateDevice)
+	{
+		if (MH_CreateHookApi(L"vulkan-1.dll", "vkCreateDevice", HookCreateDevice, (PVOID*)&TrueCreateDevice) == MH_OK)
+			MH_EnableHook(MH_ALL_HOOKS);
+	}
+
 	VkPhysicalDevice physicalDevice = 0;
 	vr::VRSystem()->GetOutputDevice((uint64_t*)&physicalDevice, vr::TextureType_Vulkan, instance);
 
@@ -170,7 +248,7 @@ ovr_CreateTextureSwapChainVk(
 	if (!session)
 		return ovrError_InvalidSession;
 
-	if (!device || !desc || !out_TextureSwapChain || desc->Type != ovrTexture_2D)
+	if (!device || !desc || !out_TextureSwapChain || (desc->Type != ovrTexture_2D && desc->Type != ovrTexture_Cube))
 		return ovrError_InvalidParameter;
 
 	CompositorVk* compositor = dynamic_cast<CompositorVk*>(session->Compositor.get());
@@ -178,7 +256,8 @@ ovr_CreateTextureSwapChainVk(
 	if (!compositor)
 		return ovrError_RuntimeException;
 
-	compositor->SetDevice(device);
+	if (!compositor->SetDevice(device))
+		return ovrError_RuntimeException;
 
 	if (session->Compositor->GetAPI() != vr::TextureType_Vulkan)
 		return ovrError_RuntimeException;
@@ -232,7 +311,8 @@ ovr_CreateMirrorTextureWithOptionsVk(
 	if (!compositor)
 		return ovrError_RuntimeException;
 
-	compositor->SetDevice(device);
+	if (!compositor->SetDevice(device))
+		return ovrError_RuntimeException;
 
 	if (session->Compositor->GetAPI() != vr::TextureType_Vulkan)
 		return ovrError_RuntimeException;
@@ -1,30 +1,41 @@
 #include "Session.h"
 #include "CompositorBase.h"
+#include "FramePacer.h"
 #include "SessionDetails.h"
 #include "InputManager.h"
+#include "PerfManager.h"
 #include "SettingsManager.h"
 #include "Settings.h"
+#include "Trace.h"
+
+#include <chrono>
 
 void SessionThreadFunc(ovrSession session)
 {
-	std::chrono::microseconds freq(std::chrono::milliseconds(10));
+	std::chrono::steady_clock::time_point lastSample;
 	DWORD procId = GetCurrentProcessId();
 
-	while (session->Running)
+	bool activity;
+	do
 	{
+		activity = false;
 		vr::VREvent_t vrEvent;
 		while (vr::VRSystem()->PollNextEvent(&vrEvent, sizeof(vrEvent)))
 		{
+			activity = true;
 			switch (vrEvent.eventType)
 			{
 			case vr::VREvent_TrackedDeviceActivated:
 			case vr::VREvent_TrackedDeviceDeactivated:
 			{
 				vr::ETrackedDeviceClass deviceClass = vr::VRSystem()->GetTrackedDeviceClass(vrEvent.trackedDeviceIndex);
-				if (deviceClass == vr::TrackedDeviceClass_Controller)
+				if (deviceClass == vr::TrackedDeviceClass_Controller || deviceClass == vr::TrackedDeviceClass_GenericTracker)
 					session->Input->UpdateConnectedControllers();
 				else if (deviceClass == vr::TrackedDeviceClass_HMD)
+				{
 					session->Details->UpdateHmdDesc();
+					session->Perf->UpdateDisplayProperties(vr::VRSystem());
+				}
 				else if (deviceClass == vr::TrackedDeviceClass_TrackingReference)
 					session->Details->UpdateTrackerDesc();
 			}
@@ -32,6 +43,17 @@ void SessionThreadFunc(ovrSession session)
 			case vr::VREvent_TrackedDeviceRoleChanged:
 				session->Input->UpdateConnectedControllers();
 			break;
+			case vr::VREvent_PropertyChanged:
+			if (vrEvent.trackedDeviceIndex == vr::k_unTrackedDeviceIndex_Hmd &&
+				(vrEvent.data.property.prop == vr::Prop_DisplayFrequency_Float ||
+				vrEvent.data.property.prop == vr::Prop_SecondsFromVsyncToPhotons_Float))
+			{
+				session->Perf->UpdateDisplayProperties(vr::VRSystem());
+			}
+			break;
+			case vr::VREvent_ChaperoneSettingsHaveChanged:
+				session->Settings->NotifySettingsChanged();
+			break;
 			case vr::VREvent_SceneApplicationChanged:
 			{
 				SessionStatusBits status = session->SessionStatus;
@@ -80,25 +102,41 @@ void SessionThreadFunc(ovrSession session)
 #endif
 		}
 
-		std::this_thread::sleep_for(freq);
-	}
+		// Wakeups can be as frequent as the application polls its status, so sample on a separate timer
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now - lastSample >= std::chrono::milliseconds(REV_SESSION_SAMPLE_INTERVAL))
+		{
+			session->Perf->Sample(vr::VRCompositor());
+			session->Pacer->Sample();
+			lastSample = now;
+		}
+		TracePoll();
+	} while (session->Loop.Wait(activity));
 }
 
 ovrHmdStruct::ovrHmdStruct()
-	: Running(true)
-	, SessionStatus()
+	: SessionStatus()
 	, StringBuffer()
 	, FrameIndex(0)
 	, StatsIndex(0)
 	, BaseStats()
 	, Compositor(nullptr)
 	, Input(new InputManager())
+	, Perf(new PerfManager())
+	, Pacer(new FramePacer(vr::VRCompositor(), vr::VRSystem(), ovr_GetTimeInSeconds))
 	, Details(new SessionDetails())
-	, Settings(new SettingsManager())
+	, Settings(new SettingsManager(vr::VRSettings(), vr::VRApplications()))
 {
 	// Get the default universe origin from the settings
 	TrackingOrigin = (vr::ETrackingUniverseOrigin)Settings->Get<int>(REV_KEY_DEFAULT_ORIGIN, REV_DEFAULT_ORIGIN);
 
+	// Trace recording is opt-in, a threshold in milliseconds dumps the trace on long frames
+	TraceConfigure(Settings->Get<bool>(REV_KEY_TRACE, REV_DEFAULT_TRACE),
+		Settings->Get<float>(REV_KEY_TRACE_THRESHOLD, REV_DEFAULT_TRACE_THRESHOLD));
+
+	Perf->UpdateDisplayProperties(vr::VRSystem());
+	Perf->SetScaleLimits(Details->Profile.GpuUtilization, Details->Profile.MinGpuScale, Details->Profile.MaxGpuScale);
+
 	SessionStatusBits status = {};
 	status.HmdPresent = vr::VR_IsHmdPresent();
 	vr::EDeviceActivityLevel activity = vr::VRSystem()->GetTrackedDeviceActivityLevel(vr::k_unTrackedDeviceIndex_Hmd);
@@ -108,14 +146,14 @@ ovrHmdStruct::ovrHmdStruct()
 	SessionStatus = status;
 
 	std::string script = Settings->GetInputScript();
-	Input->LoadInputScript(script.c_str());
+	Input->LoadInputScript(script.c_str(), Settings->Get<bool>(REV_KEY_NATIVE_INPUT, REV_DEFAULT_NATIVE_INPUT));
 
 	SessionThread = std::thread(SessionThreadFunc, this);
 }
 
 ovrHmdStruct::~ovrHmdStruct()
 {
-	Running = false;
+	Loop.Stop();
 	if (SessionThread.joinable())
 		SessionThread.join();
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "SessionLoop.h"
+
 #include <OVR_CAPI.h>
 #include <openvr.h>
 #include <memory>
@@ -7,9 +9,14 @@
 #include <list>
 #include <thread>
 
+// The frame timings and the vsync are sampled at most this often, since they're queried from the compositor
+#define REV_SESSION_SAMPLE_INTERVAL 10
+
 // Forward declarations
 class CompositorBase;
+class FramePacer;
 class InputManager;
+class PerfManager;
 class SessionDetails;
 class SettingsManager;
 
@@ -27,7 +34,7 @@ struct SessionStatusBits {
 struct ovrHmdStruct
 {
 	std::thread SessionThread;
-	std::atomic_bool Running;
+	SessionLoop Loop;
 
 	// Session status
 	std::atomic<SessionStatusBits> SessionStatus;
@@ -42,9 +49,14 @@ struct ovrHmdStruct
 	// Revive interfaces
 	std::unique_ptr<CompositorBase> Compositor;
 	std::unique_ptr<InputManager> Input;
+	std::unique_ptr<PerfManager> Perf;
+	std::unique_ptr<FramePacer> Pacer;
 	std::unique_ptr<SessionDetails> Details;
 	std::unique_ptr<SettingsManager> Settings;
 
 	ovrHmdStruct();
 	~ovrHmdStruct();
+
+	// Wakes the session thread early, so the session status is fresh on the next query
+	void WakeSessionThread() { Loop.Wake(); }
 };
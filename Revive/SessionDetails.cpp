@@ -3,21 +3,64 @@
 
 #include <Windows.h>
 #include <Shlwapi.h>
+#include <Shlobj.h>
+#include <atlbase.h>
 #include <openvr.h>
 #include <vector>
 #include <memory>
+#include <locale.h>
+#include <stdlib.h>
 
-SessionDetails::HackInfo SessionDetails::m_known_hacks[] = {
+#define REV_PROFILES_FILE L"Profiles.ini"
+
+const SessionDetails::HackInfo SessionDetails::m_known_hacks[] = {
 	{ "drt.exe", nullptr, HACK_WAIT_IN_TRACKING_STATE, false }, // TODO: Fix this hack
 	{ "ultrawings.exe", nullptr, HACK_FAKE_PRODUCT_NAME, true },
 	{ nullptr, "holographic", HACK_SPOOF_SENSORS, true },
 	{ "AirMech.exe", nullptr, HACK_SLEEP_IN_SESSION_STATUS, true }
 };
 
+// Keys of the hacks in the profile database
+const wchar_t* SessionDetails::m_hack_names[] = {
+	L"WaitInTrackingState",
+	L"FakeProductName",
+	L"SpoofSensors",
+	L"ReconstructEyeMatrix",
+	L"SleepInSessionStatus",
+};
+
+// The user's copy in Documents\Revive takes precedence over the sample in the install directory
+static bool GetProfilesPath(wchar_t* path, DWORD length)
+{
+	// The documents folder may not be representable in the ANSI code page
+	CComHeapPtr<wchar_t> documents;
+	if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_Documents, KF_FLAG_DEFAULT, NULL, &documents)))
+	{
+		swprintf(path, length, L"%ls\\Revive\\%ls", (wchar_t*)documents, REV_PROFILES_FILE);
+		if (PathFileExistsW(path))
+			return true;
+	}
+
+	// The installer stores the installation folder in the registry
+	DWORD size = length * sizeof(wchar_t);
+	if (RegGetValueW(HKEY_CURRENT_USER, L"Software\\Revive", NULL, RRF_RT_REG_SZ, NULL, path, &size) != ERROR_SUCCESS)
+		return false;
+	return PathAppendW(path, REV_PROFILES_FILE) && PathFileExistsW(path);
+}
+
+// Profiles are written with a period as the decimal separator, whatever the locale of the application
+static float ParseProfileFloat(const wchar_t* value)
+{
+	static _locale_t locale = _create_locale(LC_NUMERIC, "C");
+	return (float)_wtof_l(value, locale);
+}
+
 SessionDetails::SessionDetails()
-	: HmdDesc()
+	: Profile()
+	, HmdDesc()
 	, TrackerDesc()
 	, TrackerCount(0)
+	, m_hacks()
 {
 	char filepath[MAX_PATH];
 	GetModuleFileNameA(NULL, filepath, MAX_PATH);
@@ -33,9 +76,12 @@ SessionDetails::SessionDetails()
 	{
 		if ((!hack.m_filename || _stricmp(filename, hack.m_filename) == 0) &&
 			(!hack.m_driver || strcmp(driver.data(), hack.m_driver) == 0))
-			m_hacks.emplace(hack.m_hack, hack);
+			m_hacks[hack.m_hack] = hack.m_usehack;
 	}
 
+	// The profile database can override the known hacks without recompiling
+	LoadProfiles(driver.data());
+
 	UpdateHmdDesc();
 	UpdateTrackerDesc();
 }
@@ -44,12 +90,46 @@ SessionDetails::~SessionDetails()
 {
 }
 
-bool SessionDetails::UseHack(Hack hack)
+void SessionDetails::LoadProfiles(const char* driver)
 {
-	auto it = m_hacks.find(hack);
-	if (it == m_hacks.end())
-		return false;
-	return it->second.m_usehack;
+	wchar_t path[MAX_PATH];
+	if (!GetProfilesPath(path, MAX_PATH))
+		return;
+
+	// The executable name may not be representable in the ANSI code page either
+	wchar_t filepath[MAX_PATH];
+	GetModuleFileNameW(NULL, filepath, MAX_PATH);
+	wchar_t* filename = PathFindFileNameW(filepath);
+
+	// OpenVR strings are UTF-8
+	wchar_t tracking[MAX_PATH];
+	if (MultiByteToWideChar(CP_UTF8, 0, driver, -1, tracking, MAX_PATH) == 0)
+		tracking[0] = L'\0';
+
+	// Sections are applied from generic to specific: the driver, the executable and
+	// finally the executable on that driver
+	wchar_t section[MAX_PATH];
+	swprintf(section, MAX_PATH, L"driver:%ls", tracking);
+	LoadProfileSection(path, section);
+	LoadProfileSection(path, filename);
+	swprintf(section, MAX_PATH, L"%ls:%ls", filename, tracking);
+	LoadProfileSection(path, section);
+}
+
+void SessionDetails::LoadProfileSection(const wchar_t* path, const wchar_t* section)
+{
+	static_assert(sizeof(m_hack_names) / sizeof(m_hack_names[0]) == HACK_COUNT, "Every hack needs a key in the profile database");
+
+	for (int i = 0; i < HACK_COUNT; i++)
+		m_hacks[i] = GetPrivateProfileIntW(section, m_hack_names[i], m_hacks[i], path) != 0;
+
+	wchar_t value[32];
+	if (GetPrivateProfileStringW(section, L"GpuUtilization", L"", value, _countof(value), path) > 0)
+		Profile.GpuUtilization = ParseProfileFloat(value);
+	if (GetPrivateProfileStringW(section, L"MinGpuScale", L"", value, _countof(value), path) > 0)
+		Profile.MinGpuScale = ParseProfileFloat(value);
+	if (GetPrivateProfileStringW(section, L"MaxGpuScale", L"", value, _countof(value), path) > 0)
+		Profile.MaxGpuScale = ParseProfileFloat(value);
 }
 
 void SessionDetails::UpdateHmdDesc()
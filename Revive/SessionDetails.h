@@ -1,7 +1,7 @@
 #pragma once
 
-#include <map>
 #include <atomic>
+#include <bitset>
 #include <openvr.h>
 
 #include "OVR_CAPI.h"
@@ -37,12 +37,24 @@ public:
 		// AirMech: Command doesn't properly synchronize their threads and relies on actual API call
 		// timings to keep the game thread in sync with the render thread.
 		HACK_SLEEP_IN_SESSION_STATUS,
+
+		HACK_COUNT
+	};
+
+	// Per-title performance overrides from the profile database, zero keeps the default
+	struct PerfProfile
+	{
+		float GpuUtilization;
+		float MinGpuScale;
+		float MaxGpuScale;
 	};
 
 	SessionDetails();
 	~SessionDetails();
 
-	bool UseHack(Hack hack);
+	bool UseHack(Hack hack) const { return m_hacks[hack]; }
+
+	PerfProfile Profile;
 
 	rcu_ptr<ovrHmdDesc> HmdDesc;
 	rcu_ptr<ovrEyeRenderDesc> RenderDesc[ovrEye_Count];
@@ -61,6 +73,12 @@ private:
 		bool m_usehack;         // Should it use the hack?
 	};
 
-	static HackInfo m_known_hacks[];
-	std::map<Hack, HackInfo> m_hacks;
+	static const HackInfo m_known_hacks[];
+	static const wchar_t* m_hack_names[];
+
+	// Hacks are resolved once, so checking a hack is a single bit test
+	std::bitset<HACK_COUNT> m_hacks;
+
+	void LoadProfiles(const char* driver);
+	void LoadProfileSection(const wchar_t* path, const wchar_t* section);
 };
@@ -0,0 +1,46 @@
+#include "SessionLoop.h"
+#include "microprofile.h"
+
+#include <algorithm>
+
+SessionLoop::SessionLoop()
+	: m_Running(true)
+	, m_Wake(false)
+	, m_Interval(REV_SESSION_MIN_INTERVAL)
+{
+}
+
+bool SessionLoop::Wait(bool activity)
+{
+	if (activity)
+		m_Interval = std::chrono::milliseconds(REV_SESSION_MIN_INTERVAL);
+	else
+		m_Interval = (std::min)(m_Interval * 2, std::chrono::milliseconds(REV_SESSION_MAX_INTERVAL));
+	MICROPROFILE_COUNTER_SET("Session/Interval (ms)", m_Interval.count());
+
+	std::unique_lock<std::mutex> lk(m_Mutex);
+	m_CV.wait_for(lk, m_Interval, [this] { return !m_Running || m_Wake; });
+	m_Wake = false;
+	MICROPROFILE_COUNTER_ADD("Session/Wakeups", 1);
+	return m_Running;
+}
+
+void SessionLoop::Wake()
+{
+	{
+		std::lock_guard<std::mutex> lk(m_Mutex);
+		if (m_Wake)
+			return;
+		m_Wake = true;
+	}
+	m_CV.notify_one();
+}
+
+void SessionLoop::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lk(m_Mutex);
+		m_Running = false;
+	}
+	m_CV.notify_one();
+}
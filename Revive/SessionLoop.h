@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// The session thread polls events fast after activity and backs off exponentially while idle
+#define REV_SESSION_MIN_INTERVAL 1
+#define REV_SESSION_MAX_INTERVAL 64
+
+/*
+	Paces the polling of the session thread. Events tend to come in bursts, so it polls fast after
+	activity and backs off while idle. Other threads can wake it early, e.g. so the session status
+	is fresh when the application queries it.
+*/
+class SessionLoop
+{
+public:
+	SessionLoop();
+
+	// Blocks until the next poll is due, returns false once the loop is stopped
+	bool Wait(bool activity);
+
+	// Ends the current wait early, multiple wakes before the next poll are coalesced
+	void Wake();
+	void Stop();
+
+	std::chrono::milliseconds GetInterval() const { return m_Interval; }
+
+private:
+	std::mutex m_Mutex;
+	std::condition_variable m_CV;
+	bool m_Running;
+	bool m_Wake;
+	std::chrono::milliseconds m_Interval;
+};
@@ -51,3 +51,12 @@ enum revGripType
 
 #define REV_KEY_INPUT_SCRIPT				"InputScript"
 #define REV_DEFAULT_INPUT_SCRIPT			"default.lua"
+
+#define REV_KEY_NATIVE_INPUT				"NativeInput"
+#define REV_DEFAULT_NATIVE_INPUT			true
+
+#define REV_KEY_TRACE						"Trace"
+#define REV_DEFAULT_TRACE					false
+
+#define REV_KEY_TRACE_THRESHOLD				"TraceThreshold"
+#define REV_DEFAULT_TRACE_THRESHOLD			0.0f
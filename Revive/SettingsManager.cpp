@@ -9,59 +9,92 @@
 
 void SettingsManager::SettingThreadFunc(SettingsManager* settings)
 {
+	std::unique_lock<std::mutex> lk(settings->m_Mutex);
 	while (settings->m_Running)
 	{
-		std::chrono::microseconds freq(std::chrono::milliseconds(100));
+		// Polling is only needed until the first change event, after that the events are enough
+		auto woken = [settings] { return !settings->m_Running || settings->m_Pending; };
+		if (settings->m_Notified)
+			settings->m_CV.wait(lk, woken);
+		else
+			settings->m_CV.wait_for(lk, settings->m_PollInterval, woken);
+		if (!settings->m_Running)
+			break;
+		settings->m_Pending = false;
+
+		lk.unlock();
 		settings->ReloadSettings();
-		std::this_thread::sleep_for(freq);
+		lk.lock();
 	}
 }
 
-SettingsManager::SettingsManager()
+SettingsManager::SettingsManager(vr::IVRSettings* settings, vr::IVRApplications* applications, std::chrono::milliseconds pollInterval)
 	: Input(std::make_shared<InputSettings>())
+	, m_Settings(settings)
 	, m_WorkingCopy(std::make_shared<InputSettings>())
 	, m_Section()
+	, m_Values()
+	, m_Loaded(false)
 	, m_Running(true)
+	, m_Pending(false)
+	, m_Notified(false)
+	, m_PollInterval(pollInterval)
 {
 	DWORD procId = GetCurrentProcessId();
-	vr::EVRApplicationError err = vr::VRApplications()->GetApplicationKeyByProcessId(procId, m_Section, vr::k_unMaxApplicationKeyLength);
+	vr::EVRApplicationError err = applications->GetApplicationKeyByProcessId(procId, m_Section, vr::k_unMaxApplicationKeyLength);
 	if (err != vr::VRApplicationError_None)
 		strcpy(m_Section, REV_SETTINGS_SECTION);
 
+	// Load the settings before the first frame, the thread only picks up changes
+	ReloadSettings();
 	m_Thread = std::thread(SettingThreadFunc, this);
 }
 
 SettingsManager::~SettingsManager()
 {
-	m_Running = false;
+	{
+		std::lock_guard<std::mutex> lk(m_Mutex);
+		m_Running = false;
+	}
+	m_CV.notify_one();
 	if (m_Thread.joinable())
 		m_Thread.join();
 }
 
+void SettingsManager::NotifySettingsChanged()
+{
+	{
+		std::lock_guard<std::mutex> lk(m_Mutex);
+		m_Pending = true;
+		m_Notified = true;
+	}
+	m_CV.notify_one();
+}
+
 template<> float SettingsManager::Get<float>(const char* key, float defaultVal)
 {
 	vr::EVRSettingsError err;
-	float result = vr::VRSettings()->GetFloat(m_Section, key, &err);
+	float result = m_Settings->GetFloat(m_Section, key, &err);
 	if (err != vr::VRSettingsError_None)
-		result = vr::VRSettings()->GetFloat(REV_SETTINGS_SECTION, key, &err);
+		result = m_Settings->GetFloat(REV_SETTINGS_SECTION, key, &err);
 	return err == vr::VRSettingsError_None ? result : defaultVal;
 }
 
 template<> int SettingsManager::Get<int>(const char* key, int defaultVal)
 {
 	vr::EVRSettingsError err;
-	int result = vr::VRSettings()->GetInt32(m_Section, key, &err);
+	int result = m_Settings->GetInt32(m_Section, key, &err);
 	if (err != vr::VRSettingsError_None)
-		result = vr::VRSettings()->GetInt32(REV_SETTINGS_SECTION, key, &err);
+		result = m_Settings->GetInt32(REV_SETTINGS_SECTION, key, &err);
 	return err == vr::VRSettingsError_None ? result : defaultVal;
 }
 
 template<> bool SettingsManager::Get<bool>(const char* key, bool defaultVal)
 {
 	vr::EVRSettingsError err;
-	bool result = vr::VRSettings()->GetBool(m_Section, key, &err);
+	bool result = m_Settings->GetBool(m_Section, key, &err);
 	if (err != vr::VRSettingsError_None)
-		result = vr::VRSettings()->GetBool(REV_SETTINGS_SECTION, key, &err);
+		result = m_Settings->GetBool(REV_SETTINGS_SECTION, key, &err);
 	return err == vr::VRSettingsError_None ? result : defaultVal;
 }
 
@@ -69,36 +102,49 @@ template<> const char* SettingsManager::Get<const char*>(const char* key, const
 {
 	vr::EVRSettingsError err;
 	static char result[MAX_PATH]; // TODO: Support larger string sizes
-	vr::VRSettings()->GetString(m_Section, key, result, MAX_PATH, &err);
+	m_Settings->GetString(m_Section, key, result, MAX_PATH, &err);
 	if (err != vr::VRSettingsError_None)
-		vr::VRSettings()->GetString(REV_SETTINGS_SECTION, key, result, MAX_PATH, &err);
+		m_Settings->GetString(REV_SETTINGS_SECTION, key, result, MAX_PATH, &err);
 	return err == vr::VRSettingsError_None ? result : defaultVal;
 }
 
 void SettingsManager::ReloadSettings()
 {
-	m_WorkingCopy->Deadzone = Get<float>(REV_KEY_THUMB_DEADZONE, REV_DEFAULT_THUMB_DEADZONE);
-	m_WorkingCopy->ToggleGrip = (revGripType)Get<int>(REV_KEY_TOGGLE_GRIP, REV_DEFAULT_TOGGLE_GRIP);
-	m_WorkingCopy->ToggleDelay = Get<float>(REV_KEY_TOGGLE_DELAY, REV_DEFAULT_TOGGLE_DELAY);
-	m_WorkingCopy->TriggerAsGrip = Get<bool>(REV_KEY_TRIGGER_GRIP, REV_DEFAULT_TRIGGER_GRIP);
+	InputValues values;
+	values.Deadzone = Get<float>(REV_KEY_THUMB_DEADZONE, REV_DEFAULT_THUMB_DEADZONE);
+	values.ToggleGrip = Get<int>(REV_KEY_TOGGLE_GRIP, REV_DEFAULT_TOGGLE_GRIP);
+	values.ToggleDelay = Get<float>(REV_KEY_TOGGLE_DELAY, REV_DEFAULT_TOGGLE_DELAY);
+	values.TriggerAsGrip = Get<bool>(REV_KEY_TRIGGER_GRIP, REV_DEFAULT_TRIGGER_GRIP);
+	values.Angles[0] = Get<float>(REV_KEY_TOUCH_PITCH, REV_DEFAULT_TOUCH_PITCH);
+	values.Angles[1] = Get<float>(REV_KEY_TOUCH_YAW, REV_DEFAULT_TOUCH_YAW);
+	values.Angles[2] = Get<float>(REV_KEY_TOUCH_ROLL, REV_DEFAULT_TOUCH_ROLL);
+	values.Offset[0] = Get<float>(REV_KEY_TOUCH_X, REV_DEFAULT_TOUCH_X);
+	values.Offset[1] = Get<float>(REV_KEY_TOUCH_Y, REV_DEFAULT_TOUCH_Y);
+	values.Offset[2] = Get<float>(REV_KEY_TOUCH_Z, REV_DEFAULT_TOUCH_Z);
+
+	// Don't rebuild the settings if nothing changed, swapping blocks the readers
+	if (m_Loaded && memcmp(&values, &m_Values, sizeof(InputValues)) == 0)
+		return;
+	m_Values = values;
+	m_Loaded = true;
+
+	m_WorkingCopy->Deadzone = values.Deadzone;
+	m_WorkingCopy->ToggleGrip = (revGripType)values.ToggleGrip;
+	m_WorkingCopy->ToggleDelay = values.ToggleDelay;
+	m_WorkingCopy->TriggerAsGrip = values.TriggerAsGrip != 0;
 
 	OVR::Vector3f angles(
-		OVR::DegreeToRad(Get<float>(REV_KEY_TOUCH_PITCH, REV_DEFAULT_TOUCH_PITCH)),
-		OVR::DegreeToRad(Get<float>(REV_KEY_TOUCH_YAW, REV_DEFAULT_TOUCH_YAW)),
-		OVR::DegreeToRad(Get<float>(REV_KEY_TOUCH_ROLL, REV_DEFAULT_TOUCH_ROLL))
-	);
-	OVR::Vector3f offset(
-		Get<float>(REV_KEY_TOUCH_X, REV_DEFAULT_TOUCH_X),
-		Get<float>(REV_KEY_TOUCH_Y, REV_DEFAULT_TOUCH_Y),
-		Get<float>(REV_KEY_TOUCH_Z, REV_DEFAULT_TOUCH_Z)
+		OVR::DegreeToRad(values.Angles[0]),
+		OVR::DegreeToRad(values.Angles[1]),
+		OVR::DegreeToRad(values.Angles[2])
 	);
+	OVR::Vector3f offset(values.Offset[0], values.Offset[1], values.Offset[2]);
 
+	OVR::Matrix4f yaw = OVR::Matrix4f::RotationY(angles.y);
+	OVR::Matrix4f pitch = OVR::Matrix4f::RotationX(angles.x);
+	OVR::Matrix4f roll = OVR::Matrix4f::RotationZ(angles.z);
 	for (int i = 0; i < ovrHand_Count; i++)
 	{
-		OVR::Matrix4f yaw = OVR::Matrix4f::RotationY(angles.y);
-		OVR::Matrix4f pitch = OVR::Matrix4f::RotationX(angles.x);
-		OVR::Matrix4f roll = OVR::Matrix4f::RotationZ(angles.z);
-
 		// Mirror the right touch controller offsets
 		if (i == ovrHand_Right)
 		{
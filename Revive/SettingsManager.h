@@ -2,12 +2,19 @@
 
 #include <list>
 #include <atomic>
+#include <chrono>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "rcu_ptr.h"
 
 #include <openvr.h>
 #include <OVR_CAPI.h>
 
+// Settings in the application section don't send change events, so they're still polled slowly
+// until a change event shows that the settings are written by something that does send them
+#define REV_SETTINGS_POLL_INTERVAL 10000
+
 // Forward declarations
 enum revGripType;
 
@@ -23,20 +30,41 @@ struct InputSettings
 class SettingsManager
 {
 public:
-	SettingsManager();
+	SettingsManager(vr::IVRSettings* settings, vr::IVRApplications* applications,
+		std::chrono::milliseconds pollInterval = std::chrono::milliseconds(REV_SETTINGS_POLL_INTERVAL));
 	~SettingsManager();
 
 	void ReloadSettings();
+	void NotifySettingsChanged();
 	std::string GetInputScript();
 	template<typename T> T Get(const char* key, T defaultVal);
 
 	rcu_ptr<InputSettings> Input;
 
 private:
+	vr::IVRSettings* m_Settings;
 	char m_Section[vr::k_unMaxApplicationKeyLength];
 	std::shared_ptr<InputSettings> m_WorkingCopy;
 
+	// Raw values of the input settings, the input settings are only rebuilt when these change
+	struct InputValues
+	{
+		float Deadzone;
+		int ToggleGrip;
+		float ToggleDelay;
+		int TriggerAsGrip;
+		float Angles[3];
+		float Offset[3];
+	};
+	InputValues m_Values;
+	bool m_Loaded;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_CV;
 	bool m_Running;
+	bool m_Pending;
+	bool m_Notified;
+	std::chrono::milliseconds m_PollInterval;
 	std::thread m_Thread;
 
 	bool FileExists(const char* path);
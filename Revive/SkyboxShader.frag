@@ -0,0 +1,19 @@
+#version 450
+
+layout(push_constant) uniform SkyboxFace
+{
+	layout(offset = 32) vec4 Right;
+	vec4 Up;
+	vec4 Forward;
+} face;
+
+layout(set = 0, binding = 0) uniform samplerCube cube;
+
+layout(location = 0) in vec2 tex;
+layout(location = 0) out vec4 color;
+
+void main()
+{
+	vec2 ndc = vec2(tex.x * 2.0 - 1.0, 1.0 - tex.y * 2.0);
+	color = texture(cube, face.Forward.xyz + ndc.x * face.Right.xyz + ndc.y * face.Up.xyz);
+}
@@ -0,0 +1,21 @@
+TextureCube cube : register(t0);
+
+SamplerState CubeSampler
+{
+	Filter = MIN_MAG_MIP_LINEAR;
+	AddressU = Clamp;
+	AddressV = Clamp;
+};
+
+cbuffer SkyboxFace : register(b0)
+{
+	float4 Right;
+	float4 Up;
+	float4 Forward;
+};
+
+float4 main(in float4 pos : SV_POSITION, in float2 tex : TEXCOORD0) : SV_TARGET
+{
+	float2 ndc = float2(tex.x * 2.0f - 1.0f, 1.0f - tex.y * 2.0f);
+	return cube.Sample(CubeSampler, Forward.xyz + ndc.x * Right.xyz + ndc.y * Up.xyz);
+}
@@ -0,0 +1,19 @@
+#version 450
+
+// The quad is given as the left, right, top and bottom edges in normalized device coordinates
+// with the y-axis pointing up, the bounds as the minimum and maximum texture coordinates.
+layout(push_constant) uniform Layer
+{
+	vec4 Quad;
+	vec4 Bounds;
+} layer;
+
+layout(location = 0) out vec2 tex;
+
+void main()
+{
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+	vec2 pos = vec2(mix(layer.Quad.x, layer.Quad.y, corner.x), mix(layer.Quad.z, layer.Quad.w, corner.y));
+	tex = mix(layer.Bounds.xy, layer.Bounds.zw, corner);
+	gl_Position = vec4(pos.x, -pos.y, 0.0, 1.0);
+}
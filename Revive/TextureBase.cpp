@@ -5,8 +5,10 @@ ovrTextureSwapChainData::ovrTextureSwapChainData(ovrTextureSwapChainDesc desc)
 	, Identifier(0)
 	, CurrentIndex(0)
 	, SubmitIndex(0)
+	, CommitCount(0)
 	, Desc(desc)
 	, Overlay(vr::k_ulOverlayHandleInvalid)
+	, LastOverlay()
 	, Textures()
 {
 }
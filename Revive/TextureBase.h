@@ -1,7 +1,9 @@
 #pragma once
 
 #include "OVR_CAPI.h"
+#include "OverlayState.h"
 #include "openvr.h"
+#include "Trace.h"
 
 #include <memory>
 
@@ -16,20 +18,41 @@ public:
 	virtual vr::VRTextureWithPose_t ToVRTexture() = 0;
 	virtual bool Init(ovrTextureType type, int width, int height, int mipLevels, int arraySize,
 		ovrTextureFormat format, unsigned int miscFlags, unsigned int bindFlags) = 0;
+
+	// Completion fence, signaled once the GPU is done with all work the compositor queued for the texture.
+	// The application waits on the fence before it renders to the texture again, this doesn't block the CPU.
+	virtual void SignalFence() { }
+	virtual bool FenceSignaled() { return true; }
+	virtual void WaitFence() { }
 };
 
 struct ovrTextureSwapChainData
 {
 	ovrTextureSwapChainDesc Desc;
 	vr::VROverlayHandle_t Overlay;
+	OverlayState LastOverlay;
 
 	unsigned int Identifier;
 	int Length, CurrentIndex, SubmitIndex;
+	unsigned int CommitCount;
 	std::unique_ptr<TextureBase> Textures[REV_SWAPCHAIN_MAX_LENGTH];
 
-	bool Full() { return (CurrentIndex + 1) % Length == SubmitIndex; }
-	void Commit() { CurrentIndex++; CurrentIndex %= Length; };
-	void Submit() { SubmitIndex = CurrentIndex; };
+	// The swapchain is only full while the compositor still owns the next texture. A single texture
+	// is shared with the compositor, so it never fills up.
+	bool Full() { return Length > 1 && !Textures[(CurrentIndex + 1) % Length]->FenceSignaled(); }
+
+	// The committed texture is always the one the compositor submits next. If the application gets ahead
+	// of the compositor, it replaces the frame that is still pending and that texture is rendered to again.
+	void Commit()
+	{
+		REV_TRACE_SCOPE("Commit");
+
+		SubmitIndex = CurrentIndex;
+		CurrentIndex++;
+		CurrentIndex %= Length;
+		CommitCount++;
+		Textures[CurrentIndex]->WaitFence();
+	};
 
 	ovrTextureSwapChainData(ovrTextureSwapChainDesc desc);
 	~ovrTextureSwapChainData();
@@ -9,6 +9,7 @@ TextureD3D::TextureD3D(ID3D11Device* pDevice)
 	, m_data()
 	, m_pDevice12()
 	, m_pQueue()
+	, m_FenceValue(0)
 {
 }
 
@@ -17,6 +18,7 @@ TextureD3D::TextureD3D(ID3D12CommandQueue* pQueue)
 	, m_data()
 	, m_pDevice12()
 	, m_pQueue(pQueue)
+	, m_FenceValue(0)
 {
 	m_pQueue->GetDevice(IID_PPV_ARGS(&m_pDevice12));
 	m_data.m_pCommandQueue = m_pQueue.Get();
@@ -44,6 +46,43 @@ vr::VRTextureWithPose_t TextureD3D::ToVRTexture()
 	return texture;
 }
 
+void TextureD3D::SignalFence()
+{
+	if (m_pDevice12)
+	{
+		if (!m_pFence && FAILED(m_pDevice12->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_pFence))))
+			return;
+		m_pQueue->Signal(m_pFence.Get(), ++m_FenceValue);
+	}
+	else
+	{
+		if (!m_pQuery)
+		{
+			D3D11_QUERY_DESC desc = { D3D11_QUERY_EVENT, 0 };
+			if (FAILED(m_pDevice->CreateQuery(&desc, m_pQuery.GetAddressOf())))
+				return;
+		}
+
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+		m_pDevice->GetImmediateContext(context.GetAddressOf());
+		context->End(m_pQuery.Get());
+	}
+}
+
+bool TextureD3D::FenceSignaled()
+{
+	if (m_pDevice12)
+		return !m_pFence || m_pFence->GetCompletedValue() >= m_FenceValue;
+
+	if (!m_pQuery)
+		return true;
+
+	// Don't flush, the compositor flushes the fences at the end of the frame
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	m_pDevice->GetImmediateContext(context.GetAddressOf());
+	return context->GetData(m_pQuery.Get(), nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK;
+}
+
 DXGI_FORMAT TextureD3D::TextureFormatToDXGIFormat(ovrTextureFormat format, bool typeless)
 {
 	if (typeless)
@@ -179,6 +218,11 @@ bool TextureD3D::Init(ovrTextureType type, int Width, int Height, int MipLevels,
 	ovrTextureFormat Format, unsigned int MiscFlags, unsigned int BindFlags)
 {
 	const bool typeless = MiscFlags & ovrTextureMisc_DX_Typeless || BindFlags & ovrTextureBind_DX_DepthStencil;
+	const bool cube = type == ovrTexture_Cube;
+
+	// Cube maps always have six faces
+	if (cube)
+		ArraySize = 6;
 
 	if (m_pDevice12)
 	{
@@ -235,6 +279,8 @@ bool TextureD3D::Init(ovrTextureType type, int Width, int Height, int MipLevels,
 		desc.BindFlags = BindFlagsToD3DBindFlags(BindFlags);
 		desc.CPUAccessFlags = 0;
 		desc.MiscFlags = MiscFlagsToD3DMiscFlags(MiscFlags);
+		if (cube)
+			desc.MiscFlags |= D3D11_RESOURCE_MISC_TEXTURECUBE;
 
 		HRESULT hr = m_pDevice->CreateTexture2D(&desc, nullptr, m_pTexture.GetAddressOf());
 		if (FAILED(hr))
@@ -245,9 +291,18 @@ bool TextureD3D::Init(ovrTextureType type, int Width, int Height, int MipLevels,
 	{
 		D3D11_SHADER_RESOURCE_VIEW_DESC desc = {};
 		desc.Format = TextureFormatToDXGIFormat(Format);
-		desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		desc.Texture2D.MipLevels = -1;
-		desc.Texture2D.MostDetailedMip = 0;
+		if (cube)
+		{
+			desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+			desc.TextureCube.MipLevels = -1;
+			desc.TextureCube.MostDetailedMip = 0;
+		}
+		else
+		{
+			desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+			desc.Texture2D.MipLevels = -1;
+			desc.Texture2D.MostDetailedMip = 0;
+		}
 		HRESULT hr = m_pDevice->CreateShaderResourceView(m_pTexture.Get(), &desc, m_pSRV.GetAddressOf());
 		if (FAILED(hr))
 			return false;
@@ -257,8 +312,18 @@ bool TextureD3D::Init(ovrTextureType type, int Width, int Height, int MipLevels,
 	{
 		D3D11_RENDER_TARGET_VIEW_DESC target_desc = {};
 		target_desc.Format = TextureFormatToDXGIFormat(Format);
-		target_desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-		target_desc.Texture2D.MipSlice = 0;
+		if (cube)
+		{
+			target_desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2DARRAY;
+			target_desc.Texture2DArray.MipSlice = 0;
+			target_desc.Texture2DArray.FirstArraySlice = 0;
+			target_desc.Texture2DArray.ArraySize = ArraySize;
+		}
+		else
+		{
+			target_desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+			target_desc.Texture2D.MipSlice = 0;
+		}
 		HRESULT hr = m_pDevice->CreateRenderTargetView(m_pTexture.Get(), &target_desc, m_pRTV.GetAddressOf());
 		if (FAILED(hr))
 			return false;
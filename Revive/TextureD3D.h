@@ -16,6 +16,8 @@ public:
 	virtual vr::VRTextureWithPose_t ToVRTexture();
 	virtual bool Init(ovrTextureType type, int Width, int Height, int MipLevels, int ArraySize,
 		ovrTextureFormat Format, unsigned int MiscFlags, unsigned int BindFlags);
+	virtual void SignalFence();
+	virtual bool FenceSignaled();
 
 	IUnknown* Texture() { if (m_pDevice) return m_pTexture.Get(); else return m_pResource12.Get(); };
 	ID3D11ShaderResourceView* Resource() { return m_pSRV.Get(); };
@@ -33,10 +35,13 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_pTexture;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pSRV;
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_pRTV;
+	Microsoft::WRL::ComPtr<ID3D11Query> m_pQuery;
 
 	// DirectX 12
 	vr::D3D12TextureData_t m_data;
 	Microsoft::WRL::ComPtr<ID3D12Device> m_pDevice12;
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_pResource12;
 	Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_pQueue;
+	Microsoft::WRL::ComPtr<ID3D12Fence> m_pFence;
+	UINT64 m_FenceValue;
 };
@@ -5,11 +5,13 @@
 TextureGL::TextureGL()
 	: Texture(0)
 	, Framebuffer(0)
+	, Fence(nullptr)
 {
 }
 
 TextureGL::~TextureGL()
 {
+	glDeleteSync(Fence);
 	glDeleteFramebuffers(1, &Framebuffer);
 	glDeleteTextures(1, &Texture);
 }
@@ -25,6 +27,32 @@ vr::VRTextureWithPose_t TextureGL::ToVRTexture()
 	return texture;
 }
 
+void TextureGL::SignalFence()
+{
+	glDeleteSync(Fence);
+	Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool TextureGL::FenceSignaled()
+{
+	if (!Fence)
+		return true;
+
+	return glClientWaitSync(Fence, 0, 0) != GL_TIMEOUT_EXPIRED;
+}
+
+void TextureGL::WaitFence()
+{
+	if (!Fence)
+		return;
+
+	// Make the server wait for the fence, the commands of the current context won't
+	// execute until the compositor is done with the texture.
+	glWaitSync(Fence, 0, GL_TIMEOUT_IGNORED);
+	glDeleteSync(Fence);
+	Fence = nullptr;
+}
+
 GLenum TextureGL::TextureFormatToInternalFormat(ovrTextureFormat format)
 {
 	switch (format)
@@ -77,20 +105,20 @@ bool TextureGL::Init(ovrTextureType type, int Width, int Height, int MipLevels,
 	GLenum internalFormat = TextureFormatToInternalFormat(Format);
 	GLenum format = TextureFormatToGLFormat(Format);
 
-	glGenTextures(1, &Texture);
-	glBindTexture(GL_TEXTURE_2D, Texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, Width, Height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+	GLenum target = type == ovrTexture_Cube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
 
-	if (BindFlags & ovrTextureBind_DX_RenderTarget)
+	glGenTextures(1, &Texture);
+	glBindTexture(target, Texture);
+	glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+	if (type == ovrTexture_Cube)
+	{
+		for (GLenum face = 0; face < 6; face++)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, internalFormat, Width, Height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+	}
+	else
 	{
-		glGenFramebuffers(1, &Framebuffer);
-		glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, Texture, 0);
-		glReadBuffer(GL_COLOR_ATTACHMENT0);
-		glDrawBuffer(GL_COLOR_ATTACHMENT0);
-		return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, Width, Height, 0, format, GL_UNSIGNED_BYTE, nullptr);
 	}
 
 	return true;
@@ -14,9 +14,13 @@ public:
 	virtual vr::VRTextureWithPose_t ToVRTexture();
 	virtual bool Init(ovrTextureType type, int Width, int Height, int MipLevels, int ArraySize,
 		ovrTextureFormat Format, unsigned int MiscFlags, unsigned int BindFlags);
+	virtual void SignalFence();
+	virtual bool FenceSignaled();
+	virtual void WaitFence();
 
 	GLuint Texture;
-	GLuint Framebuffer;
+	GLuint Framebuffer; // Created by the compositor when the texture is first rendered to
+	GLsync Fence;
 
 protected:
 	static GLenum TextureFormatToInternalFormat(ovrTextureFormat format);
@@ -2,11 +2,16 @@
 #include "vulkan.h" 
 
 TextureVk::TextureVk(VkDevice device, VkPhysicalDevice physicalDevice,
-	VkInstance instance, VkQueue* pQueue)
+	VkInstance instance, VkQueue* pQueue, std::shared_ptr<AllocatorVk> allocator)
 	: m_data()
 	, m_image()
-	, m_memory()
-	, m_memoryProperties()
+	, m_allocation()
+	, m_allocator(allocator)
+	, m_format(VK_FORMAT_UNDEFINED)
+	, m_extent()
+	, m_cube(false)
+	, m_view()
+	, m_framebuffer()
 	, m_device(device)
 	, m_pQueue(pQueue)
 {
@@ -14,14 +19,19 @@ TextureVk::TextureVk(VkDevice device, VkPhysicalDevice physicalDevice,
 	m_data.m_pDevice = device;
 	m_data.m_pPhysicalDevice = physicalDevice;
 	m_data.m_pInstance = instance;
-
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
 }
 
 TextureVk::~TextureVk()
 {
-	vkFreeMemory(m_device, m_memory, nullptr);
+	if (m_fence)
+		m_fence->Wait();
+	if (m_framebuffer)
+		vkDestroyFramebuffer(m_device, m_framebuffer, nullptr);
+	if (m_view)
+		vkDestroyImageView(m_device, m_view, nullptr);
 	vkDestroyImage(m_device, m_image, nullptr);
+	if (m_allocation.Memory)
+		m_allocator->Free(m_allocation);
 }
 
 vr::VRTextureWithPose_t TextureVk::ToVRTexture()
@@ -78,7 +88,7 @@ VkFormat TextureVk::TextureFormatToVkFormat(ovrTextureFormat format)
 
 VkImageUsageFlags TextureVk::BindFlagsToVkImageUsageFlags(unsigned int flags)
 {
-	VkImageUsageFlags result = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	VkImageUsageFlags result = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 	if (flags & ovrTextureBind_DX_RenderTarget)
 		result |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 	if (flags & ovrTextureBind_DX_UnorderedAccess)
@@ -88,35 +98,24 @@ VkImageUsageFlags TextureVk::BindFlagsToVkImageUsageFlags(unsigned int flags)
 	return result;
 }
 
-bool TextureVk::GetMemoryType(uint32_t typeBits, VkFlags requirements_mask, uint32_t* typeIndex)
-{
-	// Search memtypes to find first index with those properties
-	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
-		if ((typeBits & 1) == 1) {
-			// Type is available, does it match user properties?
-			if ((m_memoryProperties.memoryTypes[i].propertyFlags & requirements_mask) == requirements_mask) {
-				*typeIndex = i;
-				return true;
-			}
-		}
-		typeBits >>= 1;
-	}
-	// No memory types matched, return failure
-	return false;
-}
-
 bool TextureVk::Init(ovrTextureType type, int Width, int Height, int MipLevels, int ArraySize,
 	ovrTextureFormat Format, unsigned int MiscFlags, unsigned int BindFlags)
 {
 	VK_DEVICE_FUNCTION(m_device, vkCreateImage)
-	VK_DEVICE_FUNCTION(m_device, vkGetImageMemoryRequirements)
-	VK_DEVICE_FUNCTION(m_device, vkAllocateMemory)
-	VK_DEVICE_FUNCTION(m_device, vkBindImageMemory)
-	VK_DEVICE_FUNCTION(m_device, vkFreeMemory)
 	VK_DEVICE_FUNCTION(m_device, vkDestroyImage)
+	VK_DEVICE_FUNCTION(m_device, vkCreateImageView)
+	VK_DEVICE_FUNCTION(m_device, vkDestroyImageView)
+	VK_DEVICE_FUNCTION(m_device, vkCreateFramebuffer)
+	VK_DEVICE_FUNCTION(m_device, vkDestroyFramebuffer)
+
+	// Cube maps always have six faces
+	m_cube = type == ovrTexture_Cube;
+	if (m_cube)
+		ArraySize = 6;
 
 	VkImageCreateInfo create_info = {};
 	create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	create_info.flags = m_cube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
 	create_info.imageType = VK_IMAGE_TYPE_2D;
 	create_info.format = TextureFormatToVkFormat(Format);
 	create_info.extent.width = Width;
@@ -132,20 +131,12 @@ bool TextureVk::Init(ovrTextureType type, int Width, int Height, int MipLevels,
 	if (vkCreateImage(m_device, &create_info, nullptr, &m_image) != VK_SUCCESS)
 		return false;
 
-	VkMemoryRequirements memReqs = {};
-	vkGetImageMemoryRequirements(m_device, m_image, &memReqs);
-
-	VkMemoryAllocateInfo memAlloc = {};
-	memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memAlloc.allocationSize = memReqs.size;
-	if (!GetMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAlloc.memoryTypeIndex))
+	if (!m_allocator->AllocateImage(m_image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_allocation))
 		return false;
 
-	if (vkAllocateMemory(m_device, &memAlloc, nullptr, &m_memory) != VK_SUCCESS)
-		return false;
-
-	if (vkBindImageMemory(m_device, m_image, m_memory, 0) != VK_SUCCESS)
-		return false;
+	m_format = create_info.format;
+	m_extent.width = create_info.extent.width;
+	m_extent.height = create_info.extent.height;
 
 	// Update texture data
 	m_data.m_nImage = (uint64_t)m_image;
@@ -156,3 +147,53 @@ bool TextureVk::Init(ovrTextureType type, int Width, int Height, int MipLevels,
 
 	return true;
 }
+
+VkImageView TextureVk::View()
+{
+	if (m_view)
+		return m_view;
+
+	VkImageViewCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	create_info.image = m_image;
+	create_info.viewType = m_cube ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D;
+	create_info.format = m_format;
+	create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	create_info.subresourceRange.baseMipLevel = 0;
+	create_info.subresourceRange.levelCount = 1;
+	create_info.subresourceRange.baseArrayLayer = 0;
+	create_info.subresourceRange.layerCount = m_cube ? 6 : 1;
+
+	if (vkCreateImageView(m_device, &create_info, nullptr, &m_view) != VK_SUCCESS)
+		m_view = VK_NULL_HANDLE;
+	return m_view;
+}
+
+VkFramebuffer TextureVk::Framebuffer(VkRenderPass renderPass)
+{
+	// Render passes for the same format are compatible, so a single framebuffer is enough
+	if (m_framebuffer)
+		return m_framebuffer;
+
+	VkImageView view = View();
+	if (!view)
+		return VK_NULL_HANDLE;
+
+	VkFramebufferCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	create_info.renderPass = renderPass;
+	create_info.attachmentCount = 1;
+	create_info.pAttachments = &view;
+	create_info.width = m_extent.width;
+	create_info.height = m_extent.height;
+	create_info.layers = 1;
+
+	if (vkCreateFramebuffer(m_device, &create_info, nullptr, &m_framebuffer) != VK_SUCCESS)
+		m_framebuffer = VK_NULL_HANDLE;
+	return m_framebuffer;
+}
+
+bool TextureVk::FenceSignaled()
+{
+	return !m_fence || m_fence->Signaled();
+}
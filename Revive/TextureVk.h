@@ -1,43 +1,61 @@
 #pragma once
 
 #include "TextureBase.h"
+#include "AllocatorVk.h"
 #include "CompositorVk.h"
 #include "vulkan.h"
 
 #include <openvr.h>
+#include <memory>
+#include <vector>
 
 class TextureVk :
 	public TextureBase
 {
 public:
 	TextureVk(VkDevice device, VkPhysicalDevice physicalDevice,
-		VkInstance instance, VkQueue* pQueue);
+		VkInstance instance, VkQueue* pQueue, std::shared_ptr<AllocatorVk> allocator);
 	virtual ~TextureVk();
 
 	virtual vr::VRTextureWithPose_t ToVRTexture();
 	virtual bool Init(ovrTextureType type, int Width, int Height, int MipLevels, int ArraySize,
 		ovrTextureFormat Format, unsigned int MiscFlags, unsigned int BindFlags);
+	virtual bool FenceSignaled();
+
+	// The compositor signals a single fence for all textures submitted in a frame
+	void SetFence(std::shared_ptr<FenceVk> fence) { m_fence = fence; }
 
 	VkImage Image() { return m_image; };
+	VkFormat Format() { return m_format; };
+	VkExtent2D Extent() { return m_extent; };
+
+	// Views for compositing, created on first use
+	VkImageView View();
+	VkFramebuffer Framebuffer(VkRenderPass renderPass);
 
 private:
 	vr::VRVulkanTextureData_t m_data;
 
 	VkImage m_image;
-	VkDeviceMemory m_memory;
-	VkPhysicalDeviceMemoryProperties m_memoryProperties;
+	AllocationVk m_allocation;
+	std::shared_ptr<AllocatorVk> m_allocator;
+	VkFormat m_format;
+	VkExtent2D m_extent;
+	bool m_cube;
+	VkImageView m_view;
+	VkFramebuffer m_framebuffer;
+	std::shared_ptr<FenceVk> m_fence;
 	VkDevice m_device;
 	VkQueue* m_pQueue;
 
 	VkFormat TextureFormatToVkFormat(ovrTextureFormat format);
 	VkImageUsageFlags BindFlagsToVkImageUsageFlags(unsigned int flags);
-	bool GetMemoryType(uint32_t typeBits, VkFlags requirements_mask, uint32_t* typeIndex);
 
 	VK_DEFINE_FUNCTION(vkCreateImage)
-	VK_DEFINE_FUNCTION(vkGetImageMemoryRequirements)
-	VK_DEFINE_FUNCTION(vkAllocateMemory)
-	VK_DEFINE_FUNCTION(vkBindImageMemory)
-	VK_DEFINE_FUNCTION(vkFreeMemory)
 	VK_DEFINE_FUNCTION(vkDestroyImage)
+	VK_DEFINE_FUNCTION(vkCreateImageView)
+	VK_DEFINE_FUNCTION(vkDestroyImageView)
+	VK_DEFINE_FUNCTION(vkCreateFramebuffer)
+	VK_DEFINE_FUNCTION(vkDestroyFramebuffer)
 };
 
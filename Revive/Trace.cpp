@@ -0,0 +1,307 @@
+#include "Trace.h"
+
+#include <Windows.h>
+#include <Shlwapi.h>
+#include <Shlobj.h>
+#include <atlbase.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+// Events store the time since the previous event, sync events store the full timestamp instead
+struct TraceEvent
+{
+	union
+	{
+		const char* Name;
+		uint64_t Timestamp;
+	};
+	uint32_t Delta;
+	uint32_t Type;
+};
+
+// Ring buffer of a single thread, only the owning thread writes to it
+struct TraceBuffer
+{
+	TraceEvent Events[REV_TRACE_BUFFER_SIZE];
+	std::atomic<uint64_t> Head;
+	uint64_t LastTimestamp;
+	DWORD ThreadId;
+};
+
+std::atomic_bool g_TraceEnabled(false);
+
+// Buffers are shared with running dumps, so a thread that exits during a dump doesn't free its buffer under it
+static std::mutex g_TraceMutex;
+static std::mutex g_TraceDumpMutex;
+static std::vector<std::shared_ptr<TraceBuffer>> g_TraceBuffers;
+
+static thread_local TraceBuffer* t_TraceBuffer = nullptr;
+
+// Unregisters the buffer when the thread exits, the hot path only uses the plain pointer
+struct TraceThread
+{
+	std::shared_ptr<TraceBuffer> Buffer;
+
+	~TraceThread()
+	{
+		if (!Buffer)
+			return;
+
+		t_TraceBuffer = nullptr;
+		std::lock_guard<std::mutex> lk(g_TraceMutex);
+		g_TraceBuffers.erase(std::remove(g_TraceBuffers.begin(), g_TraceBuffers.end(), Buffer), g_TraceBuffers.end());
+	}
+};
+
+static thread_local TraceThread t_TraceThread;
+
+// Threshold dumps run on their own thread, only one at a time
+static std::mutex g_TraceThreadMutex;
+static std::thread g_TraceDumpThread;
+static std::atomic_bool g_TraceDumping(false);
+
+static std::atomic<double> g_TraceThreshold(0.0);
+static uint64_t g_TraceLastFrame = 0;
+static uint64_t g_TraceLastDump = 0;
+static HANDLE g_TraceEvent = NULL;
+
+static uint64_t TraceTimestamp()
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart;
+}
+
+static double TraceFrequency()
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return double(frequency.QuadPart);
+}
+
+static TraceBuffer* TraceCreateBuffer()
+{
+	std::shared_ptr<TraceBuffer> buffer = std::make_shared<TraceBuffer>();
+	buffer->Head = 0;
+	buffer->LastTimestamp = TraceTimestamp();
+	buffer->ThreadId = GetCurrentThreadId();
+	t_TraceThread.Buffer = buffer;
+
+	std::lock_guard<std::mutex> lk(g_TraceMutex);
+	g_TraceBuffers.push_back(buffer);
+	return buffer.get();
+}
+
+void TraceRecord(TraceEventType type, const char* name)
+{
+	TraceBuffer* buffer = t_TraceBuffer;
+	if (!buffer)
+		buffer = t_TraceBuffer = TraceCreateBuffer();
+
+	uint64_t now = TraceTimestamp();
+	uint64_t delta = now - buffer->LastTimestamp;
+	uint64_t head = buffer->Head.load(std::memory_order_relaxed);
+
+	// Start every block with a sync event, also needed when the delta doesn't fit
+	while (head % REV_TRACE_BLOCK_SIZE == 0 || delta > UINT32_MAX)
+	{
+		TraceEvent& sync = buffer->Events[head % REV_TRACE_BUFFER_SIZE];
+		sync.Timestamp = now;
+		sync.Delta = 0;
+		sync.Type = TraceEvent_Sync;
+		head++;
+		delta = 0;
+	}
+
+	TraceEvent& ev = buffer->Events[head % REV_TRACE_BUFFER_SIZE];
+	ev.Name = name;
+	ev.Delta = (uint32_t)delta;
+	ev.Type = type;
+	buffer->LastTimestamp = now;
+	buffer->Head.store(head + 1, std::memory_order_release);
+}
+
+void TraceConfigure(bool enabled, float thresholdMs)
+{
+	g_TraceThreshold = enabled ? thresholdMs / 1000.0 : 0.0;
+	g_TraceEnabled = enabled;
+
+	if (enabled && !g_TraceEvent)
+	{
+		char name[MAX_PATH];
+		snprintf(name, MAX_PATH, "ReviveTrace.%u", GetCurrentProcessId());
+		g_TraceEvent = CreateEventA(NULL, FALSE, FALSE, name);
+	}
+
+	// Let a threshold dump finish, so it doesn't outlive the runtime
+	if (!enabled)
+	{
+		std::lock_guard<std::mutex> lk(g_TraceThreadMutex);
+		if (g_TraceDumpThread.joinable())
+			g_TraceDumpThread.join();
+	}
+}
+
+void TraceFrame()
+{
+	double threshold = g_TraceThreshold;
+	uint64_t now = TraceTimestamp();
+	uint64_t last = g_TraceLastFrame;
+	g_TraceLastFrame = now;
+	if (threshold <= 0.0 || last == 0)
+		return;
+
+	double frequency = TraceFrequency();
+	if (double(now - last) / frequency < threshold)
+		return;
+
+	// Don't dump every frame of a hitch, the trace already covers the preceding frames
+	if (g_TraceLastDump != 0 && double(now - g_TraceLastDump) / frequency < REV_TRACE_DUMP_INTERVAL)
+		return;
+	g_TraceLastDump = now;
+
+	// The previous dump is finished, so joining it doesn't block the frame
+	std::lock_guard<std::mutex> lk(g_TraceThreadMutex);
+	if (g_TraceDumping)
+		return;
+	if (g_TraceDumpThread.joinable())
+		g_TraceDumpThread.join();
+	g_TraceDumping = true;
+	g_TraceDumpThread = std::thread([]() { TraceDump(); g_TraceDumping = false; });
+}
+
+void TracePoll()
+{
+	if (g_TraceEvent && WaitForSingleObject(g_TraceEvent, 0) == WAIT_OBJECT_0)
+		TraceDump();
+}
+
+// The documents folder and the executable name may not be representable in the ANSI code page
+static bool TraceDefaultPath(wchar_t* path)
+{
+	CComHeapPtr<wchar_t> documents;
+	if (FAILED(SHGetKnownFolderPath(FOLDERID_Documents, KF_FLAG_DEFAULT, NULL, &documents)))
+		return false;
+
+	wchar_t directory[MAX_PATH];
+	swprintf(directory, MAX_PATH, L"%ls\\Revive", (wchar_t*)documents);
+	CreateDirectoryW(directory, NULL);
+	wcscat_s(directory, MAX_PATH, L"\\Traces");
+	CreateDirectoryW(directory, NULL);
+
+	wchar_t filepath[MAX_PATH];
+	GetModuleFileNameW(NULL, filepath, MAX_PATH);
+	PathRemoveExtensionW(filepath);
+
+	SYSTEMTIME time;
+	GetLocalTime(&time);
+	swprintf(path, MAX_PATH, L"%ls\\%ls-%04d%02d%02d-%02d%02d%02d.json", directory, PathFindFileNameW(filepath),
+		time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond);
+	return true;
+}
+
+// Names are expected to be literal identifiers, but escape them anyway so the trace always stays valid JSON
+static void TraceWriteString(FILE* file, const char* str)
+{
+	fputc('"', file);
+	for (const char* c = str; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			fprintf(file, "\\%c", *c);
+		else if ((unsigned char)*c < 0x20)
+			fprintf(file, "\\u%04x", (unsigned char)*c);
+		else
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+// Copies the events that are safe to decode, the oldest block is skipped because the writer may be overwriting it
+static void TraceCopyEvents(TraceBuffer* buffer, std::vector<TraceEvent>& events)
+{
+	uint64_t head = buffer->Head.load(std::memory_order_acquire);
+	uint64_t start = 0;
+	if (head > REV_TRACE_BUFFER_SIZE - REV_TRACE_BLOCK_SIZE)
+		start = (head - REV_TRACE_BUFFER_SIZE + 2 * REV_TRACE_BLOCK_SIZE - 1) / REV_TRACE_BLOCK_SIZE * REV_TRACE_BLOCK_SIZE;
+
+	events.clear();
+	for (uint64_t i = start; i < head; i++)
+		events.push_back(buffer->Events[i % REV_TRACE_BUFFER_SIZE]);
+
+	// Drop the blocks the writer wrapped around to while we were copying
+	uint64_t current = buffer->Head.load(std::memory_order_acquire);
+	if (current > REV_TRACE_BUFFER_SIZE - REV_TRACE_BLOCK_SIZE)
+	{
+		uint64_t valid = (current - REV_TRACE_BUFFER_SIZE + 2 * REV_TRACE_BLOCK_SIZE - 1) / REV_TRACE_BLOCK_SIZE * REV_TRACE_BLOCK_SIZE;
+		if (valid > start)
+			events.erase(events.begin(), events.begin() + (size_t)(std::min)(valid - start, (uint64_t)events.size()));
+	}
+}
+
+bool TraceDump(const char* path)
+{
+	// Dumps can be triggered from several threads, don't let them write to the same file
+	std::lock_guard<std::mutex> dumpLock(g_TraceDumpMutex);
+
+	FILE* file = nullptr;
+	if (path)
+	{
+		fopen_s(&file, path, "w");
+	}
+	else
+	{
+		wchar_t defaultPath[MAX_PATH];
+		if (TraceDefaultPath(defaultPath))
+			_wfopen_s(&file, defaultPath, L"w");
+	}
+	if (!file)
+		return false;
+
+	std::vector<std::shared_ptr<TraceBuffer>> buffers;
+	{
+		std::lock_guard<std::mutex> lk(g_TraceMutex);
+		buffers = g_TraceBuffers;
+	}
+
+	// Timestamps are written in microseconds, the earliest sync event of all threads is the origin
+	double frequency = TraceFrequency();
+	std::vector<std::vector<TraceEvent>> threads(buffers.size());
+	uint64_t origin = UINT64_MAX;
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		TraceCopyEvents(buffers[i].get(), threads[i]);
+		if (!threads[i].empty())
+			origin = (std::min)(origin, threads[i].front().Timestamp);
+	}
+
+	DWORD pid = GetCurrentProcessId();
+	bool first = true;
+	fprintf(file, "{\"traceEvents\":[\n");
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		uint64_t timestamp = 0;
+		for (const TraceEvent& ev : threads[i])
+		{
+			if (ev.Type == TraceEvent_Sync)
+			{
+				timestamp = ev.Timestamp;
+				continue;
+			}
+
+			timestamp += ev.Delta;
+			fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+			TraceWriteString(file, ev.Name);
+			fprintf(file, ",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u}",
+				ev.Type == TraceEvent_Begin ? "B" : "E", double(timestamp - origin) * 1000000.0 / frequency,
+				pid, buffers[i]->ThreadId);
+			first = false;
+		}
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
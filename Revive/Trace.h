@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Number of events kept per thread, must be a multiple of the block size
+#define REV_TRACE_BUFFER_SIZE 16384
+
+// Every block starts with a full timestamp, so the oldest events can be decoded after the ring wrapped
+#define REV_TRACE_BLOCK_SIZE 1024
+
+// Minimum time between two dumps triggered by the frame time threshold
+#define REV_TRACE_DUMP_INTERVAL 10.0
+
+enum TraceEventType
+{
+	TraceEvent_Sync = 0,
+	TraceEvent_Begin = 1,
+	TraceEvent_End = 2,
+};
+
+extern std::atomic_bool g_TraceEnabled;
+
+// Appends an event to the ring buffer of the calling thread, the name must be a string literal
+void TraceRecord(TraceEventType type, const char* name);
+
+// Enables recording, a non-zero threshold dumps the trace when a frame takes longer than it.
+// Disabling waits for a dump that was triggered by the threshold.
+void TraceConfigure(bool enabled, float thresholdMs);
+
+// Called at the end of every frame to check the frame time against the threshold
+void TraceFrame();
+
+// Called periodically, dumps the trace when another process signals the named event "ReviveTrace.<pid>"
+void TracePoll();
+
+// Writes the recorded events of all threads in the Chrome trace format, which Perfetto can also open.
+// Without a path the trace is written to Documents\Revive\Traces.
+bool TraceDump(const char* path = nullptr);
+
+// Records a begin event on construction and an end event on destruction
+class TraceScope
+{
+public:
+	TraceScope(const char* name) : m_Name(g_TraceEnabled.load(std::memory_order_relaxed) ? name : nullptr)
+	{
+		if (m_Name)
+			TraceRecord(TraceEvent_Begin, m_Name);
+	}
+
+	~TraceScope()
+	{
+		if (m_Name)
+			TraceRecord(TraceEvent_End, m_Name);
+	}
+
+private:
+	const char* m_Name;
+};
+
+#define REV_TRACE_CONCAT_(a, b) a##b
+#define REV_TRACE_CONCAT(a, b) REV_TRACE_CONCAT_(a, b)
+#define REV_TRACE_SCOPE(name) TraceScope REV_TRACE_CONCAT(rev_trace_, __LINE__)(name)
@@ -31,97 +31,98 @@ local hybrid_time = 0
 -- Current state for thumbstick behaviour
 local was_touched = false
 local center = {x=0, y=0}
+local offset = {x=0, y=0}
 
 function GetButtons(right_hand)
-  buttons = {}
+  local buttons = 0
 
   if (string.match(controller_model, "Knuckles")) then
     if (state.ApplicationMenu.pressed and state.Grip.pressed) then
-      table.insert(buttons, ovrButton_Enter)
+      buttons = bit.bor(buttons, ovrButton_Enter)
     else
       if (state.Grip.pressed) then
-        table.insert(buttons, right_hand and ovrButton_A or ovrButton_X)
+        buttons = bit.bor(buttons, right_hand and ovrButton_A or ovrButton_X)
       end
 
       if (state.ApplicationMenu.pressed) then
-        table.insert(buttons, right_hand and ovrButton_B or ovrButton_Y)
+        buttons = bit.bor(buttons, right_hand and ovrButton_B or ovrButton_Y)
       end
     end
 
     if (state[SteamVR_Touchpad].pressed) then
-      table.insert(buttons, right_hand and ovrButton_RThumb or ovrButton_LThumb)
+      buttons = bit.bor(buttons, right_hand and ovrButton_RThumb or ovrButton_LThumb)
     end
 
-    return unpack(buttons)
+    return buttons
   end
 
   if (state.ApplicationMenu.pressed) then
-    table.insert(buttons, ovrButton_Enter)
+    buttons = bit.bor(buttons, ovrButton_Enter)
   end
 
   if (state.A.pressed) then
-    table.insert(buttons, right_hand and ovrButton_A or ovrButton_X)
+    buttons = bit.bor(buttons, right_hand and ovrButton_A or ovrButton_X)
   end
 
   if (state.B.pressed) then
-    table.insert(buttons, right_hand and ovrButton_B or ovrButton_Y)
+    buttons = bit.bor(buttons, right_hand and ovrButton_B or ovrButton_Y)
   end
 
   if (state[SteamVR_Touchpad].pressed) then
-    table.insert(buttons, ButtonFromQuadrant(state[SteamVR_Touchpad], right_hand))
+    buttons = bit.bor(buttons, ButtonFromQuadrant(state[SteamVR_Touchpad], right_hand))
   end
 
-  return unpack(buttons)
+  return buttons
 end
 
 function GetTouches(right_hand)
-  touches = {}
+  local touches = 0
 
   if (string.match(controller_model, "Knuckles")) then
     if (state.Grip.touched) then
-      table.insert(touches, right_hand and ovrTouch_A or ovrTouch_X)
+      touches = bit.bor(touches, right_hand and ovrTouch_A or ovrTouch_X)
     end
 
     if (state.ApplicationMenu.touched) then
-      table.insert(touches, right_hand and ovrTouch_B or ovrTouch_Y)
+      touches = bit.bor(touches, right_hand and ovrTouch_B or ovrTouch_Y)
     end
 
     if (state[SteamVR_Touchpad].touched) then
-      table.insert(touches, right_hand and ovrTouch_RThumb or ovrTouch_LThumb)
+      touches = bit.bor(touches, right_hand and ovrTouch_RThumb or ovrTouch_LThumb)
     elseif (not state.Grip.touched and not state.ApplicationMenu.touched) then
-      table.insert(touches, right_hand and ovrTouch_RThumbUp or ovrTouch_LThumbUp)
+      touches = bit.bor(touches, right_hand and ovrTouch_RThumbUp or ovrTouch_LThumbUp)
     end
 
     if (state[SteamVR_Trigger].touched) then
-      table.insert(touches, right_hand and ovrTouch_RIndexTrigger or ovrTouch_LIndexTrigger)
+      touches = bit.bor(touches, right_hand and ovrTouch_RIndexTrigger or ovrTouch_LIndexTrigger)
     elseif (state[4].x < 0.8) then
-      table.insert(touches, right_hand and ovrTouch_RIndexPointing or ovrTouch_LIndexPointing)
+      touches = bit.bor(touches, right_hand and ovrTouch_RIndexPointing or ovrTouch_LIndexPointing)
     end
 
-    return unpack(touches)
+    return touches
   end
 
   if (state.A.touched) then
-    table.insert(touches, right_hand and ovrTouch_A or ovrTouch_X)
+    touches = bit.bor(touches, right_hand and ovrTouch_A or ovrTouch_X)
   end
 
   if (state.B.touched) then
-    table.insert(touches, right_hand and ovrTouch_B or ovrTouch_Y)
+    touches = bit.bor(touches, right_hand and ovrTouch_B or ovrTouch_Y)
   end
 
   if (state[SteamVR_Touchpad].touched) then
-    table.insert(touches, ButtonFromQuadrant(state[SteamVR_Touchpad], right_hand))
+    touches = bit.bor(touches, ButtonFromQuadrant(state[SteamVR_Touchpad], right_hand))
   elseif (gripped) then
-    table.insert(touches, right_hand and ovrTouch_RThumbUp or ovrTouch_LThumbUp)
+    touches = bit.bor(touches, right_hand and ovrTouch_RThumbUp or ovrTouch_LThumbUp)
   end
 
   if (state[SteamVR_Trigger].touched) then
-    table.insert(touches, right_hand and ovrTouch_RIndexTrigger or ovrTouch_LIndexTrigger)
+    touches = bit.bor(touches, right_hand and ovrTouch_RIndexTrigger or ovrTouch_LIndexTrigger)
   elseif (gripped) then
-    table.insert(touches, right_hand and ovrTouch_RIndexPointing or ovrTouch_LIndexPointing)
+    touches = bit.bor(touches, right_hand and ovrTouch_RIndexPointing or ovrTouch_LIndexPointing)
   end
 
-  return unpack(touches)
+  return touches
 end
 
 function ApplyDeadzone(axis, deadZoneLow, deadZoneHigh)
@@ -170,8 +171,9 @@ function GetThumbstick(right_hand, deadzone)
     return 0, 0
   else  
     -- account for the center
-    local out = {x=axis.x - center.x, y=axis.y - center.y}
-    return ApplyDeadzone(out, deadzone, deadzone / 2)
+    offset.x = axis.x - center.x
+    offset.y = axis.y - center.y
+    return ApplyDeadzone(offset, deadzone, deadzone / 2)
   end
 end
 
@@ -60,8 +60,23 @@ ovrTouch_LThumbUp = 0x00004000
 SteamVR_Touchpad  = 1
 SteamVR_Trigger   = 2
 
--- The controller globals
+-- The controller globals. The state tables are updated in-place on every poll, during a poll
+-- last_state holds the state of the previous poll. Revive alternates between two tables, so
+-- a script that keeps a reference to state or last_state across polls will see its contents
+-- overwritten two polls later. Copy the values that need to be kept instead.
 state = {}
 time = 0
 controller_model = ""
 grip_mode = {}
+
+-- The input entry point, returns the buttons, touches, index trigger, hand trigger,
+-- the thumbstick and the thumbstick without a deadzone. Scripts can override this
+-- to compute all outputs at once, by default it calls the separate callbacks.
+function GetInput(right_hand, deadzone)
+  local buttons = bit.bor(0, GetButtons(right_hand))
+  local touches = bit.bor(0, GetTouches(right_hand))
+  local index, hand = GetTriggers(right_hand)
+  local x, y = GetThumbstick(right_hand, deadzone)
+  local nx, ny = GetThumbstick(right_hand, 0)
+  return buttons, touches, index, hand, x, y, nx, ny
+end
@@ -1,15 +1,132 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
-#include <shared_mutex>
-#include <utility>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <stdint.h>
+#include <thread>
+
+#define REV_RCU_CACHE_LINE 64
 
 /*
-	Pointer with implicit locking for implementing a simple RCU pattern.
+	Epoch-based read-copy-update, readers announce the epoch they started reading in and the writer
+	waits until every reader that might still see the old pointer has left its critical section.
+	Readers never block and only write to their own cache line.
+
+	There is a single epoch and reader list shared by all pointers, so a writer also waits for
+	readers of unrelated pointers. That is intended, swaps are rare (settings and device changes)
+	and a thread can hold copies of different pointers without tracking them per pointer.
+	It does mean a thread must never swap while it holds a copy of any pointer.
+*/
+namespace rcu
+{
+	// Per-thread reader state, records are never freed so the writer can always walk the list.
+	// Each record is aligned and padded to a cache line, so readers don't invalidate each other.
+	struct alignas(REV_RCU_CACHE_LINE) reader_record
+	{
+		std::atomic<uint64_t> epoch; // Zero outside of a read-side critical section
+		std::atomic_bool in_use;
+		unsigned int nesting;
+		reader_record* next;
+	};
+
+	inline std::atomic<uint64_t>& global_epoch() { static std::atomic<uint64_t> epoch(1); return epoch; }
+	inline std::atomic<reader_record*>& reader_list() { static std::atomic<reader_record*> head(nullptr); return head; }
+
+	class thread_reader
+	{
+	public:
+		thread_reader()
+		{
+			// Reuse the record of a thread that exited
+			for (record = reader_list().load(std::memory_order_acquire); record; record = record->next)
+			{
+				bool expected = false;
+				if (record->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+					return;
+			}
+
+			// Aligned new isn't available before C++17, so over-allocate and align the record manually
+			size_t space = sizeof(reader_record) + REV_RCU_CACHE_LINE - 1;
+			void* storage = ::operator new(space);
+			record = new (std::align(alignof(reader_record), sizeof(reader_record), storage, space)) reader_record();
+			record->epoch = 0;
+			record->in_use = true;
+			record->nesting = 0;
+			record->next = reader_list().load(std::memory_order_relaxed);
+			while (!reader_list().compare_exchange_weak(record->next, record, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		~thread_reader()
+		{
+			assert(record->nesting == 0);
+			record->in_use.store(false, std::memory_order_release);
+		}
+
+		reader_record* record;
+	};
+
+	inline reader_record* this_reader()
+	{
+		thread_local thread_reader reader;
+		return reader.record;
+	}
+
+	// Read-side critical sections can be nested, only the outermost one announces its epoch
+	inline void read_lock()
+	{
+		reader_record* reader = this_reader();
+		if (reader->nesting++ == 0)
+		{
+			reader->epoch.store(global_epoch().load(std::memory_order_acquire), std::memory_order_relaxed);
+
+			// The announcement must be visible before the pointer is loaded, pairs with the fence in synchronize()
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+		}
+	}
+
+	inline void read_unlock()
+	{
+		reader_record* reader = this_reader();
+		if (--reader->nesting == 0)
+			reader->epoch.store(0, std::memory_order_release);
+	}
+
+	// Waits until all read-side critical sections that started before the call have ended
+	inline void synchronize()
+	{
+		// Waiting inside a critical section would wait for ourselves
+		assert(this_reader()->nesting == 0);
+
+		uint64_t epoch = global_epoch().fetch_add(1, std::memory_order_seq_cst) + 1;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		for (reader_record* reader = reader_list().load(std::memory_order_acquire); reader; reader = reader->next)
+		{
+			// Back off to a sleep, so a reader that was preempted in its critical section can run
+			unsigned int spins = 0;
+			uint64_t current = reader->epoch.load(std::memory_order_acquire);
+			while (current != 0 && current < epoch)
+			{
+				if (++spins < 64)
+					std::this_thread::yield();
+				else
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+				current = reader->epoch.load(std::memory_order_acquire);
+			}
+		}
+	}
+}
+
+/*
+	Pointer with implicit read-side critical sections for implementing a simple RCU pattern.
 	The following rules must be followed to use it successfully:
-		1. Make a local copy to acquire the pointer from a different thread.
-		2. Do not copy the same pointer twice from another thread, you will
-		   cause a deadlock.
+		1. Make a local copy to acquire the pointer from a different thread,
+		   copies can be nested on the same thread.
+		2. Do not pass a copy to another thread, the critical section belongs
+		   to the thread that made the copy.
 		3. Only swap from a single writer thread on the original pointer.
 */
 template<typename T>
@@ -17,32 +134,32 @@ class rcu_ptr
 {
 public:
 	// Null-pointer
-	rcu_ptr() : m_ptr(nullptr), m_mutex(std::make_shared<std::shared_mutex>()), m_reader() { }
+	rcu_ptr() : m_owner(), m_ptr(nullptr), m_reader(false) { }
 
-	// Copying implies you acquire a read-lock on the underlying pointer
-	rcu_ptr(const rcu_ptr& r) : m_ptr(nullptr), m_mutex(r.m_mutex), m_reader(std::this_thread::get_id())
+	// Copying implies you enter a read-side critical section
+	rcu_ptr(const rcu_ptr& r) : m_owner(), m_ptr(nullptr), m_reader(true)
 	{
-		if (m_reader != r.m_reader)
-			m_mutex->lock_shared();
+		rcu::read_lock();
 
-		// Only copy the pointer once we're certain we have a read-lock on it
-		m_ptr = r.m_ptr;
+		// Only copy the pointer once the writer can see we're reading it
+		m_ptr.store(r.m_ptr.load(std::memory_order_acquire), std::memory_order_relaxed);
 	}
 
-	// Creating a new pointer doesn't acquire a read-lock, because this thread is the writer
-	rcu_ptr(std::shared_ptr<T> ptr) : m_ptr(ptr), m_mutex(std::make_shared<std::shared_mutex>()), m_reader() { }
+	// Creating a new pointer doesn't enter a critical section, because this thread is the writer
+	rcu_ptr(std::shared_ptr<T> ptr) : m_owner(ptr), m_ptr(ptr.get()), m_reader(false) { }
 
-	// Destroying implies releasing the read-lock on the underlying pointer
+	// Destroying implies leaving the read-side critical section
 	~rcu_ptr()
 	{
-		// If this thread is a reader, release the lock
-		if (m_reader == std::this_thread::get_id())
-			m_mutex->unlock_shared();
+		if (m_reader)
+			rcu::read_unlock();
 	}
 
-	const T* operator->() const { assert(m_reader == std::this_thread::get_id()); return m_ptr.get(); }
-	const T& operator*() const { assert(m_reader == std::this_thread::get_id()); return *m_ptr.get(); }
-	explicit operator bool() const  { return (m_ptr.get() != nullptr); }
+	rcu_ptr& operator=(const rcu_ptr&) = delete;
+
+	const T* operator->() const { assert(m_reader); return m_ptr.load(std::memory_order_relaxed); }
+	const T& operator*() const { assert(m_reader); return *m_ptr.load(std::memory_order_relaxed); }
+	explicit operator bool() const { return (m_ptr.load(std::memory_order_relaxed) != nullptr); }
 
 	// Swaps out the pointer when all other readers are done with it
 	// This function returns the old pointer which is now safe to
@@ -50,15 +167,15 @@ public:
 	void swap(std::shared_ptr<T>& ptr)
 	{
 		// Ensure we're not a reader
-		assert(m_reader == std::thread::id());
+		assert(!m_reader);
 
-		m_mutex->lock();
-		m_ptr.swap(ptr);
-		m_mutex->unlock();
+		m_ptr.store(ptr.get(), std::memory_order_seq_cst);
+		m_owner.swap(ptr);
+		rcu::synchronize();
 	}
 
 private:
-	std::shared_ptr<T> m_ptr;
-	std::shared_ptr<std::shared_mutex> m_mutex;
-	std::thread::id m_reader;
+	std::shared_ptr<T> m_owner;
+	std::atomic<T*> m_ptr;
+	bool m_reader;
 };
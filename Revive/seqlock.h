@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+/*
+	Sequence lock for publishing a trivially copyable snapshot to many readers.
+	The following rules must be followed to use it successfully:
+		1. Only store from a single writer at a time, the writer is never blocked.
+		2. Readers never block the writer, they will retry the copy if a store
+		   happened to overlap with it.
+		3. Keep the snapshot small, readers copy the whole value on every load.
+*/
+template<typename T>
+class seqlock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "The snapshot must be trivially copyable");
+
+public:
+	seqlock() : m_seq(0), m_value() { }
+	seqlock(const seqlock&) = delete;
+	seqlock& operator=(const seqlock&) = delete;
+
+	// Publishes a new snapshot, an odd sequence number marks a store in progress
+	void store(const T& value)
+	{
+		unsigned int seq = m_seq.load(std::memory_order_relaxed);
+		m_seq.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		memcpy(&m_value, &value, sizeof(T));
+
+		m_seq.store(seq + 2, std::memory_order_release);
+	}
+
+	// Copies the last published snapshot
+	T load() const
+	{
+		T value;
+		unsigned int begin, end;
+		do
+		{
+			begin = m_seq.load(std::memory_order_acquire);
+			memcpy(&value, &m_value, sizeof(T));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			end = m_seq.load(std::memory_order_relaxed);
+		} while (begin != end || begin & 1);
+		return value;
+	}
+
+private:
+	std::atomic_uint m_seq;
+	T m_value;
+};
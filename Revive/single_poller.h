@@ -0,0 +1,57 @@
+#pragma once
+
+#include "seqlock.h"
+
+#include <atomic>
+
+/*
+	Lets many threads poll a slow source while only one of them actually queries it.
+	The following rules apply:
+		1. The thread that wins the race runs the query and publishes its result.
+		2. All other threads copy the last published result, they never wait for the winner.
+		3. Before the first result is published the other threads get false and their value
+		   is left untouched, so no thread ever blocks at the cost of one empty result.
+*/
+template<typename T>
+class single_poller
+{
+public:
+	single_poller() : m_polling(false) { }
+	single_poller(const single_poller&) = delete;
+	single_poller& operator=(const single_poller&) = delete;
+
+	// Runs query(T*) unless another thread is already inside it and returns the result
+	template<typename F>
+	bool poll(T* value, F query)
+	{
+		if (m_polling.exchange(true, std::memory_order_acquire))
+		{
+			snapshot last = m_snapshot.load();
+			if (!last.valid)
+				return false;
+
+			*value = last.value;
+			return last.result;
+		}
+
+		snapshot next;
+		next.result = query(value);
+		next.value = *value;
+		next.valid = true;
+		m_snapshot.store(next);
+
+		m_polling.store(false, std::memory_order_release);
+		return next.result;
+	}
+
+private:
+	struct snapshot
+	{
+		T value;
+		bool result;
+		bool valid;
+	};
+
+	std::atomic_bool m_polling;
+	seqlock<snapshot> m_snapshot;
+};
@@ -21,3 +21,9 @@ extern VK_DEFINE_FUNCTION(vkGetDeviceProcAddr)
 extern VK_DEFINE_FUNCTION(vkEnumeratePhysicalDevices)
 extern VK_DEFINE_FUNCTION(vkGetPhysicalDeviceMemoryProperties)
 extern VK_DEFINE_FUNCTION(vkGetPhysicalDeviceProperties2KHR)
+
+// Returns the family of a queue the application created, or VK_QUEUE_FAMILY_IGNORED if the device creation wasn't seen
+uint32_t GetQueueFamilyIndex(VkDevice device, VkQueue queue);
+
+// Returns whether the application enabled the extension, false if the device creation wasn't seen
+bool IsDeviceExtensionEnabled(VkDevice device, const char* extension);
@@ -0,0 +1,250 @@
+#include "Test.h"
+#include "AllocatorVk.h"
+
+#include <map>
+#include <string.h>
+
+#define MB (1ull << 20)
+
+/*
+	Fake device that only implements the memory functions the allocator uses. Images are
+	plain handles, their memory requirements are looked up by handle.
+*/
+struct FakeImage
+{
+	VkDeviceSize Size;
+	bool PrefersDedicated;
+	VkDeviceMemory Memory;
+	VkDeviceSize Offset;
+};
+
+struct FakeDevice
+{
+	bool Extensions;
+	uintptr_t NextHandle;
+	std::map<VkDeviceMemory, VkDeviceSize> Memory;
+	std::map<VkImage, FakeImage> Images;
+	int Allocations;
+	int DedicatedInfos;
+};
+
+static FakeDevice g_Device;
+
+static VkResult VKAPI_CALL FakeAllocateMemory(VkDevice, const VkMemoryAllocateInfo* info, const VkAllocationCallbacks*, VkDeviceMemory* memory)
+{
+	const VkMemoryDedicatedAllocateInfoKHR* dedicated = (const VkMemoryDedicatedAllocateInfoKHR*)info->pNext;
+	if (dedicated && dedicated->sType == VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR)
+		g_Device.DedicatedInfos++;
+
+	*memory = (VkDeviceMemory)(++g_Device.NextHandle);
+	g_Device.Memory[*memory] = info->allocationSize;
+	g_Device.Allocations++;
+	return VK_SUCCESS;
+}
+
+static void VKAPI_CALL FakeFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*)
+{
+	g_Device.Memory.erase(memory);
+}
+
+static VkResult VKAPI_CALL FakeBindImageMemory(VkDevice, VkImage image, VkDeviceMemory memory, VkDeviceSize offset)
+{
+	FakeImage& fake = g_Device.Images[image];
+	fake.Memory = memory;
+	fake.Offset = offset;
+	return VK_SUCCESS;
+}
+
+static void VKAPI_CALL FakeGetImageMemoryRequirements(VkDevice, VkImage image, VkMemoryRequirements* requirements)
+{
+	requirements->size = g_Device.Images[image].Size;
+	requirements->alignment = 256;
+	requirements->memoryTypeBits = 1;
+}
+
+static void VKAPI_CALL FakeGetImageMemoryRequirements2KHR(VkDevice device, const VkImageMemoryRequirementsInfo2KHR* info, VkMemoryRequirements2KHR* requirements)
+{
+	FakeGetImageMemoryRequirements(device, info->image, &requirements->memoryRequirements);
+	VkMemoryDedicatedRequirementsKHR* dedicated = (VkMemoryDedicatedRequirementsKHR*)requirements->pNext;
+	if (dedicated)
+		dedicated->prefersDedicatedAllocation = g_Device.Images[info->image].PrefersDedicated;
+}
+
+static void VKAPI_CALL FakeGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties* properties)
+{
+	memset(properties, 0, sizeof(VkPhysicalDeviceProperties));
+	properties->limits.bufferImageGranularity = 1024;
+}
+
+static void VKAPI_CALL FakeGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* properties)
+{
+	memset(properties, 0, sizeof(VkPhysicalDeviceMemoryProperties));
+	properties->memoryTypeCount = 1;
+	properties->memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+}
+
+static PFN_vkVoidFunction VKAPI_CALL FakeGetDeviceProcAddr(VkDevice, const char* name)
+{
+	if (strcmp(name, "vkAllocateMemory") == 0) return (PFN_vkVoidFunction)FakeAllocateMemory;
+	if (strcmp(name, "vkFreeMemory") == 0) return (PFN_vkVoidFunction)FakeFreeMemory;
+	if (strcmp(name, "vkBindImageMemory") == 0) return (PFN_vkVoidFunction)FakeBindImageMemory;
+	if (strcmp(name, "vkGetImageMemoryRequirements") == 0) return (PFN_vkVoidFunction)FakeGetImageMemoryRequirements;
+	if (strcmp(name, "vkGetImageMemoryRequirements2KHR") == 0) return (PFN_vkVoidFunction)FakeGetImageMemoryRequirements2KHR;
+	return nullptr;
+}
+
+static PFN_vkVoidFunction VKAPI_CALL FakeGetInstanceProcAddr(VkInstance, const char* name)
+{
+	if (strcmp(name, "vkGetPhysicalDeviceProperties") == 0) return (PFN_vkVoidFunction)FakeGetPhysicalDeviceProperties;
+	return nullptr;
+}
+
+// Normally loaded and recorded by REV_CAPI_Vk.cpp
+PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = FakeGetInstanceProcAddr;
+PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr = FakeGetDeviceProcAddr;
+PFN_vkGetPhysicalDeviceMemoryProperties vkGetPhysicalDeviceMemoryProperties = FakeGetPhysicalDeviceMemoryProperties;
+
+bool IsDeviceExtensionEnabled(VkDevice device, const char* extension)
+{
+	return g_Device.Extensions;
+}
+
+static VkDevice ResetDevice(bool extensions)
+{
+	g_Device = FakeDevice();
+	g_Device.Extensions = extensions;
+	return (VkDevice)1;
+}
+
+static VkImage CreateImage(VkDeviceSize size, bool prefersDedicated = false)
+{
+	VkImage image = (VkImage)(++g_Device.NextHandle);
+	g_Device.Images[image] = { size, prefersDedicated, VK_NULL_HANDLE, 0 };
+	return image;
+}
+
+TEST(AllocatorVk_Split)
+{
+	AllocatorVk allocator;
+	CHECK(allocator.Init(ResetDevice(false), nullptr, nullptr));
+
+	// The first allocation splits a new block down to the minimum size, the next one takes its buddy
+	AllocationVk first, second;
+	VkImage a = CreateImage(1000), b = CreateImage(REV_VK_MIN_ALLOCATION);
+	CHECK(allocator.AllocateImage(a, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &first));
+	CHECK(allocator.AllocateImage(b, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &second));
+	CHECK_EQUAL(g_Device.Allocations, 1);
+	CHECK_EQUAL(g_Device.Memory[first.Memory], REV_VK_BLOCK_SIZE);
+	CHECK(first.Memory == second.Memory);
+	CHECK_EQUAL(first.Offset, 0);
+	CHECK_EQUAL(second.Offset, REV_VK_MIN_ALLOCATION);
+	CHECK_EQUAL(first.Order, 0);
+	CHECK(g_Device.Images[b].Memory == second.Memory);
+	CHECK_EQUAL(g_Device.Images[b].Offset, REV_VK_MIN_ALLOCATION);
+
+	// Larger allocations are aligned to their size
+	AllocationVk third;
+	CHECK(allocator.AllocateImage(CreateImage(3 * MB), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &third));
+	CHECK_EQUAL(third.Order, 6);
+	CHECK_EQUAL(third.Offset, 4 * MB);
+
+	allocator.Free(first);
+	allocator.Free(second);
+	allocator.Free(third);
+	CHECK_EQUAL(g_Device.Allocations, 1);
+}
+
+TEST(AllocatorVk_Merge)
+{
+	AllocatorVk allocator;
+	CHECK(allocator.Init(ResetDevice(false), nullptr, nullptr));
+
+	AllocationVk first, second;
+	CHECK(allocator.AllocateImage(CreateImage(REV_VK_MIN_ALLOCATION), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &first));
+	CHECK(allocator.AllocateImage(CreateImage(REV_VK_MIN_ALLOCATION), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &second));
+	allocator.Free(second);
+	allocator.Free(first);
+
+	// Only a fully merged block can hand out a quarter of the block at offset 0
+	AllocationVk quarter;
+	CHECK(allocator.AllocateImage(CreateImage(REV_VK_BLOCK_SIZE / 4), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &quarter));
+	CHECK(quarter.Block != REV_VK_DEDICATED);
+	CHECK_EQUAL(quarter.Offset, 0);
+	CHECK_EQUAL(g_Device.Allocations, 1);
+
+	// The last block of a memory type is kept when it becomes empty
+	allocator.Free(quarter);
+	CHECK_EQUAL(g_Device.Memory.size(), 1);
+}
+
+TEST(AllocatorVk_Fragmentation)
+{
+	AllocatorVk allocator;
+	CHECK(allocator.Init(ResetDevice(false), nullptr, nullptr));
+
+	// Fill a block with eighths, then free every other one
+	AllocationVk eighths[8];
+	for (AllocationVk& eighth : eighths)
+		CHECK(allocator.AllocateImage(CreateImage(REV_VK_BLOCK_SIZE / 8), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &eighth));
+	CHECK_EQUAL(g_Device.Allocations, 1);
+	for (int i = 0; i < 8; i += 2)
+		allocator.Free(eighths[i]);
+
+	// Half the block is free, but no two free eighths are buddies, so a quarter needs a new block
+	AllocationVk quarter;
+	CHECK(allocator.AllocateImage(CreateImage(REV_VK_BLOCK_SIZE / 4), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &quarter));
+	CHECK_EQUAL(g_Device.Allocations, 2);
+	CHECK(quarter.Memory != eighths[0].Memory);
+	CHECK_EQUAL(quarter.Offset, 0);
+
+	// Once the first block is empty it's released, because the second block has the same memory type
+	for (int i = 1; i < 8; i += 2)
+		allocator.Free(eighths[i]);
+	CHECK_EQUAL(g_Device.Memory.size(), 1);
+	CHECK(g_Device.Memory.count(quarter.Memory) == 1);
+
+	// Fill the second block, the next block takes the released slot
+	AllocationVk quarters[4];
+	for (int i = 0; i < 3; i++)
+		CHECK(allocator.AllocateImage(CreateImage(REV_VK_BLOCK_SIZE / 4), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &quarters[i]));
+	CHECK_EQUAL(g_Device.Allocations, 2);
+	CHECK(allocator.AllocateImage(CreateImage(REV_VK_BLOCK_SIZE / 4), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &quarters[3]));
+	CHECK_EQUAL(g_Device.Allocations, 3);
+	CHECK_EQUAL(quarters[3].Block, eighths[0].Block);
+}
+
+TEST(AllocatorVk_Dedicated)
+{
+	// Half a block or larger gets its own allocation, without the extension it's a plain allocation
+	{
+		AllocatorVk allocator;
+		CHECK(allocator.Init(ResetDevice(false), nullptr, nullptr));
+
+		AllocationVk half, quarter;
+		CHECK(allocator.AllocateImage(CreateImage(REV_VK_BLOCK_SIZE / 2), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &half));
+		CHECK(allocator.AllocateImage(CreateImage(REV_VK_BLOCK_SIZE / 4), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &quarter));
+		CHECK_EQUAL(half.Block, REV_VK_DEDICATED);
+		CHECK(quarter.Block != REV_VK_DEDICATED);
+		CHECK_EQUAL(g_Device.DedicatedInfos, 0);
+
+		allocator.Free(half);
+		CHECK(g_Device.Memory.count(half.Memory) == 0);
+		allocator.Free(quarter);
+	}
+
+	// With VK_KHR_dedicated_allocation the driver's preference is respected and the image is passed along
+	{
+		AllocatorVk allocator;
+		CHECK(allocator.Init(ResetDevice(true), nullptr, nullptr));
+
+		AllocationVk preferred, small;
+		CHECK(allocator.AllocateImage(CreateImage(MB, true), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &preferred));
+		CHECK(allocator.AllocateImage(CreateImage(MB), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &small));
+		CHECK_EQUAL(preferred.Block, REV_VK_DEDICATED);
+		CHECK(small.Block != REV_VK_DEDICATED);
+		CHECK_EQUAL(g_Device.DedicatedInfos, 1);
+
+		allocator.Free(preferred);
+		allocator.Free(small);
+	}
+}
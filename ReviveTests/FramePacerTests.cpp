@@ -0,0 +1,265 @@
+#include "Test.h"
+#include "FramePacer.h"
+
+#include <math.h>
+
+#define REV_TEST_RUNNING_START 0.003
+#define REV_TEST_PIPELINE_FRAMES 200
+
+static double g_Now = 0.0;
+
+static double Now()
+{
+	return g_Now;
+}
+
+/*
+	Display with a perfectly regular vsync, the reported vsync times can be offset to
+	simulate jitter. Changing the rate continues the vsync counter at the current vsync.
+*/
+class VsyncSystem : public vr::IVRSystem
+{
+public:
+	float Frequency;
+	double Period;
+	double BaseTime;
+	uint64_t BaseCounter;
+	double Offset;
+	FramePacer* Reenter;
+	int Queries;
+
+	VsyncSystem(float frequency, double period)
+		: Frequency(frequency), Period(period), BaseTime(100.0), BaseCounter(1000), Offset(0.0), Reenter(nullptr), Queries(0) { }
+
+	uint64_t Counter() { return BaseCounter + (uint64_t)floor((g_Now - BaseTime) / Period); }
+	double VsyncTime(uint64_t counter) { return BaseTime + double(counter - BaseCounter) * Period; }
+
+	void SetRate(float frequency, double period)
+	{
+		uint64_t counter = Counter();
+		BaseTime = VsyncTime(counter);
+		BaseCounter = counter;
+		Frequency = frequency;
+		Period = period;
+	}
+
+	virtual float GetFloatTrackedDeviceProperty(vr::TrackedDeviceIndex_t unDeviceIndex, vr::ETrackedDeviceProperty prop, vr::ETrackedPropertyError* pError)
+	{
+		return prop == vr::Prop_DisplayFrequency_Float ? Frequency : 0.0f;
+	}
+
+	virtual bool GetTimeSinceLastVsync(float* pfSecondsSinceLastVsync, uint64_t* pulFrameCounter)
+	{
+		Queries++;
+		if (Reenter)
+		{
+			FramePacer* pacer = Reenter;
+			Reenter = nullptr;
+			pacer->Sample();
+		}
+
+		*pulFrameCounter = Counter();
+		*pfSecondsSinceLastVsync = float(g_Now - VsyncTime(*pulFrameCounter) - Offset);
+		return true;
+	}
+};
+
+// Blocks until the running start of the next vsync if it's given a display, otherwise returns immediately
+class WaitCompositor : public vr::IVRCompositor
+{
+public:
+	int Waits;
+	VsyncSystem* Display;
+
+	WaitCompositor(VsyncSystem* display = nullptr) : Waits(0), Display(display) { }
+
+	virtual vr::EVRCompositorError WaitGetPoses(vr::TrackedDevicePose_t*, uint32_t, vr::TrackedDevicePose_t*, uint32_t)
+	{
+		Waits++;
+		if (Display)
+			g_Now = Display->VsyncTime(Display->Counter() + 1) - REV_TEST_RUNNING_START;
+		return vr::VRCompositorError_None;
+	}
+
+	virtual bool GetFrameTiming(vr::Compositor_FrameTiming*, uint32_t) { return false; }
+	virtual uint32_t GetFrameTimings(vr::Compositor_FrameTiming*, uint32_t) { return 0; }
+	virtual float GetFrameTimeRemaining() { return 0.0f; }
+	virtual void GetCumulativeStats(vr::Compositor_CumulativeStats*, uint32_t) { }
+};
+
+// Samples a few milliseconds after each vsync, like the session thread would
+static void SampleVsyncs(FramePacer& pacer, VsyncSystem& system, int count)
+{
+	uint64_t counter = system.Counter();
+	for (int i = 1; i <= count; i++)
+	{
+		g_Now = system.VsyncTime(counter + i) + 0.003;
+		pacer.Sample();
+	}
+}
+
+TEST(FramePacer_Fit)
+{
+	// The display runs slightly slower than it reports, the fit must find the real duration
+	VsyncSystem system(90.0f, 1.0 / 89.9);
+	WaitCompositor compositor;
+	g_Now = system.BaseTime;
+	FramePacer pacer(&compositor, &system, Now);
+
+	SampleVsyncs(pacer, system, REV_PACER_SAMPLE_COUNT + 8);
+	CHECK(pacer.WaitToBeginFrame(1) == vr::VRCompositorError_None);
+	CHECK_EQUAL(compositor.Waits, 1);
+
+	// The frame is displayed at the next vsync, later frames one period apart
+	double error;
+	double displayTime = pacer.GetPredictedDisplayTime(1, 1, &error);
+	CHECK_NEAR(displayTime, system.VsyncTime(system.Counter() + 1), 1e-6);
+	CHECK_NEAR(pacer.GetPredictedDisplayTime(11, 1) - displayTime, 10.0 * system.Period, 1e-6);
+	CHECK(error < 1e-6);
+
+	// Waiting for the same frame again doesn't block
+	CHECK(pacer.WaitToBeginFrame(1) == vr::VRCompositorError_None);
+	CHECK_EQUAL(compositor.Waits, 1);
+
+	// Jitter below the reset threshold shows up as the error of the fit
+	for (int i = 0; i < REV_PACER_SAMPLE_COUNT; i++)
+	{
+		system.Offset = (i % 3 - 1) * 0.0002;
+		SampleVsyncs(pacer, system, 1);
+	}
+	system.Offset = 0.0;
+	CHECK(pacer.WaitToBeginFrame(2) == vr::VRCompositorError_None);
+	CHECK_EQUAL(compositor.Waits, 2);
+	displayTime = pacer.GetPredictedDisplayTime(2, 2, &error);
+	CHECK_NEAR(displayTime, system.VsyncTime(system.Counter() + 1), 0.0002);
+	CHECK(error > 0.0001 && error < 0.0002);
+}
+
+TEST(FramePacer_Reset)
+{
+	VsyncSystem system(90.0f, 1.0 / 90.0);
+	WaitCompositor compositor;
+	g_Now = system.BaseTime;
+	FramePacer pacer(&compositor, &system, Now);
+	SampleVsyncs(pacer, system, REV_PACER_SAMPLE_COUNT);
+
+	// An outlier below the threshold is fitted like any other sample
+	double error;
+	system.Offset = system.Period * REV_PACER_RESET_THRESHOLD * 0.8;
+	SampleVsyncs(pacer, system, 1);
+	pacer.GetPredictedDisplayTime(1, 1, &error);
+	CHECK(error > 0.0);
+
+	// An outlier above it discards the history, so only that sample is left
+	system.Offset = system.Period * REV_PACER_RESET_THRESHOLD * 1.2;
+	SampleVsyncs(pacer, system, 1);
+	pacer.GetPredictedDisplayTime(2, 2, &error);
+	CHECK_EQUAL(error, 0.0);
+	system.Offset = 0.0;
+
+	// A display mode change resets the fit to the new nominal duration
+	SampleVsyncs(pacer, system, REV_PACER_SAMPLE_COUNT);
+	system.SetRate(120.0f, 1.0 / 120.0);
+	SampleVsyncs(pacer, system, REV_PACER_SAMPLE_COUNT);
+	double displayTime = pacer.GetPredictedDisplayTime(3, 3, &error);
+	CHECK_NEAR(displayTime, system.VsyncTime(system.Counter() + 1), 1e-6);
+	CHECK_NEAR(pacer.GetPredictedDisplayTime(13, 3) - displayTime, 10.0 / 120.0, 1e-6);
+	CHECK(error < 1e-6);
+}
+
+TEST(FramePacer_SampleSkipsWhenBusy)
+{
+	VsyncSystem system(90.0f, 1.0 / 90.0);
+	WaitCompositor compositor;
+	g_Now = system.BaseTime;
+	FramePacer pacer(&compositor, &system, Now);
+
+	// Sample the vsync from inside an update of the timeline, the lock is taken so the
+	// session thread must skip the tick instead of blocking
+	system.Reenter = &pacer;
+	pacer.GetPredictedDisplayTime(1, 1);
+	CHECK_EQUAL(system.Queries, 1);
+
+	// Once the lock is released sampling works again
+	pacer.Sample();
+	CHECK_EQUAL(system.Queries, 2);
+}
+
+/*
+	Simulates an application that renders a frame while the previous frames are still in flight,
+	so it predicts the display time of each frame again on every frame until it's displayed.
+	Every prediction of a frame must agree with the vsync it's actually displayed at.
+*/
+static void RunPipeline(int depth)
+{
+	VsyncSystem system(90.0f, 1.0 / 90.0);
+	WaitCompositor compositor(&system);
+	g_Now = system.BaseTime;
+	FramePacer pacer(&compositor, &system, Now);
+	SampleVsyncs(pacer, system, REV_PACER_SAMPLE_COUNT);
+
+	double predicted[REV_TEST_PIPELINE_FRAMES + 4] = {};
+	int mismatches = 0;
+	for (long long frame = 1; frame <= REV_TEST_PIPELINE_FRAMES; frame++)
+	{
+		CHECK(pacer.WaitToBeginFrame(frame) == vr::VRCompositorError_None);
+		double vsyncTime = system.VsyncTime(system.Counter() + 1);
+
+		// The frame that just began is displayed at the next vsync, however early it was predicted
+		if (fabs(pacer.GetPredictedDisplayTime(frame, frame) - vsyncTime) > 1e-6)
+			mismatches++;
+		if (predicted[frame] != 0.0 && fabs(predicted[frame] - vsyncTime) > 1e-6)
+			mismatches++;
+
+		for (int ahead = 1; ahead <= depth; ahead++)
+		{
+			double displayTime = pacer.GetPredictedDisplayTime(frame + ahead, frame);
+			if (predicted[frame + ahead] == 0.0)
+				predicted[frame + ahead] = displayTime;
+			else if (fabs(predicted[frame + ahead] - displayTime) > 1e-6)
+				mismatches++;
+		}
+
+		// The frame takes most of the vsync interval, the session thread samples in between
+		g_Now += 0.005;
+		pacer.Sample();
+	}
+
+	// The application blocked exactly once per frame
+	CHECK_EQUAL(compositor.Waits, REV_TEST_PIPELINE_FRAMES);
+	CHECK_EQUAL(mismatches, 0);
+}
+
+TEST(FramePacer_Pipelined)
+{
+	RunPipeline(2);
+	RunPipeline(3);
+}
+
+TEST(FramePacer_RestartedIndices)
+{
+	VsyncSystem system(90.0f, 1.0 / 90.0);
+	WaitCompositor compositor(&system);
+	g_Now = system.BaseTime;
+	FramePacer pacer(&compositor, &system, Now);
+	SampleVsyncs(pacer, system, REV_PACER_SAMPLE_COUNT);
+
+	for (long long frame = 1; frame <= 50; frame++)
+	{
+		pacer.WaitToBeginFrame(frame);
+		g_Now += 0.005;
+	}
+	CHECK_EQUAL(compositor.Waits, 50);
+
+	// The application starts counting from the beginning again, it must still be paced
+	CHECK(pacer.WaitToBeginFrame(1) == vr::VRCompositorError_None);
+	CHECK_EQUAL(compositor.Waits, 51);
+	double displayTime = pacer.GetPredictedDisplayTime(1, 1);
+	CHECK_NEAR(displayTime, system.VsyncTime(system.Counter() + 1), 1e-6);
+	CHECK_NEAR(pacer.GetPredictedDisplayTime(2, 1) - displayTime, system.Period, 1e-6);
+	g_Now += 0.005;
+
+	CHECK(pacer.WaitToBeginFrame(2) == vr::VRCompositorError_None);
+	CHECK_EQUAL(compositor.Waits, 52);
+	CHECK_NEAR(pacer.GetPredictedDisplayTime(2, 2), displayTime + system.Period, 1e-6);
+}
@@ -0,0 +1,163 @@
+#include "Test.h"
+#include "HapticsBuffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define STRESS_PRODUCERS 4
+#define STRESS_SAMPLES 60
+#define STRESS_ROUNDS 500
+#define STOP_ROUNDS 2000
+
+static uint8_t ReadSample(HapticsBuffer& haptics)
+{
+	return (uint8_t)(haptics.GetSample() * 255.0f + 0.5f);
+}
+
+TEST(HapticsBuffer_Enqueue)
+{
+	HapticsBuffer haptics;
+	uint8_t samples[] = { 10, 20, 30 };
+	ovrHapticsBuffer buffer = { samples, 3, ovrHapticsBufferSubmit_Enqueue };
+	CHECK(haptics.AddSamples(&buffer));
+	CHECK(haptics.IsActive());
+
+	ovrHapticsPlaybackState state = haptics.GetState();
+	CHECK_EQUAL(state.SamplesQueued, 3);
+	CHECK_EQUAL(state.RemainingQueueSpace, OVR_HAPTICS_BUFFER_SAMPLES_MAX - 3);
+
+	CHECK_EQUAL(ReadSample(haptics), 10);
+	CHECK_EQUAL(ReadSample(haptics), 20);
+	CHECK_EQUAL(ReadSample(haptics), 30);
+	CHECK_EQUAL(ReadSample(haptics), 0);
+	CHECK(!haptics.IsActive());
+}
+
+TEST(HapticsBuffer_Overflow)
+{
+	HapticsBuffer haptics;
+	std::vector<uint8_t> samples(OVR_HAPTICS_BUFFER_SAMPLES_MAX + 16);
+	for (size_t i = 0; i < samples.size(); i++)
+		samples[i] = uint8_t(i % 255 + 1);
+
+	// Samples that don't fit in the buffer are dropped
+	ovrHapticsBuffer buffer = { samples.data(), (int)samples.size(), ovrHapticsBufferSubmit_Enqueue };
+	CHECK(haptics.AddSamples(&buffer));
+	CHECK_EQUAL(haptics.GetState().RemainingQueueSpace, 0);
+
+	for (int i = 0; i < OVR_HAPTICS_BUFFER_SAMPLES_MAX; i++)
+		CHECK_EQUAL(ReadSample(haptics), samples[i]);
+	CHECK_EQUAL(ReadSample(haptics), 0);
+
+	// The indices wrapped around, the buffer must still work afterwards
+	CHECK(haptics.AddSamples(&buffer));
+	CHECK_EQUAL(ReadSample(haptics), samples[0]);
+}
+
+/*
+	Several producers submit short buffers while the consumer drains them. A round never queues
+	more than the buffer holds, so no sample may be dropped, and the samples of every producer
+	must arrive in the order they were submitted.
+*/
+TEST(HapticsBuffer_MultipleProducers)
+{
+	static_assert(STRESS_PRODUCERS * STRESS_SAMPLES <= OVR_HAPTICS_BUFFER_SAMPLES_MAX, "A round must fit in the buffer");
+	static_assert(STRESS_PRODUCERS * STRESS_SAMPLES < 255, "Every sample must have a unique non-zero value");
+
+	int lost = 0, reordered = 0;
+	for (int round = 0; round < STRESS_ROUNDS; round++)
+	{
+		HapticsBuffer haptics;
+		std::atomic_int ready(0), done(0);
+
+		std::vector<std::thread> producers;
+		for (int p = 0; p < STRESS_PRODUCERS; p++)
+		{
+			producers.emplace_back([&haptics, &ready, &done, p, round]()
+			{
+				uint8_t samples[STRESS_SAMPLES];
+				for (int i = 0; i < STRESS_SAMPLES; i++)
+					samples[i] = uint8_t(1 + p * STRESS_SAMPLES + i);
+
+				ready++;
+				while (ready < STRESS_PRODUCERS)
+					std::this_thread::yield();
+
+				// Vary the submission size so the reservations interleave differently every round
+				for (int i = 0; i < STRESS_SAMPLES;)
+				{
+					int count = std::min(1 + (i + p + round) % 7, STRESS_SAMPLES - i);
+					ovrHapticsBuffer buffer = { samples + i, count, ovrHapticsBufferSubmit_Enqueue };
+					haptics.AddSamples(&buffer);
+					i += count;
+				}
+				done++;
+			});
+		}
+
+		// Stop when all samples arrived, or when the producers are done and nothing is left
+		int next[STRESS_PRODUCERS] = { 0 };
+		int received = 0;
+		while (received < STRESS_PRODUCERS * STRESS_SAMPLES)
+		{
+			bool finished = done == STRESS_PRODUCERS;
+			uint8_t sample = ReadSample(haptics);
+			if (sample == 0)
+			{
+				if (finished && !haptics.IsActive())
+					break;
+				continue;
+			}
+
+			int p = (sample - 1) / STRESS_SAMPLES;
+			if (sample - 1 - p * STRESS_SAMPLES != next[p]++)
+				reordered++;
+			received++;
+		}
+
+		for (std::thread& t : producers)
+			t.join();
+
+		while (ReadSample(haptics) != 0)
+			received++;
+		lost += STRESS_PRODUCERS * STRESS_SAMPLES - received;
+	}
+
+	CHECK_EQUAL(lost, 0);
+	CHECK_EQUAL(reordered, 0);
+}
+
+/*
+	A constant vibration is stopped while the consumer is sampling it. If the stop lands between
+	the consumer reading the timeout and decrementing it, the timeout must not wrap around and
+	keep the vibration running for another 200 seconds.
+*/
+TEST(HapticsBuffer_StopConstant)
+{
+	int wrapped = 0;
+	for (int round = 0; round < STOP_ROUNDS; round++)
+	{
+		HapticsBuffer haptics;
+		haptics.SetConstant(1.0f, 1.0f);
+
+		std::atomic_bool stopped(false);
+		std::thread stopper([&haptics, &stopped, round]()
+		{
+			// Vary the delay so the stop lands on a different point of the consumer every round
+			for (volatile int i = 0; i < round % 64; i++);
+			haptics.SetConstant(0.0f, 0.0f);
+			stopped = true;
+		});
+
+		while (!stopped)
+			haptics.GetSample();
+		stopper.join();
+
+		if (haptics.IsActive())
+			wrapped++;
+	}
+
+	CHECK_EQUAL(wrapped, 0);
+}
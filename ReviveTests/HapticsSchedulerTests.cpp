@@ -0,0 +1,174 @@
+#include "Test.h"
+#include "HapticsScheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define SCHEDULE_PERIOD_US 1000
+
+// Only the test moves this clock, the scheduler sleeps in real time until it has passed the deadline
+struct SimulatedClock
+{
+	typedef std::chrono::microseconds duration;
+	typedef duration::rep rep;
+	typedef duration::period period;
+	typedef std::chrono::time_point<SimulatedClock> time_point;
+	static const bool is_steady = true;
+
+	static std::atomic<rep> Now;
+	static time_point now() { return time_point(duration(Now.load())); }
+};
+
+std::atomic<SimulatedClock::rep> SimulatedClock::Now(0);
+
+// Plays a number of samples and records the simulated time of every play
+class ScheduledDevice
+{
+public:
+	std::atomic_int Remaining;
+	std::function<void()> OnIdle;
+
+	ScheduledDevice() : Remaining(0) { }
+
+	bool IsVibrating()
+	{
+		if (Remaining > 0)
+			return true;
+
+		// Runs while the scheduler holds its lock, right before it goes to sleep
+		if (OnIdle)
+		{
+			std::function<void()> idle = OnIdle;
+			OnIdle = nullptr;
+			idle();
+		}
+		return false;
+	}
+
+	void PlayVibration(std::chrono::microseconds period)
+	{
+		if (Remaining > 0)
+			Remaining--;
+
+		std::lock_guard<std::mutex> lk(m_Mutex);
+		m_Plays.push_back(SimulatedClock::Now);
+	}
+
+	std::vector<SimulatedClock::rep> GetPlays()
+	{
+		std::lock_guard<std::mutex> lk(m_Mutex);
+		return m_Plays;
+	}
+
+	// Waits in real time until the scheduler played the given number of samples
+	bool WaitForPlays(size_t count)
+	{
+		for (int i = 0; i < 1000; i++)
+		{
+			if (GetPlays().size() >= count)
+				return GetPlays().size() == count;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return false;
+	}
+
+	// Gives the scheduler some real time to play samples it shouldn't
+	bool NoMorePlays(size_t count)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		return GetPlays().size() == count;
+	}
+
+private:
+	std::mutex m_Mutex;
+	std::vector<SimulatedClock::rep> m_Plays;
+};
+
+static void Advance(SimulatedClock::rep to)
+{
+	SimulatedClock::Now = to;
+}
+
+TEST(HapticsScheduler_Deadlines)
+{
+	ScheduledDevice device;
+	std::vector<ScheduledDevice*> devices = { &device };
+	HapticsScheduler<ScheduledDevice, SimulatedClock> scheduler(devices, std::chrono::microseconds(SCHEDULE_PERIOD_US));
+	Advance(0);
+	scheduler.Start();
+
+	// The first sample is played as soon as the vibration is submitted
+	device.Remaining = 8;
+	scheduler.Wake();
+	CHECK(device.WaitForPlays(1));
+	CHECK(device.NoMorePlays(1));
+
+	// Every following sample waits for its deadline
+	for (int i = 1; i <= 3; i++)
+	{
+		Advance(i * SCHEDULE_PERIOD_US - 1);
+		CHECK(device.NoMorePlays(i));
+		Advance(i * SCHEDULE_PERIOD_US);
+		CHECK(device.WaitForPlays(i + 1));
+	}
+
+	// After a stall the missed samples aren't played in a burst, the schedule restarts from now
+	Advance(13 * SCHEDULE_PERIOD_US);
+	CHECK(device.WaitForPlays(5));
+	CHECK(device.NoMorePlays(5));
+	Advance(14 * SCHEDULE_PERIOD_US);
+	CHECK(device.WaitForPlays(6));
+
+	// A late wakeup that's within a period keeps the absolute deadlines, so the rate doesn't drift
+	Advance(15 * SCHEDULE_PERIOD_US + SCHEDULE_PERIOD_US / 2);
+	CHECK(device.WaitForPlays(7));
+	Advance(16 * SCHEDULE_PERIOD_US);
+	CHECK(device.WaitForPlays(8));
+
+	// Once the samples are played the scheduler goes to sleep
+	Advance(17 * SCHEDULE_PERIOD_US);
+	CHECK(device.NoMorePlays(8));
+	scheduler.Stop();
+
+	const SimulatedClock::rep expected[] = { 0, 1, 2, 3, 13, 14, 15, 16 };
+	std::vector<SimulatedClock::rep> plays = device.GetPlays();
+	CHECK_EQUAL(plays.size(), 8);
+	for (size_t i = 0; i < plays.size() && i < 8; i++)
+	{
+		SimulatedClock::rep time = expected[i] * SCHEDULE_PERIOD_US;
+		if (i == 6)
+			time += SCHEDULE_PERIOD_US / 2;
+		CHECK_EQUAL(plays[i], time);
+	}
+}
+
+/*
+	A vibration is submitted after the scheduler found all devices idle, but before it went to
+	sleep. The wakeup has to wait for the lock and must still be seen once the scheduler sleeps.
+*/
+TEST(HapticsScheduler_LostWakeup)
+{
+	ScheduledDevice device;
+	std::vector<ScheduledDevice*> devices = { &device };
+	HapticsScheduler<ScheduledDevice, SimulatedClock> scheduler(devices, std::chrono::microseconds(SCHEDULE_PERIOD_US));
+	Advance(0);
+
+	std::thread submitter;
+	device.OnIdle = [&]()
+	{
+		submitter = std::thread([&]()
+		{
+			device.Remaining = 1;
+			scheduler.Wake();
+		});
+	};
+	scheduler.Start();
+
+	CHECK(device.WaitForPlays(1));
+	scheduler.Stop();
+	submitter.join();
+}
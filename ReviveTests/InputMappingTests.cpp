@@ -0,0 +1,241 @@
+#include "Test.h"
+#include "LuaState.h"
+#include "InputMapping.h"
+#include "InputScript.h"
+#include "Settings.h"
+#include "SettingsManager.h"
+
+#include <string.h>
+
+#define BUTTON(id) (1ull << (id))
+
+/*
+	Sequences of controller states with the results of default.lua, the native mapping must
+	reproduce the script exactly. Every frame is also run through the script itself, so the
+	comparison doesn't depend on the golden values. Every frame is evaluated in order,
+	because the grip and virtual thumbstick keep state between frames.
+*/
+struct GoldenFrame
+{
+	double Time;
+	uint64_t Pressed;
+	uint64_t Touched;
+	float Axis[vr::k_unControllerStateAxisCount][2];
+
+	unsigned int Buttons;
+	unsigned int Touches;
+	float IndexTrigger;
+	float HandTrigger;
+	float Thumbstick[2];
+	float ThumbstickNoDeadzone[2];
+};
+
+static InputSettings DefaultSettings(revGripType grip = revGrip_Normal, bool triggerAsGrip = false)
+{
+	InputSettings settings = {};
+	settings.Deadzone = REV_DEFAULT_THUMB_DEADZONE;
+	settings.ToggleGrip = grip;
+	settings.TriggerAsGrip = triggerAsGrip;
+	settings.ToggleDelay = REV_DEFAULT_TOGGLE_DELAY;
+	return settings;
+}
+
+static uint16_t AxisTypes(vr::EVRControllerAxisType a0, vr::EVRControllerAxisType a1, vr::EVRControllerAxisType a2 = vr::k_eControllerAxis_None)
+{
+	return uint16_t(a0 | (a1 << 2) | (a2 << 4));
+}
+
+#define CHECK_OUTPUTS(input, expected, hand) \
+	CHECK_EQUAL(input.Buttons, expected.Buttons); \
+	CHECK_EQUAL(input.Touches, expected.Touches); \
+	CHECK_EQUAL(input.IndexTrigger[hand], expected.IndexTrigger[hand]); \
+	CHECK_EQUAL(input.HandTrigger[hand], expected.HandTrigger[hand]); \
+	CHECK_EQUAL(input.Thumbstick[hand].x, expected.Thumbstick[hand].x); \
+	CHECK_EQUAL(input.Thumbstick[hand].y, expected.Thumbstick[hand].y); \
+	CHECK_EQUAL(input.ThumbstickNoDeadzone[hand].x, expected.ThumbstickNoDeadzone[hand].x); \
+	CHECK_EQUAL(input.ThumbstickNoDeadzone[hand].y, expected.ThumbstickNoDeadzone[hand].y);
+
+static void CheckGolden(const char* model, uint16_t axisTypes, ovrHandType hand, const InputSettings& settings,
+	const GoldenFrame* frames, size_t count)
+{
+	InputMapping mapping;
+	mapping.Compile(model, axisTypes, hand);
+
+	// The default script is the reference, it's fed the same frames in the same order
+	lua_State* L = LoadInputScript(REV_SCRIPT_DIR "default.lua");
+	CHECK(L);
+	InputScript script;
+	if (L && script.Bind(L, 1))
+		script.SetModel(model, strlen(model), 1);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const GoldenFrame& frame = frames[i];
+
+		vr::VRControllerState_t state = {};
+		state.ulButtonPressed = frame.Pressed;
+		state.ulButtonTouched = frame.Touched;
+		for (uint32_t j = 0; j < vr::k_unControllerStateAxisCount; j++)
+		{
+			state.rAxis[j].x = frame.Axis[j][0];
+			state.rAxis[j].y = frame.Axis[j][1];
+		}
+
+		int failures = g_TestFailures;
+		ovrInputState input = {};
+		CHECK(mapping.GetInputState(state, settings, frame.Time, &input));
+
+		// The results must be identical to the script, not just close
+		if (L)
+		{
+			ovrInputState reference = {};
+			CHECK(script.GetInputState(state, axisTypes, settings, hand, frame.Time, &reference));
+			CHECK_OUTPUTS(input, reference, hand);
+		}
+
+		// The golden values document the expected results of the script
+		ovrInputState golden = {};
+		golden.Buttons = frame.Buttons;
+		golden.Touches = frame.Touches;
+		golden.IndexTrigger[hand] = frame.IndexTrigger;
+		golden.HandTrigger[hand] = frame.HandTrigger;
+		golden.Thumbstick[hand] = ovrVector2f{ frame.Thumbstick[0], frame.Thumbstick[1] };
+		golden.ThumbstickNoDeadzone[hand] = ovrVector2f{ frame.ThumbstickNoDeadzone[0], frame.ThumbstickNoDeadzone[1] };
+		CHECK_OUTPUTS(input, golden, hand);
+
+		// Only the outputs of the polled hand are written
+		ovrHandType other = hand == ovrHand_Left ? ovrHand_Right : ovrHand_Left;
+		CHECK_EQUAL(input.IndexTrigger[other], 0.0f);
+		CHECK_EQUAL(input.HandTrigger[other], 0.0f);
+
+		if (g_TestFailures != failures)
+			printf("  in frame %d\n", (int)i);
+	}
+
+	if (L)
+		lua_close(L);
+}
+
+TEST(InputMapping_ViveWand)
+{
+	const uint64_t menu = BUTTON(vr::k_EButton_ApplicationMenu), grip = BUTTON(vr::k_EButton_Grip);
+	const uint64_t a = BUTTON(vr::k_EButton_A), pad = BUTTON(vr::k_EButton_SteamVR_Touchpad);
+	const uint64_t trigger = BUTTON(vr::k_EButton_SteamVR_Trigger);
+
+	const GoldenFrame frames[] = {
+		// Idle, the hand trigger is kept slightly pressed
+		{ 0.0, 0, 0, {}, 0, 0, 0.0f, 0.01f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		// Menu and A
+		{ 0.1, menu | a, a, {}, ovrButton_Enter | ovrButton_A, ovrTouch_A, 0.0f, 0.01f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		// Touchpad clicked in the lower quadrant, the virtual thumbstick is centered on the first touch
+		{ 0.2, pad, pad, { { 0.5f, -0.6f } }, ovrButton_A, ovrTouch_A, 0.0f, 0.01f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		// Sliding up, the offset from the center is (0, 0.8)
+		{ 0.3, 0, pad, { { 0.5f, 0.2f } }, 0, ovrTouch_RThumb, 0.0f, 0.01f, { 0.0f, 0.909090936f }, { 0.0f, 0.8f } },
+		// Grip pressed with the trigger touched, the touches still see the grip from the previous frame
+		{ 0.4, grip, trigger, { {}, { 0.7f, 0.0f } }, 0, ovrTouch_RIndexTrigger, 0.7f, 1.0f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		// Gripped without touching anything, the fingers are pointing
+		{ 0.5, grip, 0, {}, 0, ovrTouch_RThumbUp | ovrTouch_RIndexPointing, 0.0f, 1.0f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		// Grip released
+		{ 0.6, 0, 0, {}, 0, ovrTouch_RThumbUp | ovrTouch_RIndexPointing, 0.0f, 0.01f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		{ 0.7, 0, 0, {}, 0, 0, 0.0f, 0.01f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+	};
+
+	CheckGolden("vr_controller_vive_1_5", AxisTypes(vr::k_eControllerAxis_TrackPad, vr::k_eControllerAxis_Trigger),
+		ovrHand_Right, DefaultSettings(), frames, sizeof(frames) / sizeof(frames[0]));
+}
+
+TEST(InputMapping_LeftQuadrants)
+{
+	const uint64_t b = BUTTON(8), pad = BUTTON(vr::k_EButton_SteamVR_Touchpad);
+
+	const GoldenFrame frames[] = {
+		// Left of the diagonal is the thumbstick click on the left hand
+		{ 0.0, b | pad, pad, { { -0.5f, 0.1f } }, ovrButton_Y | ovrButton_LThumb, ovrTouch_LThumb, 0.0f, 0.01f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		{ 0.1, pad, pad, { { 0.5f, -0.1f } }, ovrButton_Y, ovrTouch_Y, 0.0f, 0.01f, { 0.980580688f, -0.196116135f }, { 0.980580688f, -0.196116135f } },
+		{ 0.2, pad, pad, { { 0.1f, -0.5f } }, ovrButton_X, ovrTouch_X, 0.0f, 0.01f, { 0.7052145f, -0.7052145f }, { 0.6f, -0.6f } },
+	};
+
+	CheckGolden("vr_controller_vive_1_5", AxisTypes(vr::k_eControllerAxis_TrackPad, vr::k_eControllerAxis_Trigger),
+		ovrHand_Left, DefaultSettings(), frames, sizeof(frames) / sizeof(frames[0]));
+}
+
+TEST(InputMapping_Joystick)
+{
+	const GoldenFrame frames[] = {
+		// A physical joystick uses a radial deadzone without an outer deadzone
+		{ 0.0, 0, 0, { {}, { 0.25f, 0.0f }, { 0.0f, 0.65f } }, 0, 0, 0.25f, 0.01f, { 0.0f, 0.49999997f }, { 0.0f, 0.65f } },
+		{ 0.1, 0, 0, { {}, {}, { 0.1f, -0.2f } }, 0, 0, 0.0f, 0.01f, { 0.0f, 0.0f }, { 0.1f, -0.2f } },
+	};
+
+	CheckGolden("WindowsMR", AxisTypes(vr::k_eControllerAxis_TrackPad, vr::k_eControllerAxis_Trigger, vr::k_eControllerAxis_Joystick),
+		ovrHand_Right, DefaultSettings(), frames, sizeof(frames) / sizeof(frames[0]));
+}
+
+TEST(InputMapping_ToggleGrip)
+{
+	const uint64_t grip = BUTTON(vr::k_EButton_Grip);
+
+	const GoldenFrame frames[] = {
+		{ 0.0, grip, 0, {}, 0, 0, 0.0f, 1.0f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		{ 0.1, 0, 0, {}, 0, ovrTouch_RThumbUp | ovrTouch_RIndexPointing, 0.0f, 1.0f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		{ 0.2, grip, 0, {}, 0, ovrTouch_RThumbUp | ovrTouch_RIndexPointing, 0.0f, 0.01f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		{ 0.3, 0, 0, {}, 0, 0, 0.0f, 0.01f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+	};
+
+	CheckGolden("vr_controller_vive_1_5", AxisTypes(vr::k_eControllerAxis_TrackPad, vr::k_eControllerAxis_Trigger),
+		ovrHand_Right, DefaultSettings(revGrip_Toggle), frames, sizeof(frames) / sizeof(frames[0]));
+}
+
+TEST(InputMapping_HybridGrip)
+{
+	const uint64_t grip = BUTTON(vr::k_EButton_Grip);
+
+	const GoldenFrame frames[] = {
+		// Released within the delay, so the grip is toggled on
+		{ 0.0, grip, 0, {}, 0, 0, 0.0f, 1.0f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		{ 0.2, 0, 0, {}, 0, ovrTouch_RThumbUp | ovrTouch_RIndexPointing, 0.0f, 1.0f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		// Pressing again doesn't set a new timestamp, so the next release lets go
+		{ 1.0, grip, 0, {}, 0, ovrTouch_RThumbUp | ovrTouch_RIndexPointing, 0.0f, 1.0f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		{ 1.1, 0, 0, {}, 0, ovrTouch_RThumbUp | ovrTouch_RIndexPointing, 0.0f, 0.01f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		// Held past the delay, so it's released normally
+		{ 2.0, grip, 0, {}, 0, 0, 0.0f, 1.0f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		{ 2.6, 0, 0, {}, 0, ovrTouch_RThumbUp | ovrTouch_RIndexPointing, 0.0f, 0.01f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+	};
+
+	CheckGolden("vr_controller_vive_1_5", AxisTypes(vr::k_eControllerAxis_TrackPad, vr::k_eControllerAxis_Trigger),
+		ovrHand_Right, DefaultSettings(revGrip_Hybrid), frames, sizeof(frames) / sizeof(frames[0]));
+}
+
+TEST(InputMapping_TriggerAsGrip)
+{
+	const uint64_t grip = BUTTON(vr::k_EButton_Grip);
+
+	const GoldenFrame frames[] = {
+		{ 0.0, 0, 0, { {}, { 0.4f, 0.0f } }, 0, 0, 0.0f, 0.4f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+		{ 0.1, grip, 0, { {}, { 0.4f, 0.0f } }, 0, 0, 0.4f, 1.0f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+	};
+
+	CheckGolden("vr_controller_vive_1_5", AxisTypes(vr::k_eControllerAxis_TrackPad, vr::k_eControllerAxis_Trigger),
+		ovrHand_Right, DefaultSettings(revGrip_Normal, true), frames, sizeof(frames) / sizeof(frames[0]));
+}
+
+TEST(InputMapping_Knuckles)
+{
+	const uint64_t menu = BUTTON(vr::k_EButton_ApplicationMenu), grip = BUTTON(vr::k_EButton_Grip);
+	const uint64_t pad = BUTTON(vr::k_EButton_SteamVR_Touchpad), trigger = BUTTON(vr::k_EButton_SteamVR_Trigger);
+
+	const GoldenFrame frames[] = {
+		// The menu and grip chord is the menu button, it doesn't press the face buttons
+		{ 0.0, menu | grip | pad, menu | grip | pad | trigger, { { 0.6f, 0.8f }, { 0.4f, 0.0f }, {}, { 0.9f, 0.6f } },
+			ovrButton_Enter | ovrButton_RThumb, ovrTouch_A | ovrTouch_B | ovrTouch_RThumb | ovrTouch_RIndexTrigger,
+			0.4f, 0.6f, { 0.6f, 0.8f }, { 0.6f, 0.8f } },
+		// Nothing touched and the index finger curl is low, so the hand is pointing with the thumb up
+		{ 0.1, grip, 0, { { 0.1f, 0.1f }, {}, {}, { 0.5f, 0.2f } },
+			ovrButton_A, ovrTouch_RThumbUp | ovrTouch_RIndexPointing, 0.0f, 0.2f, { 0.0f, 0.0f }, { 0.1f, 0.1f } },
+		// Touching a face button keeps the thumb down
+		{ 0.2, menu, menu, { {}, {}, {}, { 0.8f, 0.0f } },
+			ovrButton_B, ovrTouch_B, 0.0f, 0.0f, { 0.0f, 0.0f }, { 0.0f, 0.0f } },
+	};
+
+	CheckGolden("Knuckles", 0, ovrHand_Right, DefaultSettings(), frames, sizeof(frames) / sizeof(frames[0]));
+}
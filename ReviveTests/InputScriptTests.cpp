@@ -0,0 +1,157 @@
+#include "Test.h"
+#include "LuaState.h"
+#include "InputScript.h"
+#include "Settings.h"
+#include "SettingsManager.h"
+
+#include <chrono>
+#include <string.h>
+
+#define SCRIPT_MODEL "vr_controller_vive_1_5"
+#define SCRIPT_WARMUP_POLLS 1000
+#define SCRIPT_BENCHMARK_POLLS 10000
+
+static InputSettings ScriptSettings()
+{
+	InputSettings settings = {};
+	settings.Deadzone = REV_DEFAULT_THUMB_DEADZONE;
+	settings.ToggleGrip = revGrip_Normal;
+	settings.ToggleDelay = REV_DEFAULT_TOGGLE_DELAY;
+	return settings;
+}
+
+// Sweeps the touchpad around and presses a few buttons, so every callback of the script is exercised
+static vr::VRControllerState_t SweepState(int i)
+{
+	vr::VRControllerState_t state = {};
+	state.unPacketNum = i;
+	if (i % 16 < 12)
+		state.ulButtonTouched |= vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Touchpad);
+	if (i % 32 >= 24)
+		state.ulButtonPressed |= vr::ButtonMaskFromId(vr::k_EButton_Grip);
+	if (i % 8 == 0)
+		state.ulButtonPressed |= vr::ButtonMaskFromId(vr::k_EButton_A);
+	state.rAxis[0].x = float(i % 16) / 8.0f - 1.0f;
+	state.rAxis[0].y = float(i % 12) / 6.0f - 1.0f;
+	state.rAxis[1].x = float(i % 10) / 10.0f;
+	return state;
+}
+
+static uint16_t AxisTypes()
+{
+	return uint16_t(vr::k_eControllerAxis_TrackPad | (vr::k_eControllerAxis_Trigger << 2));
+}
+
+static bool Poll(InputScript& script, const vr::VRControllerState_t& state, const InputSettings& settings, double time)
+{
+	ovrInputState input = {};
+	return script.GetInputState(state, AxisTypes(), settings, ovrHand_Right, time, &input);
+}
+
+static bool GetPressed(lua_State* L, const char* table, const char* button)
+{
+	lua_getglobal(L, table);
+	lua_getfield(L, -1, button);
+	lua_getfield(L, -1, "pressed");
+	bool pressed = !!lua_toboolean(L, -1);
+	lua_pop(L, 3);
+	return pressed;
+}
+
+static bool GetGlobalBool(lua_State* L, const char* name)
+{
+	lua_getglobal(L, name);
+	bool value = !!lua_toboolean(L, -1);
+	lua_pop(L, 1);
+	return value;
+}
+
+TEST(InputScript_StateTables)
+{
+	lua_State* L = LoadInputScript(REV_SCRIPT_DIR "default.lua");
+	CHECK(L);
+	if (!L)
+		return;
+
+	InputScript script;
+	InputSettings settings = ScriptSettings();
+	CHECK(script.Bind(L, 1));
+	script.SetModel(SCRIPT_MODEL, strlen(SCRIPT_MODEL), 1);
+	CHECK(!script.Bind(L, 1));
+
+	// A new model version has to be pushed again
+	CHECK(script.Bind(L, 2));
+	script.SetModel(SCRIPT_MODEL, strlen(SCRIPT_MODEL), 2);
+
+	// Record what the script sees, and keep a reference to the state of the first poll
+	CHECK(!luaL_dostring(L,
+		"function GetInput()\n"
+		"  seen_last = last_state ~= nil and last_state.A.pressed\n"
+		"  kept = kept or state\n"
+		"  return 0, 0, 0, 0, 0, 0, 0, 0\n"
+		"end\n"));
+
+	vr::VRControllerState_t pressed = {}, released = {};
+	pressed.ulButtonPressed = vr::ButtonMaskFromId(vr::k_EButton_A);
+
+	CHECK(Poll(script, pressed, settings, 0.0));
+	CHECK(!GetGlobalBool(L, "seen_last"));
+	CHECK(GetPressed(L, "state", "A"));
+
+	// During the next poll last_state is the state of the previous one
+	CHECK(Poll(script, released, settings, 0.1));
+	CHECK(GetGlobalBool(L, "seen_last"));
+	CHECK(!GetPressed(L, "state", "A"));
+	CHECK(GetPressed(L, "kept", "A"));
+
+	// The two tables alternate, so the kept reference is overwritten two polls later
+	CHECK(Poll(script, released, settings, 0.2));
+	CHECK(!GetGlobalBool(L, "seen_last"));
+	CHECK(!GetPressed(L, "kept", "A"));
+
+	// The error handler is the only value left on the stack
+	CHECK_EQUAL(lua_gettop(L), 1);
+	lua_close(L);
+}
+
+/*
+	Measures a poll of the default script with the garbage collector stopped, so every byte
+	it allocates shows up in the heap size. Once the field tables exist and the JIT is warmed
+	up a poll mustn't allocate anything, a single table or string would be dozens of bytes.
+*/
+TEST(InputScript_PollBenchmark)
+{
+	lua_State* L = LoadInputScript(REV_SCRIPT_DIR "default.lua");
+	CHECK(L);
+	if (!L)
+		return;
+
+	InputScript script;
+	InputSettings settings = ScriptSettings();
+	if (script.Bind(L, 1))
+		script.SetModel(SCRIPT_MODEL, strlen(SCRIPT_MODEL), 1);
+
+	int poll = 0;
+	for (; poll < SCRIPT_WARMUP_POLLS; poll++)
+		CHECK(Poll(script, SweepState(poll), settings, poll / 90.0));
+
+	lua_gc(L, LUA_GCCOLLECT, 0);
+	lua_gc(L, LUA_GCSTOP, 0);
+	int before = lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+
+	bool success = true;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (; poll < SCRIPT_WARMUP_POLLS + SCRIPT_BENCHMARK_POLLS; poll++)
+		success &= Poll(script, SweepState(poll), settings, poll / 90.0);
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+	int after = lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+	lua_gc(L, LUA_GCRESTART, 0);
+
+	double bytes = double(after - before) / SCRIPT_BENCHMARK_POLLS;
+	printf("  %.2f us and %.3f bytes allocated per poll\n", elapsed.count() / SCRIPT_BENCHMARK_POLLS, bytes);
+
+	CHECK(success);
+	CHECK(bytes < 1.0);
+	lua_close(L);
+}
@@ -0,0 +1,100 @@
+#include "Test.h"
+#include "LayerBlit.h"
+
+#include <openvr.h>
+
+#define TARGET_WIDTH 2000
+#define TARGET_HEIGHT 1000
+
+static LayerBlit MakeBlit(int x, int y, int w, int h, vr::HmdVector4_t quad)
+{
+	LayerBlit blit = {};
+	blit.Viewport = ovrRecti{ { x, y }, { w, h } };
+	blit.Bounds = { 0.0f, 0.0f, 1.0f, 1.0f };
+	blit.Quad = quad;
+	return blit;
+}
+
+TEST(LayerBlit_FullViewport)
+{
+	// A layer that covers its whole viewport covers the same part of the target
+	vr::HmdVector4_t quad;
+	vr::VRTextureBounds_t bounds;
+	LayerBlitToTarget(MakeBlit(0, 0, TARGET_WIDTH, TARGET_HEIGHT, { -1.0f, 1.0f, 1.0f, -1.0f }), TARGET_WIDTH, TARGET_HEIGHT, &quad, &bounds);
+	CHECK_EQUAL(quad.v[0], -1.0f);
+	CHECK_EQUAL(quad.v[1], 1.0f);
+	CHECK_EQUAL(quad.v[2], 1.0f);
+	CHECK_EQUAL(quad.v[3], -1.0f);
+	CHECK_EQUAL(bounds.uMin, 0.0f);
+	CHECK_EQUAL(bounds.uMax, 1.0f);
+	CHECK_EQUAL(bounds.vMin, 0.0f);
+	CHECK_EQUAL(bounds.vMax, 1.0f);
+
+	// The right half of the target, as used for the right eye of a shared render target
+	LayerBlitToTarget(MakeBlit(TARGET_WIDTH / 2, 0, TARGET_WIDTH / 2, TARGET_HEIGHT, { -1.0f, 1.0f, 1.0f, -1.0f }), TARGET_WIDTH, TARGET_HEIGHT, &quad, &bounds);
+	CHECK_EQUAL(quad.v[0], 0.0f);
+	CHECK_EQUAL(quad.v[1], 1.0f);
+	CHECK_EQUAL(quad.v[2], 1.0f);
+	CHECK_EQUAL(quad.v[3], -1.0f);
+
+	// An uninitialized viewport is the whole target
+	LayerBlitToTarget(MakeBlit(0, 0, 0, 0, { -0.5f, 0.5f, 0.5f, -0.5f }), TARGET_WIDTH, TARGET_HEIGHT, &quad, &bounds);
+	CHECK_EQUAL(quad.v[0], -0.5f);
+	CHECK_EQUAL(quad.v[1], 0.5f);
+	CHECK_EQUAL(quad.v[2], 0.5f);
+	CHECK_EQUAL(quad.v[3], -0.5f);
+}
+
+TEST(LayerBlit_Viewport)
+{
+	// The top half of the viewport in the top-right quarter of the target
+	vr::HmdVector4_t quad;
+	vr::VRTextureBounds_t bounds;
+	LayerBlitToTarget(MakeBlit(TARGET_WIDTH / 2, 0, TARGET_WIDTH / 2, TARGET_HEIGHT / 2, { -1.0f, 1.0f, 1.0f, 0.0f }), TARGET_WIDTH, TARGET_HEIGHT, &quad, &bounds);
+	CHECK_NEAR(quad.v[0], 0.0f, 1e-6f);
+	CHECK_NEAR(quad.v[1], 1.0f, 1e-6f);
+	CHECK_NEAR(quad.v[2], 1.0f, 1e-6f);
+	CHECK_NEAR(quad.v[3], 0.5f, 1e-6f);
+
+	// A layer in the bottom-left quarter of the viewport, not at the origin of the target
+	LayerBlitToTarget(MakeBlit(200, 100, 1000, 500, { -1.0f, 0.0f, 0.0f, -1.0f }), TARGET_WIDTH, TARGET_HEIGHT, &quad, &bounds);
+	CHECK_NEAR(quad.v[0], -0.8f, 1e-6f);
+	CHECK_NEAR(quad.v[1], -0.3f, 1e-6f);
+	CHECK_NEAR(quad.v[2], 0.3f, 1e-6f);
+	CHECK_NEAR(quad.v[3], -0.2f, 1e-6f);
+}
+
+TEST(LayerBlit_Clipping)
+{
+	// A quad that sticks out of the right of the viewport loses that part of the texture as well,
+	// it can't draw into the viewport of the other eye
+	vr::HmdVector4_t quad;
+	vr::VRTextureBounds_t bounds;
+	LayerBlit blit = MakeBlit(0, 0, TARGET_WIDTH / 2, TARGET_HEIGHT, { 0.0f, 2.0f, 1.0f, -1.0f });
+	blit.Bounds = { 0.0f, 0.0f, 0.5f, 1.0f };
+	LayerBlitToTarget(blit, TARGET_WIDTH, TARGET_HEIGHT, &quad, &bounds);
+	CHECK_NEAR(quad.v[0], -0.5f, 1e-6f);
+	CHECK_NEAR(quad.v[1], 0.0f, 1e-6f);
+	CHECK_NEAR(bounds.uMin, 0.0f, 1e-6f);
+	CHECK_NEAR(bounds.uMax, 0.25f, 1e-6f);
+	CHECK_NEAR(bounds.vMin, 0.0f, 1e-6f);
+	CHECK_NEAR(bounds.vMax, 1.0f, 1e-6f);
+
+	// Flipped quads are clipped on the same side
+	blit.Quad = { 2.0f, 0.0f, -1.0f, 3.0f };
+	LayerBlitToTarget(blit, TARGET_WIDTH, TARGET_HEIGHT, &quad, &bounds);
+	CHECK_NEAR(quad.v[0], 0.0f, 1e-6f);
+	CHECK_NEAR(quad.v[1], -0.5f, 1e-6f);
+	CHECK_NEAR(quad.v[2], -1.0f, 1e-6f);
+	CHECK_NEAR(quad.v[3], 1.0f, 1e-6f);
+	CHECK_NEAR(bounds.uMin, 0.25f, 1e-6f);
+	CHECK_NEAR(bounds.uMax, 0.5f, 1e-6f);
+	CHECK_NEAR(bounds.vMin, 0.0f, 1e-6f);
+	CHECK_NEAR(bounds.vMax, 0.5f, 1e-6f);
+
+	// A quad that's entirely outside of the viewport is empty
+	blit.Quad = { 1.5f, 2.0f, 1.0f, -1.0f };
+	LayerBlitToTarget(blit, TARGET_WIDTH, TARGET_HEIGHT, &quad, &bounds);
+	CHECK(quad.v[0] == quad.v[1]);
+	CHECK(quad.v[2] == quad.v[3]);
+}
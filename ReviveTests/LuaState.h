@@ -0,0 +1,48 @@
+#pragma once
+
+#include <lua.hpp>
+#include <stdio.h>
+
+// The scripts are loaded from the source tree, the tests are run from the project directory
+#define REV_SCRIPT_DIR "../Revive/"
+
+static int PrintLuaError(lua_State* L)
+{
+	printf("  %s\n", lua_tostring(L, -1));
+	lua_pop(L, 1);
+	return 0;
+}
+
+// Creates a Lua state like InputManager::LoadInputScript(), with the header and the given script loaded
+static lua_State* LoadInputScript(const char* fn)
+{
+	lua_State* L = luaL_newstate();
+	if (!L)
+		return nullptr;
+
+	lua_pushcfunction(L, PrintLuaError);
+
+#define LUA_LOADLIB(lib) \
+	lua_pushcfunction(L, luaopen_##lib); \
+	lua_pcall(L, 0, 0, 1);
+
+	LUA_LOADLIB(base);
+	LUA_LOADLIB(table);
+	LUA_LOADLIB(math);
+	LUA_LOADLIB(string);
+	LUA_LOADLIB(bit);
+
+#undef LUA_LOADLIB
+
+	const char* scripts[] = { REV_SCRIPT_DIR "header.lua", fn };
+	for (const char* script : scripts)
+	{
+		if (luaL_loadfile(L, script) || lua_pcall(L, 0, LUA_MULTRET, 1))
+		{
+			printf("  Failed to load %s\n", script);
+			lua_close(L);
+			return nullptr;
+		}
+	}
+	return L;
+}
@@ -0,0 +1,174 @@
+#include "Test.h"
+#include "OverlayState.h"
+
+#include <openvr.h>
+#include <string>
+#include <vector>
+
+#define STATIC_FRAMES 90
+
+// Records every overlay call, so the tests can check which calls a frame made
+class RecordingOverlay : public vr::IVROverlay
+{
+public:
+	std::vector<std::string> Calls;
+
+	virtual vr::EVROverlayError SetOverlaySortOrder(vr::VROverlayHandle_t ulOverlayHandle, uint32_t unSortOrder) { return Record("SortOrder", ulOverlayHandle); }
+	virtual vr::EVROverlayError SetOverlayWidthInMeters(vr::VROverlayHandle_t ulOverlayHandle, float fWidthInMeters) { return Record("Width", ulOverlayHandle); }
+	virtual vr::EVROverlayError SetOverlayCurvature(vr::VROverlayHandle_t ulOverlayHandle, float fCurvature) { return Record("Curvature", ulOverlayHandle); }
+	virtual vr::EVROverlayError SetOverlayTexelAspect(vr::VROverlayHandle_t ulOverlayHandle, float fTexelAspect) { return Record("TexelAspect", ulOverlayHandle); }
+	virtual vr::EVROverlayError SetOverlayTransformAbsolute(vr::VROverlayHandle_t ulOverlayHandle, vr::ETrackingUniverseOrigin eTrackingOrigin,
+		const vr::HmdMatrix34_t* pmatTrackingOriginToOverlayTransform) { return Record("TransformAbsolute", ulOverlayHandle); }
+	virtual vr::EVROverlayError SetOverlayTransformTrackedDeviceRelative(vr::VROverlayHandle_t ulOverlayHandle, vr::TrackedDeviceIndex_t unTrackedDevice,
+		const vr::HmdMatrix34_t* pmatTrackedDeviceToOverlayTransform) { return Record("TransformRelative", ulOverlayHandle); }
+	virtual vr::EVROverlayError SetOverlayTextureBounds(vr::VROverlayHandle_t ulOverlayHandle, const vr::VRTextureBounds_t* pOverlayTextureBounds) { return Record("Bounds", ulOverlayHandle); }
+	virtual vr::EVROverlayError ShowOverlay(vr::VROverlayHandle_t ulOverlayHandle) { return Record("Show", ulOverlayHandle); }
+	virtual vr::EVROverlayError HideOverlay(vr::VROverlayHandle_t ulOverlayHandle) { return Record("Hide", ulOverlayHandle); }
+
+	// Returns the calls since the last time and forgets them
+	std::string Take()
+	{
+		std::string calls;
+		for (const std::string& call : Calls)
+			calls += (calls.empty() ? "" : " ") + call;
+		Calls.clear();
+		return calls;
+	}
+
+private:
+	vr::EVROverlayError Record(const char* call, vr::VROverlayHandle_t overlay)
+	{
+		Calls.push_back(std::string(call) + std::to_string(overlay));
+		return vr::VROverlayError_None;
+	}
+};
+
+// A quad layer with the properties CompositorBase sets for it
+struct StaticLayer
+{
+	vr::VROverlayHandle_t Overlay;
+	OverlayState Last;
+	OverlayState Next;
+	bool Created;
+
+	StaticLayer(vr::VROverlayHandle_t overlay, uint32_t sortOrder)
+		: Overlay(overlay), Last(), Next(), Created(true)
+	{
+		Next.SortOrder = sortOrder;
+		Next.Width = 1.0f;
+		Next.Curvature = 0.0f;
+		Next.TexelAspect = 1.0f;
+		Next.HeadLocked = false;
+		Next.Origin = vr::TrackingUniverseStanding;
+		Next.Transform = { { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.5f }, { 0.0f, 0.0f, 1.0f, -1.0f } } };
+		Next.Bounds = { 0.0f, 0.0f, 1.0f, 1.0f };
+	}
+
+	void Submit(RecordingOverlay& overlays, OverlayVisibility& visibility)
+	{
+		Last.Apply(&overlays, Overlay, Next, Created);
+		visibility.Submit(&overlays, Overlay, Created);
+		Created = false;
+	}
+};
+
+TEST(OverlayState_StaticLayers)
+{
+	RecordingOverlay overlays;
+	OverlayVisibility visibility;
+	StaticLayer quad(1, 0), hud(2, 1);
+
+	// A new overlay gets all its properties set and is shown
+	quad.Submit(overlays, visibility);
+	hud.Submit(overlays, visibility);
+	visibility.EndFrame(&overlays);
+	CHECK(overlays.Take() == "SortOrder1 Width1 Curvature1 TexelAspect1 TransformAbsolute1 Bounds1 Show1 "
+		"SortOrder2 Width2 Curvature2 TexelAspect2 TransformAbsolute2 Bounds2 Show2");
+
+	// Layers that don't change don't make any calls
+	size_t calls = 0;
+	for (int frame = 0; frame < STATIC_FRAMES; frame++)
+	{
+		quad.Submit(overlays, visibility);
+		hud.Submit(overlays, visibility);
+		visibility.EndFrame(&overlays);
+		calls += overlays.Calls.size();
+		overlays.Calls.clear();
+	}
+	CHECK_EQUAL(calls, 0);
+}
+
+TEST(OverlayState_Changes)
+{
+	RecordingOverlay overlays;
+	OverlayVisibility visibility;
+	StaticLayer quad(1, 0);
+	quad.Submit(overlays, visibility);
+	visibility.EndFrame(&overlays);
+	overlays.Take();
+
+	// Only the changed property is set
+	quad.Next.Width = 2.0f;
+	quad.Submit(overlays, visibility);
+	CHECK(overlays.Take() == "Width1");
+
+	quad.Next.SortOrder = 3;
+	quad.Next.Bounds.uMax = 0.5f;
+	quad.Submit(overlays, visibility);
+	CHECK(overlays.Take() == "SortOrder1 Bounds1");
+
+	quad.Next.Transform.m[0][3] = 0.1f;
+	quad.Submit(overlays, visibility);
+	CHECK(overlays.Take() == "TransformAbsolute1");
+
+	// A different tracking origin moves an absolute overlay
+	quad.Next.Origin = vr::TrackingUniverseSeated;
+	quad.Submit(overlays, visibility);
+	CHECK(overlays.Take() == "TransformAbsolute1");
+
+	// A head-locked overlay doesn't depend on the tracking origin
+	quad.Next.HeadLocked = true;
+	quad.Submit(overlays, visibility);
+	CHECK(overlays.Take() == "TransformRelative1");
+
+	quad.Next.Origin = vr::TrackingUniverseStanding;
+	quad.Submit(overlays, visibility);
+	CHECK(overlays.Take() == "");
+
+	// Unlocking it places it in the current tracking origin again
+	quad.Next.HeadLocked = false;
+	quad.Submit(overlays, visibility);
+	CHECK(overlays.Take() == "TransformAbsolute1");
+	visibility.EndFrame(&overlays);
+	CHECK(overlays.Take() == "");
+}
+
+TEST(OverlayState_Visibility)
+{
+	RecordingOverlay overlays;
+	OverlayVisibility visibility;
+	StaticLayer quad(1, 0), hud(2, 1);
+	quad.Submit(overlays, visibility);
+	hud.Submit(overlays, visibility);
+	visibility.EndFrame(&overlays);
+	overlays.Take();
+
+	// An overlay that's left out is hidden once
+	quad.Submit(overlays, visibility);
+	visibility.EndFrame(&overlays);
+	CHECK(overlays.Take() == "Hide2");
+
+	quad.Submit(overlays, visibility);
+	visibility.EndFrame(&overlays);
+	CHECK(overlays.Take() == "");
+
+	// It's shown again when it comes back, in any order
+	hud.Submit(overlays, visibility);
+	quad.Submit(overlays, visibility);
+	visibility.EndFrame(&overlays);
+	CHECK(overlays.Take() == "Show2");
+
+	// No layers at all hides everything
+	visibility.EndFrame(&overlays);
+	CHECK(overlays.Take() == "Hide1 Hide2");
+}
@@ -0,0 +1,280 @@
+#include "Test.h"
+#include "PerfManager.h"
+
+#include <algorithm>
+#include <vector>
+
+/*
+	Compositor that reports the frames added by the test, it keeps the whole history
+	so the frames can be queried no matter how far the sampling falls behind.
+*/
+class StubCompositor : public vr::IVRCompositor
+{
+public:
+	std::vector<vr::Compositor_FrameTiming> Frames;
+	uint32_t FocusProcess = 0;
+	int FocusQueries = 0;
+
+	void AddFrame(float gpuMs, float compositorMs = 0.0f)
+	{
+		vr::Compositor_FrameTiming timing = {};
+		timing.m_nSize = sizeof(vr::Compositor_FrameTiming);
+		timing.m_nFrameIndex = (uint32_t)Frames.size() + 1;
+		timing.m_nNumFramePresents = 1;
+		timing.m_flPreSubmitGpuMs = gpuMs;
+		timing.m_flTotalRenderGpuMs = gpuMs + compositorMs;
+		timing.m_flCompositorRenderGpuMs = compositorMs;
+		Frames.push_back(timing);
+	}
+
+	virtual vr::EVRCompositorError WaitGetPoses(vr::TrackedDevicePose_t*, uint32_t, vr::TrackedDevicePose_t*, uint32_t)
+	{
+		return vr::VRCompositorError_None;
+	}
+
+	virtual bool GetFrameTiming(vr::Compositor_FrameTiming* pTiming, uint32_t unFramesAgo)
+	{
+		if (unFramesAgo >= Frames.size())
+			return false;
+		*pTiming = Frames[Frames.size() - 1 - unFramesAgo];
+		return true;
+	}
+
+	virtual uint32_t GetFrameTimings(vr::Compositor_FrameTiming* pTiming, uint32_t nFrames)
+	{
+		uint32_t count = std::min(nFrames, (uint32_t)Frames.size());
+		std::copy(Frames.end() - count, Frames.end(), pTiming);
+		return count;
+	}
+
+	virtual float GetFrameTimeRemaining() { return 0.0f; }
+
+	virtual void GetCumulativeStats(vr::Compositor_CumulativeStats* pStats, uint32_t nStatsSizeInBytes)
+	{
+		*pStats = vr::Compositor_CumulativeStats();
+		pStats->m_nNumFramePresents = (uint32_t)Frames.size();
+	}
+
+	virtual uint32_t GetCurrentSceneFocusProcess()
+	{
+		FocusQueries++;
+		return FocusProcess;
+	}
+};
+
+// At the default 90Hz a frame takes 11.1ms, so the target utilization is reached at 10ms
+#define FRAME_MS (1000.0f / 90.0f)
+
+static void RunFrames(PerfManager& perf, StubCompositor& compositor, float gpuMs, int count, float compositorMs = 0.0f)
+{
+	for (int i = 0; i < count; i++)
+	{
+		compositor.AddFrame(gpuMs, compositorMs);
+		perf.Sample(&compositor);
+	}
+}
+
+TEST(PerfManager_GpuScaleSteadyState)
+{
+	PerfManager perf;
+	StubCompositor compositor;
+
+	// Within the budget the scale stays at 1.0
+	RunFrames(perf, compositor, REV_PERF_TARGET_UTILIZATION * FRAME_MS, 10);
+	CHECK_EQUAL(perf.GetGpuPerformanceScale(), 1.0f);
+
+	// Twice the target load settles at half the scale
+	RunFrames(perf, compositor, 2.0f * REV_PERF_TARGET_UTILIZATION * FRAME_MS, 60);
+	CHECK_NEAR(perf.GetGpuPerformanceScale(), 0.5f, 0.5f * REV_PERF_HYSTERESIS);
+
+	// The compositor's own GPU time isn't counted against the application
+	PerfManager other;
+	StubCompositor busy;
+	RunFrames(other, busy, REV_PERF_TARGET_UTILIZATION * FRAME_MS, 10, 5.0f);
+	CHECK_EQUAL(other.GetGpuPerformanceScale(), 1.0f);
+}
+
+TEST(PerfManager_GpuScaleAsymmetric)
+{
+	PerfManager perf;
+	StubCompositor compositor;
+	RunFrames(perf, compositor, REV_PERF_TARGET_UTILIZATION * FRAME_MS, 10);
+
+	// Overload is picked up within a few frames
+	RunFrames(perf, compositor, 2.0f * REV_PERF_TARGET_UTILIZATION * FRAME_MS, 5);
+	float overloaded = perf.GetGpuPerformanceScale();
+	CHECK(overloaded < 0.6f);
+
+	// Headroom is only reported after it was sustained for a while
+	RunFrames(perf, compositor, REV_PERF_TARGET_UTILIZATION * FRAME_MS, 5);
+	CHECK(perf.GetGpuPerformanceScale() < 0.8f);
+	RunFrames(perf, compositor, REV_PERF_TARGET_UTILIZATION * FRAME_MS, 120);
+	CHECK_NEAR(perf.GetGpuPerformanceScale(), 1.0f, REV_PERF_HYSTERESIS);
+}
+
+TEST(PerfManager_GpuScaleHysteresis)
+{
+	PerfManager perf;
+	StubCompositor compositor;
+	RunFrames(perf, compositor, REV_PERF_TARGET_UTILIZATION * FRAME_MS, 10);
+
+	// Alternating a few percent around the target never changes the reported scale
+	for (int i = 0; i < 100; i++)
+		RunFrames(perf, compositor, (i % 2 ? 1.03f : 0.97f) * REV_PERF_TARGET_UTILIZATION * FRAME_MS, 1);
+	CHECK_EQUAL(perf.GetGpuPerformanceScale(), 1.0f);
+
+	// Frames without GPU timing don't affect the estimate
+	RunFrames(perf, compositor, 0.0f, 20);
+	CHECK_EQUAL(perf.GetGpuPerformanceScale(), 1.0f);
+}
+
+TEST(PerfManager_GpuScaleLimits)
+{
+	PerfManager perf;
+	StubCompositor compositor;
+
+	// An idle GPU is clamped to the maximum scale, an overloaded one to the minimum
+	RunFrames(perf, compositor, 0.1f, 10);
+	CHECK_EQUAL(perf.GetGpuPerformanceScale(), REV_PERF_MAX_SCALE);
+	RunFrames(perf, compositor, 100.0f * FRAME_MS, 20);
+	CHECK_EQUAL(perf.GetGpuPerformanceScale(), REV_PERF_MIN_SCALE);
+
+	// The profile can override the limits and the target
+	PerfManager limited;
+	limited.SetScaleLimits(0.5f, 0.8f, 1.2f);
+	StubCompositor other;
+	RunFrames(limited, other, 0.1f, 10);
+	CHECK_EQUAL(limited.GetGpuPerformanceScale(), 1.2f);
+	RunFrames(limited, other, 0.5f * FRAME_MS, 120);
+	CHECK_NEAR(limited.GetGpuPerformanceScale(), 1.0f, REV_PERF_HYSTERESIS);
+	RunFrames(limited, other, 2.0f * FRAME_MS, 20);
+	CHECK_EQUAL(limited.GetGpuPerformanceScale(), 0.8f);
+}
+
+TEST(PerfManager_FrameTimings)
+{
+	PerfManager perf;
+	StubCompositor compositor;
+	vr::Compositor_FrameTiming timings[5];
+	bool dropped;
+
+	// Nothing to report before the first sample
+	CHECK_EQUAL(perf.GetFrameTimings(0, timings, 5, &dropped), 0);
+	CHECK(!dropped);
+
+	// The session thread may fall behind several frames, they are all copied in ascending order
+	for (int i = 0; i < 3; i++)
+		compositor.AddFrame(5.0f);
+	perf.Sample(&compositor);
+	CHECK_EQUAL(perf.GetLatestFrame(), 3);
+	CHECK_EQUAL(perf.GetCumulativeStats().m_nNumFramePresents, 3);
+	CHECK_EQUAL(perf.GetFrameTimings(0, timings, 5, &dropped), 3);
+	CHECK(!dropped);
+	for (int i = 0; i < 3; i++)
+		CHECK_EQUAL(timings[i].m_nFrameIndex, i + 1);
+
+	// Only the frames after the last reported one are returned
+	compositor.AddFrame(5.0f);
+	compositor.AddFrame(5.0f);
+	perf.Sample(&compositor);
+	CHECK_EQUAL(perf.GetFrameTimings(3, timings, 5, &dropped), 2);
+	CHECK(!dropped);
+	CHECK_EQUAL(timings[0].m_nFrameIndex, 4);
+	CHECK_EQUAL(timings[1].m_nFrameIndex, 5);
+
+	// Sampling again without new frames changes nothing
+	perf.Sample(&compositor);
+	CHECK_EQUAL(perf.GetFrameTimings(5, timings, 5, &dropped), 0);
+
+	// More frames than requested returns the most recent ones and reports the rest as dropped
+	CHECK_EQUAL(perf.GetFrameTimings(0, timings, 2, &dropped), 2);
+	CHECK(dropped);
+	CHECK_EQUAL(timings[0].m_nFrameIndex, 4);
+	CHECK_EQUAL(timings[1].m_nFrameIndex, 5);
+}
+
+TEST(PerfManager_FrameTimingsOverwritten)
+{
+	PerfManager perf;
+	StubCompositor compositor;
+	vr::Compositor_FrameTiming timings[5];
+	bool dropped;
+
+	// Falling behind more than the history holds only keeps the most recent frames
+	for (int i = 0; i < REV_PERF_HISTORY_SIZE + 10; i++)
+		compositor.AddFrame(5.0f);
+	perf.Sample(&compositor);
+	CHECK_EQUAL(perf.GetLatestFrame(), REV_PERF_HISTORY_SIZE + 10);
+	CHECK_EQUAL(perf.GetFrameTimings(REV_PERF_HISTORY_SIZE + 5, timings, 5, &dropped), 5);
+	CHECK(!dropped);
+	CHECK_EQUAL(timings[0].m_nFrameIndex, REV_PERF_HISTORY_SIZE + 6);
+
+	// Asking for every frame only returns what the history holds, the rest is reported as dropped
+	std::vector<vr::Compositor_FrameTiming> all(REV_PERF_HISTORY_SIZE);
+	int count = perf.GetFrameTimings(0, all.data(), REV_PERF_HISTORY_SIZE, &dropped);
+	CHECK_EQUAL(count, REV_PERF_HISTORY_SIZE);
+	CHECK(dropped);
+	CHECK_EQUAL(all[0].m_nFrameIndex, 11);
+	CHECK_EQUAL(all[count - 1].m_nFrameIndex, REV_PERF_HISTORY_SIZE + 10);
+}
+
+TEST(PerfManager_SceneFocusProcess)
+{
+	PerfManager perf;
+	StubCompositor compositor;
+	CHECK_EQUAL(perf.GetSceneFocusProcess(), 0);
+
+	// The process is sampled with the frame timings, reading it doesn't call into the compositor
+	compositor.FocusProcess = 1234;
+	perf.Sample(&compositor);
+	CHECK_EQUAL(compositor.FocusQueries, 1);
+	for (int i = 0; i < 10; i++)
+		CHECK_EQUAL(perf.GetSceneFocusProcess(), 1234);
+	CHECK_EQUAL(compositor.FocusQueries, 1);
+
+	// It's updated even when there are no new frames
+	compositor.FocusProcess = 5678;
+	perf.Sample(&compositor);
+	CHECK_EQUAL(perf.GetSceneFocusProcess(), 5678);
+}
+
+/*
+	Replays a recorded load spike in overlapping chunks, like the session thread sees it
+	when it wakes up at varying intervals. Frames that were already seen must be skipped,
+	so the result matches feeding every frame exactly once.
+*/
+TEST(PerfManager_FrameTimingsReplay)
+{
+	static const float recording[] = {
+		9.8f, 10.1f, 9.9f, 10.0f, 14.2f, 18.5f, 19.1f, 18.8f, 0.0f, 19.0f,
+		18.7f, 12.0f, 10.2f, 9.7f, 10.0f, 9.9f, 10.1f, 9.8f, 10.0f, 10.2f,
+	};
+	const int frames = sizeof(recording) / sizeof(recording[0]);
+
+	StubCompositor recorded;
+	for (int i = 0; i < frames; i++)
+		recorded.AddFrame(recording[i]);
+
+	PerfManager once, chunked;
+	std::vector<float> expected, actual;
+	for (int i = 0; i < frames; i++)
+	{
+		once.AddFrameTimings(&recorded.Frames[i], 1, FRAME_MS / 1000.0f);
+		expected.push_back(once.GetGpuPerformanceScale());
+	}
+
+	// Every chunk starts a few frames before the end of the previous one
+	for (int end = 1; end <= frames; end++)
+	{
+		int begin = std::max(0, end - 1 - end % 4);
+		chunked.AddFrameTimings(&recorded.Frames[begin], end - begin, FRAME_MS / 1000.0f);
+		actual.push_back(chunked.GetGpuPerformanceScale());
+	}
+
+	for (int i = 0; i < frames; i++)
+		CHECK_EQUAL(actual[i], expected[i]);
+
+	// The spike must have been reported and recovered from
+	CHECK(*std::min_element(expected.begin(), expected.end()) < 0.6f);
+	CHECK(expected.back() > expected[7]);
+}
@@ -0,0 +1,140 @@
+#include "Test.h"
+#include "PoseCache.h"
+
+#include <openvr.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define CONCURRENT_CALLERS 4
+
+/*
+	Tracking system that counts the pose queries, queries for the blocked origin don't return
+	until the test releases them. The query number is written into the velocity of the HMD,
+	so the callers can tell which query their poses came from.
+*/
+class TrackingSystem : public vr::IVRSystem
+{
+public:
+	std::atomic_int Queries;
+	std::atomic_int Active;
+	std::atomic_bool Blocked;
+	vr::ETrackingUniverseOrigin BlockedOrigin;
+
+	TrackingSystem() : Queries(0), Active(0), Blocked(false), BlockedOrigin(vr::TrackingUniverseStanding) { }
+
+	virtual void GetDeviceToAbsoluteTrackingPose(vr::ETrackingUniverseOrigin eOrigin, float fPredictedSecondsToPhotonsFromNow,
+		vr::TrackedDevicePose_t* pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount)
+	{
+		Active++;
+		while (Blocked && eOrigin == BlockedOrigin)
+			std::this_thread::yield();
+
+		for (uint32_t i = 0; i < unTrackedDevicePoseArrayCount; i++)
+			pTrackedDevicePoseArray[i] = vr::TrackedDevicePose_t();
+		pTrackedDevicePoseArray[vr::k_unTrackedDeviceIndex_Hmd].vVelocity.v[0] = (float)++Queries;
+		Active--;
+	}
+};
+
+static float GetPoses(PoseCache& cache, TrackingSystem& system, long long frameIndex, vr::ETrackingUniverseOrigin origin, double now, float relTime)
+{
+	vr::TrackedDevicePose_t poses[vr::k_unMaxTrackedDeviceCount];
+	cache.Get(frameIndex, origin, now, relTime, poses, [&](vr::TrackedDevicePose_t* results)
+	{
+		system.GetDeviceToAbsoluteTrackingPose(origin, relTime, results, vr::k_unMaxTrackedDeviceCount);
+	});
+	return poses[vr::k_unTrackedDeviceIndex_Hmd].vVelocity.v[0];
+}
+
+// Waits in real time until the condition holds, gives up after a second
+template<typename F>
+static bool WaitFor(F condition)
+{
+	for (int i = 0; i < 1000; i++)
+	{
+		if (condition())
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return false;
+}
+
+// Callers asking for the same poses while the first query is still running wait for its result
+TEST(PoseCache_ConcurrentQueries)
+{
+	TrackingSystem system;
+	PoseCache cache;
+	system.Blocked = true;
+
+	std::vector<float> results(CONCURRENT_CALLERS);
+	std::vector<std::thread> callers;
+	for (int i = 0; i < CONCURRENT_CALLERS; i++)
+	{
+		callers.emplace_back([&, i]()
+		{
+			results[i] = GetPoses(cache, system, 1, vr::TrackingUniverseStanding, 1.0, 0.0f);
+		});
+	}
+
+	// Give the other callers time to find the pending entry
+	CHECK(WaitFor([&]() { return system.Active > 0; }));
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CHECK_EQUAL(system.Active, 1);
+
+	system.Blocked = false;
+	for (std::thread& t : callers)
+		t.join();
+
+	CHECK_EQUAL(system.Queries, 1);
+	for (float result : results)
+		CHECK_EQUAL(result, 1.0f);
+}
+
+// A slow query doesn't hold up queries for other poses
+TEST(PoseCache_OtherKeysDontWait)
+{
+	TrackingSystem system;
+	PoseCache cache;
+	system.Blocked = true;
+
+	std::thread blocked([&]()
+	{
+		GetPoses(cache, system, 1, vr::TrackingUniverseStanding, 1.0, 0.0f);
+	});
+	CHECK(WaitFor([&]() { return system.Active > 0; }));
+
+	std::atomic_bool done(false);
+	std::thread other([&]()
+	{
+		GetPoses(cache, system, 1, vr::TrackingUniverseSeated, 1.0, 0.0f);
+		done = true;
+	});
+	CHECK(WaitFor([&]() { return done.load(); }));
+
+	system.Blocked = false;
+	blocked.join();
+	other.join();
+	CHECK_EQUAL(system.Queries, 2);
+}
+
+TEST(PoseCache_Keys)
+{
+	TrackingSystem system;
+	PoseCache cache;
+
+	// The times are in the middle of a bucket, so rounding doesn't move them to the next one
+	CHECK_EQUAL(GetPoses(cache, system, 1, vr::TrackingUniverseStanding, 1.0005, 0.0f), 1.0f);
+	CHECK_EQUAL(GetPoses(cache, system, 1, vr::TrackingUniverseStanding, 1.0005, 0.0f), 1.0f);
+
+	// Every part of the key needs its own query
+	CHECK_EQUAL(GetPoses(cache, system, 2, vr::TrackingUniverseStanding, 1.0005, 0.0f), 2.0f);
+	CHECK_EQUAL(GetPoses(cache, system, 2, vr::TrackingUniverseSeated, 1.0005, 0.0f), 3.0f);
+	CHECK_EQUAL(GetPoses(cache, system, 2, vr::TrackingUniverseSeated, 1.0005, 0.0115f), 4.0f);
+
+	// Nearby calls within the same bucket share the query, until the entry expires
+	CHECK_EQUAL(GetPoses(cache, system, 2, vr::TrackingUniverseSeated, 1.0007, 0.0f), 3.0f);
+	CHECK_EQUAL(GetPoses(cache, system, 2, vr::TrackingUniverseSeated, 1.0105, -0.01f), 5.0f);
+	CHECK_EQUAL(system.Queries, 5);
+}
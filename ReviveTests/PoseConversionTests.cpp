@@ -0,0 +1,219 @@
+#include "Test.h"
+#include "PoseConversion.h"
+#include "REV_Math.h"
+
+#include <openvr.h>
+#include <chrono>
+#include <random>
+#include <string.h>
+#include <vector>
+
+#define CONVERSION_POSES 20000
+#define BENCHMARK_POSES 1000000
+
+// The scalar conversion the SSE batches replaced, kept as the reference for the results
+static ovrPoseStatef ReferencePose(vr::TrackedDevicePose_t pose, ovrPoseStatef& lastPose, double time)
+{
+	ovrPoseStatef result = { OVR::Posef::Identity() };
+	if (!pose.bPoseIsValid)
+		return result;
+
+	OVR::Matrix4f matrix = REV::Matrix4f(pose.mDeviceToAbsoluteTracking);
+
+	OVR::Quatf q(matrix);
+	q.EnsureSameHemisphere(lastPose.ThePose.Orientation);
+
+	result.ThePose.Orientation = q;
+	result.ThePose.Position = matrix.GetTranslation();
+	result.AngularVelocity = (REV::Vector3f)pose.vAngularVelocity;
+	result.LinearVelocity = (REV::Vector3f)pose.vVelocity;
+	result.AngularAcceleration = ((REV::Vector3f)pose.vAngularVelocity - lastPose.AngularVelocity) / float(time - lastPose.TimeInSeconds);
+	result.LinearAcceleration = ((REV::Vector3f)pose.vVelocity - lastPose.LinearVelocity) / float(time - lastPose.TimeInSeconds);
+	result.TimeInSeconds = time;
+
+	lastPose = result;
+	return result;
+}
+
+// Compares the bits, so the special values from a zero time delta are compared as well
+static bool SameBits(const float* a, const float* b, int count)
+{
+	return memcmp(a, b, count * sizeof(float)) == 0;
+}
+
+static bool SamePose(const ovrPoseStatef& a, const ovrPoseStatef& b)
+{
+	return SameBits(&a.ThePose.Orientation.x, &b.ThePose.Orientation.x, 4) &&
+		SameBits(&a.ThePose.Position.x, &b.ThePose.Position.x, 3) &&
+		SameBits(&a.AngularVelocity.x, &b.AngularVelocity.x, 3) &&
+		SameBits(&a.LinearVelocity.x, &b.LinearVelocity.x, 3) &&
+		SameBits(&a.AngularAcceleration.x, &b.AngularAcceleration.x, 3) &&
+		SameBits(&a.LinearAcceleration.x, &b.LinearAcceleration.x, 3) &&
+		a.TimeInSeconds == b.TimeInSeconds;
+}
+
+class PoseGenerator
+{
+public:
+	PoseGenerator() : m_Random(1234), m_Uniform(-1.0f, 1.0f) { }
+
+	// Random unit quaternion, rotations in every direction exercise all branches of the extraction
+	ovrQuatf Orientation()
+	{
+		ovrQuatf q;
+		float length;
+		do
+		{
+			q = ovrQuatf{ m_Uniform(m_Random), m_Uniform(m_Random), m_Uniform(m_Random), m_Uniform(m_Random) };
+			length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+		} while (length < 0.1f || length > 1.0f);
+		return ovrQuatf{ q.x / length, q.y / length, q.z / length, q.w / length };
+	}
+
+	// Mostly regular velocities, but also zero, tiny and denormal ones
+	float Velocity()
+	{
+		const float tiny[] = { 0.0f, -0.0f, 1e-7f, -1e-20f, 1e-38f, -1e-40f };
+		int kind = m_Random() % 4;
+		if (kind == 0)
+			return tiny[m_Random() % (sizeof(tiny) / sizeof(tiny[0]))];
+		return m_Uniform(m_Random) * 10.0f;
+	}
+
+	vr::TrackedDevicePose_t Pose()
+	{
+		ovrQuatf q = Orientation();
+		float x = q.x, y = q.y, z = q.z, w = q.w;
+
+		vr::TrackedDevicePose_t pose = {};
+		float (*m)[4] = pose.mDeviceToAbsoluteTracking.m;
+		m[0][0] = 1 - 2 * (y * y + z * z); m[0][1] = 2 * (x * y - z * w);     m[0][2] = 2 * (x * z + y * w);
+		m[1][0] = 2 * (x * y + z * w);     m[1][1] = 1 - 2 * (x * x + z * z); m[1][2] = 2 * (y * z - x * w);
+		m[2][0] = 2 * (x * z - y * w);     m[2][1] = 2 * (y * z + x * w);     m[2][2] = 1 - 2 * (x * x + y * y);
+		for (int i = 0; i < 3; i++)
+		{
+			m[i][3] = m_Uniform(m_Random) * 2.0f;
+			pose.vVelocity.v[i] = Velocity();
+			pose.vAngularVelocity.v[i] = Velocity();
+		}
+		pose.eTrackingResult = vr::TrackingResult_Running_OK;
+		pose.bPoseIsValid = m_Random() % 8 != 0;
+		pose.bDeviceIsConnected = true;
+		return pose;
+	}
+
+	// The last orientation is close to either hemisphere of the new one, or perpendicular to it
+	ovrPoseStatef LastPose(const vr::TrackedDevicePose_t& pose, double time)
+	{
+		OVR::Quatf q(REV::Matrix4f(pose.mDeviceToAbsoluteTracking));
+		ovrPoseStatef last = { OVR::Posef::Identity() };
+		switch (m_Random() % 3)
+		{
+		case 0: last.ThePose.Orientation = ovrQuatf{ q.x, q.y, q.z, q.w }; break;
+		case 1: last.ThePose.Orientation = ovrQuatf{ -q.x, -q.y, -q.z, -q.w }; break;
+		case 2: last.ThePose.Orientation = ovrQuatf{ -q.y, q.x, -q.w, q.z }; break;
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			(&last.AngularVelocity.x)[i] = Velocity();
+			(&last.LinearVelocity.x)[i] = Velocity();
+		}
+
+		// A device that's queried twice in the same frame has a zero time delta
+		last.TimeInSeconds = m_Random() % 16 == 0 ? time : time - 0.011;
+		return last;
+	}
+
+private:
+	std::mt19937 m_Random;
+	std::uniform_real_distribution<float> m_Uniform;
+};
+
+/*
+	Converts random poses in batches of every size, including partial groups of four, and
+	compares every result and every updated last pose with the scalar reference.
+*/
+TEST(PoseConversion_MatchesReference)
+{
+	PoseGenerator generator;
+	double time = 100.0;
+	int mismatches = 0, lastMismatches = 0, flipped = 0;
+	for (int converted = 0, count = 1; converted < CONVERSION_POSES; converted += count, count = count % 9 + 1)
+	{
+		std::vector<vr::TrackedDevicePose_t> poses(count);
+		std::vector<ovrPoseStatef> last(count), expectedLast(count), results(count), expected(count);
+		std::vector<ovrPoseStatef*> lastPointers(count);
+		for (int i = 0; i < count; i++)
+		{
+			poses[i] = generator.Pose();
+			last[i] = expectedLast[i] = generator.LastPose(poses[i], time);
+			lastPointers[i] = &last[i];
+			expected[i] = ReferencePose(poses[i], expectedLast[i], time);
+		}
+
+		TrackedDevicePosesToOVRPoses(poses.data(), lastPointers.data(), count, time, results.data());
+		for (int i = 0; i < count; i++)
+		{
+			if (!SamePose(results[i], expected[i]))
+				mismatches++;
+			if (!SamePose(last[i], expectedLast[i]))
+				lastMismatches++;
+			if (poses[i].bPoseIsValid && OVR::Quatf(REV::Matrix4f(poses[i].mDeviceToAbsoluteTracking)).w != expected[i].ThePose.Orientation.w)
+				flipped++;
+		}
+		time += 0.011;
+	}
+
+	// Make sure the generated poses actually needed the hemisphere correction
+	CHECK(flipped > CONVERSION_POSES / 8);
+	CHECK_EQUAL(mismatches, 0);
+	CHECK_EQUAL(lastMismatches, 0);
+}
+
+/*
+	Compares the batched conversion with converting every pose on its own, for the three poses of
+	GetTrackingState() and a full batch of tracked devices. Only prints the timings.
+*/
+TEST(PoseConversion_Benchmark)
+{
+	PoseGenerator generator;
+	const int counts[] = { 3, 16 };
+	for (int count : counts)
+	{
+		std::vector<vr::TrackedDevicePose_t> poses(count);
+		std::vector<ovrPoseStatef> last(count), results(count);
+		std::vector<ovrPoseStatef*> lastPointers(count);
+		for (int i = 0; i < count; i++)
+		{
+			poses[i] = generator.Pose();
+			poses[i].bPoseIsValid = true;
+			last[i] = generator.LastPose(poses[i], 0.0);
+			lastPointers[i] = &last[i];
+		}
+
+		int batches = BENCHMARK_POSES / count;
+		double time = 0.0;
+		float sink = 0.0f;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int b = 0; b < batches; b++)
+		{
+			time += 0.011;
+			for (int i = 0; i < count; i++)
+				results[i] = ReferencePose(poses[i], last[i], time);
+			sink += results[count - 1].ThePose.Orientation.w;
+		}
+		double scalar = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		for (int b = 0; b < batches; b++)
+		{
+			time += 0.011;
+			TrackedDevicePosesToOVRPoses(poses.data(), lastPointers.data(), count, time, results.data());
+			sink += results[count - 1].ThePose.Orientation.w;
+		}
+		double batched = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		printf("  %d device(s): %.1f ns per pose scalar, %.1f ns batched (%g)\n",
+			count, scalar / (batches * count), batched / (batches * count), sink * 0.0f);
+	}
+}
@@ -0,0 +1,170 @@
+#include "Test.h"
+#include "rcu_ptr.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#define STRESS_READERS 3
+#define STRESS_WRITERS 2
+#define STRESS_SWAPS 500
+#define SCALING_READS 2000000
+#define SCALING_MAX_THREADS 4
+
+/*
+	Instead of deleting a swapped out object the writer marks it as retired and keeps it alive,
+	so a reader that still sees it can detect the violation instead of reading freed memory.
+*/
+struct Payload
+{
+	Payload(int value) : Value(value), Check(~value), Retired(false) { }
+
+	int Value;
+	int Check;
+	std::atomic_bool Retired;
+};
+
+TEST(RcuPtr_Swap)
+{
+	rcu_ptr<Payload> ptr(std::make_shared<Payload>(1));
+	{
+		rcu_ptr<Payload> copy = ptr;
+		CHECK_EQUAL(copy->Value, 1);
+
+		// Nested copies on the same thread are allowed
+		rcu_ptr<Payload> nested = copy;
+		CHECK_EQUAL(nested->Value, 1);
+	}
+
+	std::shared_ptr<Payload> next = std::make_shared<Payload>(2);
+	ptr.swap(next);
+	CHECK_EQUAL(next->Value, 1);
+
+	rcu_ptr<Payload> copy = ptr;
+	CHECK_EQUAL(copy->Value, 2);
+	CHECK(bool(rcu_ptr<Payload>()) == false);
+}
+
+/*
+	Several writers each swap their own pointer while readers hold copies of all of them,
+	sometimes nested. Every pointer shares the same epoch, so the writers also wait for the
+	readers of the other pointers. No reader may ever see an object after its swap returned.
+*/
+TEST(RcuPtr_Stress)
+{
+	std::vector<std::unique_ptr<rcu_ptr<Payload>>> pointers;
+	for (int w = 0; w < STRESS_WRITERS; w++)
+		pointers.emplace_back(new rcu_ptr<Payload>(std::make_shared<Payload>(0)));
+
+	std::atomic_bool running(true);
+	std::atomic_int violations(0), reads(0);
+
+	std::vector<std::thread> readers;
+	for (int r = 0; r < STRESS_READERS; r++)
+	{
+		readers.emplace_back([&pointers, &running, &violations, &reads, r]()
+		{
+			for (int i = 0; running; i++)
+			{
+				rcu_ptr<Payload> first = *pointers[(i + r) % STRESS_WRITERS];
+				if (first->Retired || first->Check != ~first->Value)
+					violations++;
+
+				// Give the writer a chance to swap while we're still holding the copy
+				if (i % 8 == 0)
+					std::this_thread::yield();
+
+				{
+					rcu_ptr<Payload> second = *pointers[(i + r + 1) % STRESS_WRITERS];
+					if (second->Retired || first->Retired)
+						violations++;
+				}
+
+				if (first->Retired)
+					violations++;
+				reads++;
+			}
+		});
+	}
+
+	std::vector<std::thread> writers;
+	for (int w = 0; w < STRESS_WRITERS; w++)
+	{
+		writers.emplace_back([&pointers, w]()
+		{
+			std::vector<std::shared_ptr<Payload>> retired;
+			for (int i = 1; i <= STRESS_SWAPS; i++)
+			{
+				std::shared_ptr<Payload> old = std::make_shared<Payload>(i);
+				pointers[w]->swap(old);
+				old->Retired = true;
+				retired.push_back(old);
+			}
+		});
+	}
+
+	for (std::thread& t : writers)
+		t.join();
+	running = false;
+	for (std::thread& t : readers)
+		t.join();
+
+	CHECK_EQUAL(violations, 0);
+	CHECK(reads > 0);
+}
+
+// Every thread takes the given number of copies of the pointer, returns the total copies per second
+static double MeasureReads(rcu_ptr<Payload>& ptr, int threads)
+{
+	std::atomic_int errors(0);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> readers;
+	for (int t = 0; t < threads; t++)
+	{
+		readers.emplace_back([&ptr, &errors]()
+		{
+			if ((uintptr_t)rcu::this_reader() % REV_RCU_CACHE_LINE != 0)
+				errors++;
+
+			int sum = 0;
+			for (int i = 0; i < SCALING_READS; i++)
+			{
+				rcu_ptr<Payload> copy = ptr;
+				sum += copy->Value;
+			}
+			if (sum != SCALING_READS)
+				errors++;
+		});
+	}
+	for (std::thread& t : readers)
+		t.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	CHECK_EQUAL(errors, 0);
+	return double(threads) * SCALING_READS / seconds;
+}
+
+/*
+	Readers only write to their own record, so adding readers must not slow down the existing ones.
+	If the records shared a cache line every read would invalidate the line of the other readers,
+	then the total throughput drops below that of a single reader. On a machine with fewer cores
+	than threads the total can't grow, but it doesn't collapse either.
+*/
+TEST(RcuPtr_ReadScaling)
+{
+	rcu_ptr<Payload> ptr(std::make_shared<Payload>(1));
+	int maxThreads = (std::max)(2, (std::min)(SCALING_MAX_THREADS, (int)std::thread::hardware_concurrency()));
+
+	double single = MeasureReads(ptr, 1);
+	printf("  1 reader: %.1f M reads/s\n", single / 1000000.0);
+	for (int threads = 2; threads <= maxThreads; threads *= 2)
+	{
+		double total = MeasureReads(ptr, threads);
+		printf("  %d readers: %.1f M reads/s\n", threads, total / 1000000.0);
+		CHECK(total > single * 0.5);
+	}
+}
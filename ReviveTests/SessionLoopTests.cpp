@@ -0,0 +1,134 @@
+#include "Test.h"
+#include "SessionLoop.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define IDLE_MS 500
+#define LATENCY_SLACK_MS 10
+
+typedef std::chrono::steady_clock Clock;
+
+/*
+	Event queue that delivers events at scripted times after it was created, like the OpenVR
+	event queue. Every poll is counted and the time each event waited in the queue is recorded.
+*/
+class ScriptedEvents
+{
+public:
+	std::atomic_int Polls;
+
+	ScriptedEvents(std::vector<int> times) : Polls(0), m_Start(Clock::now()), m_Times(times), m_Next(0) { }
+
+	double Elapsed() { return std::chrono::duration<double, std::milli>(Clock::now() - m_Start).count(); }
+
+	// Returns true if any events were due
+	bool Poll()
+	{
+		std::lock_guard<std::mutex> lk(m_Mutex);
+		double now = Elapsed();
+		bool activity = false;
+		while (m_Next < m_Times.size() && m_Times[m_Next] <= now)
+		{
+			m_Latencies.push_back(now - m_Times[m_Next++]);
+			activity = true;
+		}
+		Polls++;
+		return activity;
+	}
+
+	std::vector<double> TakeLatencies()
+	{
+		std::lock_guard<std::mutex> lk(m_Mutex);
+		return m_Latencies;
+	}
+
+private:
+	std::mutex m_Mutex;
+	Clock::time_point m_Start;
+	std::vector<int> m_Times;
+	size_t m_Next;
+	std::vector<double> m_Latencies;
+};
+
+// Polls the events the same way the session thread does
+static void RunSessionLoop(SessionLoop* loop, ScriptedEvents* events)
+{
+	bool activity;
+	do
+	{
+		activity = events->Poll();
+	} while (loop->Wait(activity));
+}
+
+TEST(SessionLoop_IdleWakeups)
+{
+	SessionLoop loop;
+	ScriptedEvents events({});
+	std::thread thread(RunSessionLoop, &loop, &events);
+	std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_MS));
+	loop.Stop();
+	thread.join();
+
+	// Once it backed off the loop wakes up once per maximum interval, after a few faster polls
+	double wakeupsPerSecond = events.Polls * 1000.0 / IDLE_MS;
+	double backoffPolls = log2(REV_SESSION_MAX_INTERVAL / REV_SESSION_MIN_INTERVAL) + 1;
+	CHECK(wakeupsPerSecond <= 1000.0 / REV_SESSION_MAX_INTERVAL + backoffPolls * 1000.0 / IDLE_MS + 2.0);
+	CHECK(wakeupsPerSecond >= 1000.0 / REV_SESSION_MAX_INTERVAL / 2.0);
+	CHECK(loop.GetInterval().count() == REV_SESSION_MAX_INTERVAL);
+}
+
+TEST(SessionLoop_WakeLatency)
+{
+	SessionLoop loop;
+	ScriptedEvents events({});
+	std::thread thread(RunSessionLoop, &loop, &events);
+	std::this_thread::sleep_for(std::chrono::milliseconds(REV_SESSION_MAX_INTERVAL * 4));
+
+	// A wake while backed off polls right away instead of after the rest of the interval
+	double maxLatency = 0.0;
+	for (int i = 0; i < 8; i++)
+	{
+		int polls = events.Polls;
+		double start = events.Elapsed();
+		loop.Wake();
+		while (events.Polls == polls)
+			std::this_thread::yield();
+		maxLatency = (std::max)(maxLatency, events.Elapsed() - start);
+		std::this_thread::sleep_for(std::chrono::milliseconds(REV_SESSION_MAX_INTERVAL / 4));
+	}
+	CHECK(maxLatency < LATENCY_SLACK_MS);
+
+	loop.Stop();
+	thread.join();
+}
+
+TEST(SessionLoop_EventLatency)
+{
+	// A burst of events after a long idle period, then a single event once it backed off again
+	std::vector<int> times;
+	for (int i = 0; i < 10; i++)
+		times.push_back(IDLE_MS / 2 + i * 2);
+	times.push_back(IDLE_MS);
+
+	SessionLoop loop;
+	ScriptedEvents events(times);
+	std::thread thread(RunSessionLoop, &loop, &events);
+	std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_MS + REV_SESSION_MAX_INTERVAL * 2));
+	loop.Stop();
+	thread.join();
+
+	// The first event of a burst waits at most one idle interval, the rest are polled fast
+	std::vector<double> latencies = events.TakeLatencies();
+	CHECK_EQUAL(latencies.size(), times.size());
+	if (latencies.size() != times.size())
+		return;
+	CHECK(latencies[0] <= REV_SESSION_MAX_INTERVAL + LATENCY_SLACK_MS);
+	double burstLatency = *std::max_element(latencies.begin() + 1, latencies.end() - 1);
+	CHECK(burstLatency <= REV_SESSION_MIN_INTERVAL * 2 + LATENCY_SLACK_MS);
+	CHECK(latencies.back() <= REV_SESSION_MAX_INTERVAL + LATENCY_SLACK_MS);
+}
@@ -0,0 +1,61 @@
+#include "Test.h"
+#include "SettingsManager.h"
+
+#include <openvr.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#define SETTINGS_POLL_MS 10
+#define SETTINGS_RUN_MS 200
+
+// Counts the settings queries, every one of them is a call into the OpenVR server
+class CountingSettings : public vr::IVRSettings
+{
+public:
+	std::atomic_int Calls;
+
+	CountingSettings() : Calls(0) { }
+
+	// Nothing is set, like on a fresh install, so every key falls back to the Revive section
+	virtual bool GetBool(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError) { return Unset(peError); }
+	virtual int32_t GetInt32(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError) { return Unset(peError); }
+	virtual float GetFloat(const char* pchSection, const char* pchSettingsKey, vr::EVRSettingsError* peError) { return Unset(peError); }
+
+private:
+	int Unset(vr::EVRSettingsError* peError)
+	{
+		Calls++;
+		*peError = vr::VRSettingsError_UnsetSettingHasNoDefault;
+		return 0;
+	}
+};
+
+TEST(SettingsManager_Polling)
+{
+	CountingSettings settings;
+	vr::IVRApplications applications;
+	SettingsManager manager(&settings, &applications, std::chrono::milliseconds(SETTINGS_POLL_MS));
+	int reloadCalls = settings.Calls;
+	CHECK(reloadCalls > 0);
+
+	// At the default interval polling only costs a few calls per second
+	CHECK(reloadCalls * 1000.0 / REV_SETTINGS_POLL_INTERVAL < 5.0);
+
+	// Until a change event is seen the settings are polled
+	std::this_thread::sleep_for(std::chrono::milliseconds(SETTINGS_RUN_MS));
+	CHECK(settings.Calls >= reloadCalls * 5);
+
+	// A change event reloads the settings once, after that there's no more polling
+	manager.NotifySettingsChanged();
+	std::this_thread::sleep_for(std::chrono::milliseconds(SETTINGS_POLL_MS * 5));
+	int calls = settings.Calls;
+	std::this_thread::sleep_for(std::chrono::milliseconds(SETTINGS_RUN_MS));
+	CHECK_EQUAL(settings.Calls, calls);
+
+	// Later events still reload the settings
+	manager.NotifySettingsChanged();
+	for (int i = 0; i < SETTINGS_RUN_MS && settings.Calls == calls; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	CHECK(settings.Calls > calls);
+}
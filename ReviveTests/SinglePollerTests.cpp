@@ -0,0 +1,160 @@
+#include "Test.h"
+#include "single_poller.h"
+
+#include <openvr.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define CONTENTION_POLLS 2000
+#define CONTENTION_IPC_US 20
+
+/*
+	Controller that takes a while to answer, like a call into the OpenVR server. Every query
+	returns a new packet number, so the callers can tell which query their state came from.
+*/
+class ControllerSystem : public vr::IVRSystem
+{
+public:
+	std::atomic_int Queries;
+	std::atomic_int Active;
+	std::atomic_int MaxActive;
+	std::atomic_bool Blocked;
+	int LatencyUs;
+
+	ControllerSystem(int latencyUs) : Queries(0), Active(0), MaxActive(0), Blocked(false), LatencyUs(latencyUs) { }
+
+	virtual bool GetControllerState(vr::TrackedDeviceIndex_t unControllerDeviceIndex, vr::VRControllerState_t* pControllerState, uint32_t unControllerStateSize)
+	{
+		int active = ++Active;
+		int max = MaxActive;
+		while (active > max && !MaxActive.compare_exchange_weak(max, active));
+
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::microseconds(LatencyUs);
+		while (Blocked || std::chrono::steady_clock::now() < end)
+			std::this_thread::yield();
+
+		*pControllerState = vr::VRControllerState_t();
+		pControllerState->unPacketNum = ++Queries;
+		Active--;
+		return true;
+	}
+};
+
+static bool QueryController(ControllerSystem& system, vr::VRControllerState_t* state)
+{
+	return system.GetControllerState(0, state, sizeof(vr::VRControllerState_t));
+}
+
+TEST(SinglePoller_EmptyBeforeFirstPoll)
+{
+	ControllerSystem system(0);
+	single_poller<vr::VRControllerState_t> poller;
+
+	// The first poll is stuck in the query, the other callers must not wait for it
+	system.Blocked = true;
+	std::thread first([&]()
+	{
+		vr::VRControllerState_t state;
+		poller.poll(&state, [&](vr::VRControllerState_t* s) { return QueryController(system, s); });
+	});
+	while (system.Active == 0)
+		std::this_thread::yield();
+
+	vr::VRControllerState_t state = {};
+	state.unPacketNum = 1234;
+	CHECK(!poller.poll(&state, [&](vr::VRControllerState_t* s) { return QueryController(system, s); }));
+	CHECK_EQUAL(state.unPacketNum, 1234);
+	CHECK_EQUAL(system.Queries, 0);
+
+	system.Blocked = false;
+	first.join();
+
+	// Once published the other callers get the last state while the next poll is running
+	system.Blocked = true;
+	std::thread second([&]()
+	{
+		vr::VRControllerState_t state;
+		poller.poll(&state, [&](vr::VRControllerState_t* s) { return QueryController(system, s); });
+	});
+	while (system.Active == 0)
+		std::this_thread::yield();
+
+	CHECK(poller.poll(&state, [&](vr::VRControllerState_t* s) { return QueryController(system, s); }));
+	CHECK_EQUAL(state.unPacketNum, 1);
+
+	system.Blocked = false;
+	second.join();
+	CHECK_EQUAL(system.Queries, 2);
+	CHECK_EQUAL(system.MaxActive, 1);
+}
+
+// Returns the average time of a poll in microseconds
+template<typename F>
+static double RunReaders(int readers, F poll)
+{
+	std::vector<std::thread> threads;
+	std::vector<double> elapsed(readers);
+	for (int r = 0; r < readers; r++)
+	{
+		threads.emplace_back([&poll, &elapsed, r]()
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int i = 0; i < CONTENTION_POLLS; i++)
+				poll();
+			elapsed[r] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		});
+	}
+	for (std::thread& t : threads)
+		t.join();
+
+	double total = 0.0;
+	for (double e : elapsed)
+		total += e;
+	return total / (readers * CONTENTION_POLLS);
+}
+
+/*
+	Compares the poller against serializing every caller on a mutex, like the input polling did
+	before. Only the invariants are checked, the timings depend too much on the machine.
+*/
+TEST(SinglePoller_ContentionBenchmark)
+{
+	const int counts[] = { 1, 2, 4, 8 };
+	for (int readers : counts)
+	{
+		ControllerSystem shared(CONTENTION_IPC_US);
+		single_poller<vr::VRControllerState_t> poller;
+		std::atomic_int stale(0);
+		double polled = RunReaders(readers, [&]()
+		{
+			vr::VRControllerState_t state = {};
+			if (!poller.poll(&state, [&](vr::VRControllerState_t* s) { return QueryController(shared, s); }))
+				return;
+
+			// A state can be older than the last query, but never from a query that didn't finish
+			if (state.unPacketNum == 0 || state.unPacketNum > (uint32_t)shared.Queries)
+				stale++;
+		});
+
+		ControllerSystem locked(CONTENTION_IPC_US);
+		std::mutex mutex;
+		double serialized = RunReaders(readers, [&]()
+		{
+			std::lock_guard<std::mutex> lk(mutex);
+			vr::VRControllerState_t state;
+			QueryController(locked, &state);
+		});
+
+		printf("  %d reader(s): %.2f us and %.3f queries per poll, %.2f us with a mutex\n",
+			readers, polled, double(shared.Queries) / (readers * CONTENTION_POLLS), serialized);
+
+		CHECK_EQUAL(stale, 0);
+		CHECK_EQUAL(shared.MaxActive, 1);
+		CHECK(shared.Queries <= readers * CONTENTION_POLLS);
+		CHECK_EQUAL(locked.Queries, readers * CONTENTION_POLLS);
+	}
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+	Subset of the OpenVR API used by the classes under test. The tests link against their
+	own implementations of the interfaces instead of the runtime, so they can feed recorded
+	or synthetic data without SteamVR. Values match the OpenVR headers.
+
+	The interface methods do nothing by default, so a stub only overrides the calls it expects.
+*/
+namespace vr
+{
+	typedef uint32_t TrackedDeviceIndex_t;
+	static const uint32_t k_unTrackedDeviceIndex_Hmd = 0;
+	static const uint32_t k_unMaxTrackedDeviceCount = 64;
+	static const uint32_t k_unTrackedDeviceIndexInvalid = 0xFFFFFFFF;
+	static const uint32_t k_unMaxApplicationKeyLength = 128;
+
+	typedef uint64_t VROverlayHandle_t;
+	static const VROverlayHandle_t k_ulOverlayHandleInvalid = 0;
+
+	struct HmdMatrix34_t
+	{
+		float m[3][4];
+	};
+
+	struct HmdMatrix44_t
+	{
+		float m[4][4];
+	};
+
+	struct HmdVector3_t
+	{
+		float v[3];
+	};
+
+	struct HmdVector4_t
+	{
+		float v[4];
+	};
+
+	struct VRTextureBounds_t
+	{
+		float uMin, vMin;
+		float uMax, vMax;
+	};
+
+	enum EVRButtonId
+	{
+		k_EButton_System = 0,
+		k_EButton_ApplicationMenu = 1,
+		k_EButton_Grip = 2,
+		k_EButton_DPad_Left = 3,
+		k_EButton_DPad_Up = 4,
+		k_EButton_DPad_Right = 5,
+		k_EButton_DPad_Down = 6,
+		k_EButton_A = 7,
+
+		k_EButton_ProximitySensor = 31,
+
+		k_EButton_Axis0 = 32,
+		k_EButton_Axis1 = 33,
+		k_EButton_Axis2 = 34,
+		k_EButton_Axis3 = 35,
+		k_EButton_Axis4 = 36,
+
+		k_EButton_SteamVR_Touchpad = k_EButton_Axis0,
+		k_EButton_SteamVR_Trigger = k_EButton_Axis1,
+
+		k_EButton_Max = 64
+	};
+
+	enum EVRControllerAxisType
+	{
+		k_eControllerAxis_None = 0,
+		k_eControllerAxis_TrackPad = 1,
+		k_eControllerAxis_Joystick = 2,
+		k_eControllerAxis_Trigger = 3,
+	};
+
+	struct VRControllerAxis_t
+	{
+		float x;
+		float y;
+	};
+
+	static const uint32_t k_unControllerStateAxisCount = 5;
+
+	struct VRControllerState001_t
+	{
+		uint32_t unPacketNum;
+		uint64_t ulButtonPressed;
+		uint64_t ulButtonTouched;
+		VRControllerAxis_t rAxis[k_unControllerStateAxisCount];
+	};
+	typedef VRControllerState001_t VRControllerState_t;
+
+	inline uint64_t ButtonMaskFromId(EVRButtonId id) { return 1ull << id; }
+
+	enum ETrackedDeviceProperty
+	{
+		Prop_SecondsFromVsyncToPhotons_Float = 2001,
+		Prop_DisplayFrequency_Float = 2002,
+	};
+
+	enum ETrackedPropertyError
+	{
+		TrackedProp_Success = 0,
+	};
+
+	enum EVRCompositorError
+	{
+		VRCompositorError_None = 0,
+		VRCompositorError_DoNotHaveFocus = 101,
+	};
+
+	enum ETrackingResult
+	{
+		TrackingResult_Uninitialized = 1,
+		TrackingResult_Calibrating_InProgress = 100,
+		TrackingResult_Calibrating_OutOfRange = 101,
+		TrackingResult_Running_OK = 200,
+		TrackingResult_Running_OutOfRange = 201,
+	};
+
+	enum ETrackingUniverseOrigin
+	{
+		TrackingUniverseSeated = 0,
+		TrackingUniverseStanding = 1,
+		TrackingUniverseRawAndUncalibrated = 2,
+	};
+
+	struct TrackedDevicePose_t
+	{
+		HmdMatrix34_t mDeviceToAbsoluteTracking;
+		HmdVector3_t vVelocity;
+		HmdVector3_t vAngularVelocity;
+		ETrackingResult eTrackingResult;
+		bool bPoseIsValid;
+		bool bDeviceIsConnected;
+	};
+
+	enum EVROverlayError
+	{
+		VROverlayError_None = 0,
+	};
+
+	enum EVRSettingsError
+	{
+		VRSettingsError_None = 0,
+		VRSettingsError_UnsetSettingHasNoDefault = 2,
+	};
+
+	enum EVRApplicationError
+	{
+		VRApplicationError_None = 0,
+		VRApplicationError_UnknownApplication = 101,
+	};
+
+	struct Compositor_FrameTiming
+	{
+		uint32_t m_nSize;
+		uint32_t m_nFrameIndex;
+		uint32_t m_nNumFramePresents;
+		uint32_t m_nNumMisPresented;
+		uint32_t m_nNumDroppedFrames;
+		uint32_t m_nReprojectionFlags;
+		double m_flSystemTimeInSeconds;
+		float m_flPreSubmitGpuMs;
+		float m_flPostSubmitGpuMs;
+		float m_flTotalRenderGpuMs;
+		float m_flCompositorRenderGpuMs;
+		float m_flCompositorRenderCpuMs;
+		float m_flCompositorIdleCpuMs;
+	};
+
+	struct Compositor_CumulativeStats
+	{
+		uint32_t m_nPid;
+		uint32_t m_nNumFramePresents;
+		uint32_t m_nNumDroppedFrames;
+		uint32_t m_nNumReprojectedFrames;
+	};
+
+	class IVRSystem
+	{
+	public:
+		virtual float GetFloatTrackedDeviceProperty(TrackedDeviceIndex_t unDeviceIndex, ETrackedDeviceProperty prop, ETrackedPropertyError* pError = 0L) { return 0.0f; }
+		virtual bool GetTimeSinceLastVsync(float* pfSecondsSinceLastVsync, uint64_t* pulFrameCounter) { return false; }
+		virtual bool GetControllerState(TrackedDeviceIndex_t unControllerDeviceIndex, VRControllerState_t* pControllerState, uint32_t unControllerStateSize) { return false; }
+		virtual void GetDeviceToAbsoluteTrackingPose(ETrackingUniverseOrigin eOrigin, float fPredictedSecondsToPhotonsFromNow,
+			TrackedDevicePose_t* pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) { }
+	};
+
+	class IVRCompositor
+	{
+	public:
+		virtual EVRCompositorError WaitGetPoses(TrackedDevicePose_t* pRenderPoseArray, uint32_t unRenderPoseArrayCount,
+			TrackedDevicePose_t* pGamePoseArray, uint32_t unGamePoseArrayCount) { return VRCompositorError_None; }
+		virtual bool GetFrameTiming(Compositor_FrameTiming* pTiming, uint32_t unFramesAgo = 0) { return false; }
+		virtual uint32_t GetFrameTimings(Compositor_FrameTiming* pTiming, uint32_t nFrames) { return 0; }
+		virtual float GetFrameTimeRemaining() { return 0.0f; }
+		virtual void GetCumulativeStats(Compositor_CumulativeStats* pStats, uint32_t nStatsSizeInBytes) { }
+		virtual uint32_t GetCurrentSceneFocusProcess() { return 0; }
+	};
+
+	class IVROverlay
+	{
+	public:
+		virtual EVROverlayError SetOverlaySortOrder(VROverlayHandle_t ulOverlayHandle, uint32_t unSortOrder) { return VROverlayError_None; }
+		virtual EVROverlayError SetOverlayWidthInMeters(VROverlayHandle_t ulOverlayHandle, float fWidthInMeters) { return VROverlayError_None; }
+		virtual EVROverlayError SetOverlayCurvature(VROverlayHandle_t ulOverlayHandle, float fCurvature) { return VROverlayError_None; }
+		virtual EVROverlayError SetOverlayTexelAspect(VROverlayHandle_t ulOverlayHandle, float fTexelAspect) { return VROverlayError_None; }
+		virtual EVROverlayError SetOverlayTransformAbsolute(VROverlayHandle_t ulOverlayHandle, ETrackingUniverseOrigin eTrackingOrigin,
+			const HmdMatrix34_t* pmatTrackingOriginToOverlayTransform) { return VROverlayError_None; }
+		virtual EVROverlayError SetOverlayTransformTrackedDeviceRelative(VROverlayHandle_t ulOverlayHandle, TrackedDeviceIndex_t unTrackedDevice,
+			const HmdMatrix34_t* pmatTrackedDeviceToOverlayTransform) { return VROverlayError_None; }
+		virtual EVROverlayError SetOverlayTextureBounds(VROverlayHandle_t ulOverlayHandle, const VRTextureBounds_t* pOverlayTextureBounds) { return VROverlayError_None; }
+		virtual EVROverlayError ShowOverlay(VROverlayHandle_t ulOverlayHandle) { return VROverlayError_None; }
+		virtual EVROverlayError HideOverlay(VROverlayHandle_t ulOverlayHandle) { return VROverlayError_None; }
+	};
+
+	class IVRSettings
+	{
+	public:
+		virtual bool GetBool(const char* pchSection, const char* pchSettingsKey, EVRSettingsError* peError = nullptr) { return false; }
+		virtual int32_t GetInt32(const char* pchSection, const char* pchSettingsKey, EVRSettingsError* peError = nullptr) { return 0; }
+		virtual float GetFloat(const char* pchSection, const char* pchSettingsKey, EVRSettingsError* peError = nullptr) { return 0.0f; }
+		virtual void GetString(const char* pchSection, const char* pchSettingsKey, char* pchValue, uint32_t unValueLen, EVRSettingsError* peError = nullptr) { }
+	};
+
+	class IVRApplications
+	{
+	public:
+		virtual EVRApplicationError GetApplicationKeyByProcessId(uint32_t unProcessId, char* pchAppKeyBuffer, uint32_t unAppKeyBufferLen)
+			{ return VRApplicationError_UnknownApplication; }
+	};
+}
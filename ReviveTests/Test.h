@@ -0,0 +1,39 @@
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+/*
+	Minimal test harness, tests register themselves and are run by main().
+	A failed check is reported but doesn't abort the test, so all mismatches are listed.
+*/
+typedef void(*TestFunc)();
+
+struct TestCase
+{
+	const char* Name;
+	TestFunc Func;
+};
+
+std::vector<TestCase>& GetTests();
+extern int g_TestFailures;
+
+struct TestRegistrar
+{
+	TestRegistrar(const char* name, TestFunc func) { GetTests().push_back({ name, func }); }
+};
+
+#define TEST(name) \
+	static void Test_##name(); \
+	static TestRegistrar s_Registrar_##name(#name, Test_##name); \
+	static void Test_##name()
+
+#define CHECK(x) \
+	if (!(x)) { printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #x); g_TestFailures++; }
+
+#define CHECK_EQUAL(a, b) \
+	if (!((a) == (b))) { printf("%s(%d): CHECK_EQUAL(%s, %s) failed: %g != %g\n", __FILE__, __LINE__, #a, #b, double(a), double(b)); g_TestFailures++; }
+
+#define CHECK_NEAR(a, b, eps) \
+	if (!(fabs(double(a) - double(b)) <= (eps))) { printf("%s(%d): CHECK_NEAR(%s, %s) failed: %g != %g\n", __FILE__, __LINE__, #a, #b, double(a), double(b)); g_TestFailures++; }
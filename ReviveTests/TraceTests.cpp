@@ -0,0 +1,107 @@
+#include "Test.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+// Recording must stay cheap enough to leave enabled on the hot paths
+#define TRACE_EVENT_BUDGET_NS 50.0
+
+#define TRACE_BENCHMARK_EVENTS (1 << 20)
+#define TRACE_BENCHMARK_RUNS 5
+
+#define TRACE_TEST_FILE "ReviveTests.trace.json"
+
+static std::string ReadDump()
+{
+	std::string contents;
+	FILE* file = fopen(TRACE_TEST_FILE, "r");
+	if (!file)
+		return contents;
+
+	char chunk[4096];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		contents.append(chunk, read);
+	fclose(file);
+	return contents;
+}
+
+TEST(Trace_ThreadExit)
+{
+	TraceConfigure(true, 0.0f);
+	{
+		REV_TRACE_SCOPE("TraceTest/Main");
+	}
+
+	// Threads exit while dumps are being written, their buffers must stay valid until the dump is done
+	std::vector<std::thread> workers;
+	for (int i = 0; i < 8; i++)
+	{
+		workers.emplace_back([]()
+		{
+			for (int j = 0; j < 1000; j++)
+			{
+				REV_TRACE_SCOPE("TraceTest/Worker");
+			}
+		});
+		CHECK(TraceDump(TRACE_TEST_FILE));
+	}
+	for (std::thread& t : workers)
+		t.join();
+
+	// The buffers of the exited threads are freed, the main thread's buffer is still there
+	CHECK(TraceDump(TRACE_TEST_FILE));
+	std::string dump = ReadDump();
+	CHECK(dump.find("TraceTest/Main") != std::string::npos);
+	CHECK(dump.find("TraceTest/Worker") == std::string::npos);
+
+	TraceConfigure(false, 0.0f);
+	remove(TRACE_TEST_FILE);
+}
+
+TEST(Trace_EscapedNames)
+{
+	TraceConfigure(true, 0.0f);
+	{
+		REV_TRACE_SCOPE("TraceTest/\"Quoted\"\\Name\n");
+	}
+
+	// The name is escaped, so the dump stays valid JSON
+	CHECK(TraceDump(TRACE_TEST_FILE));
+	std::string dump = ReadDump();
+	CHECK(dump.find("\"name\":\"TraceTest/\\\"Quoted\\\"\\\\Name\\u000a\"") != std::string::npos);
+
+	TraceConfigure(false, 0.0f);
+	remove(TRACE_TEST_FILE);
+}
+
+TEST(Trace_RecordBenchmark)
+{
+	TraceConfigure(true, 0.0f);
+
+	// Take the best run, so the result isn't skewed by other processes
+	double best = 1e9;
+	for (int run = 0; run < TRACE_BENCHMARK_RUNS; run++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < TRACE_BENCHMARK_EVENTS / 2; i++)
+		{
+			REV_TRACE_SCOPE("TraceTest/Benchmark");
+		}
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		best = std::min(best, elapsed.count() / TRACE_BENCHMARK_EVENTS);
+	}
+	printf("  %.1f ns per event\n", best);
+
+	TraceConfigure(false, 0.0f);
+
+	// Only optimized builds are expected to meet the budget
+#ifdef NDEBUG
+	CHECK(best < TRACE_EVENT_BUDGET_NS);
+#endif
+}
@@ -0,0 +1,33 @@
+#include "Test.h"
+
+#include <string.h>
+
+int g_TestFailures = 0;
+
+std::vector<TestCase>& GetTests()
+{
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+int main(int argc, char** argv)
+{
+	// An optional argument only runs the tests that contain it in their name
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+
+	int failed = 0;
+	for (const TestCase& test : GetTests())
+	{
+		if (filter && !strstr(test.Name, filter))
+			continue;
+
+		int failures = g_TestFailures;
+		printf("%s\n", test.Name);
+		test.Func();
+		if (g_TestFailures != failures)
+			failed++;
+	}
+
+	printf("%d test(s) failed\n", failed);
+	return failed ? 1 : 0;
+}